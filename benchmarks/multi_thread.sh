@@ -1,16 +1,28 @@
 #!/bin/sh
 
+# Usage: multi_thread.sh [float|pin|all]
+# pin pins every IO loop of the server to its own cpu and steers the
+# connections by SO_INCOMING_CPU, all runs both modes.
+mode=${1:-float}
+if [ "$mode" = "all" ]; then
+  modes="float pin"
+else
+  modes=$mode
+fi
+
 killall server
 timeout=100
 bufsize=16384
 
-for nosessions in 10 100 1000; do
-  for nothreads in 1 2 3 4; do
-    sleep 5
-    echo "Bufsize: $bufsize Threads: $nothreads Sessions: $nosessions"
-    ../build/release/bin/server 127.0.0.1 55555 $nothreads & srvpid=$!
-    sleep 5
-    ../build/release/bin/client 127.0.0.1 55555 $nothreads $bufsize $nosessions $timeout 
-    kill -9 $srvpid
+for mode in $modes; do
+  for nosessions in 10 100 1000; do
+    for nothreads in 1 2 3 4; do
+      sleep 5
+      echo "Mode: $mode Bufsize: $bufsize Threads: $nothreads Sessions: $nosessions"
+      ../build/release/bin/server 127.0.0.1 55555 $nothreads $mode & srvpid=$!
+      sleep 5
+      ../build/release/bin/client 127.0.0.1 55555 $nothreads $bufsize $nosessions $timeout 
+      kill -9 $srvpid
+    done
   done
 done
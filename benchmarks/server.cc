@@ -2,8 +2,12 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <iostream>
+#include <vector>
 
+#include "voyager/core/bg_eventloop.h"
 #include "voyager/core/callback.h"
 #include "voyager/core/eventloop.h"
 #include "voyager/core/sockaddr.h"
@@ -23,6 +27,17 @@ class Server {
         std::bind(&Server::MessageCallback, this, _1, _2));
   }
 
+  // The acceptor loop stays on cpu 0 and the IO loops take the next ones.
+  void Pin(int thread_count) {
+    std::vector<int> cpus;
+    for (int i = 1; i < thread_count; ++i) {
+      cpus.push_back(i);
+    }
+    if (!cpus.empty()) {
+      server_.SetCpuAffinity(cpus, true);
+    }
+  }
+
   void Start() { server_.Start(); }
 
  private:
@@ -40,17 +55,24 @@ class Server {
 };
 
 int main(int argc, char** argv) {
-  if (argc != 4) {
-    std::cerr << "Usage: server <host> <port> <threads>\n";
+  if (argc != 4 && argc != 5) {
+    std::cerr << "Usage: server <host> <port> <threads> [pin]\n";
     return 1;
   }
+  bool pin = argc == 5 && strcmp(argv[4], "pin") == 0;
   const char* host = argv[1];
   uint16_t port = static_cast<uint16_t>(atoi(argv[2]));
   int thread_count = atoi(argv[3]);
 
+  if (pin) {
+    voyager::BGEventLoop::SetThreadAffinity(0);
+  }
   voyager::SockAddr addr(host, port);
   voyager::EventLoop ev;
   Server server(&ev, addr, "server", thread_count - 1);
+  if (pin) {
+    server.Pin(thread_count);
+  }
 
   server.Start();
   ev.Loop();
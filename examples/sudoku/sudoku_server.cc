@@ -2,6 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "examples/sudoku/sudoku_solver.h"
 #include "voyager/core/buffer.h"
 #include "voyager/core/callback.h"
@@ -9,6 +14,7 @@
 #include "voyager/core/sockaddr.h"
 #include "voyager/core/tcp_connection.h"
 #include "voyager/core/tcp_server.h"
+#include "voyager/core/thread_pool.h"
 #include "voyager/util/logging.h"
 #include "voyager/util/string_util.h"
 
@@ -16,21 +22,46 @@ namespace sudoku {
 
 class SudukuServer {
  public:
-  SudukuServer(voyager::EventLoop* ev, const voyager::SockAddr& addr)
-      : server_(ev, addr, "SudukuServer", 4) {
+  SudukuServer(voyager::EventLoop* ev, const voyager::SockAddr& addr,
+               int compute_threads)
+      : server_(ev, addr, "SudukuServer", 4), pool_(compute_threads) {
     server_.SetConnectionCallback(
         std::bind(&SudukuServer::ConnectCallback, this, std::placeholders::_1));
+    server_.SetCloseCallback(
+        std::bind(&SudukuServer::CloseCallback, this, std::placeholders::_1));
     server_.SetMessageCallback(std::bind(&SudukuServer::MessageCallback, this,
                                          std::placeholders::_1,
                                          std::placeholders::_2));
   }
 
-  void Start() { server_.Start(); }
+  void Start() {
+    pool_.Start();
+    server_.Start();
+  }
 
  private:
   static const int kCells = 81;
 
-  void ConnectCallback(const voyager::TcpConnectionPtr& ptr) {}
+  // The pool may solve pipelined puzzles out of order. Those without an id
+  // are answered in the order they came, a reply solved early waits in
+  // ready until the ones before it are sent. Only touched in the loop of
+  // the connection.
+  struct Session {
+    Session() : next(0), sent(0) {}
+    uint64_t next;
+    uint64_t sent;
+    std::map<uint64_t, std::string> ready;
+  };
+  typedef std::shared_ptr<Session> SessionPtr;
+
+  void ConnectCallback(const voyager::TcpConnectionPtr& ptr) {
+    ptr->SetContext(new SessionPtr(new Session()));
+  }
+
+  void CloseCallback(const voyager::TcpConnectionPtr& ptr) {
+    delete static_cast<SessionPtr*>(ptr->Context());
+    ptr->SetContext(nullptr);
+  }
 
   void MessageCallback(const voyager::TcpConnectionPtr& ptr,
                        voyager::Buffer* buf) {
@@ -69,17 +100,34 @@ class SudukuServer {
     if (puzzle.size() != static_cast<size_t>(kCells)) {
       return false;
     }
-    SudokuSolver solver(puzzle);
-    std::string res = solver.Solve();
-    if (id.empty()) {
-      ptr->SendMessage(res + "\r\n");
-    } else {
-      ptr->SendMessage(id + ":" + res + "\r\n");
+    // Solve in the pool, so the IO loop keeps serving the other connections,
+    // and reply in the loop of the connection.
+    auto solve = pool_.Submit([puzzle]() {
+      SudokuSolver solver(puzzle);
+      return solver.Solve();
+    });
+    if (!id.empty()) {
+      solve.Then(ptr->OwnerEventLoop(), [ptr, id](std::string res) {
+        ptr->SendMessage(id + ":" + res + "\r\n");
+      });
+      return true;
     }
+    SessionPtr session(*static_cast<SessionPtr*>(ptr->Context()));
+    uint64_t seq = session->next++;
+    solve.Then(ptr->OwnerEventLoop(), [ptr, session, seq](std::string res) {
+      session->ready[seq] = std::move(res);
+      std::map<uint64_t, std::string>::iterator it = session->ready.begin();
+      while (it != session->ready.end() && it->first == session->sent) {
+        ptr->SendMessage(it->second + "\r\n");
+        it = session->ready.erase(it);
+        ++session->sent;
+      }
+    });
     return true;
   }
 
   voyager::TcpServer server_;
+  voyager::ThreadPool pool_;
 };
 
 }  // namespace sudoku
@@ -87,7 +135,8 @@ class SudukuServer {
 int main(int argc, char** argv) {
   voyager::EventLoop ev;
   voyager::SockAddr addr(5666);
-  sudoku::SudukuServer server(&ev, addr);
+  int compute_threads = argc > 1 ? atoi(argv[1]) : 4;
+  sudoku::SudukuServer server(&ev, addr, compute_threads);
   server.Start();
   ev.Loop();
   return 0;
@@ -106,6 +106,34 @@ int BaseSocket::SetTcpNoDelay(bool on) const {
   return 0;
 }
 
+int BaseSocket::SetBusyPoll(int micros) const {
+#ifdef SO_BUSY_POLL
+  if (::setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &micros,
+                   static_cast<socklen_t>(sizeof(micros))) == -1) {
+    VOYAGER_LOG(ERROR) << "setsockopt(SO_BUSY_POLL): " << strerror(errno);
+    return -1;
+  }
+  return 0;
+#else
+  (void)micros;
+  VOYAGER_LOG(ERROR) << "SO_BUSY_POLL isn't supported";
+  return -1;
+#endif
+}
+
+int BaseSocket::IncomingCpu() const {
+#ifdef SO_INCOMING_CPU
+  int cpu = -1;
+  socklen_t len = static_cast<socklen_t>(sizeof(cpu));
+  if (::getsockopt(fd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == -1) {
+    return -1;
+  }
+  return cpu;
+#else
+  return -1;
+#endif
+}
+
 int BaseSocket::CheckSocketError() const {
   int err = 0;
   socklen_t errlen = static_cast<socklen_t>(sizeof(err));
@@ -28,9 +28,16 @@ class BaseSocket {
   int SetReusePort(bool on) const;
   int SetKeepAlive(bool on) const;
   int SetTcpNoDelay(bool on) const;
+  // SO_BUSY_POLL, lets the kernel busy poll the device queue for up to
+  // micros on a blocking read. Only on Linux, -1 elsewhere.
+  int SetBusyPoll(int micros) const;
 
   int CheckSocketError() const;
 
+  // SO_INCOMING_CPU, the cpu which handled the packets of the socket, or -1
+  // if it is unknown.
+  int IncomingCpu() const;
+
   struct sockaddr_storage PeerSockAddr() const;
   struct sockaddr_storage LocalSockAddr() const;
   bool IsSelfConnect() const;
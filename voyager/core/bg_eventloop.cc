@@ -5,10 +5,18 @@
 #include "voyager/core/bg_eventloop.h"
 
 #include <assert.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <string.h>
+
+#include "voyager/util/logging.h"
 
 namespace voyager {
 
-BGEventLoop::BGEventLoop(PollType type) : type_(type), eventloop_(nullptr) {}
+BGEventLoop::BGEventLoop(PollType type, int cpu)
+    : type_(type), cpu_(cpu), eventloop_(nullptr) {}
 
 BGEventLoop::~BGEventLoop() {
   if (eventloop_ != nullptr) {
@@ -31,7 +39,29 @@ EventLoop* BGEventLoop::Loop() {
   return eventloop_;
 }
 
+bool BGEventLoop::SetThreadAffinity(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  if (err != 0) {
+    VOYAGER_LOG(ERROR) << "pthread_setaffinity_np(" << cpu
+                       << "): " << strerror(err);
+    return false;
+  }
+  return true;
+#else
+  VOYAGER_LOG(WARN) << "BGEventLoop::SetThreadAffinity - unsupported";
+  return false;
+#endif
+}
+
 void BGEventLoop::ThreadFunc() {
+  // Pin before the EventLoop exists, so its memory is node-local.
+  if (cpu_ >= 0) {
+    SetThreadAffinity(cpu_);
+  }
   EventLoop ev(type_);
   {
     std::unique_lock<std::mutex> lock(mutex_);
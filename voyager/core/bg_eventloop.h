@@ -16,15 +16,25 @@ namespace voyager {
 
 class BGEventLoop {
  public:
-  explicit BGEventLoop(PollType type = kEpoll);
+  // The thread is pinned to cpu unless it is -1. The EventLoop and all the
+  // memory it first touches, such as the buffers of the connections created
+  // in it, then come from the NUMA node of that cpu.
+  explicit BGEventLoop(PollType type = kEpoll, int cpu = -1);
   ~BGEventLoop();
 
   EventLoop* Loop();
 
+  int Cpu() const { return cpu_; }
+
+  // Pins the calling thread to cpu, returns false on failure or on the
+  // platforms without pthread_setaffinity_np().
+  static bool SetThreadAffinity(int cpu);
+
  private:
   void ThreadFunc();
 
   PollType type_;
+  const int cpu_;
   EventLoop* eventloop_;
   std::mutex mutex_;
   std::condition_variable cv_;
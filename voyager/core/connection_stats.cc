@@ -0,0 +1,80 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/connection_stats.h"
+
+#include <algorithm>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/util/stringprintf.h"
+
+namespace voyager {
+
+uint64_t ConnectionStatsValue(const TcpConnectionStats& stats,
+                              ConnectionStatsKey key) {
+  switch (key) {
+    case kSortByBytesIn:
+      return stats.bytes_in;
+    case kSortByBytesOut:
+      return stats.bytes_out;
+    case kSortByReads:
+      return stats.reads;
+    case kSortByWrites:
+      return stats.writes;
+    case kSortByCallbackNanos:
+      return stats.callback_nanos;
+  }
+  return 0;
+}
+
+void TopConnections(const EventLoop* loop, size_t n, ConnectionStatsKey key,
+                    std::vector<ConnectionStatsEntry>* top,
+                    const void* owner) {
+  std::vector<ConnectionStatsEntry> entries;
+  loop->ForEachConnection([&entries, owner](const TcpConnectionPtr& ptr) {
+    if (owner != nullptr && ptr->Owner() != owner) {
+      return;
+    }
+    ConnectionStatsEntry entry;
+    entry.name = ptr->name();
+    entry.peer = ptr->PeerSockAddr().Ipbuf();
+    entry.stats = ptr->Stats();
+    entries.push_back(entry);
+  });
+  SortConnections(n, key, &entries);
+  top->insert(top->end(), entries.begin(), entries.end());
+}
+
+void SortConnections(size_t n, ConnectionStatsKey key,
+                     std::vector<ConnectionStatsEntry>* entries) {
+  size_t size = std::min(n, entries->size());
+  std::partial_sort(
+      entries->begin(), entries->begin() + static_cast<ptrdiff_t>(size),
+      entries->end(),
+      [key](const ConnectionStatsEntry& a, const ConnectionStatsEntry& b) {
+        return ConnectionStatsValue(a.stats, key) >
+               ConnectionStatsValue(b.stats, key);
+      });
+  entries->resize(size);
+}
+
+std::string ConnectionStatsReport(
+    const std::vector<ConnectionStatsEntry>& entries) {
+  std::string s;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const TcpConnectionStats& stats = entries[i].stats;
+    StringAppendF(
+        &s, "%s peer=%s in=%llu out=%llu reads=%llu writes=%llu cb_us=%llu\n",
+        entries[i].name.c_str(), entries[i].peer.c_str(),
+        static_cast<unsigned long long>(stats.bytes_in),
+        static_cast<unsigned long long>(stats.bytes_out),
+        static_cast<unsigned long long>(stats.reads),
+        static_cast<unsigned long long>(stats.writes),
+        static_cast<unsigned long long>(stats.callback_nanos / 1000));
+  }
+  return s;
+}
+
+}  // namespace voyager
@@ -0,0 +1,68 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_CONNECTION_STATS_H_
+#define VOYAGER_CORE_CONNECTION_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace voyager {
+
+class EventLoop;
+
+// The resources used by one connection. These are plain fields which only
+// the loop thread updates, so counting costs a few adds. callback_nanos is
+// the time spent in the message and write complete callbacks, and is only
+// measured while the stats of the loop are enabled, see
+// EventLoop::EnableStats().
+struct TcpConnectionStats {
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t callback_nanos;
+
+  TcpConnectionStats()
+      : bytes_in(0), bytes_out(0), reads(0), writes(0), callback_nanos(0) {}
+};
+
+enum ConnectionStatsKey {
+  kSortByBytesIn,
+  kSortByBytesOut,
+  kSortByReads,
+  kSortByWrites,
+  kSortByCallbackNanos
+};
+
+struct ConnectionStatsEntry {
+  std::string name;
+  std::string peer;
+  TcpConnectionStats stats;
+};
+
+uint64_t ConnectionStatsValue(const TcpConnectionStats& stats,
+                              ConnectionStatsKey key);
+
+// Appends the n connections of loop with the largest key to top, sorted in
+// descending order. With owner, only the connections of that TcpServer.
+// Only in the loop thread.
+void TopConnections(const EventLoop* loop, size_t n, ConnectionStatsKey key,
+                    std::vector<ConnectionStatsEntry>* top,
+                    const void* owner = nullptr);
+
+// Sorts entries by key and keeps the first n.
+void SortConnections(size_t n, ConnectionStatsKey key,
+                     std::vector<ConnectionStatsEntry>* entries);
+
+// One line per connection.
+std::string ConnectionStatsReport(
+    const std::vector<ConnectionStatsEntry>& entries);
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_CONNECTION_STATS_H_
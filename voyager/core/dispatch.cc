@@ -16,6 +16,7 @@ Dispatch::Dispatch(EventLoop* eventloop, int fd)
       index_(-1),
       modify_(kNoModify),
       add_write_(false),
+      name_(nullptr),
       tied_(false),
       event_handling_(false) {}
 
@@ -71,6 +71,11 @@ class Dispatch {
 
   int Modify() const { return modify_; }
 
+  // The owner of the fd, reported by StallDetector. The string must outlive
+  // the Dispatch.
+  void SetName(const char* name) { name_ = name; }
+  const char* Name() const { return name_; }
+
  private:
   void UpdateEvents();
   void HandleEventWithGuard();
@@ -86,6 +91,7 @@ class Dispatch {
   int index_;
   ModifyEvent modify_;
   bool add_write_;
+  const char* name_;
 
   std::weak_ptr<void> tie_;
   bool tied_;
@@ -7,6 +7,7 @@
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -15,9 +16,12 @@
 #include "voyager/core/dispatch.h"
 #include "voyager/core/event_poll.h"
 #include "voyager/core/event_select.h"
+#include "voyager/core/eventloop_stats.h"
+#include "voyager/core/stall_detector.h"
 #include "voyager/core/tcp_connection.h"
 #include "voyager/core/timerlist.h"
 #include "voyager/util/logging.h"
+#include "voyager/util/macros.h"
 #include "voyager/util/timeops.h"
 
 #ifdef __linux__
@@ -31,6 +35,17 @@ namespace {
 
 __thread EventLoop* runloop = nullptr;
 
+// The CPU clock of the calling thread. Another thread's clock can not be
+// read safely, the thread may have exited and its id been reused.
+uint64_t CurrentThreadCpuNanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000 +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
 class IgnoreSIGPIPE {
  public:
   IgnoreSIGPIPE() { ::signal(SIGPIPE, SIG_IGN); }
@@ -73,9 +88,27 @@ EventLoop::EventLoop(PollType type)
       type_(type),
       exit_(false),
       run_(false),
+      looping_(false),
+      now_(timeops::NowMicros()),
+      monotonic_now_(timeops::MonotonicMicros()),
+      stats_enabled_(false),
+      stats_(new EventLoopStatsRecorder()),
+      recorder_(nullptr),
+      thread_cpu_nanos_(0),
+      thread_cpu_base_(0),
+      lag_enabled_(false),
+      lag_micros_(0),
+      busy_since_(0),
+      blocking_(false),
+      busy_poll_nanos_(0),
+      spin_nanos_(0),
       connection_size_(0),
       poller_(CreatePoller(type, this)),
-      timers_(new TimerList(this)) {
+      timers_(new TimerList(this)),
+      has_high_funcs_(false),
+      funcs_backlog_(0),
+      funcs_budget_nanos_(0),
+      deferred_funcs_(false) {
   if (::socketpair(AF_UNIX, SOCK_STREAM, 0, wakeup_fd_) == -1) {
     VOYAGER_LOG(FATAL) << "socketpair failed";
   }
@@ -97,6 +130,9 @@ EventLoop::~EventLoop() {
   runloop = nullptr;
   VOYAGER_LOG(DEBUG) << "EventLoop " << this << " of thread " << tid_
                      << " destructs in thread " << std::this_thread::get_id();
+  if (stall_watch_) {
+    stall_watch_->Unwatch();
+  }
 
   wakeup_dispatch_->DisableAll();
   wakeup_dispatch_->RemoveEvents();
@@ -107,22 +143,107 @@ EventLoop::~EventLoop() {
 void EventLoop::Loop() {
   AssertInMyLoop();
   exit_ = false;
+  looping_ = true;
+  UpdateTime();
   std::vector<Dispatch*> dispatches;
 
+  uint64_t busy_start = 0;
+
   while (!exit_) {
     dispatches.clear();
+    recorder_ = stats_enabled_.load(std::memory_order_relaxed) ? stats_.get()
+                                                               : nullptr;
     static const uint64_t kPollTimeMs = 5000;
-    uint64_t t = (timers_->TimeoutMicros() / 1000);
-    int timeout = static_cast<int>(std::min(t, kPollTimeMs));
-    poller_->Poll(timeout, &dispatches);
+#ifdef __linux__
+    // The timerfd of timers_ wakes up the poller at the earliest deadline.
+    int timeout = static_cast<int>(kPollTimeMs);
+#else
+    // Round up, or a timer less than 1ms away makes the poller spin with
+    // timeout 0 until it expires.
+    uint64_t t = timers_->TimeoutMicros();
+    t = t > kPollTimeMs * 1000 ? kPollTimeMs : (t + 999) / 1000;
+    int timeout = static_cast<int>(t);
+#endif
+    if (deferred_funcs_) {
+      timeout = 0;
+    }
+    uint64_t budget = busy_poll_nanos_.load(std::memory_order_relaxed);
+    // The deferred functors are due now, a spin would only delay them.
+    bool spin = budget != 0 && !deferred_funcs_;
+    bool ready = false;
+    if (VOYAGER_PREDICT_FALSE(spin)) {
+      ready = BusyPoll(budget, &dispatches);
+    }
+    uint64_t poll_start = 0;
+    if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr || budget != 0)) {
+      poll_start = timeops::TscNanos();
+      if (recorder_ != nullptr && busy_start != 0) {
+        AtomicHistogram::Increase(&recorder_->busy_nanos,
+                                  poll_start - busy_start);
+      }
+    }
+    if (!ready) {
+      if (!sources_.empty() && timeout != 0) {
+        // Announce the block before the last look at the sources, so a
+        // producer either sees blocking_ and wakes us up, or its message is
+        // seen here.
+        blocking_.store(true);
+        if (SourcesPending()) {
+          timeout = 0;
+        }
+      }
+      poller_->Poll(timeout, &dispatches);
+      blocking_.store(false, std::memory_order_relaxed);
+    }
+    UpdateTime();
+    bool lag = lag_enabled_.load(std::memory_order_relaxed);
+    if (VOYAGER_PREDICT_FALSE(lag)) {
+      busy_since_.store(monotonic_now_, std::memory_order_relaxed);
+    }
+    if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr || budget != 0)) {
+      busy_start = timeops::TscNanos();
+      if (recorder_ != nullptr) {
+        AtomicHistogram::Increase(&recorder_->blocked_nanos,
+                                  busy_start - poll_start);
+        AtomicHistogram::Increase(&recorder_->iterations, 1);
+        recorder_->poll_events.Add(dispatches.size());
+      }
+      if (spin && !ready) {
+        AdaptBusyPoll(budget, busy_start - poll_start);
+      }
+    } else {
+      busy_start = 0;
+    }
+#ifndef __linux__
     timers_->RunTimerProcs();
+#endif
+    if (has_high_funcs_.load(std::memory_order_relaxed)) {
+      RunFuncs(true);
+    }
 
     for (std::vector<Dispatch*>::iterator it = dispatches.begin();
          it != dispatches.end(); ++it) {
-      (*it)->HandleEvent();
+      if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr || stall_watch_)) {
+        HandleEvent(*it);
+      } else {
+        (*it)->HandleEvent();
+      }
+    }
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      sources_[i]->Drain();
+    }
+    RunFuncs(false);
+    if (VOYAGER_PREDICT_FALSE(lag)) {
+      UpdateLag();
+    }
+    if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+      thread_cpu_nanos_.store(CurrentThreadCpuNanos(),
+                              std::memory_order_relaxed);
     }
-    RunFuncs();
   }
+  busy_since_.store(0, std::memory_order_relaxed);
+  recorder_ = nullptr;
+  looping_ = false;
 }
 
 void EventLoop::Exit() {
@@ -141,17 +262,10 @@ void EventLoop::RunInLoop(const Func& func) {
 }
 
 void EventLoop::QueueInLoop(const Func& func) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    funcs_.push_back(func);
-  }
-
-  // "必要时"有两种情况：
-  // 1、如果调用QueueInLoop()的线程不是IO线程，那么唤醒是必需的；
-  // 2、如果在IO线程调用QueueInLoop(),而此时正在调用RunFuncs
-  if (!IsInMyLoop() || run_) {
-    WakeUp();
-  }
+  QueuedFunc f;
+  f.func = func;
+  f.deadline = 0;
+  Queue(std::move(f), kNormalPriority);
 }
 
 void EventLoop::RunInLoop(Func&& func) {
@@ -163,50 +277,195 @@ void EventLoop::RunInLoop(Func&& func) {
 }
 
 void EventLoop::QueueInLoop(Func&& func) {
+  QueuedFunc f;
+  f.func = std::move(func);
+  f.deadline = 0;
+  Queue(std::move(f), kNormalPriority);
+}
+
+void EventLoop::QueueInLoop(Func&& func, FuncPriority priority,
+                            uint64_t micros_timeout, Func&& expired) {
+  QueuedFunc f;
+  f.func = std::move(func);
+  f.deadline =
+      micros_timeout == 0 ? 0 : timeops::MonotonicMicros() + micros_timeout;
+  f.expired = std::move(expired);
+  Queue(std::move(f), priority);
+}
+
+void EventLoop::Queue(QueuedFunc&& func, FuncPriority priority) {
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    funcs_.push_back(std::move(func));
+    funcs_[priority].push_back(std::move(func));
+    funcs_backlog_.fetch_add(1, std::memory_order_relaxed);
+    if (priority == kHighPriority) {
+      has_high_funcs_.store(true, std::memory_order_relaxed);
+    }
   }
   // "必要时"有两种情况：
   // 1、如果调用QueueInLoop()的线程不是IO线程，那么唤醒是必需的；
-  // 2、如果在IO线程调用QueueInLoop(),而此时正在调用RunFuncQueue
+  // 2、如果在IO线程调用QueueInLoop(),而此时正在调用RunFuncs
   if (!IsInMyLoop() || run_) {
     WakeUp();
   }
 }
 
 TimerId EventLoop::RunAt(uint64_t micros_value, const TimerProcCallback& cb) {
-  return timers_->Insert(micros_value, 0, cb);
+  return timers_->Insert(WallToMonotonic(micros_value), 0, cb);
 }
 
 TimerId EventLoop::RunAfter(uint64_t micros_delay,
                             const TimerProcCallback& cb) {
-  uint64_t micros_value = timeops::NowMicros() + micros_delay;
+  uint64_t micros_value = timeops::MonotonicMicros() + micros_delay;
   return timers_->Insert(micros_value, 0, cb);
 }
 
 TimerId EventLoop::RunEvery(uint64_t micros_interval,
                             const TimerProcCallback& cb) {
-  uint64_t micros_value = timeops::NowMicros() + micros_interval;
+  uint64_t micros_value = timeops::MonotonicMicros() + micros_interval;
   return timers_->Insert(micros_value, micros_interval, cb);
 }
 
 TimerId EventLoop::RunAt(uint64_t micros_value, TimerProcCallback&& cb) {
-  return timers_->Insert(micros_value, 0, std::move(cb));
+  return timers_->Insert(WallToMonotonic(micros_value), 0, std::move(cb));
 }
 
 TimerId EventLoop::RunAfter(uint64_t micros_delay, TimerProcCallback&& cb) {
-  uint64_t micros_value = timeops::NowMicros() + micros_delay;
+  uint64_t micros_value = timeops::MonotonicMicros() + micros_delay;
   return timers_->Insert(micros_value, 0, std::move(cb));
 }
 
 TimerId EventLoop::RunEvery(uint64_t micros_interval, TimerProcCallback&& cb) {
-  uint64_t micros_value = timeops::NowMicros() + micros_interval;
+  uint64_t micros_value = timeops::MonotonicMicros() + micros_interval;
   return timers_->Insert(micros_value, micros_interval, std::move(cb));
 }
 
 void EventLoop::RemoveTimer(TimerId t) { timers_->Erase(t); }
 
+uint64_t EventLoop::Now() const {
+  return looping_ && IsInMyLoop() ? now_ : timeops::NowMicros();
+}
+
+uint64_t EventLoop::MonotonicNow() const {
+  return looping_ && IsInMyLoop() ? monotonic_now_
+                                  : timeops::MonotonicMicros();
+}
+
+uint64_t EventLoop::WallToMonotonic(uint64_t micros_value) const {
+  uint64_t wall = timeops::NowMicros();
+  uint64_t monotonic = timeops::MonotonicMicros();
+  return micros_value > wall ? monotonic + (micros_value - wall) : monotonic;
+}
+
+void EventLoop::UpdateTime() {
+  now_ = timeops::NowMicros();
+  monotonic_now_ = timeops::MonotonicMicros();
+}
+
+void EventLoop::UpdateLag() {
+  uint64_t lag = timeops::MonotonicMicros() - monotonic_now_;
+  // A lost race with TakeLagMicros() only drops a sample.
+  if (lag > lag_micros_.load(std::memory_order_relaxed)) {
+    lag_micros_.store(lag, std::memory_order_relaxed);
+  }
+  busy_since_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t EventLoop::TakeLagMicros() {
+  uint64_t lag = lag_micros_.exchange(0, std::memory_order_relaxed);
+  uint64_t since = busy_since_.load(std::memory_order_relaxed);
+  if (since != 0) {
+    uint64_t now = timeops::MonotonicMicros();
+    if (now > since && now - since > lag) {
+      lag = now - since;
+    }
+  }
+  return lag;
+}
+
+bool EventLoop::BusyPoll(uint64_t budget, std::vector<Dispatch*>* dispatches) {
+  if (spin_nanos_ > budget) {
+    spin_nanos_ = budget;
+  }
+  if (spin_nanos_ == 0) {
+    return false;
+  }
+  uint64_t start = timeops::TscNanos();
+  uint64_t spin = spin_nanos_;
+#ifndef __linux__
+  // Without the timerfd, a timer does not end the spin.
+  uint64_t t = timers_->TimeoutMicros() * 1000;
+  spin = t < spin ? t : spin;
+#endif
+  uint64_t now = start;
+  do {
+    poller_->Poll(0, dispatches);
+    now = timeops::TscNanos();
+  } while (dispatches->empty() && now - start < spin && !exit_ &&
+           !SourcesPending());
+
+  bool hit = !dispatches->empty() || SourcesPending();
+  if (hit) {
+    spin_nanos_ = budget;
+  }
+  if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+    AtomicHistogram::Increase(&recorder_->busy_polls, 1);
+    AtomicHistogram::Increase(&recorder_->busy_poll_hits, hit ? 1 : 0);
+    AtomicHistogram::Increase(&recorder_->busy_poll_nanos, now - start);
+  }
+  return hit;
+}
+
+void EventLoop::AdaptBusyPoll(uint64_t budget, uint64_t blocked_nanos) {
+  static const uint64_t kMinSpinNanos = 1000;
+  if (blocked_nanos < budget) {
+    // A longer spin would have caught the event.
+    spin_nanos_ = spin_nanos_ < kMinSpinNanos ? kMinSpinNanos : spin_nanos_ * 2;
+    if (spin_nanos_ > budget) {
+      spin_nanos_ = budget;
+    }
+  } else {
+    // Idle, stop burning the CPU step by step.
+    spin_nanos_ /= 2;
+    if (spin_nanos_ < kMinSpinNanos) {
+      spin_nanos_ = 0;
+    }
+  }
+}
+
+void EventLoop::AddSource(LoopSource* source) {
+  AssertInMyLoop();
+  sources_.push_back(source);
+}
+
+void EventLoop::RemoveSource(LoopSource* source) {
+  AssertInMyLoop();
+  sources_.erase(std::remove(sources_.begin(), sources_.end(), source),
+                 sources_.end());
+}
+
+bool EventLoop::SourcesPending() const {
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (sources_[i]->Pending()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void EventLoop::GetStats(EventLoopStats* stats) const {
+  stats_->Load(stats);
+  stats->thread_cpu_nanos = ThreadCpuNanos() - thread_cpu_base_;
+}
+
+void EventLoop::ResetStats() {
+  RunInLoop([this]() {
+    stats_->Reset();
+    thread_cpu_nanos_ = CurrentThreadCpuNanos();
+    thread_cpu_base_ = thread_cpu_nanos_.load();
+  });
+}
+
 void EventLoop::RemoveDispatch(Dispatch* dispatch) {
   assert(dispatch->OwnerEventLoop() == this);
   AssertInMyLoop();
@@ -243,20 +502,110 @@ void EventLoop::RemoveConnection(const TcpConnectionPtr& ptr) {
   --all_connection_size_;
 }
 
-void EventLoop::RunFuncs() {
-  std::vector<Func> funcs;
+void EventLoop::ForEachConnection(const ConnectionCallback& cb) const {
+  assert(IsInMyLoop());
+  for (std::unordered_map<std::string, TcpConnectionPtr>::const_iterator it =
+           connections_.begin();
+       it != connections_.end(); ++it) {
+    cb(it->second);
+  }
+}
+
+void EventLoop::RunFuncs(bool high_only) {
+  std::vector<QueuedFunc> funcs[kNumPriorities];
+  int last = high_only ? kHighPriority : kLowPriority;
   run_ = true;
   {
     std::lock_guard<std::mutex> lock(mutex_);
-    funcs.swap(funcs_);
+    for (int p = 0; p <= last; ++p) {
+      funcs[p].swap(funcs_[p]);
+    }
+    has_high_funcs_.store(false, std::memory_order_relaxed);
   }
-  for (std::vector<Func>::iterator it = funcs.begin(); it != funcs.end();
-       ++it) {
-    (*it)();
+  uint64_t start = 0;
+  if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+    start = timeops::TscNanos();
+    size_t size = 0;
+    for (int p = 0; p <= last; ++p) {
+      size += deferred_[p].size() + funcs[p].size();
+    }
+    recorder_->funcs_depth.Add(size);
+  }
+  uint64_t budget = high_only ? 0 : funcs_budget_nanos_;
+  uint64_t budget_start = budget != 0 ? timeops::TscNanos() : 0;
+  bool over = false;
+  size_t ran = 0;
+  size_t deferred = 0;
+  for (int p = 0; p <= last; ++p) {
+    // The functors deferred before run ahead of the ones queued meanwhile,
+    // and the rest of this iteration joins them behind.
+    std::deque<QueuedFunc>& carry = deferred_[p];
+    bool limited = budget != 0 && p != kHighPriority;
+    while (!over && !carry.empty()) {
+      if (limited && timeops::TscNanos() - budget_start > budget) {
+        over = true;
+        break;
+      }
+      RunFunc(&carry.front());
+      carry.pop_front();
+      ++ran;
+    }
+    for (size_t i = 0; i < funcs[p].size(); ++i) {
+      if (!over && limited && timeops::TscNanos() - budget_start > budget) {
+        over = true;
+      }
+      if (over) {
+        carry.push_back(std::move(funcs[p][i]));
+        ++deferred;
+      } else {
+        RunFunc(&funcs[p][i]);
+        ++ran;
+      }
+    }
+  }
+  funcs_backlog_.fetch_sub(ran, std::memory_order_relaxed);
+  if (!high_only) {
+    deferred_funcs_ = over;
+  }
+  if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+    if (deferred != 0) {
+      AtomicHistogram::Increase(&recorder_->funcs_deferred, deferred);
+    }
+    recorder_->funcs_nanos.Add(timeops::TscNanos() - start);
   }
   run_ = false;
 }
 
+void EventLoop::RunFunc(QueuedFunc* func) {
+  if (func->deadline != 0 && timeops::MonotonicMicros() > func->deadline) {
+    if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+      AtomicHistogram::Increase(&recorder_->funcs_expired, 1);
+    }
+    if (func->expired) {
+      func->expired();
+    }
+    return;
+  }
+  if (VOYAGER_PREDICT_FALSE(stall_watch_ != nullptr)) {
+    StallScope scope(stall_watch_.get(), "EventLoop::QueueInLoop functor");
+    func->func();
+  } else {
+    func->func();
+  }
+}
+
+void EventLoop::HandleEvent(Dispatch* dispatch) {
+  StallScope scope(stall_watch_.get(), "Dispatch::HandleEvent",
+                   dispatch->Name(), dispatch->Fd());
+  if (recorder_ != nullptr) {
+    uint64_t start = timeops::TscNanos();
+    dispatch->HandleEvent();
+    recorder_->event_nanos.Add(timeops::TscNanos() - start);
+  } else {
+    dispatch->HandleEvent();
+  }
+}
+
 void EventLoop::WakeUp() {
   uint64_t one = 0;
   ssize_t n = ::write(wakeup_fd_[1], &one, sizeof(one));
@@ -267,6 +616,9 @@ void EventLoop::WakeUp() {
 }
 
 void EventLoop::HandleRead() {
+  if (VOYAGER_PREDICT_FALSE(recorder_ != nullptr)) {
+    AtomicHistogram::Increase(&recorder_->wakeups, 1);
+  }
   uint64_t one = 0;
   ssize_t n = ::read(wakeup_fd_[0], &one, sizeof(one));
   if (n != sizeof(one)) {
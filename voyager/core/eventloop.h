@@ -5,7 +5,10 @@
 #ifndef VOYAGER_CORE_EVENTLOOP_H_
 #define VOYAGER_CORE_EVENTLOOP_H_
 
+#include <stdint.h>
+
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -21,13 +24,41 @@ namespace voyager {
 
 class Dispatch;
 class EventPoller;
-class Timer;
+class StallWatch;
 class TimerList;
+struct EventLoopStats;
+struct EventLoopStatsRecorder;
+
+// The handle of a timer: the index of its slot in TimerList and the
+// generation of the slot when the timer was added. A slot gets a new
+// generation whenever it is freed, so a stale handle never cancels a timer
+// which reuses the slot. TimerId() refers to no timer.
+struct TimerId {
+  uint32_t index;
+  uint32_t generation;
 
-typedef std::pair<uint64_t, Timer*> TimerId;
+  TimerId() : index(0), generation(0) {}
+  TimerId(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+  bool Valid() const { return generation != 0; }
+};
 
 enum PollType { kSelect, kPoll, kEpoll };
 
+enum FuncPriority { kHighPriority = 0, kNormalPriority = 1, kLowPriority = 2 };
+
+// Work which the loop drains once per iteration besides its events and
+// queued functors, such as the inbound LoopChannels of the loop.
+class LoopSource {
+ public:
+  virtual ~LoopSource() {}
+
+  virtual void Drain() = 0;
+  // Checked after the loop announced that it is about to block, see
+  // EventLoop::Blocking(), true makes the poll return at once.
+  virtual bool Pending() const = 0;
+};
+
 class EventLoop {
  public:
   typedef std::function<void()> Func;
@@ -44,6 +75,21 @@ class EventLoop {
   void RunInLoop(Func&& func);
   void QueueInLoop(Func&& func);
 
+  // QueueInLoop() with a priority class and an optional timeout.
+  // kHighPriority functors, such as closing a connection or a cancellation,
+  // run before the IO events of the next iteration, the others after them and
+  // kLowPriority last. If micros_timeout is not 0 and func has not started
+  // within it, func is dropped and expired, if set, runs instead.
+  void QueueInLoop(Func&& func, FuncPriority priority,
+                   uint64_t micros_timeout = 0, Func&& expired = Func());
+
+  // Caps the time spent on normal and low priority functors in one
+  // iteration. The rest are deferred to the next iteration, which then polls
+  // without blocking, so a flood of functors can not starve the IO. 0, the
+  // default, means no limit. Only in the loop thread.
+  void SetFuncsBudget(uint64_t micros) { funcs_budget_nanos_ = micros * 1000; }
+
+  // micros_value of RunAt() is the wall clock time, as timeops::NowMicros().
   TimerId RunAt(uint64_t micros_value, const TimerProcCallback& cb);
   TimerId RunAfter(uint64_t micros_delay, const TimerProcCallback& cb);
   TimerId RunEvery(uint64_t micros_interval, const TimerProcCallback& cb);
@@ -52,14 +98,60 @@ class EventLoop {
   TimerId RunAfter(uint64_t micros_delay, TimerProcCallback&& cb);
   TimerId RunEvery(uint64_t micros_interval, TimerProcCallback&& cb);
 
+  // O(1) in the loop thread. From other threads it only flags the timer
+  // without waking up the loop, and the timer is dropped at its deadline.
   void RemoveTimer(TimerId t);
 
+  // The wall clock time in microseconds, cached when the poller returns in
+  // every Loop() iteration. It is much cheaper than timeops::NowMicros(), but
+  // lags behind it by the time spent handling the current events, so only
+  // use it in the loop thread where that resolution is enough. Outside of
+  // Loop() it reads the clock.
+  uint64_t Now() const;
+
+  // CLOCK_MONOTONIC microseconds cached like Now(), at which the timers due
+  // are run. Their deadlines are taken from the clock itself, so that they
+  // never fire early.
+  uint64_t MonotonicNow() const;
+
   void AssertInMyLoop() {
     if (!IsInMyLoop()) {
       Abort();
     }
   }
 
+  // Per-loop statistics, see EventLoopStats. They are off by default, and
+  // then cost one well predicted branch per event. When enabled, every event,
+  // RunFuncs() and poll is timed with timeops::TscNanos().
+  void EnableStats(bool on) { stats_enabled_ = on; }
+  bool StatsEnabled() const { return stats_enabled_; }
+  // Safe to call in any thread.
+  void GetStats(EventLoopStats* stats) const;
+  void ResetStats();
+  // The CPU time consumed by the loop thread, as the thread sampled it at
+  // the end of its last iteration with stats enabled. Safe to call in any
+  // thread, also after the loop thread exited.
+  uint64_t ThreadCpuNanos() const { return thread_cpu_nanos_; }
+
+  // Spin on a non-blocking poll for up to micros before blocking in the
+  // poller, which trades a CPU for the wakeup latency of the next event. The
+  // spin adapts: it shrinks while the loop stays idle after spinning, and
+  // grows back when events arrive soon after the loop blocks. 0, the default,
+  // disables it. Safe to call in any thread.
+  void SetBusyPoll(uint64_t micros) { busy_poll_nanos_ = micros * 1000; }
+  uint64_t BusyPollMicros() const { return busy_poll_nanos_ / 1000; }
+
+  // Tracks the lag of the loop: how long the events and functors of an
+  // iteration wait after the poller returned. It costs a clock read per
+  // iteration, so it is off by default. Safe to call in any thread.
+  void EnableLag(bool on) { lag_enabled_ = on; }
+  // The worst lag in microseconds since the previous call, counting the
+  // iteration in progress, and 0 if lag tracking is off. Meant for a single
+  // monitor, such as OverloadController, in any thread.
+  uint64_t TakeLagMicros();
+  // Functors queued but not started yet, safe in any thread.
+  size_t FuncsBacklog() const { return funcs_backlog_.load(); }
+
   bool IsInMyLoop() const { return tid_ == std::this_thread::get_id(); }
   PollType GetPollType() const { return type_; }
 
@@ -74,14 +166,53 @@ class EventLoop {
   void AddConnection(const TcpConnectionPtr& ptr);
   void RemoveConnection(const TcpConnectionPtr& ptr);
   int ConnectionSize() const { return connection_size_; }
+  // Only in the loop thread, cb must not add or remove connections
+  // synchronously.
+  void ForEachConnection(const ConnectionCallback& cb) const;
 
   static int AllConnectionSize() { return all_connection_size_; }
 
+  // Sources are drained after the events of every iteration. Only in the
+  // loop thread.
+  void AddSource(LoopSource* source);
+  void RemoveSource(LoopSource* source);
+
+  // True while the loop is blocked, or about to block, in the poller. A
+  // thread which feeds a LoopSource must WakeUp() the loop if this is true
+  // after its write is visible, behind a seq_cst fence.
+  bool Blocking() const { return blocking_.load(); }
+  void WakeUp();
+
+  // Internal use only, nullptr unless the stats are enabled.
+  EventLoopStatsRecorder* StatsRecorder() const { return recorder_; }
+
+  // Internal use only, set by StallDetector::Watch() in the loop thread.
+  void SetStallWatch(const std::shared_ptr<StallWatch>& watch) {
+    stall_watch_ = watch;
+  }
+  StallWatch* GetStallWatch() const { return stall_watch_.get(); }
+
  private:
-  void RunFuncs();
+  uint64_t WallToMonotonic(uint64_t micros_value) const;
+  void UpdateTime();
+  void UpdateLag();
+  bool BusyPoll(uint64_t budget, std::vector<Dispatch*>* dispatches);
+  void AdaptBusyPoll(uint64_t budget, uint64_t blocked_nanos);
+  struct QueuedFunc {
+    Func func;
+    // CLOCK_MONOTONIC microseconds, 0 for none.
+    uint64_t deadline;
+    Func expired;
+  };
+  static const int kNumPriorities = 3;
+
+  void Queue(QueuedFunc&& func, FuncPriority priority);
+  void RunFuncs(bool high_only);
+  void RunFunc(QueuedFunc* func);
+  void HandleEvent(Dispatch* dispatch);
   void HandleRead();
+  bool SourcesPending() const;
   void Abort();
-  void WakeUp();
 
   static std::atomic<int> all_connection_size_;
 
@@ -90,6 +221,33 @@ class EventLoop {
 
   bool exit_;
   bool run_;
+  // Whether Loop() runs, and keeps now_ and monotonic_now_.
+  bool looping_;
+  uint64_t now_;
+  uint64_t monotonic_now_;
+
+  std::atomic<bool> stats_enabled_;
+  std::unique_ptr<EventLoopStatsRecorder> stats_;
+  // stats_ if they are enabled in the current iteration, or nullptr.
+  EventLoopStatsRecorder* recorder_;
+  // Published by the loop thread from its own CPU clock, and its value at
+  // the last ResetStats().
+  std::atomic<uint64_t> thread_cpu_nanos_;
+  std::atomic<uint64_t> thread_cpu_base_;
+  std::shared_ptr<StallWatch> stall_watch_;
+
+  std::atomic<bool> lag_enabled_;
+  // The worst lag since TakeLagMicros(), and MonotonicNow() of the
+  // iteration in progress or 0 while the loop polls.
+  std::atomic<uint64_t> lag_micros_;
+  std::atomic<uint64_t> busy_since_;
+
+  std::vector<LoopSource*> sources_;
+  std::atomic<bool> blocking_;
+
+  std::atomic<uint64_t> busy_poll_nanos_;
+  // The adaptive spin of the next iteration, at most busy_poll_nanos_.
+  uint64_t spin_nanos_;
 
   std::atomic<int> connection_size_;
   std::unique_ptr<EventPoller> poller_;
@@ -99,7 +257,15 @@ class EventLoop {
   std::unique_ptr<Dispatch> wakeup_dispatch_;
 
   std::mutex mutex_;
-  std::vector<Func> funcs_;
+  std::vector<QueuedFunc> funcs_[kNumPriorities];
+  std::atomic<bool> has_high_funcs_;
+  std::atomic<size_t> funcs_backlog_;
+  uint64_t funcs_budget_nanos_;
+  // Functors deferred by the budget, only touched in the loop thread. They
+  // stay in funcs_backlog_ until they run.
+  std::deque<QueuedFunc> deferred_[kNumPriorities];
+  // Some were deferred, don't block in the next poll.
+  bool deferred_funcs_;
   std::unordered_map<std::string, TcpConnectionPtr> connections_;
 
   // No copying allowed
@@ -0,0 +1,156 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/eventloop_stats.h"
+
+#include <string.h>
+
+#include "voyager/util/stringprintf.h"
+
+namespace voyager {
+
+Histogram::Histogram() : count(0), sum(0), max(0) {
+  memset(buckets, 0, sizeof(buckets));
+}
+
+double Histogram::Average() const {
+  return count == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+uint64_t Histogram::Percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+  double threshold = static_cast<double>(count) * p / 100;
+  uint64_t cumulative = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    cumulative += buckets[i];
+    if (static_cast<double>(cumulative) >= threshold) {
+      uint64_t limit = i == 0 ? 0 : (1ULL << i) - 1;
+      return limit < max ? limit : max;
+    }
+  }
+  return max;
+}
+
+std::string Histogram::ToString() const {
+  return StringPrintf(
+      "count=%llu avg=%.1f p50=%llu p99=%llu p999=%llu max=%llu",
+      static_cast<unsigned long long>(count), Average(),
+      static_cast<unsigned long long>(Percentile(50)),
+      static_cast<unsigned long long>(Percentile(99)),
+      static_cast<unsigned long long>(Percentile(99.9)),
+      static_cast<unsigned long long>(max));
+}
+
+EventLoopStats::EventLoopStats()
+    : iterations(0),
+      wakeups(0),
+      blocked_nanos(0),
+      busy_nanos(0),
+      busy_polls(0),
+      busy_poll_hits(0),
+      busy_poll_nanos(0),
+      thread_cpu_nanos(0),
+      funcs_deferred(0),
+      funcs_expired(0) {}
+
+double EventLoopStats::Utilization() const {
+  uint64_t total = busy_nanos + blocked_nanos;
+  return total == 0 ? 0
+                    : static_cast<double>(busy_nanos) /
+                          static_cast<double>(total);
+}
+
+double EventLoopStats::BusyPollHitRate() const {
+  return busy_polls == 0 ? 0
+                         : static_cast<double>(busy_poll_hits) /
+                               static_cast<double>(busy_polls);
+}
+
+std::string EventLoopStats::ToString() const {
+  std::string s;
+  StringAppendF(&s,
+                "iterations=%llu wakeups=%llu utilization=%.2f%% "
+                "thread_cpu_us=%llu\n",
+                static_cast<unsigned long long>(iterations),
+                static_cast<unsigned long long>(wakeups),
+                Utilization() * 100,
+                static_cast<unsigned long long>(thread_cpu_nanos / 1000));
+  if (busy_polls != 0) {
+    StringAppendF(&s, "busy_polls=%llu hit_rate=%.2f%% spin_nanos=%llu\n",
+                  static_cast<unsigned long long>(busy_polls),
+                  BusyPollHitRate() * 100,
+                  static_cast<unsigned long long>(busy_poll_nanos));
+  }
+  s += "poll_events: " + poll_events.ToString() + "\n";
+  s += "event_nanos: " + event_nanos.ToString() + "\n";
+  s += "funcs_depth: " + funcs_depth.ToString() + "\n";
+  s += "funcs_nanos: " + funcs_nanos.ToString() + "\n";
+  if (funcs_deferred != 0 || funcs_expired != 0) {
+    StringAppendF(&s, "funcs_deferred=%llu funcs_expired=%llu\n",
+                  static_cast<unsigned long long>(funcs_deferred),
+                  static_cast<unsigned long long>(funcs_expired));
+  }
+  s += "timer_lateness_micros: " + timer_lateness_micros.ToString() + "\n";
+  return s;
+}
+
+AtomicHistogram::AtomicHistogram() { Reset(); }
+
+void AtomicHistogram::Load(Histogram* h) const {
+  for (int i = 0; i < Histogram::kNumBuckets; ++i) {
+    h->buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  h->count = count_.load(std::memory_order_relaxed);
+  h->sum = sum_.load(std::memory_order_relaxed);
+  h->max = max_.load(std::memory_order_relaxed);
+}
+
+void AtomicHistogram::Reset() {
+  for (int i = 0; i < Histogram::kNumBuckets; ++i) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+EventLoopStatsRecorder::EventLoopStatsRecorder() { Reset(); }
+
+void EventLoopStatsRecorder::Load(EventLoopStats* stats) const {
+  stats->iterations = iterations.load(std::memory_order_relaxed);
+  stats->wakeups = wakeups.load(std::memory_order_relaxed);
+  stats->blocked_nanos = blocked_nanos.load(std::memory_order_relaxed);
+  stats->busy_nanos = busy_nanos.load(std::memory_order_relaxed);
+  stats->busy_polls = busy_polls.load(std::memory_order_relaxed);
+  stats->busy_poll_hits = busy_poll_hits.load(std::memory_order_relaxed);
+  stats->busy_poll_nanos = busy_poll_nanos.load(std::memory_order_relaxed);
+  poll_events.Load(&stats->poll_events);
+  event_nanos.Load(&stats->event_nanos);
+  funcs_depth.Load(&stats->funcs_depth);
+  funcs_nanos.Load(&stats->funcs_nanos);
+  stats->funcs_deferred = funcs_deferred.load(std::memory_order_relaxed);
+  stats->funcs_expired = funcs_expired.load(std::memory_order_relaxed);
+  timer_lateness_micros.Load(&stats->timer_lateness_micros);
+}
+
+void EventLoopStatsRecorder::Reset() {
+  iterations.store(0, std::memory_order_relaxed);
+  wakeups.store(0, std::memory_order_relaxed);
+  blocked_nanos.store(0, std::memory_order_relaxed);
+  busy_nanos.store(0, std::memory_order_relaxed);
+  busy_polls.store(0, std::memory_order_relaxed);
+  busy_poll_hits.store(0, std::memory_order_relaxed);
+  busy_poll_nanos.store(0, std::memory_order_relaxed);
+  poll_events.Reset();
+  event_nanos.Reset();
+  funcs_depth.Reset();
+  funcs_nanos.Reset();
+  funcs_deferred.store(0, std::memory_order_relaxed);
+  funcs_expired.store(0, std::memory_order_relaxed);
+  timer_lateness_micros.Reset();
+}
+
+}  // namespace voyager
@@ -0,0 +1,136 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_EVENTLOOP_STATS_H_
+#define VOYAGER_CORE_EVENTLOOP_STATS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+namespace voyager {
+
+// A histogram with power of two buckets: buckets[0] counts the value 0 and
+// buckets[i] counts the values in [2^(i-1), 2^i).
+struct Histogram {
+  static const int kNumBuckets = 64;
+
+  uint64_t buckets[kNumBuckets];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+
+  Histogram();
+
+  double Average() const;
+  // The upper bound of the bucket which holds the percentile p (0 ~ 100).
+  uint64_t Percentile(double p) const;
+  std::string ToString() const;
+};
+
+// A snapshot of the statistics of one EventLoop, see
+// EventLoop::EnableStats(). Durations are in nanoseconds unless noted.
+struct EventLoopStats {
+  uint64_t iterations;
+  // Times the loop was woken up by another thread.
+  uint64_t wakeups;
+  // Time spent blocked in the poller, and doing anything else.
+  uint64_t blocked_nanos;
+  uint64_t busy_nanos;
+  // Busy-poll spins, the spins which found ready events before the budget
+  // ran out, and the time spent spinning, see EventLoop::SetBusyPoll().
+  uint64_t busy_polls;
+  uint64_t busy_poll_hits;
+  uint64_t busy_poll_nanos;
+  // CPU time of the loop thread, measured with its CPU clock, see
+  // EventLoop::ThreadCpuNanos().
+  uint64_t thread_cpu_nanos;
+  // Ready dispatches returned by each poll.
+  Histogram poll_events;
+  // Time of each Dispatch::HandleEvent().
+  Histogram event_nanos;
+  // Queued functors and the time to drain them in each RunFuncs().
+  Histogram funcs_depth;
+  Histogram funcs_nanos;
+  // Functors deferred to the next iteration by EventLoop::SetFuncsBudget(),
+  // and dropped after their timeout.
+  uint64_t funcs_deferred;
+  uint64_t funcs_expired;
+  // How late timers fire, in microseconds.
+  Histogram timer_lateness_micros;
+
+  EventLoopStats();
+
+  // busy_nanos / (busy_nanos + blocked_nanos)
+  double Utilization() const;
+  // busy_poll_hits / busy_polls
+  double BusyPollHitRate() const;
+  std::string ToString() const;
+};
+
+// Internal use only. Written by the loop thread alone, so updates are plain
+// relaxed loads and stores, and other threads take consistent enough
+// snapshots without any locking.
+class AtomicHistogram {
+ public:
+  AtomicHistogram();
+
+  void Add(uint64_t value) {
+    int i = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    if (i >= Histogram::kNumBuckets) {
+      i = Histogram::kNumBuckets - 1;
+    }
+    Increase(&buckets_[i], 1);
+    Increase(&count_, 1);
+    Increase(&sum_, value);
+    if (value > max_.load(std::memory_order_relaxed)) {
+      max_.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  void Load(Histogram* h) const;
+  void Reset();
+
+  static void Increase(std::atomic<uint64_t>* a, uint64_t n) {
+    a->store(a->load(std::memory_order_relaxed) + n,
+             std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> buckets_[Histogram::kNumBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+
+  // No copying allowed
+  AtomicHistogram(const AtomicHistogram&);
+  void operator=(const AtomicHistogram&);
+};
+
+struct EventLoopStatsRecorder {
+  std::atomic<uint64_t> iterations;
+  std::atomic<uint64_t> wakeups;
+  std::atomic<uint64_t> blocked_nanos;
+  std::atomic<uint64_t> busy_nanos;
+  std::atomic<uint64_t> busy_polls;
+  std::atomic<uint64_t> busy_poll_hits;
+  std::atomic<uint64_t> busy_poll_nanos;
+  AtomicHistogram poll_events;
+  AtomicHistogram event_nanos;
+  AtomicHistogram funcs_depth;
+  AtomicHistogram funcs_nanos;
+  std::atomic<uint64_t> funcs_deferred;
+  std::atomic<uint64_t> funcs_expired;
+  AtomicHistogram timer_lateness_micros;
+
+  EventLoopStatsRecorder();
+
+  void Load(EventLoopStats* stats) const;
+  void Reset();
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_EVENTLOOP_STATS_H_
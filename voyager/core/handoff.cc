@@ -0,0 +1,164 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/handoff.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "voyager/util/logging.h"
+
+namespace voyager {
+namespace handoff {
+
+static int UnixSocket() {
+  int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock != -1) {
+    ::fcntl(sock, F_SETFD, FD_CLOEXEC);
+  }
+  return sock;
+}
+
+static bool FillAddr(const std::string& path, struct sockaddr_un* addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr->sun_path)) {
+    VOYAGER_LOG(ERROR) << "handoff - path too long: " << path;
+    return false;
+  }
+  memcpy(addr->sun_path, path.data(), path.size());
+  return true;
+}
+
+int SendFd(int sock, int fd) {
+  char byte = 'F';
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  ssize_t n;
+  do {
+    n = ::sendmsg(sock, &msg, 0);
+  } while (n == -1 && errno == EINTR);
+  return n == 1 ? 0 : -1;
+}
+
+int RecvFd(int sock) {
+  char byte;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = ::recvmsg(sock, &msg, 0);
+  } while (n == -1 && errno == EINTR);
+  if (n != 1) {
+    return -1;
+  }
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS) {
+    errno = EPROTO;
+    return -1;
+  }
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+bool ServeFd(const std::string& path, int fd, uint64_t micros_timeout) {
+  struct sockaddr_un addr;
+  if (!FillAddr(path, &addr)) {
+    return false;
+  }
+  int sock = UnixSocket();
+  if (sock == -1) {
+    VOYAGER_LOG(ERROR) << "handoff::ServeFd - socket: " << strerror(errno);
+    return false;
+  }
+  ::unlink(path.c_str());
+  bool ok = false;
+  if (::bind(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) ==
+          -1 ||
+      ::listen(sock, 1) == -1) {
+    VOYAGER_LOG(ERROR) << "handoff::ServeFd - bind " << path << ": "
+                       << strerror(errno);
+  } else {
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    int timeout = static_cast<int>(micros_timeout / 1000);
+    int n = ::poll(&pfd, 1, timeout);
+    if (n == 1) {
+      int peer = ::accept(sock, nullptr, nullptr);
+      if (peer != -1) {
+        ok = SendFd(peer, fd) == 0;
+        if (!ok) {
+          VOYAGER_LOG(ERROR) << "handoff::ServeFd - sendmsg: "
+                             << strerror(errno);
+        }
+        ::close(peer);
+      }
+    } else {
+      VOYAGER_LOG(WARN) << "handoff::ServeFd - nobody fetched the fd";
+    }
+  }
+  ::close(sock);
+  ::unlink(path.c_str());
+  return ok;
+}
+
+int FetchFd(const std::string& path) {
+  struct sockaddr_un addr;
+  if (!FillAddr(path, &addr)) {
+    return -1;
+  }
+  int sock = UnixSocket();
+  if (sock == -1) {
+    return -1;
+  }
+  int fd = -1;
+  if (::connect(sock, reinterpret_cast<struct sockaddr*>(&addr),
+                sizeof(addr)) == 0) {
+    fd = RecvFd(sock);
+  }
+  if (fd == -1) {
+    VOYAGER_LOG(ERROR) << "handoff::FetchFd - " << path << ": "
+                       << strerror(errno);
+  }
+  ::close(sock);
+  return fd;
+}
+
+}  // namespace handoff
+}  // namespace voyager
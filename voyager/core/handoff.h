@@ -0,0 +1,35 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_HANDOFF_H_
+#define VOYAGER_CORE_HANDOFF_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace voyager {
+
+// Passes a file descriptor to another process with SCM_RIGHTS over a Unix
+// domain socket, for restarts which never refuse a connection: the old
+// process serves its listening socket, the newly exec'ed one fetches it and
+// starts a TcpServer on it, then the old one drains with TcpServer::Drain().
+// All the calls block, so use them outside of the loop threads.
+namespace handoff {
+
+// Returns 0 on success, -1 with errno on failure.
+extern int SendFd(int sock, int fd);
+// Returns the received fd, or -1 with errno.
+extern int RecvFd(int sock);
+
+// Listens on the Unix socket path, waits up to micros_timeout for one peer
+// and sends it fd.
+extern bool ServeFd(const std::string& path, int fd, uint64_t micros_timeout);
+// Connects to path and receives an fd, or returns -1.
+extern int FetchFd(const std::string& path);
+
+}  // namespace handoff
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_HANDOFF_H_
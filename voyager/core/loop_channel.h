@@ -0,0 +1,186 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_LOOP_CHANNEL_H_
+#define VOYAGER_CORE_LOOP_CHANNEL_H_
+
+#include <assert.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/spsc_queue.h"
+
+namespace voyager {
+
+// A mesh of bounded SPSC rings between every pair of a set of loops, for
+// sharded servers where each loop owns a partition and forwards requests to
+// its peers. Compared with QueueInLoop() a message costs no mutex and no
+// std::function. Each loop drains its inbound rings once per iteration, and
+// a sender wakes the receiver up only when it is blocked in the poller, at
+// most once until the receiver drains the ring again.
+//
+//   LoopChannels<Request> channels(loops, 1024, handler);
+//   channels.Start();
+//   ...
+//   // in the thread of loops[i]
+//   channels.Send(i, j, std::move(request));
+//
+// Stop() it while the loops still run, before destroying it. T must be
+// default-constructible and move-assignable, the rings are arrays of it.
+template <typename T>
+class LoopChannels {
+ public:
+  // Runs in the thread of loops[to] for every message.
+  typedef std::function<void(size_t from, T&& message)> Handler;
+
+  LoopChannels(const std::vector<EventLoop*>& loops, size_t capacity,
+               const Handler& handler);
+  ~LoopChannels() { assert(!started_); }
+
+  // Registers the rings with the loops, safe to call in any thread.
+  void Start();
+  // Unregisters them and waits for the loops, which must still be running,
+  // must not be called in any of them.
+  void Stop();
+
+  size_t Size() const { return loops_.size(); }
+
+  // Only in the thread of loops[from]. False if the ring to loops[to] is
+  // full, the caller keeps the message and may retry later.
+  bool Send(size_t from, size_t to, T&& message);
+
+ private:
+  struct Channel {
+    explicit Channel(size_t capacity) : queue(capacity), notified(false) {}
+
+    SpscQueue<T> queue;
+    std::atomic<bool> notified;
+  };
+
+  class Inbox : public LoopSource {
+   public:
+    Inbox(LoopChannels* channels, size_t to) : channels_(channels), to_(to) {}
+
+    virtual void Drain();
+    virtual bool Pending() const;
+
+   private:
+    LoopChannels* channels_;
+    const size_t to_;
+  };
+
+  Channel* Get(size_t from, size_t to) {
+    return channels_[from * loops_.size() + to].get();
+  }
+
+  const std::vector<EventLoop*> loops_;
+  const Handler handler_;
+  std::vector<std::unique_ptr<Channel> > channels_;
+  std::vector<std::unique_ptr<Inbox> > inboxes_;
+  bool started_;
+
+  // No copying allowed
+  LoopChannels(const LoopChannels&);
+  void operator=(const LoopChannels&);
+};
+
+template <typename T>
+LoopChannels<T>::LoopChannels(const std::vector<EventLoop*>& loops,
+                              size_t capacity, const Handler& handler)
+    : loops_(loops), handler_(handler), started_(false) {
+  for (size_t i = 0; i < loops_.size() * loops_.size(); ++i) {
+    channels_.push_back(std::unique_ptr<Channel>(new Channel(capacity)));
+  }
+  for (size_t i = 0; i < loops_.size(); ++i) {
+    inboxes_.push_back(std::unique_ptr<Inbox>(new Inbox(this, i)));
+  }
+}
+
+template <typename T>
+void LoopChannels<T>::Start() {
+  assert(!started_);
+  started_ = true;
+  for (size_t i = 0; i < loops_.size(); ++i) {
+    LoopSource* inbox = inboxes_[i].get();
+    EventLoop* loop = loops_[i];
+    loop->RunInLoop([loop, inbox]() { loop->AddSource(inbox); });
+  }
+}
+
+template <typename T>
+void LoopChannels<T>::Stop() {
+  if (!started_) {
+    return;
+  }
+  started_ = false;
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t done = 0;
+  for (size_t i = 0; i < loops_.size(); ++i) {
+    LoopSource* inbox = inboxes_[i].get();
+    EventLoop* loop = loops_[i];
+    loop->RunInLoop([loop, inbox, &mutex, &cv, &done]() {
+      loop->RemoveSource(inbox);
+      std::lock_guard<std::mutex> lock(mutex);
+      ++done;
+      cv.notify_one();
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [this, &done]() { return done == loops_.size(); });
+}
+
+template <typename T>
+bool LoopChannels<T>::Send(size_t from, size_t to, T&& message) {
+  assert(loops_[from]->IsInMyLoop());
+  Channel* channel = Get(from, to);
+  if (!channel->queue.TryPush(std::move(message))) {
+    return false;
+  }
+  // Pairs with the store of blocking_ in EventLoop::Loop().
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  EventLoop* loop = loops_[to];
+  if (loop->Blocking() &&
+      !channel->notified.exchange(true, std::memory_order_relaxed)) {
+    loop->WakeUp();
+  }
+  return true;
+}
+
+template <typename T>
+void LoopChannels<T>::Inbox::Drain() {
+  size_t n = channels_->loops_.size();
+  T message;
+  for (size_t from = 0; from < n; ++from) {
+    Channel* channel = channels_->Get(from, to_);
+    channel->notified.store(false, std::memory_order_relaxed);
+    // Only what is there now, a busy sender must not starve the loop.
+    size_t budget = channel->queue.Capacity();
+    while (budget-- > 0 && channel->queue.TryPop(&message)) {
+      channels_->handler_(from, std::move(message));
+    }
+  }
+}
+
+template <typename T>
+bool LoopChannels<T>::Inbox::Pending() const {
+  size_t n = channels_->loops_.size();
+  for (size_t from = 0; from < n; ++from) {
+    if (!channels_->Get(from, to_)->queue.Empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_LOOP_CHANNEL_H_
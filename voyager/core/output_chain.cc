@@ -0,0 +1,240 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/output_chain.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+
+namespace voyager {
+
+void OutputChain::Append(const char* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  size_ += size;
+  if (!segments_.empty() && segments_.back().block) {
+    Segment& back = segments_.back();
+    char* end = const_cast<char*>(back.data) + back.size;
+    size_t room =
+        static_cast<size_t>(back.block.get() + back.capacity - end);
+    size_t n = std::min(room, size);
+    memcpy(end, data, n);
+    back.size += n;
+    data += n;
+    size -= n;
+    if (size == 0) {
+      return;
+    }
+  }
+  Segment segment;
+  segment.capacity = std::max(kBlockSize, size);
+  segment.block.reset(new char[segment.capacity]);
+  memcpy(segment.block.get(), data, size);
+  segment.data = segment.block.get();
+  segment.size = size;
+  segments_.push_back(std::move(segment));
+}
+
+void OutputChain::Append(std::string&& s) {
+  if (s.size() < kMinReferenceSize) {
+    Append(s.data(), s.size());
+  } else {
+    Append(std::make_shared<const std::string>(std::move(s)));
+  }
+}
+
+void OutputChain::Append(const std::shared_ptr<const std::string>& s) {
+  AppendReference(s->data(), s->size(), s);
+}
+
+void OutputChain::AppendReference(const char* data, size_t size,
+                                  const std::shared_ptr<const void>& owner) {
+  if (size < kMinReferenceSize) {
+    Append(data, size);
+    return;
+  }
+  Segment segment;
+  segment.data = data;
+  segment.size = size;
+  segment.owner = owner;
+  segments_.push_back(std::move(segment));
+  size_ += size;
+}
+
+void OutputChain::AppendFile(int fd, off_t offset, size_t size,
+                             const std::shared_ptr<const void>& owner) {
+  if (size == 0) {
+    return;
+  }
+  Segment segment;
+  segment.size = size;
+  segment.owner = owner;
+  segment.fd = fd;
+  segment.offset = offset;
+  segments_.push_back(std::move(segment));
+  size_ += size;
+}
+
+void OutputChain::Append(OutputChain* other) {
+  if (other == this || other->empty()) {
+    return;
+  }
+  if (empty()) {
+    Swap(other);
+    return;
+  }
+  for (auto& segment : other->segments_) {
+    segments_.push_back(std::move(segment));
+  }
+  size_ += other->size_;
+  other->Clear();
+}
+
+void OutputChain::Append(OutputChain* other, size_t size) {
+  assert(other != this && size <= other->size_);
+  if (size == other->size_) {
+    Append(other);
+    return;
+  }
+  while (size > 0) {
+    Segment& front = other->segments_.front();
+    size_t n = std::min(size, front.size);
+    if (n == front.size) {
+      segments_.push_back(std::move(front));
+      other->segments_.pop_front();
+      size_ += n;
+      other->size_ -= n;
+    } else {
+      if (front.fd >= 0) {
+        AppendFile(front.fd, front.offset, n, front.owner);
+      } else if (front.owner) {
+        AppendReference(front.data, n, front.owner);
+      } else {
+        // Owned blocks are not shared, the part is copied.
+        Append(front.data, n);
+      }
+      other->Retrieve(n);
+    }
+    size -= n;
+  }
+}
+
+int OutputChain::Peek(struct iovec* iov, int max) const {
+  int n = 0;
+  for (auto it = segments_.begin(); it != segments_.end() && n < max; ++it) {
+    if (it->fd >= 0) {
+      break;
+    }
+    if (it->size > 0) {
+      iov[n].iov_base = const_cast<char*>(it->data);
+      iov[n].iov_len = it->size;
+      ++n;
+    }
+  }
+  return n;
+}
+
+void OutputChain::Retrieve(size_t size) {
+  assert(size <= size_);
+  size_ -= size;
+  while (size > 0) {
+    Segment& front = segments_.front();
+    if (size < front.size) {
+      if (front.fd >= 0) {
+        front.offset += static_cast<off_t>(size);
+      } else {
+        front.data += size;
+      }
+      front.size -= size;
+      return;
+    }
+    size -= front.size;
+    if (segments_.size() == 1 && front.block) {
+      // Keeps the last block for what comes next.
+      front.data = front.block.get();
+      front.size = 0;
+    } else {
+      segments_.pop_front();
+    }
+  }
+}
+
+void OutputChain::Clear() {
+  segments_.clear();
+  size_ = 0;
+}
+
+void OutputChain::Swap(OutputChain* other) {
+  segments_.swap(other->segments_);
+  std::swap(size_, other->size_);
+}
+
+ssize_t OutputChain::WriteV(int fd) {
+  ssize_t total = 0;
+  while (!segments_.empty()) {
+    Segment* front = &segments_.front();
+    if (front->fd < 0 && front->size == 0) {
+      // The kept empty block.
+      if (segments_.size() == 1) {
+        break;
+      }
+      segments_.pop_front();
+      continue;
+    }
+    size_t want = 0;
+    ssize_t n;
+    if (front->fd >= 0) {
+      want = front->size;
+      n = SendFile(fd, front);
+    } else {
+      struct iovec iov[kMaxIovecs];
+      int count = Peek(iov, kMaxIovecs);
+      for (int i = 0; i < count; ++i) {
+        want += iov[i].iov_len;
+      }
+      n = ::writev(fd, iov, count);
+    }
+    if (n < 0) {
+      return total > 0 ? total : -1;
+    }
+    if (n == 0 && front->fd >= 0) {
+      // The file is shorter than it was, the rest can never be sent.
+      Retrieve(front->size);
+      errno = EIO;
+      return -1;
+    }
+    Retrieve(static_cast<size_t>(n));
+    total += n;
+    if (static_cast<size_t>(n) < want) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t OutputChain::SendFile(int socket, Segment* segment) {
+#ifdef __linux__
+  off_t offset = segment->offset;
+  return ::sendfile(socket, segment->fd, &offset, segment->size);
+#else
+  char buf[65536];
+  ssize_t n = ::pread(segment->fd, buf, std::min(sizeof(buf), segment->size),
+                      segment->offset);
+  if (n <= 0) {
+    return n;
+  }
+  return ::write(socket, buf, static_cast<size_t>(n));
+#endif
+}
+
+}  // namespace voyager
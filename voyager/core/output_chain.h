@@ -0,0 +1,103 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_OUTPUT_CHAIN_H_
+#define VOYAGER_CORE_OUTPUT_CHAIN_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// The bytes waiting to be written to a connection, as a list of segments:
+// small pieces are copied into blocks owned by the chain, large ones are
+// only referenced and kept alive by their owner until they are written, so
+// a big response body is never copied. The segments in memory go out with
+// one writev(), and parts of files with sendfile():
+//
+//   OutputChain out;
+//   out.Append(head);
+//   out.Append(body);  // a std::shared_ptr<const std::string>
+//   conn->SendMessage(&out);
+class OutputChain {
+ public:
+  static const size_t kBlockSize = 4096;
+  // Smaller data is copied, an extra iovec costs more than the copy.
+  static const size_t kMinReferenceSize = 1024;
+  // The most iovecs passed to one writev().
+  static const int kMaxIovecs = 64;
+
+  OutputChain() : size_(0) {}
+
+  void Append(const Slice& s) { Append(s.data(), s.size()); }
+  void Append(const char* s) { Append(s, strlen(s)); }
+  void Append(const char* data, size_t size);
+  // Takes s without copying it when it is large.
+  void Append(std::string&& s);
+  void Append(const std::shared_ptr<const std::string>& s);
+  // References [data, data + size) until it is written, owner keeps it alive.
+  void AppendReference(const char* data, size_t size,
+                       const std::shared_ptr<const void>& owner);
+  // Sends size bytes of the file fd from offset with sendfile(), so they
+  // never pass through user space. owner keeps fd open until then.
+  void AppendFile(int fd, off_t offset, size_t size,
+                  const std::shared_ptr<const void>& owner);
+  // Moves all the segments of other to the end, other becomes empty.
+  void Append(OutputChain* other);
+  // Moves the first size bytes of other to the end, splitting a segment
+  // by reference where it can.
+  void Append(OutputChain* other, size_t size);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Points iov at the first segments in memory, up to max of them and up
+  // to the first part of a file, returns how many.
+  int Peek(struct iovec* iov, int max) const;
+  void Retrieve(size_t size);
+  void Clear();
+  void Swap(OutputChain* other);
+
+  // Writes as much as the socket takes, returns it or -1 with errno. A file
+  // which turned out shorter than its part fails with EIO.
+  ssize_t WriteV(int fd);
+
+ private:
+  struct Segment {
+    Segment() : data(nullptr), size(0), capacity(0), fd(-1), offset(0) {}
+
+    // The unwritten bytes, in memory or in the file fd.
+    const char* data;
+    size_t size;
+    // Set for a referenced segment.
+    std::shared_ptr<const void> owner;
+    // Set for an owned one, which has room up to block + capacity.
+    std::unique_ptr<char[]> block;
+    size_t capacity;
+    // Set for a part of a file, from offset.
+    int fd;
+    off_t offset;
+  };
+
+  static ssize_t SendFile(int socket, Segment* segment);
+
+  std::deque<Segment> segments_;
+  size_t size_;
+
+  // No copying allowed
+  OutputChain(const OutputChain&);
+  void operator=(const OutputChain&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_OUTPUT_CHAIN_H_
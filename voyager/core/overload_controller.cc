@@ -0,0 +1,192 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/overload_controller.h"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "voyager/core/tcp_connection.h"
+#include "voyager/core/tcp_server.h"
+#include "voyager/util/logging.h"
+
+namespace voyager {
+
+OverloadOptions::OverloadOptions()
+    : max_lag_micros(20 * 1000),
+      max_funcs_backlog(10000),
+      recover_lag_micros(5 * 1000),
+      interval_micros(10 * 1000),
+      pause_accept(true),
+      shed_connections(1) {}
+
+struct OverloadController::LoopState {
+  explicit LoopState(EventLoop* ev) : loop(ev), overloaded(false) {}
+
+  EventLoop* const loop;
+  std::atomic<bool> overloaded;
+
+  // Only touched in the thread of loop: Stats().bytes_in of every connection at
+  // the previous check, and the connections which were stopped.
+  std::unordered_map<std::string, uint64_t> bytes_read;
+  std::vector<std::weak_ptr<TcpConnection> > stopped;
+};
+
+OverloadController::OverloadController(TcpServer* server,
+                                       const OverloadOptions& options)
+    : server_(CHECK_NOTNULL(server)),
+      options_(options),
+      running_(false),
+      overloaded_(false) {
+  // Never changed after this, the loops read it from OnMessage unlocked.
+  const std::vector<EventLoop*>* loops = server_->AllLoops();
+  for (size_t i = 0; i < loops->size(); ++i) {
+    states_.push_back(std::make_shared<LoopState>((*loops)[i]));
+  }
+}
+
+OverloadController::~OverloadController() {
+  if (running_) {
+    Stop();
+  }
+}
+
+void OverloadController::Start() {
+  server_->OwnerEventLoop()->AssertInMyLoop();
+  assert(!running_);
+  running_ = true;
+  for (size_t i = 0; i < states_.size(); ++i) {
+    states_[i]->loop->EnableLag(true);
+  }
+  timer_ = server_->OwnerEventLoop()->RunEvery(options_.interval_micros,
+                                               [this]() { Check(); });
+}
+
+void OverloadController::Stop() {
+  server_->OwnerEventLoop()->AssertInMyLoop();
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  server_->OwnerEventLoop()->RemoveTimer(timer_);
+  for (size_t i = 0; i < states_.size(); ++i) {
+    std::shared_ptr<LoopState> state(states_[i]);
+    state->loop->EnableLag(false);
+    if (state->overloaded.exchange(false)) {
+      state->loop->QueueInLoop([state]() { Restore(state); }, kHighPriority);
+    }
+  }
+  if (overloaded_.exchange(false) && options_.pause_accept) {
+    server_->PauseAccept(false);
+  }
+}
+
+bool OverloadController::Overloaded(const EventLoop* loop) const {
+  for (size_t i = 0; i < states_.size(); ++i) {
+    if (states_[i]->loop == loop) {
+      return states_[i]->overloaded;
+    }
+  }
+  return false;
+}
+
+void OverloadController::Check() {
+  bool any = false;
+  for (size_t i = 0; i < states_.size(); ++i) {
+    std::shared_ptr<LoopState> state(states_[i]);
+    EventLoop* loop = state->loop;
+    uint64_t lag = loop->TakeLagMicros();
+    size_t backlog = loop->FuncsBacklog();
+    bool was = state->overloaded;
+    bool now;
+    if (was) {
+      now = lag >= options_.recover_lag_micros ||
+            backlog >= options_.max_funcs_backlog / 2;
+    } else {
+      now = lag > options_.max_lag_micros ||
+            backlog > options_.max_funcs_backlog;
+    }
+    if (now != was) {
+      state->overloaded = now;
+      if (now) {
+        VOYAGER_LOG(WARN) << "OverloadController - EventLoop " << loop
+                          << " is overloaded, lag " << lag << "us, "
+                          << backlog << " queued functors";
+      } else {
+        VOYAGER_LOG(INFO) << "OverloadController - EventLoop " << loop
+                          << " recovered";
+        loop->QueueInLoop([state]() { Restore(state); }, kHighPriority);
+      }
+    }
+    if (now && options_.shed_connections > 0) {
+      // Ahead of the events which keep the loop behind.
+      const void* owner = server_;
+      int n = options_.shed_connections;
+      loop->QueueInLoop([state, owner, n]() { Shed(state, owner, n); },
+                        kHighPriority);
+    }
+    any = any || now;
+  }
+  if (any != overloaded_) {
+    overloaded_ = any;
+    if (options_.pause_accept) {
+      server_->PauseAccept(any);
+    }
+  }
+}
+
+void OverloadController::Shed(const std::shared_ptr<LoopState>& state,
+                              const void* owner, int n) {
+  if (!state->overloaded) {
+    return;
+  }
+  std::unordered_map<std::string, uint64_t> bytes_read;
+  std::vector<std::pair<uint64_t, TcpConnectionPtr> > noisy;
+  state->loop->ForEachConnection([&](const TcpConnectionPtr& ptr) {
+    if (ptr->Owner() != owner) {
+      return;
+    }
+    std::string name(ptr->name());
+    uint64_t bytes = ptr->Stats().bytes_in;
+    std::unordered_map<std::string, uint64_t>::const_iterator it =
+        state->bytes_read.find(name);
+    // A connection seen for the first time is only measured.
+    if (it != state->bytes_read.end() && bytes > it->second) {
+      noisy.push_back(std::make_pair(bytes - it->second, ptr));
+    }
+    bytes_read[name] = bytes;
+  });
+  state->bytes_read.swap(bytes_read);
+
+  size_t size = std::min(noisy.size(), static_cast<size_t>(n));
+  std::partial_sort(noisy.begin(), noisy.begin() + size, noisy.end(),
+                    [](const std::pair<uint64_t, TcpConnectionPtr>& a,
+                       const std::pair<uint64_t, TcpConnectionPtr>& b) {
+                      return a.first > b.first;
+                    });
+  for (size_t i = 0; i < size; ++i) {
+    VOYAGER_LOG(WARN) << "OverloadController - stop reading on ["
+                      << noisy[i].second->name() << "], " << noisy[i].first
+                      << " bytes read since the last check";
+    noisy[i].second->StopRead();
+    state->stopped.push_back(noisy[i].second);
+  }
+}
+
+void OverloadController::Restore(const std::shared_ptr<LoopState>& state) {
+  for (size_t i = 0; i < state->stopped.size(); ++i) {
+    TcpConnectionPtr ptr = state->stopped[i].lock();
+    if (ptr && ptr->IsConnected()) {
+      ptr->StartRead();
+    }
+  }
+  state->stopped.clear();
+  state->bytes_read.clear();
+}
+
+}  // namespace voyager
@@ -0,0 +1,94 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_OVERLOAD_CONTROLLER_H_
+#define VOYAGER_CORE_OVERLOAD_CONTROLLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+
+namespace voyager {
+
+class TcpServer;
+
+struct OverloadOptions {
+  // A loop becomes overloaded once its lag, see EventLoop::TakeLagMicros(),
+  // exceeds max_lag_micros or its queued functors exceed max_funcs_backlog.
+  // Default: 20 * 1000
+  uint64_t max_lag_micros;
+  // Default: 10000
+  size_t max_funcs_backlog;
+
+  // It recovers once the lag drops below recover_lag_micros and the backlog
+  // below half of max_funcs_backlog.
+  // Default: 5 * 1000
+  uint64_t recover_lag_micros;
+
+  // Default: 10 * 1000
+  uint64_t interval_micros;
+
+  // Stop accepting while any loop is overloaded.
+  // Default: true
+  bool pause_accept;
+
+  // Stop reading on this many of the connections which read the most since
+  // the previous check, every check while their loop stays overloaded. They
+  // read again when it recovers.
+  // Default: 1
+  int shed_connections;
+
+  OverloadOptions();
+};
+
+// Keeps the goodput of a TcpServer stable when its loops fall behind, by
+// shedding new work instead of letting every connection slow down. The
+// controller checks the lag and the functor backlog of every loop of the
+// server from the loop of the server, and acts on the transitions:
+// accepting pauses, the noisiest connections of an overloaded loop stop
+// reading, and protocols may answer quickly with an error while
+// Overloaded() is true, as HttpServer does with 503.
+class OverloadController {
+ public:
+  // Start() the server first, the controller takes its loops here.
+  OverloadController(TcpServer* server, const OverloadOptions& options);
+  ~OverloadController();
+
+  // Only in the loop of the server.
+  void Start();
+  // Resumes everything that was shed, only in the loop of the server.
+  void Stop();
+
+  // Safe to call in any thread.
+  bool Overloaded() const { return overloaded_; }
+  bool Overloaded(const EventLoop* loop) const;
+
+ private:
+  struct LoopState;
+
+  void Check();
+  static void Shed(const std::shared_ptr<LoopState>& state, const void* owner,
+                   int n);
+  static void Restore(const std::shared_ptr<LoopState>& state);
+
+  TcpServer* server_;
+  const OverloadOptions options_;
+  bool running_;
+  TimerId timer_;
+  std::atomic<bool> overloaded_;
+  std::vector<std::shared_ptr<LoopState> > states_;
+
+  // No copying allowed
+  OverloadController(const OverloadController&);
+  void operator=(const OverloadController&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_OVERLOAD_CONTROLLER_H_
@@ -16,9 +16,16 @@ void Schedule::Start() {
   assert(!started_);
   started_ = true;
   for (size_t i = 0; i < size_; ++i) {
-    BGEventLoop* loop = new BGEventLoop(baseloop_->GetPollType());
+    int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+    BGEventLoop* loop = new BGEventLoop(baseloop_->GetPollType(), cpu);
     loops_.push_back(loop->Loop());
     bg_loops_.push_back(std::unique_ptr<BGEventLoop>(loop));
+    if (cpu >= 0) {
+      if (cpu_loops_.size() <= static_cast<size_t>(cpu)) {
+        cpu_loops_.resize(static_cast<size_t>(cpu) + 1);
+      }
+      cpu_loops_[cpu].first.push_back(loops_.back());
+    }
   }
   if (size_ == 0) {
     loops_.push_back(baseloop_);
@@ -30,10 +37,18 @@ const std::vector<EventLoop*>* Schedule::AllLoops() const {
   return &loops_;
 }
 
-EventLoop* Schedule::AssignLoop() {
+EventLoop* Schedule::AssignLoop(int cpu) {
   baseloop_->AssertInMyLoop();
   assert(started_);
   assert(!loops_.empty());
+  if (cpu >= 0 && static_cast<size_t>(cpu) < cpu_loops_.size() &&
+      !cpu_loops_[cpu].first.empty()) {
+    // More loops than cpus share them, so every loop gets connections.
+    std::pair<std::vector<EventLoop*>, size_t>& pinned = cpu_loops_[cpu];
+    EventLoop* loop = pinned.first[pinned.second];
+    pinned.second = (pinned.second + 1) % pinned.first.size();
+    return loop;
+  }
   EventLoop* loop = loops_[0];
   int min = loop->ConnectionSize();
 
@@ -6,6 +6,7 @@
 #define VOYAGER_CORE_SCHEDULE_H_
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "voyager/core/bg_eventloop.h"
@@ -16,9 +17,15 @@ class Schedule {
  public:
   Schedule(EventLoop* ev, int size);
 
+  // Pins the i-th loop to cpus[i % cpus.size()], call it before Start().
+  void SetCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+
   void Start();
 
-  EventLoop* AssignLoop();
+  // Prefers the loops pinned to cpu, usually the cpu which handled the
+  // packets of the new connection, in turn when there are several, and
+  // falls back to the loop with the fewest connections.
+  EventLoop* AssignLoop(int cpu = -1);
 
   bool Started() const { return started_; }
 
@@ -28,7 +35,11 @@ class Schedule {
   EventLoop* baseloop_;
   size_t size_;
   bool started_;
+  std::vector<int> cpus_;
   std::vector<EventLoop*> loops_;
+  // The loops pinned to each cpu, indexed by cpu, and the index of the
+  // next one to assign.
+  std::vector<std::pair<std::vector<EventLoop*>, size_t> > cpu_loops_;
   std::vector<std::unique_ptr<BGEventLoop> > bg_loops_;
 
   // No copying alloweded
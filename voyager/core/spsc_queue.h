@@ -0,0 +1,99 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_SPSC_QUEUE_H_
+#define VOYAGER_CORE_SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace voyager {
+
+// A bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Both sides keep a cached copy of the other index, so they only
+// touch the shared cache line when the cached view says full or empty. T
+// must be default-constructible and move-assignable.
+template <typename T>
+class SpscQueue {
+ public:
+  // capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : mask_(RoundUp(capacity) - 1),
+        slots_(new T[mask_ + 1]),
+        head_(0),
+        cached_tail_(0),
+        tail_(0),
+        cached_head_(0) {}
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // Producer only, false if the ring is full.
+  bool TryPush(T&& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only, false if the ring is empty.
+  bool TryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    *value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Safe in any thread, but only a hint outside the consumer.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static const size_t kCacheLine = 64;
+
+  static size_t RoundUp(size_t n) {
+    size_t c = 2;
+    while (c < n) {
+      c <<= 1;
+    }
+    return c;
+  }
+
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+
+  // The consumer side, then the producer side, padded onto separate cache
+  // lines.
+  char pad0_[kCacheLine];
+  std::atomic<size_t> head_;
+  size_t cached_tail_;
+  char pad1_[kCacheLine - sizeof(size_t) * 2];
+  std::atomic<size_t> tail_;
+  size_t cached_head_;
+  char pad2_[kCacheLine - sizeof(size_t) * 2];
+
+  // No copying allowed
+  SpscQueue(const SpscQueue&);
+  void operator=(const SpscQueue&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_SPSC_QUEUE_H_
@@ -0,0 +1,267 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/stall_detector.h"
+
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <sstream>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/util/logging.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+namespace {
+
+const int kMaxFrames = 64;
+
+// Only one monitor thread samples a backtrace at a time. The handler takes
+// the request before it writes the frames, and a request which the sampler
+// took back after its timeout is not answered, so a late signal never
+// writes the frames while they are read, nor answers a request for another
+// thread.
+std::mutex backtrace_mutex;
+uint64_t backtrace_seq = 0;
+std::atomic<pthread_t> backtrace_thread;
+std::atomic<uint64_t> backtrace_request(0);
+std::atomic<uint64_t> backtrace_done(0);
+void* backtrace_frames[kMaxFrames];
+int backtrace_depth = 0;
+
+void BacktraceHandler(int) {
+  if (!::pthread_equal(backtrace_thread.load(std::memory_order_acquire),
+                       ::pthread_self())) {
+    return;
+  }
+  uint64_t request = backtrace_request.exchange(0, std::memory_order_acquire);
+  if (request == 0) {
+    return;
+  }
+  int saved_errno = errno;
+  backtrace_depth = ::backtrace(backtrace_frames, kMaxFrames);
+  backtrace_done.store(request, std::memory_order_release);
+  errno = saved_errno;
+}
+
+int BacktraceSignal() { return SIGRTMIN + 2; }
+
+}  // anonymous namespace
+
+StallWatch::StallWatch(EventLoop* loop, uint64_t threshold_nanos)
+    : loop_(loop),
+      threshold_nanos_(threshold_nanos),
+      thread_(pthread_t()),
+      valid_(false),
+      seq_(0),
+      start_nanos_(0),
+      what_(nullptr),
+      depth_(0),
+      reported_(false),
+      reported_seq_(0) {}
+
+uint64_t StallWatch::Enter(const char* what) {
+  uint64_t start = timeops::TscNanos();
+  if (depth_++ == 0) {
+    start_nanos_.store(start, std::memory_order_relaxed);
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+  what_.store(what, std::memory_order_relaxed);
+  return start;
+}
+
+void StallWatch::Exit(const char* what, const char* name, int fd,
+                      uint64_t start) {
+  uint64_t nanos = timeops::TscNanos() - start;
+  if (nanos > threshold_nanos_ && !reported_) {
+    reported_ = true;
+    std::ostringstream os;
+    os << "EventLoop " << loop_ << " blocked " << nanos / 1000 << "us in "
+       << what;
+    if (name != nullptr) {
+      os << " of " << name;
+    }
+    if (fd >= 0) {
+      os << " fd=" << fd;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reports_.size() < kMaxPendingReports) {
+      reports_.push_back(os.str());
+    }
+  }
+  if (--depth_ == 0) {
+    reported_ = false;
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_release);
+  }
+}
+
+void StallWatch::Unwatch() {
+  std::lock_guard<std::mutex> lock(thread_mutex_);
+  valid_.store(false, std::memory_order_relaxed);
+}
+
+StallDetector::StallDetector(uint64_t threshold_micros, bool backtrace)
+    : threshold_nanos_(threshold_micros * 1000),
+      backtrace_(backtrace),
+      running_(false) {}
+
+StallDetector::~StallDetector() { Stop(); }
+
+void StallDetector::Watch(EventLoop* loop) {
+  std::shared_ptr<StallWatch> watch(new StallWatch(loop, threshold_nanos_));
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    watches_.push_back(watch);
+  }
+  loop->RunInLoop([loop, watch]() {
+    {
+      std::lock_guard<std::mutex> lock(watch->thread_mutex_);
+      watch->thread_.store(pthread_self(), std::memory_order_relaxed);
+      watch->valid_.store(true, std::memory_order_relaxed);
+    }
+    loop->SetStallWatch(watch);
+  });
+}
+
+void StallDetector::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    return;
+  }
+  if (backtrace_) {
+    // backtrace() loads libgcc on its first call, which must not happen
+    // in the signal handler.
+    void* frame;
+    ::backtrace(&frame, 1);
+    struct sigaction sa;
+    sa.sa_handler = BacktraceHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    ::sigaction(BacktraceSignal(), &sa, nullptr);
+  }
+  running_ = true;
+  thread_.reset(new std::thread(&StallDetector::Run, this));
+}
+
+void StallDetector::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_) {
+      return;
+    }
+    running_ = false;
+  }
+  cv_.notify_all();
+  thread_->join();
+  thread_.reset();
+}
+
+void StallDetector::Run() {
+  // Check twice per threshold, but no more than once per millisecond.
+  uint64_t tick = threshold_nanos_ / 2000;
+  tick = tick < 1000 ? 1000 : (tick > 100000 ? 100000 : tick);
+  std::vector<std::shared_ptr<StallWatch> > watches;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_for(lock, std::chrono::microseconds(tick),
+                   [this]() { return !running_; });
+      if (!running_) {
+        break;
+      }
+      watches = watches_;
+    }
+    uint64_t now = timeops::TscNanos();
+    for (size_t i = 0; i < watches.size(); ++i) {
+      Check(watches[i].get(), now);
+    }
+  }
+}
+
+void StallDetector::Check(StallWatch* watch, uint64_t now) {
+  uint64_t seq = watch->seq_.load(std::memory_order_acquire);
+  if ((seq & 1) && seq != watch->reported_seq_) {
+    uint64_t start = watch->start_nanos_.load(std::memory_order_relaxed);
+    const char* what = watch->what_.load(std::memory_order_relaxed);
+    if (watch->seq_.load(std::memory_order_acquire) == seq && now > start &&
+        now - start > threshold_nanos_) {
+      watch->reported_seq_ = seq;
+      std::string trace;
+      if (backtrace_) {
+        trace = SampleBacktrace(watch);
+      }
+      VOYAGER_LOG(WARN) << "EventLoop " << watch->loop_ << " is blocked in "
+                        << what << " for " << (now - start) / 1000 << "us"
+                        << trace;
+    }
+  }
+
+  std::vector<std::string> reports;
+  {
+    std::lock_guard<std::mutex> lock(watch->mutex_);
+    reports.swap(watch->reports_);
+  }
+  for (size_t i = 0; i < reports.size(); ++i) {
+    VOYAGER_LOG(WARN) << reports[i];
+  }
+}
+
+std::string StallDetector::SampleBacktrace(StallWatch* watch) {
+  std::lock_guard<std::mutex> lock(backtrace_mutex);
+  uint64_t seq = ++backtrace_seq;
+  {
+    // The thread can not exit while it is signalled and waited for.
+    std::lock_guard<std::mutex> thread_lock(watch->thread_mutex_);
+    if (!watch->valid_.load(std::memory_order_relaxed)) {
+      return std::string();
+    }
+    pthread_t thread = watch->thread_.load(std::memory_order_relaxed);
+    backtrace_thread.store(thread, std::memory_order_relaxed);
+    backtrace_request.store(seq, std::memory_order_release);
+    if (::pthread_kill(thread, BacktraceSignal()) != 0) {
+      backtrace_request.store(0, std::memory_order_relaxed);
+      return std::string();
+    }
+    bool done = false;
+    for (int i = 0; i < 1000 && !done; ++i) {
+      done = backtrace_done.load(std::memory_order_acquire) == seq;
+      if (!done) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+    if (!done) {
+      if (backtrace_request.exchange(0, std::memory_order_acquire) == seq) {
+        // Not taken, the handler will ignore the signal.
+        return std::string();
+      }
+      // Taken and being written.
+      while (backtrace_done.load(std::memory_order_acquire) != seq) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  int depth = backtrace_depth;
+  if (depth <= 0) {
+    return std::string();
+  }
+  std::string result;
+  char** symbols = ::backtrace_symbols(backtrace_frames, depth);
+  if (symbols != nullptr) {
+    // Skip the frames of the signal handler.
+    for (int i = 1; i < depth; ++i) {
+      result += "\n    ";
+      result += symbols[i];
+    }
+    ::free(symbols);
+  }
+  return result;
+}
+
+}  // namespace voyager
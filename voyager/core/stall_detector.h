@@ -0,0 +1,149 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_STALL_DETECTOR_H_
+#define VOYAGER_CORE_STALL_DETECTOR_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace voyager {
+
+class EventLoop;
+
+// Internal use only, one for each loop watched by a StallDetector. The loop
+// thread brackets every dispatched event, queued functor and timer proc with
+// Enter() and Exit(), which only store a few atomics unless the callback
+// turns out to be slow.
+class StallWatch {
+ public:
+  StallWatch(EventLoop* loop, uint64_t threshold_nanos);
+
+  // Returns the start time, which must be passed to Exit(). Scopes nest, a
+  // timer proc runs inside the event of the timerfd for example, and only
+  // the innermost slow scope is reported.
+  uint64_t Enter(const char* what);
+  void Exit(const char* what, const char* name, int fd, uint64_t start);
+
+  // Called by the loop before it is destroyed, no backtrace is sampled
+  // from its thread afterwards.
+  void Unwatch();
+
+ private:
+  friend class StallDetector;
+
+  static const size_t kMaxPendingReports = 1024;
+
+  EventLoop* const loop_;
+  const uint64_t threshold_nanos_;
+
+  // The loop thread, valid_ once it is known and until Unwatch(), which
+  // waits for a backtrace being sampled under thread_mutex_.
+  std::mutex thread_mutex_;
+  std::atomic<pthread_t> thread_;
+  std::atomic<bool> valid_;
+
+  // Odd while the loop thread is inside a callback.
+  std::atomic<uint64_t> seq_;
+  // The start of the outermost callback and the innermost identifier.
+  std::atomic<uint64_t> start_nanos_;
+  std::atomic<const char*> what_;
+
+  // Only touched in the loop thread.
+  int depth_;
+  bool reported_;
+
+  // Only touched in the monitor thread.
+  uint64_t reported_seq_;
+
+  std::mutex mutex_;
+  std::vector<std::string> reports_;
+
+  // No copying allowed
+  StallWatch(const StallWatch&);
+  void operator=(const StallWatch&);
+};
+
+// Reports the callbacks which block an EventLoop for longer than a
+// threshold, so a synchronous DNS lookup or a heavy MessageCallback can be
+// found. Callbacks are reported twice: by a monitor thread while they are
+// still running, optionally with a backtrace sampled from the stuck loop
+// thread, and by the loop thread when they return, with the name of the
+// connection. All logging happens in the monitor thread, the loop thread
+// only formats a report for a callback that was already too slow.
+//
+// Backtraces are sampled by sending SIGRTMIN + 2 to the loop thread, so
+// the application must not use that signal for anything else.
+class StallDetector {
+ public:
+  explicit StallDetector(uint64_t threshold_micros, bool backtrace = false);
+  ~StallDetector();
+
+  // Safe to call in any thread, before or after Start(). The loop may be
+  // destroyed before the detector.
+  void Watch(EventLoop* loop);
+
+  void Start();
+  void Stop();
+
+ private:
+  void Run();
+  void Check(StallWatch* watch, uint64_t now);
+  std::string SampleBacktrace(StallWatch* watch);
+
+  const uint64_t threshold_nanos_;
+  const bool backtrace_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+  std::vector<std::shared_ptr<StallWatch> > watches_;
+  std::unique_ptr<std::thread> thread_;
+
+  // No copying allowed
+  StallDetector(const StallDetector&);
+  void operator=(const StallDetector&);
+};
+
+// Brackets a callback with StallWatch::Enter() and Exit(), watch may be
+// nullptr.
+class StallScope {
+ public:
+  StallScope(StallWatch* watch, const char* what, const char* name = nullptr,
+             int fd = -1)
+      : watch_(watch), what_(what), name_(name), fd_(fd), start_(0) {
+    if (watch_ != nullptr) {
+      start_ = watch_->Enter(what_);
+    }
+  }
+
+  ~StallScope() {
+    if (watch_ != nullptr) {
+      watch_->Exit(what_, name_, fd_, start_);
+    }
+  }
+
+ private:
+  StallWatch* watch_;
+  const char* what_;
+  const char* name_;
+  int fd_;
+  uint64_t start_;
+
+  // No copying allowed
+  StallScope(const StallScope&);
+  void operator=(const StallScope&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_STALL_DETECTOR_H_
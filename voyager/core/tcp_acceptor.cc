@@ -30,6 +30,18 @@ TcpAcceptor::TcpAcceptor(EventLoop* eventloop, const SockAddr& addr,
   dispatch_.SetReadCallback(std::bind(&TcpAcceptor::Accept, this));
 }
 
+TcpAcceptor::TcpAcceptor(EventLoop* eventloop, int listenfd, int backlog)
+    : eventloop_(eventloop),
+      socket_(listenfd),
+      dispatch_(eventloop_, socket_.SocketFd()),
+      backlog_(backlog),
+      idlefd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+      listenning_(false) {
+  assert(idlefd_ >= 0);
+  socket_.SetNonBlockAndCloseOnExec(true);
+  dispatch_.SetReadCallback(std::bind(&TcpAcceptor::Accept, this));
+}
+
 TcpAcceptor::~TcpAcceptor() {
   dispatch_.DisableAll();
   dispatch_.RemoveEvents();
@@ -43,6 +55,26 @@ void TcpAcceptor::EnableListen() {
   dispatch_.EnableRead();
 }
 
+void TcpAcceptor::DisableListen() {
+  eventloop_->AssertInMyLoop();
+  listenning_ = false;
+  dispatch_.DisableAll();
+}
+
+void TcpAcceptor::PauseListen(bool pause) {
+  eventloop_->AssertInMyLoop();
+  if (!listenning_) {
+    return;
+  }
+  if (pause == dispatch_.IsReading()) {
+    if (pause) {
+      dispatch_.DisableRead();
+    } else {
+      dispatch_.EnableRead();
+    }
+  }
+}
+
 void TcpAcceptor::Accept() {
   eventloop_->AssertInMyLoop();
   struct sockaddr_storage sa;
@@ -25,10 +25,18 @@ class TcpAcceptor {
 
   TcpAcceptor(EventLoop* eventloop, const SockAddr& addr, int backlog,
               bool reuseport);
+  // Adopts a socket which is already bound and listening.
+  TcpAcceptor(EventLoop* eventloop, int listenfd, int backlog);
   ~TcpAcceptor();
 
   void EnableListen();
+  // Stops accepting, the socket stays open and keeps queueing connections.
+  void DisableListen();
+  // Stops or resumes accepting while listenning, so new connections wait in
+  // the backlog of the kernel.
+  void PauseListen(bool pause);
   bool IsListenning() const { return listenning_; }
+  int ListenFd() const { return socket_.SocketFd(); }
 
   void SetNewConnectionCallback(const NewConnectionCallback& cb) {
     conn_cb_ = cb;
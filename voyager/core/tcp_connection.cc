@@ -9,8 +9,10 @@
 
 #include "voyager/core/dispatch.h"
 #include "voyager/core/eventloop.h"
+#include "voyager/util/macros.h"
 #include "voyager/util/logging.h"
 #include "voyager/util/slice.h"
+#include "voyager/util/timeops.h"
 
 namespace voyager {
 
@@ -24,7 +26,10 @@ TcpConnection::TcpConnection(const std::string& name, EventLoop* ev, int fd,
       state_(kConnecting),
       dispatch_(new Dispatch(ev, fd)),
       context_(nullptr),
+      owner_(nullptr),
+      last_active_(0),
       high_water_mark_(64 * 1024 * 1024) {
+  dispatch_->SetName(name_.c_str());
   dispatch_->SetReadCallback(std::bind(&TcpConnection::HandleRead, this));
   dispatch_->SetWriteCallback(std::bind(&TcpConnection::HandleWrite, this));
   dispatch_->SetCloseCallback(std::bind(&TcpConnection::HandleClose, this));
@@ -46,6 +51,7 @@ void TcpConnection::StartWorking() {
   eventloop_->AssertInMyLoop();
   assert(state_ == kConnecting);
   state_ = kConnected;
+  last_active_ = eventloop_->Now();
   TcpConnectionPtr ptr(shared_from_this());
   dispatch_->Tie(ptr);
   dispatch_->EnableRead();
@@ -90,11 +96,25 @@ void TcpConnection::ForceClose() {
   if (state_.compare_exchange_weak(expected, kDisconnecting) ||
       state_ == kDisconnecting) {
     TcpConnectionPtr ptr(shared_from_this());
-    eventloop_->QueueInLoop([ptr]() {
-      if (ptr->state_ == kConnected || ptr->state_ == kDisconnecting) {
-        ptr->HandleClose();
-      }
-    });
+    // Ahead of the queued data-plane work, the data is dropped anyway.
+    eventloop_->QueueInLoop(
+        [ptr]() {
+          if (ptr->state_ == kConnected || ptr->state_ == kDisconnecting) {
+            ptr->HandleClose();
+          }
+        },
+        kHighPriority);
+  }
+}
+
+template <typename F>
+void TcpConnection::RunTimed(const F& f) {
+  if (VOYAGER_PREDICT_FALSE(eventloop_->StatsRecorder() != nullptr)) {
+    uint64_t start = timeops::TscNanos();
+    f();
+    stats_.callback_nanos += timeops::TscNanos() - start;
+  } else {
+    f();
   }
 }
 
@@ -102,8 +122,11 @@ void TcpConnection::HandleRead() {
   eventloop_->AssertInMyLoop();
   ssize_t n = readbuf_.ReadV(dispatch_->Fd());
   if (n > 0) {
+    last_active_ = eventloop_->Now();
+    ++stats_.reads;
+    stats_.bytes_in += static_cast<uint64_t>(n);
     if (message_cb_) {
-      message_cb_(shared_from_this(), &readbuf_);
+      RunTimed([this]() { message_cb_(shared_from_this(), &readbuf_); });
     }
   } else if (n == 0) {
     HandleClose();
@@ -112,8 +135,9 @@ void TcpConnection::HandleRead() {
       HandleClose();
     }
     if (errno != EWOULDBLOCK && errno != EAGAIN) {
-      VOYAGER_LOG(ERROR) << "TcpConnection::HandleRead [" << name_
-                         << "] - readv: " << strerror(errno);
+      VOYAGER_LOG_EVERY_MS(ERROR, 1000) << "TcpConnection::HandleRead ["
+                                        << name_ << "] - readv: "
+                                        << strerror(errno);
     }
   }
 }
@@ -121,27 +145,21 @@ void TcpConnection::HandleRead() {
 void TcpConnection::HandleWrite() {
   eventloop_->AssertInMyLoop();
   if (dispatch_->IsWriting()) {
-    ssize_t n =
-        ::write(dispatch_->Fd(), writebuf_.Peek(), writebuf_.ReadableSize());
+    ssize_t n = writebuf_.WriteV(dispatch_->Fd());
     if (n >= 0) {
-      writebuf_.Retrieve(static_cast<size_t>(n));
-      if (writebuf_.ReadableSize() == 0) {
+      ++stats_.writes;
+      stats_.bytes_out += static_cast<uint64_t>(n);
+      if (writebuf_.empty()) {
         dispatch_->DisableWrite();
         if (writecomplete_cb_) {
-          writecomplete_cb_(shared_from_this());
+          RunTimed([this]() { writecomplete_cb_(shared_from_this()); });
         }
         if (state_ == kDisconnecting) {
           HandleClose();
         }
       }
     } else {
-      if (errno == EPIPE || errno == ECONNRESET) {
-        HandleClose();
-      }
-      if (errno != EWOULDBLOCK && errno != EAGAIN) {
-        VOYAGER_LOG(ERROR) << "TcpConnection::HandleWrite [" << name_
-                           << "] - write: " << strerror(errno);
-      }
+      WriteFault("HandleWrite");
     }
   } else {
     VOYAGER_LOG(INFO) << "TcpConnection::HandleWrite [" << name_
@@ -205,6 +223,20 @@ void TcpConnection::SendMessage(Buffer* message) {
   }
 }
 
+void TcpConnection::SendMessage(OutputChain* message) {
+  CHECK_NOTNULL(message);
+  if (state_ == kConnected) {
+    if (eventloop_->IsInMyLoop()) {
+      SendInLoop(message);
+    } else {
+      std::shared_ptr<OutputChain> chain(new OutputChain());
+      chain->Swap(message);
+      TcpConnectionPtr ptr(shared_from_this());
+      eventloop_->RunInLoop([ptr, chain]() { ptr->SendInLoop(chain.get()); });
+    }
+  }
+}
+
 void TcpConnection::Send(const std::string& s) {
   SendInLoop(s.data(), s.size());
 }
@@ -219,36 +251,28 @@ void TcpConnection::SendInLoop(const void* data, size_t size) {
 
   ssize_t nwrote = 0;
   size_t remaining = size;
-  bool fault = false;
+  last_active_ = eventloop_->Now();
 
-  if (!dispatch_->IsWriting() && writebuf_.ReadableSize() == 0) {
+  if (!dispatch_->IsWriting() && writebuf_.empty()) {
     nwrote = ::write(dispatch_->Fd(), data, size);
     if (nwrote >= 0) {
+      ++stats_.writes;
+      stats_.bytes_out += static_cast<uint64_t>(nwrote);
       remaining = size - static_cast<size_t>(nwrote);
       if (remaining == 0 && writecomplete_cb_) {
-        writecomplete_cb_(shared_from_this());
+        RunTimed([this]() { writecomplete_cb_(shared_from_this()); });
       }
     } else {
       nwrote = 0;
-      if (errno == EPIPE || errno == ECONNRESET) {
-        HandleClose();
-        fault = true;
-      }
-      if (errno != EWOULDBLOCK && errno != EAGAIN) {
-        VOYAGER_LOG(ERROR) << "TcpConnection::SendInLoop [" << name_
-                           << "] - write: " << strerror(errno);
+      if (WriteFault("SendInLoop")) {
+        return;
       }
     }
   }
 
   assert(remaining <= size);
-  if (!fault && remaining > 0) {
-    size_t old = writebuf_.ReadableSize();
-    if (high_water_mark_cb_ && old < high_water_mark_ &&
-        (old + remaining) >= high_water_mark_) {
-      eventloop_->QueueInLoop(
-          std::bind(high_water_mark_cb_, shared_from_this(), old + remaining));
-    }
+  if (remaining > 0) {
+    CheckHighWaterMark(remaining);
     writebuf_.Append(static_cast<const char*>(data) + nwrote, remaining);
     if (!dispatch_->IsWriting()) {
       dispatch_->EnableWrite();
@@ -256,6 +280,71 @@ void TcpConnection::SendInLoop(const void* data, size_t size) {
   }
 }
 
+void TcpConnection::SendInLoop(OutputChain* message) {
+  eventloop_->AssertInMyLoop();
+  if (state_ == kDisconnected) {
+    VOYAGER_LOG(WARN) << "TcpConnection::SendInLoop[" << name_ << "]"
+                      << "has disconnected, give up writing.";
+    message->Clear();
+    return;
+  }
+
+  last_active_ = eventloop_->Now();
+  if (!dispatch_->IsWriting() && writebuf_.empty()) {
+    ssize_t nwrote = message->WriteV(dispatch_->Fd());
+    if (nwrote >= 0) {
+      ++stats_.writes;
+      stats_.bytes_out += static_cast<uint64_t>(nwrote);
+      if (message->empty() && writecomplete_cb_) {
+        RunTimed([this]() { writecomplete_cb_(shared_from_this()); });
+      }
+    } else if (WriteFault("SendInLoop")) {
+      message->Clear();
+      return;
+    }
+  }
+
+  if (!message->empty()) {
+    CheckHighWaterMark(message->size());
+    writebuf_.Append(message);
+    if (!dispatch_->IsWriting()) {
+      dispatch_->EnableWrite();
+    }
+  }
+}
+
+bool TcpConnection::WriteFault(const char* func) {
+  int err = errno;
+  bool closed = false;
+  // EIO is a file body cut short, which leaves the peer waiting.
+  if (err == EPIPE || err == ECONNRESET || err == EIO) {
+    HandleClose();
+    closed = true;
+  }
+  if (err != EWOULDBLOCK && err != EAGAIN) {
+    VOYAGER_LOG_EVERY_MS(ERROR, 1000) << "TcpConnection::" << func << " ["
+                                      << name_ << "] - write: "
+                                      << strerror(err);
+  }
+  return closed;
+}
+
+void TcpConnection::CheckHighWaterMark(size_t size) {
+  size_t old = writebuf_.size();
+  if (high_water_mark_cb_ && old < high_water_mark_ &&
+      (old + size) >= high_water_mark_) {
+    eventloop_->QueueInLoop(
+        std::bind(high_water_mark_cb_, shared_from_this(), old + size));
+  }
+}
+
+bool TcpConnection::IsIdle(uint64_t micros) const {
+  eventloop_->AssertInMyLoop();
+  return state_ == kConnected && readbuf_.ReadableSize() == 0 &&
+         writebuf_.empty() &&
+         eventloop_->Now() >= last_active_ + micros;
+}
+
 std::string TcpConnection::StateToString() const {
   const char* type;
   switch (state_.load(std::memory_order_relaxed)) {
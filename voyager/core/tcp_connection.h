@@ -5,6 +5,8 @@
 #ifndef VOYAGER_CORE_TCP_CONNECTION_H_
 #define VOYAGER_CORE_TCP_CONNECTION_H_
 
+#include <stdint.h>
+
 #include <atomic>
 #include <memory>
 #include <string>
@@ -13,6 +15,8 @@
 #include "voyager/core/base_socket.h"
 #include "voyager/core/buffer.h"
 #include "voyager/core/callback.h"
+#include "voyager/core/connection_stats.h"
+#include "voyager/core/output_chain.h"
 #include "voyager/core/sockaddr.h"
 
 namespace voyager {
@@ -70,6 +74,8 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   void SendMessage(std::string&& message);
   void SendMessage(const Slice& message);
   void SendMessage(Buffer* message);
+  // Takes over the segments of message, the referenced ones are not copied.
+  void SendMessage(OutputChain* message);
 
   std::string StateToString() const;
 
@@ -78,22 +84,45 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   bool IsConnected() const { return state_ == kConnected; }
   bool IsConnecting() const { return state_ == kConnecting; }
 
+  // Connected, nothing buffered in either direction, and no data read or
+  // sent for micros. Only in the loop thread.
+  bool IsIdle(uint64_t micros) const;
+
+  // The bytes waiting to be written. Only in the loop thread.
+  size_t OutputSize() const { return writebuf_.size(); }
+  size_t HighWaterMark() const { return high_water_mark_; }
+
+  // Only in the loop thread, see TopConnections().
+  const TcpConnectionStats& Stats() const { return stats_; }
+
   // 默认为ture
   void SetTcpNoDelay(bool on) { socket_.SetTcpNoDelay(on); }
+  void SetBusyPoll(int micros) { socket_.SetBusyPoll(micros); }
 
   // Internal use only, use in TcpClient and TcpServer.
   void StartWorking();
+  // Internal use only, the TcpServer which accepted the connection.
+  void SetOwner(const void* owner) { owner_ = owner; }
+  const void* Owner() const { return owner_; }
 
  private:
   enum ConnectState { kDisconnected, kDisconnecting, kConnected, kConnecting };
 
   void Send(const std::string& s);
   void SendInLoop(const void* data, size_t size);
+  void SendInLoop(OutputChain* message);
+  // Handles the errno of a failed write, true if the connection closed.
+  bool WriteFault(const char* func);
+  // Calls high_water_mark_cb_ if size more bytes cross the mark.
+  void CheckHighWaterMark(size_t size);
 
   void HandleRead();
   void HandleWrite();
   void HandleClose();
   void HandleError();
+  // Runs f, timed into stats_ while the loop records its stats.
+  template <typename F>
+  void RunTimed(const F& f);
 
   const std::string name_;
   EventLoop* eventloop_;
@@ -105,9 +134,13 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   std::unique_ptr<Dispatch> dispatch_;
 
   Buffer readbuf_;
-  Buffer writebuf_;
+  OutputChain writebuf_;
 
   void* context_;
+  const void* owner_;
+  // EventLoop::Now() of the last read or send.
+  uint64_t last_active_;
+  TcpConnectionStats stats_;
 
   size_t high_water_mark_;
 
@@ -3,10 +3,14 @@
 // found in the LICENSE file.
 
 #include "voyager/core/tcp_server.h"
+
+#include <unistd.h>
+
 #include "voyager/core/schedule.h"
 #include "voyager/core/tcp_acceptor.h"
 #include "voyager/core/tcp_connection.h"
 #include "voyager/util/logging.h"
+#include "voyager/util/timeops.h"
 
 namespace voyager {
 
@@ -19,6 +23,10 @@ TcpServer::TcpServer(EventLoop* ev, const SockAddr& addr,
       addr_(addr),
       name_(name),
       started_(false),
+      busy_poll_micros_(0),
+      socket_busy_poll_micros_(0),
+      steer_by_incoming_cpu_(false),
+      live_(new std::atomic<int>(0)),
       schedule_(new Schedule(eventloop_, thread_size)),
       acceptor_(new TcpAcceptor(eventloop_, addr, backlog, reuseport)) {
   acceptor_->SetNewConnectionCallback(std::bind(&TcpServer::NewConnection, this,
@@ -27,19 +35,128 @@ TcpServer::TcpServer(EventLoop* ev, const SockAddr& addr,
   VOYAGER_LOG(INFO) << "TcpServer::TcpServer [" << name_ << "] is running";
 }
 
+TcpServer::TcpServer(EventLoop* ev, int listenfd, const std::string& name,
+                     int thread_size)
+    : eventloop_(CHECK_NOTNULL(ev)),
+      addr_(SockAddr::LocalSockAddr(listenfd)),
+      name_(name),
+      started_(false),
+      busy_poll_micros_(0),
+      socket_busy_poll_micros_(0),
+      steer_by_incoming_cpu_(false),
+      live_(new std::atomic<int>(0)),
+      schedule_(new Schedule(eventloop_, thread_size)),
+      acceptor_(new TcpAcceptor(eventloop_, listenfd, SOMAXCONN)) {
+  acceptor_->SetNewConnectionCallback(std::bind(&TcpServer::NewConnection, this,
+                                                std::placeholders::_1,
+                                                std::placeholders::_2));
+  VOYAGER_LOG(INFO) << "TcpServer::TcpServer [" << name_
+                    << "] is running on fd " << listenfd;
+}
+
 TcpServer::~TcpServer() {
   VOYAGER_LOG(INFO) << "TcpServer::~TcpServer [" << name_ << "] is down";
 }
 
+void TcpServer::SetCpuAffinity(const std::vector<int>& cpus,
+                               bool steer_by_incoming_cpu) {
+  assert(!started_);
+  schedule_->SetCpuAffinity(cpus);
+  steer_by_incoming_cpu_ = steer_by_incoming_cpu;
+}
+
 void TcpServer::Start() {
   bool expected = false;
   if (started_.compare_exchange_strong(expected, true)) {
     schedule_->Start();
+    if (busy_poll_micros_ != 0) {
+      const std::vector<EventLoop*>* loops = schedule_->AllLoops();
+      for (size_t i = 0; i < loops->size(); ++i) {
+        (*loops)[i]->SetBusyPoll(busy_poll_micros_);
+      }
+    }
     assert(!acceptor_->IsListenning());
     eventloop_->RunInLoop([this]() { acceptor_->EnableListen(); });
   }
 }
 
+void TcpServer::Drain(uint64_t micros_timeout,
+                      const std::function<void()>& cb) {
+  eventloop_->RunInLoop([this, micros_timeout, cb]() {
+    if (acceptor_->IsListenning()) {
+      acceptor_->DisableListen();
+    }
+    VOYAGER_LOG(INFO) << "TcpServer::Drain [" << name_ << "] - " << *live_
+                      << " connections";
+    DrainTick(timeops::MonotonicMicros() + micros_timeout, cb);
+  });
+}
+
+void TcpServer::DrainTick(uint64_t deadline, const std::function<void()>& cb) {
+  eventloop_->AssertInMyLoop();
+  if (*live_ == 0) {
+    if (cb) {
+      cb();
+    }
+    return;
+  }
+  bool force = timeops::MonotonicMicros() >= deadline;
+  const void* owner = this;
+  const std::vector<EventLoop*>* loops = schedule_->AllLoops();
+  for (size_t i = 0; i < loops->size(); ++i) {
+    EventLoop* loop = (*loops)[i];
+    loop->RunInLoop([loop, owner, force]() {
+      loop->ForEachConnection([owner, force](const TcpConnectionPtr& ptr) {
+        if (ptr->Owner() != owner) {
+          return;
+        }
+        if (force) {
+          ptr->ForceClose();
+        } else if (ptr->IsIdle(kDrainIdleMicros)) {
+          ptr->ShutDown();
+        }
+      });
+    });
+  }
+  eventloop_->RunAfter(kDrainTickMicros,
+                       [this, deadline, cb]() { DrainTick(deadline, cb); });
+}
+
+void TcpServer::PauseAccept(bool pause) {
+  eventloop_->RunInLoop([this, pause]() { acceptor_->PauseListen(pause); });
+}
+
+void TcpServer::TopConnections(size_t n, ConnectionStatsKey key,
+                               const TopConnectionsCallback& cb) {
+  struct Gather {
+    std::vector<ConnectionStatsEntry> entries;
+    size_t remaining;
+  };
+  const std::vector<EventLoop*>* loops = schedule_->AllLoops();
+  std::shared_ptr<Gather> gather(new Gather());
+  gather->remaining = loops->size();
+  EventLoop* home = eventloop_;
+  const void* owner = this;
+  for (size_t i = 0; i < loops->size(); ++i) {
+    EventLoop* loop = (*loops)[i];
+    loop->RunInLoop([=]() {
+      std::shared_ptr<std::vector<ConnectionStatsEntry> > top(
+          new std::vector<ConnectionStatsEntry>());
+      voyager::TopConnections(loop, n, key, top.get(), owner);
+      home->RunInLoop([=]() {
+        gather->entries.insert(gather->entries.end(), top->begin(),
+                               top->end());
+        if (--gather->remaining == 0) {
+          SortConnections(n, key, &gather->entries);
+          cb(gather->entries);
+        }
+      });
+    });
+  }
+}
+
+int TcpServer::ListenFd() const { return acceptor_->ListenFd(); }
+
 const std::vector<EventLoop*>* TcpServer::AllLoops() const {
   return schedule_->AllLoops();
 }
@@ -56,15 +173,56 @@ void TcpServer::NewConnection(int fd, const struct sockaddr_storage& sa) {
                     << "] - new connection [" << conn_name << "] from "
                     << peer.Ipbuf();
 
-  EventLoop* ev = schedule_->AssignLoop();
-  TcpConnectionPtr ptr(new TcpConnection(conn_name, ev, fd, addr_, peer));
-
-  ptr->SetConnectionCallback(connection_cb_);
-  ptr->SetCloseCallback(close_cb_);
-  ptr->SetWriteCompleteCallback(writecomplete_cb_);
-  ptr->SetMessageCallback(message_cb_);
+  int cpu = -1;
+  if (steer_by_incoming_cpu_) {
+    BaseSocket socket(fd);
+    socket.SetNoAutoCloseFd();
+    cpu = socket.IncomingCpu();
+  }
+  EventLoop* ev = schedule_->AssignLoop(cpu);
 
-  ev->RunInLoop([ptr]() { ptr->StartWorking(); });
+  // Counted here, so Drain() also waits for the connections still on
+  // their way to their loop.
+  ++*live_;
+  std::shared_ptr<std::atomic<int> > live(live_);
+  // Closed, and no longer counted, if the loop exits before the connection
+  // is built.
+  std::shared_ptr<int> handoff(new int(fd), [live](int* p) {
+    if (*p >= 0) {
+      ::close(*p);
+      --*live;
+    }
+    delete p;
+  });
+  // Build the connection in its own loop, so its buffers come from the
+  // allocator arena and NUMA node of that thread. Everything it needs is
+  // copied here, the server may be gone by the time it runs.
+  std::string name(conn_name);
+  ConnectionCallback connection_cb(connection_cb_);
+  CloseCallback close_cb(close_cb_);
+  WriteCompleteCallback writecomplete_cb(writecomplete_cb_);
+  MessageCallback message_cb(message_cb_);
+  SockAddr local(addr_);
+  int busy_poll = socket_busy_poll_micros_;
+  const void* owner = this;
+  ev->RunInLoop([=]() {
+    TcpConnectionPtr ptr(new TcpConnection(name, ev, *handoff, local, peer));
+    *handoff = -1;
+    ptr->SetOwner(owner);
+    ptr->SetConnectionCallback(connection_cb);
+    ptr->SetCloseCallback([live, close_cb](const TcpConnectionPtr& p) {
+      --*live;
+      if (close_cb) {
+        close_cb(p);
+      }
+    });
+    ptr->SetWriteCompleteCallback(writecomplete_cb);
+    ptr->SetMessageCallback(message_cb);
+    if (busy_poll != 0) {
+      ptr->SetBusyPoll(busy_poll);
+    }
+    ptr->StartWorking();
+  });
 }
 
 }  // namespace voyager
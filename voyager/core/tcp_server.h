@@ -8,6 +8,7 @@
 #include <netdb.h>
 
 #include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -15,6 +16,7 @@
 #include <vector>
 
 #include "voyager/core/callback.h"
+#include "voyager/core/connection_stats.h"
 #include "voyager/core/eventloop.h"
 #include "voyager/core/sockaddr.h"
 
@@ -29,9 +31,15 @@ class TcpServer {
             const std::string& name = std::string("VoyagerServer"),
             int thread_size = 0, int backlog = SOMAXCONN,
             bool reuseport = false);
+  // Adopts a listening socket, such as the one handed over by the process
+  // which this one replaces, see handoff::FetchFd().
+  TcpServer(EventLoop* ev, int listenfd,
+            const std::string& name = std::string("VoyagerServer"),
+            int thread_size = 0);
   ~TcpServer();
 
   const std::string& name() const { return name_; }
+  EventLoop* OwnerEventLoop() const { return eventloop_; }
 
   void SetConnectionCallback(const ConnectionCallback& cb) {
     connection_cb_ = cb;
@@ -51,13 +59,63 @@ class TcpServer {
   }
   void SetMessageCallback(MessageCallback&& cb) { message_cb_ = std::move(cb); }
 
+  // Busy-poll mode for latency critical servers: every loop of the server
+  // spins for up to loop_micros before blocking, see EventLoop::SetBusyPoll(),
+  // and accepted sockets get SO_BUSY_POLL of socket_micros unless it is 0.
+  // Call it before Start().
+  void SetBusyPoll(uint64_t loop_micros, int socket_micros = 0) {
+    busy_poll_micros_ = loop_micros;
+    socket_busy_poll_micros_ = socket_micros;
+  }
+
+  // Pins the i-th IO loop to cpus[i % cpus.size()], see
+  // Schedule::SetCpuAffinity(). With steer_by_incoming_cpu, a new connection
+  // goes to the loop pinned to the cpu which handled its packets, as
+  // reported by SO_INCOMING_CPU, so it stays in the cache of the NIC queue.
+  // The loops which share a cpu take its connections in turn.
+  // The connection counts of the loops are then ignored, only a connection
+  // from a cpu without a loop goes to the least loaded one, so the balance
+  // is up to how the NIC spreads its flows. Call it before Start().
+  void SetCpuAffinity(const std::vector<int>& cpus,
+                      bool steer_by_incoming_cpu = false);
+
   void Start();
 
-  // All loops for schedule tcp connections.
+  // Stops accepting and lets the connections finish. Every connection which
+  // has been idle for kDrainIdleMicros is half closed, so a keep-alive peer
+  // sees EOF between requests, and the ones still open after micros_timeout
+  // are closed by force. cb runs in the loop of the server once all the
+  // connections of the server are gone. The listening socket stays open
+  // until the server is destroyed, so a successor process which shares it
+  // keeps accepting. The server must outlive the drain.
+  void Drain(uint64_t micros_timeout, const std::function<void()>& cb);
+
+  // Stops or resumes accepting, new connections wait in the backlog of the
+  // kernel meanwhile. Safe to call in any thread.
+  void PauseAccept(bool pause);
+
+  int ListenFd() const;
+  // The live connections of this server, safe in any thread.
+  int ConnectionSize() const { return *live_; }
+
+  // Collects the n connections of the server with the largest key from all
+  // its loops, see TcpConnection::Stats(). cb runs in the loop of the
+  // server, and the server must outlive it.
+  typedef std::function<void(const std::vector<ConnectionStatsEntry>&)>
+      TopConnectionsCallback;
+  void TopConnections(size_t n, ConnectionStatsKey key,
+                      const TopConnectionsCallback& cb);
+
+  // All loops for schedule tcp connections, which is also the way to reach
+  // the per-loop statistics, see EventLoop::EnableStats().
   const std::vector<EventLoop*>* AllLoops() const;
 
  private:
   void NewConnection(int fd, const struct sockaddr_storage& sa);
+  void DrainTick(uint64_t deadline, const std::function<void()>& cb);
+
+  static const uint64_t kDrainIdleMicros = 100 * 1000;
+  static const uint64_t kDrainTickMicros = 10 * 1000;
 
   static std::atomic<int> conn_id_;
 
@@ -65,6 +123,10 @@ class TcpServer {
   SockAddr addr_;
   std::string name_;
   std::atomic<bool> started_;
+  uint64_t busy_poll_micros_;
+  int socket_busy_poll_micros_;
+  bool steer_by_incoming_cpu_;
+  std::shared_ptr<std::atomic<int> > live_;
 
   ConnectionCallback connection_cb_;
   CloseCallback close_cb_;
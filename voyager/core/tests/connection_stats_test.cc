@@ -0,0 +1,98 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "voyager/core/buffer.h"
+#include "voyager/core/connection_stats.h"
+#include "voyager/core/eventloop.h"
+#include "voyager/core/eventloop_stats.h"
+#include "voyager/core/sockaddr.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/core/tcp_server.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class ConnectionStatsTest {};
+
+// Sends size bytes and waits for the echo.
+static void Echo(int fd, size_t size) {
+  std::string data(size, 'x');
+  ASSERT_EQ(::write(fd, data.data(), data.size()),
+            static_cast<ssize_t>(size));
+  size_t got = 0;
+  char buf[4096];
+  while (got < size) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    got += static_cast<size_t>(n);
+  }
+}
+
+TEST(ConnectionStatsTest, TopConnections) {
+  EventLoop ev;
+  TcpServer server(&ev, SockAddr("127.0.0.1", 0), "stats", 2);
+  server.SetMessageCallback(
+      [](const TcpConnectionPtr& ptr, Buffer* buf) { ptr->SendMessage(buf); });
+  server.Start();
+  const std::vector<EventLoop*>* loops = server.AllLoops();
+  for (size_t i = 0; i < loops->size(); ++i) {
+    (*loops)[i]->EnableStats(true);
+  }
+
+  test::RunServer(&ev, &server, [&](uint16_t port) {
+    int heavy = test::Connect(port);
+    int light = test::Connect(port);
+    Echo(heavy, 100000);
+    Echo(light, 100);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<ConnectionStatsEntry> top;
+    bool done = false;
+    server.TopConnections(
+        2, kSortByBytesIn,
+        [&](const std::vector<ConnectionStatsEntry>& entries) {
+          std::lock_guard<std::mutex> lock(mutex);
+          top = entries;
+          done = true;
+          cv.notify_one();
+        });
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&done]() { return done; });
+    }
+    fprintf(stdout, "%s", ConnectionStatsReport(top).c_str());
+    ASSERT_EQ(top.size(), 2U);
+    ASSERT_EQ(top[0].stats.bytes_in, 100000U);
+    ASSERT_EQ(top[0].stats.bytes_out, 100000U);
+    ASSERT_GT(top[0].stats.reads, 0U);
+    ASSERT_GT(top[0].stats.writes, 0U);
+    ASSERT_GT(top[0].stats.callback_nanos, 0U);
+    ASSERT_EQ(top[1].stats.bytes_in, 100U);
+
+    uint64_t cpu = 0;
+    for (size_t i = 0; i < loops->size(); ++i) {
+      EventLoopStats stats;
+      (*loops)[i]->GetStats(&stats);
+      cpu += stats.thread_cpu_nanos;
+    }
+    ASSERT_GT(cpu, 0U);
+
+    ::close(heavy);
+    ::close(light);
+  });
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
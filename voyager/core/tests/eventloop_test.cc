@@ -0,0 +1,217 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/eventloop_stats.h"
+#include "voyager/core/stall_detector.h"
+#include "voyager/util/logging.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class EventLoopTest {};
+
+TEST(EventLoopTest, Stats) {
+  EventLoop ev;
+  ev.EnableStats(true);
+  int count = 0;
+  ev.RunEvery(1000, [&count]() { ++count; });
+  ev.RunAfter(20000, [&ev]() { ev.Exit(); });
+  std::thread th([&ev]() {
+    for (int i = 0; i < 10; ++i) {
+      ev.QueueInLoop([]() {});
+    }
+  });
+  ev.Loop();
+  th.join();
+
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_GT(stats.iterations, 0U);
+  ASSERT_GE(stats.timer_lateness_micros.count, static_cast<uint64_t>(count));
+  ASSERT_GT(stats.event_nanos.count, 0U);
+  ASSERT_GE(stats.funcs_depth.sum, 10U);
+  ASSERT_GT(stats.blocked_nanos, 0U);
+  ASSERT_GT(stats.busy_nanos, 0U);
+  ASSERT_GT(stats.Utilization(), 0.0);
+  ASSERT_LT(stats.Utilization(), 1.0);
+  // Most of the 20ms are spent waiting for the timers.
+  ASSERT_GT(stats.blocked_nanos, stats.busy_nanos);
+  ASSERT_LE(stats.funcs_depth.max, 10U);
+  ASSERT_EQ(stats.busy_polls, 0U);
+  std::string s(stats.ToString());
+  ASSERT_EQ(s.find("iterations="), 0U);
+  ASSERT_NE(s.find("timer_lateness_micros: "), std::string::npos);
+}
+
+TEST(EventLoopTest, StatsDisabled) {
+  EventLoop ev;
+  ev.RunAfter(1000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_EQ(stats.iterations, 0U);
+  ASSERT_EQ(stats.event_nanos.count, 0U);
+}
+
+TEST(EventLoopTest, BusyPoll) {
+  EventLoop ev;
+  ev.EnableStats(true);
+  ev.SetBusyPoll(2000);
+  int count = 0;
+  std::thread th([&ev, &count]() {
+    for (int i = 0; i < 200; ++i) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      ev.QueueInLoop([&count]() { ++count; });
+    }
+    ev.QueueInLoop([&ev]() { ev.Exit(); });
+  });
+  ev.Loop();
+  th.join();
+
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_EQ(count, 200);
+  ASSERT_GT(stats.busy_polls, 0U);
+  ASSERT_GT(stats.busy_poll_hits, 0U);
+  ASSERT_LE(stats.busy_poll_hits, stats.busy_polls);
+  ASSERT_GT(stats.BusyPollHitRate(), 0.0);
+  ASSERT_LE(stats.BusyPollHitRate(), 1.0);
+  ASSERT_GT(stats.busy_poll_nanos, 0U);
+  // A spin ends once the 2ms budget is used up.
+  ASSERT_LE(stats.busy_poll_nanos, stats.busy_polls * 3000000);
+  ASSERT_NE(stats.ToString().find("busy_polls="), std::string::npos);
+}
+
+TEST(EventLoopTest, BusyPollDeferred) {
+  EventLoop ev;
+  ev.EnableStats(true);
+  ev.SetBusyPoll(20000);
+  ev.SetFuncsBudget(100);
+  int count = 0;
+  for (int i = 0; i < 1000; ++i) {
+    ev.QueueInLoop([&count]() {
+      ++count;
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    });
+  }
+  ev.QueueInLoop([&ev]() { ev.Exit(); }, kLowPriority);
+  ev.Loop();
+
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_EQ(count, 1000);
+  ASSERT_GT(stats.funcs_deferred, 0U);
+  // The iterations which run deferred functors do not spin first.
+  ASSERT_LT(stats.busy_polls, 3U);
+}
+
+TEST(EventLoopTest, FuncPriority) {
+  EventLoop ev;
+  ev.EnableStats(true);
+  std::string order;
+  int expired = 0;
+  ev.QueueInLoop([&order]() { order += 'l'; }, kLowPriority);
+  ev.QueueInLoop([&order]() { order += 'n'; });
+  ev.QueueInLoop([&order]() { order += 'h'; }, kHighPriority);
+  ev.QueueInLoop([&order]() { order += 'x'; }, kNormalPriority, 1,
+                 [&expired]() { ++expired; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  ev.RunAfter(1000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(order, "hnl");
+  ASSERT_EQ(expired, 1);
+
+  // With a budget, a flood of functors is spread over iterations.
+  ev.ResetStats();
+  ev.SetFuncsBudget(100);
+  int count = 0;
+  bool in_order = true;
+  for (int i = 0; i < 1000; ++i) {
+    ev.QueueInLoop([&count, &in_order, i]() {
+      in_order = in_order && count == i;
+      ++count;
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    });
+  }
+  ev.QueueInLoop([&ev]() { ev.Exit(); }, kLowPriority);
+  ev.Loop();
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_EQ(count, 1000);
+  ASSERT_TRUE(in_order);
+  // Each functor is deferred once at most.
+  ASSERT_GT(stats.funcs_deferred, 0U);
+  ASSERT_LE(stats.funcs_deferred, 1000U);
+  ASSERT_EQ(ev.FuncsBacklog(), 0U);
+  ASSERT_GT(stats.iterations, 2U);
+  ASSERT_EQ(stats.funcs_expired, 0U);
+}
+
+static std::mutex stall_mutex;
+static std::vector<std::string> stall_logs;
+
+static void StallLogHandler(LogLevel level, const char* /* filename */,
+                            int /* line */,
+                            const std::string& message) {
+  if (level == LOGLEVEL_WARN) {
+    std::lock_guard<std::mutex> lock(stall_mutex);
+    stall_logs.push_back(message);
+  }
+}
+
+TEST(EventLoopTest, Lag) {
+  EventLoop ev;
+  ev.EnableLag(true);
+  ev.QueueInLoop(
+      []() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+  for (int i = 0; i < 3; ++i) {
+    ev.QueueInLoop([]() {}, kLowPriority);
+  }
+  ASSERT_EQ(ev.FuncsBacklog(), 4U);
+  ev.RunAfter(30000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(ev.FuncsBacklog(), 0U);
+  ASSERT_GE(ev.TakeLagMicros(), 20000U);
+  ASSERT_EQ(ev.TakeLagMicros(), 0U);
+}
+
+TEST(EventLoopTest, StallDetector) {
+  EventLoop ev;
+  StallDetector detector(5000, true);
+  detector.Watch(&ev);
+  detector.Start();
+  LogHandler* old = SetLogHandler(StallLogHandler);
+  ev.QueueInLoop(
+      []() { std::this_thread::sleep_for(std::chrono::milliseconds(30)); });
+  ev.RunAfter(1000, []() {});
+  ev.RunAfter(60000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  detector.Stop();
+  SetLogHandler(old);
+
+  bool running = false;
+  bool finished = false;
+  for (size_t i = 0; i < stall_logs.size(); ++i) {
+    if (stall_logs[i].find("is blocked in EventLoop::QueueInLoop") !=
+        std::string::npos) {
+      running = true;
+    }
+    if (stall_logs[i].find("us in EventLoop::QueueInLoop") !=
+        std::string::npos) {
+      finished = true;
+    }
+  }
+  ASSERT_TRUE(running);
+  ASSERT_TRUE(finished);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
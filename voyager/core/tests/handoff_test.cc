@@ -0,0 +1,130 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/handoff.h"
+#include "voyager/core/sockaddr.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/core/tcp_server.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/util/stringprintf.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+static char** test_argv;
+
+static std::string ReadLine(int fd) {
+  std::string s;
+  char c;
+  while (::read(fd, &c, 1) == 1) {
+    s += c;
+    if (c == '\n') {
+      break;
+    }
+  }
+  return s;
+}
+
+// Connects to the server, which greets with its name.
+static std::string Greeting(uint16_t port) {
+  int fd = test::Connect(port);
+  if (fd == -1) {
+    return "refused";
+  }
+  std::string s = ReadLine(fd);
+  ::close(fd);
+  return s;
+}
+
+// The new process: takes over the listening socket and greets one client.
+static int RunChild(const std::string& path) {
+  int fd = handoff::FetchFd(path);
+  if (fd == -1) {
+    return 1;
+  }
+  EventLoop ev;
+  TcpServer server(&ev, fd, "child");
+  server.SetConnectionCallback([&ev](const TcpConnectionPtr& ptr) {
+    ptr->SendMessage(std::string("child\n"));
+    ev.RunAfter(100000, [&ev]() { ev.Exit(); });
+  });
+  server.Start();
+  ev.Loop();
+  return 0;
+}
+
+class HandoffTest {};
+
+TEST(HandoffTest, DrainAndHandoff) {
+  std::string path = StringPrintf("/tmp/voyager_handoff_%d", getpid());
+
+  EventLoop ev;
+  TcpServer server(&ev, SockAddr("127.0.0.1", 0), "parent");
+  server.SetConnectionCallback([](const TcpConnectionPtr& ptr) {
+    ptr->SendMessage(std::string("parent\n"));
+  });
+  server.Start();
+
+  test::RunServer(&ev, &server, [&](uint16_t port) {
+    ASSERT_EQ(Greeting(port), "parent\n");
+
+    // A keep-alive connection which stays idle.
+    int idle = test::Connect(port);
+    ASSERT_EQ(ReadLine(idle), "parent\n");
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      execl("/proc/self/exe", test_argv[0], "child", path.c_str(),
+            static_cast<char*>(nullptr));
+      _exit(127);
+    }
+    ASSERT_TRUE(handoff::ServeFd(path, server.ListenFd(), 5000000));
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool drained = false;
+    server.Drain(5000000, [&]() {
+      std::lock_guard<std::mutex> lock(mutex);
+      drained = true;
+      cv.notify_one();
+    });
+
+    // The idle connection is half closed by the drain.
+    char c;
+    ASSERT_EQ(::read(idle, &c, 1), 0);
+    ::close(idle);
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&drained]() { return drained; });
+    }
+    ASSERT_EQ(server.ConnectionSize(), 0);
+
+    // The parent still holds the socket but no longer accepts, the child
+    // does.
+    ASSERT_EQ(Greeting(port), "child\n");
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  });
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  if (argc == 3 && strcmp(argv[1], "child") == 0) {
+    return voyager::RunChild(argv[2]);
+  }
+  voyager::test_argv = argv;
+  return voyager::test::RunAllTests();
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "voyager/core/bg_eventloop.h"
+#include "voyager/core/eventloop.h"
+#include "voyager/core/loop_channel.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+struct Message {
+  uint64_t seq;
+};
+
+class Done {
+ public:
+  Done() : done_(false) {}
+
+  void Notify() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    cv_.notify_one();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return done_; });
+    done_ = false;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool done_;
+};
+
+static void Report(const char* name, uint64_t count, uint64_t nanos) {
+  fprintf(stdout, "%-28s %10.1f ns/msg %10.0f msgs/s\n", name,
+          static_cast<double>(nanos) / static_cast<double>(count),
+          static_cast<double>(count) * 1e9 / static_cast<double>(nanos));
+}
+
+// Loop 0 sends count messages to loop 1 as fast as the ring allows.
+static void ChannelThroughput(const std::vector<EventLoop*>& loops,
+                              uint64_t count) {
+  Done done;
+  uint64_t received = 0;
+  LoopChannels<Message> channels(
+      loops, 4096, [&done, &received, count](size_t, Message&&) {
+        if (++received == count) {
+          done.Notify();
+        }
+      });
+  channels.Start();
+
+  uint64_t sent = 0;
+  std::function<void()> send;
+  send = [&]() {
+    Message m;
+    while (sent < count) {
+      m.seq = sent;
+      if (!channels.Send(0, 1, std::move(m))) {
+        loops[0]->QueueInLoop(send);
+        return;
+      }
+      ++sent;
+    }
+  };
+  uint64_t start = timeops::MonotonicNanos();
+  loops[0]->QueueInLoop(send);
+  done.Wait();
+  Report("LoopChannels throughput", count, timeops::MonotonicNanos() - start);
+  channels.Stop();
+}
+
+static void QueueInLoopThroughput(const std::vector<EventLoop*>& loops,
+                                  uint64_t count) {
+  Done done;
+  uint64_t received = 0;
+  uint64_t start = timeops::MonotonicNanos();
+  loops[0]->QueueInLoop([&]() {
+    for (uint64_t i = 0; i < count; ++i) {
+      Message m;
+      m.seq = i;
+      loops[1]->QueueInLoop([m, &done, &received, count]() {
+        if (++received == count) {
+          done.Notify();
+        }
+      });
+    }
+  });
+  done.Wait();
+  Report("QueueInLoop throughput", count, timeops::MonotonicNanos() - start);
+}
+
+// A message bounces between loop 0 and loop 1 count times.
+static void ChannelPingPong(const std::vector<EventLoop*>& loops,
+                            uint64_t count) {
+  Done done;
+  LoopChannels<Message>* p = nullptr;
+  LoopChannels<Message> channels(
+      loops, 64, [&done, &p, count](size_t from, Message&& m) {
+        if (++m.seq == count) {
+          done.Notify();
+          return;
+        }
+        // Back to the sender, from the other loop of the two.
+        p->Send(1 - from, from, std::move(m));
+      });
+  p = &channels;
+  channels.Start();
+
+  uint64_t start = timeops::MonotonicNanos();
+  loops[0]->QueueInLoop([&channels]() {
+    Message m;
+    m.seq = 0;
+    channels.Send(0, 1, std::move(m));
+  });
+  done.Wait();
+  Report("LoopChannels round trip", count / 2,
+         timeops::MonotonicNanos() - start);
+  channels.Stop();
+}
+
+static void QueueInLoopPingPong(const std::vector<EventLoop*>& loops,
+                                uint64_t count) {
+  Done done;
+  std::function<void(size_t, Message)> bounce;
+  bounce = [&](size_t to, Message m) {
+    if (++m.seq == count) {
+      done.Notify();
+      return;
+    }
+    loops[1 - to]->QueueInLoop([&bounce, to, m]() { bounce(1 - to, m); });
+  };
+  uint64_t start = timeops::MonotonicNanos();
+  loops[1]->QueueInLoop([&bounce]() {
+    Message m;
+    m.seq = 0;
+    bounce(1, m);
+  });
+  done.Wait();
+  Report("QueueInLoop round trip", count / 2,
+         timeops::MonotonicNanos() - start);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  uint64_t count = 1000000;
+  if (argc > 1) {
+    count = static_cast<uint64_t>(atoll(argv[1]));
+  }
+  voyager::BGEventLoop bg0(voyager::kEpoll, argc > 2 ? atoi(argv[2]) : -1);
+  voyager::BGEventLoop bg1(voyager::kEpoll, argc > 3 ? atoi(argv[3]) : -1);
+  std::vector<voyager::EventLoop*> loops;
+  loops.push_back(bg0.Loop());
+  loops.push_back(bg1.Loop());
+
+  voyager::ChannelThroughput(loops, count);
+  voyager::QueueInLoopThroughput(loops, count);
+  voyager::ChannelPingPong(loops, count / 10);
+  voyager::QueueInLoopPingPong(loops, count / 10);
+  return 0;
+}
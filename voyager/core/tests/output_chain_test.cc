@@ -0,0 +1,138 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "voyager/core/output_chain.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class OutputChainTest {};
+
+static std::string ToString(const OutputChain& chain) {
+  struct iovec iov[OutputChain::kMaxIovecs];
+  int n = chain.Peek(iov, OutputChain::kMaxIovecs);
+  std::string s;
+  for (int i = 0; i < n; ++i) {
+    s.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+  return s;
+}
+
+TEST(OutputChainTest, Segments) {
+  OutputChain chain;
+  std::shared_ptr<const std::string> body(new std::string(10000, 'b'));
+  chain.Append("head ");
+  chain.Append(std::string("small"));
+  chain.Append(body);
+  chain.Append("tail");
+  ASSERT_EQ(chain.size(), 10014U);
+
+  struct iovec iov[4];
+  ASSERT_EQ(chain.Peek(iov, 4), 3);
+  // The body is referenced, not copied.
+  ASSERT_EQ(iov[1].iov_base, static_cast<const void*>(body->data()));
+  ASSERT_EQ(ToString(chain), "head small" + *body + "tail");
+
+  chain.Retrieve(7);
+  chain.Retrieve(5000);
+  ASSERT_EQ(ToString(chain), std::string(5003, 'b') + "tail");
+  chain.Retrieve(5003);
+  ASSERT_EQ(ToString(chain), "tail");
+  chain.Retrieve(4);
+  ASSERT_TRUE(chain.empty());
+  chain.Append("again");
+  ASSERT_EQ(ToString(chain), "again");
+}
+
+TEST(OutputChainTest, Splice) {
+  OutputChain a;
+  OutputChain b;
+  a.Append("a");
+  b.Append(std::string(5000, 'x'));
+  b.Append("y");
+  a.Append(&b);
+  ASSERT_TRUE(b.empty());
+  ASSERT_EQ(a.size(), 5002U);
+  ASSERT_EQ(ToString(a), "a" + std::string(5000, 'x') + "y");
+}
+
+TEST(OutputChainTest, WriteV) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  OutputChain chain;
+  std::shared_ptr<const std::string> body(new std::string(3000, 'z'));
+  chain.Append("x");
+  chain.Append(body);
+  chain.Append("y");
+  ASSERT_EQ(chain.WriteV(fds[0]), 3002);
+  ASSERT_TRUE(chain.empty());
+  std::string s;
+  char buf[4096];
+  while (s.size() < 3002) {
+    ssize_t n = ::read(fds[1], buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    s.append(buf, static_cast<size_t>(n));
+  }
+  ASSERT_EQ(s, "x" + *body + "y");
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+TEST(OutputChainTest, File) {
+  char path[] = "/tmp/output_chain_testXXXXXX";
+  int file = mkstemp(path);
+  ASSERT_GE(file, 0);
+  unlink(path);
+  std::string content;
+  for (int i = 0; content.size() < 100000; ++i) {
+    content += std::to_string(i);
+  }
+  ASSERT_EQ(::write(file, content.data(), content.size()),
+            static_cast<ssize_t>(content.size()));
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  OutputChain chain;
+  chain.Append("head:");
+  chain.AppendFile(file, 10, 50000, std::shared_ptr<const void>());
+  chain.Append(":tail");
+  struct iovec iov[4];
+  // Only what is in memory ahead of the file.
+  ASSERT_EQ(chain.Peek(iov, 4), 1);
+  ASSERT_EQ(chain.size(), 50010U);
+
+  std::string s;
+  char buf[65536];
+  while (s.size() < 50010) {
+    ASSERT_GT(chain.WriteV(fds[0]), 0);
+    ssize_t n = ::read(fds[1], buf, sizeof(buf));
+    ASSERT_GT(n, 0);
+    s.append(buf, static_cast<size_t>(n));
+  }
+  ASSERT_TRUE(chain.empty());
+  ASSERT_TRUE(s == "head:" + content.substr(10, 50000) + ":tail");
+
+  // A file cut short fails the write rather than hanging.
+  chain.AppendFile(file, static_cast<off_t>(content.size()) - 1, 10,
+                   std::shared_ptr<const void>());
+  ASSERT_EQ(chain.WriteV(fds[0]), 1);
+  ASSERT_EQ(chain.WriteV(fds[0]), -1);
+  ASSERT_TRUE(chain.empty());
+  ::close(file);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,78 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "voyager/core/buffer.h"
+#include "voyager/core/eventloop.h"
+#include "voyager/core/overload_controller.h"
+#include "voyager/core/sockaddr.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/core/tcp_server.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class OverloadControllerTest {};
+
+// A client floods a server whose every message takes 5ms: the loop falls
+// behind, the flooding connection stops being read, and the loop recovers
+// although the client keeps sending.
+TEST(OverloadControllerTest, ShedNoisyConnection) {
+  EventLoop ev;
+  TcpServer server(&ev, SockAddr("127.0.0.1", 0), "overload", 1);
+  server.SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf) {
+    buf->RetrieveAll();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  });
+  server.Start();
+
+  OverloadOptions options;
+  options.max_lag_micros = 2000;
+  options.recover_lag_micros = 1000;
+  OverloadController controller(&server, options);
+  controller.Start();
+
+  test::RunServer(&ev, &server, [&](uint16_t port) {
+    std::atomic<bool> stop(false);
+    std::thread flood([port, &stop]() {
+      int fd = test::Connect(port);
+      char data[1024];
+      memset(data, 'x', sizeof(data));
+      while (!stop) {
+        if (::send(fd, data, sizeof(data), MSG_DONTWAIT) <= 0) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      ::close(fd);
+    });
+
+    bool overloaded = false;
+    bool recovered = false;
+    for (int i = 0; i < 5000 && !recovered; ++i) {
+      if (controller.Overloaded()) {
+        overloaded = true;
+      } else if (overloaded) {
+        recovered = true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop = true;
+    flood.join();
+    ASSERT_TRUE(overloaded);
+    ASSERT_TRUE(recovered);
+    ev.QueueInLoop([&controller]() { controller.Stop(); });
+  });
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,33 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <set>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/schedule.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class ScheduleTest {};
+
+TEST(ScheduleTest, SharedCpu) {
+  EventLoop ev;
+  Schedule schedule(&ev, 4);
+  schedule.SetCpuAffinity(std::vector<int>(1, 0));
+  schedule.Start();
+  // All four loops are pinned to cpu 0 and take its connections in turn.
+  std::set<EventLoop*> loops;
+  for (int i = 0; i < 8; ++i) {
+    loops.insert(schedule.AssignLoop(0));
+  }
+  ASSERT_EQ(loops.size(), 4U);
+  // A cpu without a loop goes to the least loaded one.
+  ASSERT_TRUE(schedule.AssignLoop(1) != nullptr);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_TESTS_TEST_SERVER_H_
+#define VOYAGER_CORE_TESTS_TEST_SERVER_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <functional>
+#include <thread>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/sockaddr.h"
+
+// Helpers for the tests which talk to a server over the loopback. The
+// servers listen on port 0, so tests running at the same time never
+// collide, and the clients ask the socket for the port it got.
+
+namespace voyager {
+namespace test {
+
+// The port listenfd is bound to.
+inline uint16_t ListenPort(int listenfd) {
+  return SockAddr(SockAddr::LocalSockAddr(listenfd)).Port();
+}
+
+// A blocking connection whose reads give up after 5 seconds, so a broken
+// server fails the test instead of hanging it. -1 if it is refused.
+inline int Connect(uint16_t port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  struct timeval tv = {5, 0};
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                sizeof(addr)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Runs f with the port of server, a started TcpServer or HttpServer of ev,
+// in a client thread while ev loops. Exits ev once f returns.
+template <typename Server>
+void RunServer(EventLoop* ev, Server* server,
+               const std::function<void(uint16_t)>& f) {
+  uint16_t port = ListenPort(server->ListenFd());
+  std::thread client([ev, port, &f]() {
+    f(port);
+    ev->QueueInLoop([ev]() { ev->Exit(); });
+  });
+  ev->Loop();
+  client.join();
+}
+
+}  // namespace test
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_TESTS_TEST_SERVER_H_
@@ -0,0 +1,81 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/eventloop_stats.h"
+#include "voyager/core/thread_pool.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class ThreadPoolTest {};
+
+TEST(ThreadPoolTest, Execute) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(4);
+    pool.Start();
+    for (int i = 0; i < 10000; ++i) {
+      pool.Execute([&count]() { ++count; });
+    }
+  }
+  ASSERT_EQ(count.load(), 10000);
+}
+
+TEST(ThreadPoolTest, Nested) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(4);
+    pool.Start();
+    for (int i = 0; i < 10; ++i) {
+      pool.Execute([&pool, &count]() {
+        // Nested tasks go to the deque of this worker, the idle workers
+        // steal them.
+        for (int j = 0; j < 1000; ++j) {
+          pool.Execute([&count]() { ++count; });
+        }
+      });
+    }
+  }
+  ASSERT_EQ(count.load(), 10000);
+}
+
+TEST(ThreadPoolTest, Then) {
+  EventLoop ev;
+  ev.EnableStats(true);
+  ThreadPool pool(2);
+  pool.Start();
+
+  const int kTasks = 1000;
+  int done = 0;
+  int sum = 0;
+  for (int i = 0; i < kTasks; ++i) {
+    pool.Submit([i]() { return i; }).Then(&ev, [&](int v) {
+      ev.AssertInMyLoop();
+      sum += v;
+      if (++done == kTasks + 1) {
+        ev.Exit();
+      }
+    });
+  }
+  pool.Submit([]() {}).Then(&ev, [&]() {
+    if (++done == kTasks + 1) {
+      ev.Exit();
+    }
+  });
+  ev.Loop();
+  pool.Stop();
+
+  EventLoopStats stats;
+  ev.GetStats(&stats);
+  ASSERT_EQ(sum, kTasks * (kTasks - 1) / 2);
+  // The completions are batched, far fewer wakeups than tasks.
+  ASSERT_LT(stats.wakeups, static_cast<uint64_t>(kTasks));
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,37 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+// Timeouts are mostly cancelled long before they fire, which is the case
+// the timer list is built for.
+static void CancelBeforeFire(int timers) {
+  EventLoop ev;
+  int fired = 0;
+  uint64_t start = timeops::MonotonicNanos();
+  for (int i = 0; i < timers; ++i) {
+    TimerId t = ev.RunAfter(15 * 1000 * 1000, [&fired]() { ++fired; });
+    ev.RemoveTimer(t);
+  }
+  uint64_t end = timeops::MonotonicNanos();
+  fprintf(stdout, "RunAfter + RemoveTimer: %.1f ns/timer (%d fired)\n",
+          static_cast<double>(end - start) / timers, fired);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  int timers = 1000000;
+  if (argc > 1) {
+    timers = atoi(argv[1]);
+  }
+  voyager::CancelBeforeFire(timers);
+  return 0;
+}
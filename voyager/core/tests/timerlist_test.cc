@@ -0,0 +1,115 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/util/testharness.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+class TimerListTest {};
+
+TEST(TimerListTest, Cancel) {
+  EventLoop ev;
+  int fired = 0;
+  TimerId t1 = ev.RunAfter(1000, [&fired]() { fired += 1; });
+  TimerId t2 = ev.RunAfter(1000, [&fired]() { fired += 10; });
+  ev.RemoveTimer(t1);
+  ev.RunAfter(5000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(fired, 10);
+  // Removing a fired or removed timer again is harmless.
+  ev.RemoveTimer(t1);
+  ev.RemoveTimer(t2);
+  ev.RemoveTimer(TimerId());
+}
+
+TEST(TimerListTest, StaleHandle) {
+  EventLoop ev;
+  int fired = 0;
+  TimerId t1 = ev.RunAfter(1000, [&fired]() { fired += 1; });
+  ev.RemoveTimer(t1);
+  // t2 reuses the slot of t1 with a new generation.
+  TimerId t2 = ev.RunAfter(1000, [&fired]() { fired += 10; });
+  ASSERT_EQ(t1.index, t2.index);
+  ASSERT_NE(t1.generation, t2.generation);
+  ev.RemoveTimer(t1);
+  ev.RunAfter(5000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(fired, 10);
+}
+
+TEST(TimerListTest, RemoveInOtherThread) {
+  EventLoop ev;
+  int fired = 0;
+  TimerId t1 = ev.RunAfter(20000, [&fired]() { fired += 1; });
+  TimerId t2;
+  std::thread th([&ev, &t1, &t2, &fired]() {
+    t2 = ev.RunAfter(20000, [&fired]() { fired += 10; });
+    ev.RemoveTimer(t1);
+    ev.RemoveTimer(t2);
+    ev.RunAfter(40000, [&ev]() { ev.Exit(); });
+  });
+  th.join();
+  ev.Loop();
+  ASSERT_EQ(fired, 0);
+}
+
+TEST(TimerListTest, RemoveEveryInCallback) {
+  EventLoop ev;
+  int fired = 0;
+  TimerId t;
+  t = ev.RunEvery(1000, [&ev, &t, &fired]() {
+    if (++fired == 3) {
+      ev.RemoveTimer(t);
+    }
+  });
+  ev.RunAfter(20000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(fired, 3);
+}
+
+TEST(TimerListTest, NeverEarly) {
+  EventLoop ev;
+  // Set before Loop() and late in a long callback, long after the loop
+  // clock was read.
+  usleep(30000);
+  uint64_t start = timeops::MonotonicMicros();
+  uint64_t first = 0;
+  uint64_t second = 0;
+  uint64_t second_start = 0;
+  ev.RunAfter(20000, [&ev, &first, &second, &second_start]() {
+    first = timeops::MonotonicMicros();
+    usleep(30000);
+    second_start = timeops::MonotonicMicros();
+    ev.RunAfter(20000, [&ev, &second]() {
+      second = timeops::MonotonicMicros();
+      ev.Exit();
+    });
+  });
+  ev.Loop();
+  ASSERT_GE(first - start, 20000U);
+  ASSERT_GE(second - second_start, 20000U);
+}
+
+TEST(TimerListTest, CancelBeforeFire) {
+  EventLoop ev;
+  int fired = 0;
+  for (int i = 0; i < 1000; ++i) {
+    TimerId t = ev.RunAfter(1000, [&fired]() { ++fired; });
+    ev.RemoveTimer(t);
+  }
+  ev.RunAfter(5000, [&ev]() { ev.Exit(); });
+  ev.Loop();
+  ASSERT_EQ(fired, 0);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
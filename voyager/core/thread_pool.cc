@@ -0,0 +1,302 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/core/thread_pool.h"
+
+#include <assert.h>
+
+#include "voyager/util/logging.h"
+
+namespace voyager {
+namespace {
+
+typedef ThreadPool::Task Task;
+
+// The lock-free deque of "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Le et al.). Only the owner pushes and pops at the bottom,
+// any thread steals from the top. Outgrown arrays are kept until the deque
+// is destroyed, since a thief may still read them.
+class WorkStealingDeque {
+ public:
+  WorkStealingDeque() : top_(0), bottom_(0), array_(new Array(256)) {
+    garbage_.push_back(std::unique_ptr<Array>(array_.load()));
+  }
+
+  void Push(Task* task) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      a = Grow(a, b, t);
+    }
+    a->Put(b, task);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  Task* Pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    Task* task = nullptr;
+    if (t <= b) {
+      task = a->Get(b);
+      if (t == b) {
+        // The last one, race against the thieves.
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          task = nullptr;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  Task* Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t < b) {
+      Array* a = array_.load(std::memory_order_acquire);
+      Task* task = a->Get(t);
+      if (top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  struct Array {
+    const int64_t capacity;
+    std::unique_ptr<std::atomic<Task*>[]> buffer;
+
+    explicit Array(int64_t c)
+        : capacity(c), buffer(new std::atomic<Task*>[static_cast<size_t>(c)]) {}
+
+    Task* Get(int64_t i) const {
+      return buffer[static_cast<size_t>(i & (capacity - 1))].load(
+          std::memory_order_relaxed);
+    }
+    void Put(int64_t i, Task* task) {
+      buffer[static_cast<size_t>(i & (capacity - 1))].store(
+          task, std::memory_order_relaxed);
+    }
+  };
+
+  Array* Grow(Array* a, int64_t b, int64_t t) {
+    Array* bigger = new Array(a->capacity * 2);
+    for (int64_t i = t; i < b; ++i) {
+      bigger->Put(i, a->Get(i));
+    }
+    garbage_.push_back(std::unique_ptr<Array>(bigger));
+    array_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  std::vector<std::unique_ptr<Array> > garbage_;
+};
+
+}  // anonymous namespace
+
+struct ThreadPool::Completions {
+  std::mutex mutex;
+  std::vector<EventLoop::Func> funcs;
+  bool scheduled = false;
+};
+
+struct ThreadPool::Worker {
+  WorkStealingDeque deque;
+  std::unique_ptr<std::thread> thread;
+  size_t index;
+  uint64_t seed;
+  // The completions_ this worker has used, so it looks them up without the
+  // lock of the pool.
+  std::unordered_map<EventLoop*, std::shared_ptr<Completions> > completions;
+};
+
+namespace {
+
+struct CurrentWorker {
+  ThreadPool* pool;
+  void* worker;
+};
+
+__thread CurrentWorker current = {nullptr, nullptr};
+
+}  // anonymous namespace
+
+ThreadPool::ThreadPool(int threads)
+    : size_(threads > 0 ? threads : 1),
+      running_(false),
+      pending_(0),
+      idle_(0) {}
+
+ThreadPool::~ThreadPool() {
+  Stop();
+  for (std::deque<Task*>::iterator it = queue_.begin(); it != queue_.end();
+       ++it) {
+    delete *it;
+  }
+}
+
+void ThreadPool::Start() {
+  assert(!running_);
+  running_ = true;
+  for (int i = 0; i < size_; ++i) {
+    Worker* worker = new Worker();
+    worker->index = static_cast<size_t>(i);
+    worker->seed = static_cast<uint64_t>(i) * 2654435761U + 1;
+    workers_.push_back(std::unique_ptr<Worker>(worker));
+  }
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker* worker = workers_[i].get();
+    worker->thread.reset(new std::thread([this, worker]() { Run(worker); }));
+  }
+}
+
+void ThreadPool::Stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+  }
+  idle_cv_.notify_all();
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i]->thread->join();
+  }
+  workers_.clear();
+}
+
+void ThreadPool::Execute(Task&& task) { Push(new Task(std::move(task))); }
+
+void ThreadPool::Push(Task* task) {
+  if (current.pool == this) {
+    static_cast<Worker*>(current.worker)->deque.Push(task);
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(task);
+  }
+  pending_.fetch_add(1);
+  if (idle_.load() > 0) {
+    {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_cv_.notify_one();
+  }
+}
+
+ThreadPool::Task* ThreadPool::Take(Worker* worker) {
+  Task* task = worker->deque.Pop();
+  if (task == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!queue_.empty()) {
+      task = queue_.front();
+      queue_.pop_front();
+    }
+  }
+  if (task == nullptr && workers_.size() > 1) {
+    // xorshift, to spread the thieves over the victims.
+    uint64_t x = worker->seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    worker->seed = x;
+    size_t n = workers_.size();
+    size_t start = static_cast<size_t>(x % n);
+    for (size_t i = 0; i < n && task == nullptr; ++i) {
+      size_t victim = (start + i) % n;
+      if (victim != worker->index) {
+        task = workers_[victim]->deque.Steal();
+      }
+    }
+  }
+  if (task != nullptr) {
+    pending_.fetch_sub(1);
+  }
+  return task;
+}
+
+void ThreadPool::Run(Worker* worker) {
+  current.pool = this;
+  current.worker = worker;
+  while (true) {
+    Task* task = Take(worker);
+    if (task != nullptr) {
+      (*task)();
+      delete task;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_.fetch_add(1);
+    idle_cv_.wait(lock, [this]() {
+      return pending_.load() > 0 || !running_.load();
+    });
+    idle_.fetch_sub(1);
+    if (!running_.load() && pending_.load() <= 0) {
+      break;
+    }
+  }
+  current.pool = nullptr;
+  current.worker = nullptr;
+}
+
+void ThreadPool::Complete(EventLoop* loop, EventLoop::Func&& func) {
+  // Only the first completion of a worker to a loop takes the lock of the
+  // pool, the workers contend on the batch of their loop only.
+  Worker* worker =
+      current.pool == this ? static_cast<Worker*>(current.worker) : nullptr;
+  std::shared_ptr<Completions> c;
+  if (worker != nullptr) {
+    auto it = worker->completions.find(loop);
+    if (it != worker->completions.end()) {
+      c = it->second;
+    }
+  }
+  if (!c) {
+    std::lock_guard<std::mutex> lock(completions_mutex_);
+    std::shared_ptr<Completions>& p = completions_[loop];
+    if (!p) {
+      p.reset(new Completions());
+    }
+    c = p;
+    if (worker != nullptr) {
+      worker->completions[loop] = c;
+    }
+  }
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(c->mutex);
+    c->funcs.push_back(std::move(func));
+    if (!c->scheduled) {
+      c->scheduled = true;
+      schedule = true;
+    }
+  }
+  if (schedule) {
+    loop->QueueInLoop([c]() {
+      std::vector<EventLoop::Func> funcs;
+      {
+        std::lock_guard<std::mutex> lock(c->mutex);
+        funcs.swap(c->funcs);
+        c->scheduled = false;
+      }
+      for (size_t i = 0; i < funcs.size(); ++i) {
+        funcs[i]();
+      }
+    });
+  }
+}
+
+}  // namespace voyager
@@ -0,0 +1,193 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_CORE_THREAD_POOL_H_
+#define VOYAGER_CORE_THREAD_POOL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+
+namespace voyager {
+
+class ThreadPool;
+
+namespace internal {
+
+template <typename R>
+struct ContinuationOf {
+  typedef std::function<void(R)> type;
+};
+
+template <>
+struct ContinuationOf<void> {
+  typedef std::function<void()> type;
+};
+
+// Runs the task in the pool and hands the result to the continuation in
+// the loop.
+template <typename R>
+struct ThenTask {
+  std::function<R()> task;
+  ThreadPool* pool;
+  EventLoop* loop;
+  std::function<void(R)> cont;
+
+  void operator()();
+};
+
+template <>
+struct ThenTask<void> {
+  std::function<void()> task;
+  ThreadPool* pool;
+  EventLoop* loop;
+  std::function<void()> cont;
+
+  void operator()();
+};
+
+}  // namespace internal
+
+// Returned by ThreadPool::Submit(). Then() attaches a continuation which
+// runs in the given EventLoop with the result of the task; without it the
+// task is simply executed when the Submission goes away.
+template <typename R>
+class Submission {
+ public:
+  typedef typename internal::ContinuationOf<R>::type Continuation;
+
+  Submission(ThreadPool* pool, std::function<R()>&& task)
+      : pool_(pool), task_(std::move(task)) {}
+  Submission(Submission&& other)
+      : pool_(other.pool_), task_(std::move(other.task_)) {
+    other.pool_ = nullptr;
+  }
+  ~Submission();
+
+  void Then(EventLoop* loop, Continuation&& cont);
+
+ private:
+  ThreadPool* pool_;
+  std::function<R()> task_;
+
+  // No copying allowed
+  Submission(const Submission&);
+  void operator=(const Submission&);
+};
+
+// A compute pool for the work which should not run in an IO loop, such as
+// solving a puzzle or a heavy RPC service:
+//
+//   pool.Submit([puzzle]() { return Solve(puzzle); })
+//       .Then(conn->OwnerEventLoop(), [conn](std::string res) {
+//         conn->SendMessage(std::move(res));
+//       });
+//
+// Every worker owns a lock-free Chase-Lev deque: tasks submitted by a worker
+// go to its own deque, the others to a shared queue, and idle workers steal
+// from the top of the other deques. The continuations for one loop are
+// batched, so any number of them costs the loop a single wakeup.
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+
+  explicit ThreadPool(int threads);
+  // Stop()s the pool.
+  ~ThreadPool();
+
+  void Start();
+  // Runs the tasks already submitted, then joins the workers.
+  void Stop();
+
+  void Execute(Task&& task);
+  void Execute(const Task& task) { Execute(Task(task)); }
+
+  template <typename F>
+  Submission<typename std::result_of<F()>::type> Submit(F&& f) {
+    typedef typename std::result_of<F()>::type R;
+    return Submission<R>(this, std::function<R()>(std::forward<F>(f)));
+  }
+
+  // Internal use only, queues func into the completion batch of loop.
+  void Complete(EventLoop* loop, EventLoop::Func&& func);
+
+  int Size() const { return static_cast<int>(workers_.size()); }
+
+ private:
+  struct Worker;
+  struct Completions;
+
+  void Run(Worker* worker);
+  Task* Take(Worker* worker);
+  void Push(Task* task);
+
+  const int size_;
+  std::atomic<bool> running_;
+  std::vector<std::unique_ptr<Worker> > workers_;
+
+  std::mutex mutex_;
+  std::deque<Task*> queue_;
+
+  // Tasks which are queued somewhere but not taken yet, and the workers
+  // waiting for them.
+  std::atomic<int64_t> pending_;
+  std::atomic<int> idle_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+
+  // The completion batch of every loop, each worker caches the ones it used.
+  std::mutex completions_mutex_;
+  std::unordered_map<EventLoop*, std::shared_ptr<Completions> > completions_;
+
+  // No copying allowed
+  ThreadPool(const ThreadPool&);
+  void operator=(const ThreadPool&);
+};
+
+template <typename R>
+void internal::ThenTask<R>::operator()() {
+  std::shared_ptr<R> result(new R(task()));
+  std::function<void(R)> c(std::move(cont));
+  pool->Complete(loop, [result, c]() { c(std::move(*result)); });
+}
+
+inline void internal::ThenTask<void>::operator()() {
+  task();
+  pool->Complete(loop, std::move(cont));
+}
+
+template <typename R>
+Submission<R>::~Submission() {
+  if (pool_ != nullptr) {
+    std::function<R()> task(std::move(task_));
+    pool_->Execute([task]() { task(); });
+  }
+}
+
+template <typename R>
+void Submission<R>::Then(EventLoop* loop, Continuation&& cont) {
+  internal::ThenTask<R> t;
+  t.task = std::move(task_);
+  t.pool = pool_;
+  t.loop = loop;
+  t.cont = std::move(cont);
+  pool_->Execute(std::move(t));
+  pool_ = nullptr;
+}
+
+}  // namespace voyager
+
+#endif  // VOYAGER_CORE_THREAD_POOL_H_
@@ -3,133 +3,334 @@
 // found in the LICENSE file.
 
 #include "voyager/core/timerlist.h"
-#include "voyager/util/logging.h"
-#include "voyager/util/timeops.h"
 
-namespace voyager {
+#ifdef __linux__
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
 
-class Timer {
- private:
-  friend class TimerList;
+#include <algorithm>
+#include <utility>
 
-  Timer(uint64_t value, uint64_t interval, const TimerProcCallback& cb)
-      : micros_value(value), micros_interval(interval), timerproc_cb(cb) {}
+#include "voyager/core/dispatch.h"
+#include "voyager/core/eventloop_stats.h"
+#include "voyager/core/stall_detector.h"
+#include "voyager/util/logging.h"
+#include "voyager/util/macros.h"
+#include "voyager/util/timeops.h"
 
-  Timer(uint64_t value, uint64_t interval, TimerProcCallback&& cb)
-      : micros_value(value),
-        micros_interval(interval),
-        timerproc_cb(std::move(cb)) {}
+namespace voyager {
 
-  ~Timer() {}
+struct TimerList::Slot {
+  Slot() : micros_interval(0), generation(1), cancelled(0), in_heap(false) {}
 
-  uint64_t micros_value;
   uint64_t micros_interval;
+  // Bumped each time the slot is freed, and never 0.
+  uint32_t generation;
+  // The newest generation cancelled by other threads.
+  std::atomic<uint32_t> cancelled;
+  bool in_heap;
   TimerProcCallback timerproc_cb;
 };
 
 TimerList::TimerList(EventLoop* ev)
-    : last_time_out_(timeops::NowMicros()), eventloop_(CHECK_NOTNULL(ev)) {}
+    : eventloop_(CHECK_NOTNULL(ev)),
+#ifdef __linux__
+      timerfd_(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      dispatch_(new Dispatch(ev, timerfd_)),
+      armed_value_(0),
+#endif
+      num_chunks_(0),
+      chunks_(new std::atomic<Slot*>[kMaxChunks]),
+      stale_entries_(0) {
+  for (uint32_t i = 0; i < kMaxChunks; ++i) {
+    chunks_[i].store(nullptr, std::memory_order_relaxed);
+  }
+#ifdef __linux__
+  if (timerfd_ == -1) {
+    VOYAGER_LOG(FATAL) << "timerfd_create: " << strerror(errno);
+  }
+  dispatch_->SetReadCallback(std::bind(&TimerList::HandleRead, this));
+  dispatch_->EnableRead();
+#endif
+}
 
 TimerList::~TimerList() {
-  for (auto& t : timer_ptrs_) {
-    delete t;
+#ifdef __linux__
+  dispatch_->DisableAll();
+  dispatch_->RemoveEvents();
+  ::close(timerfd_);
+#endif
+  for (uint32_t i = 0; i < num_chunks_; ++i) {
+    delete[] chunks_[i].load(std::memory_order_relaxed);
   }
 }
 
 TimerId TimerList::Insert(uint64_t micros_value, uint64_t micros_interval,
                           const TimerProcCallback& cb) {
-  TimerId timer(micros_value, new Timer(micros_value, micros_interval, cb));
-  eventloop_->RunInLoop([this, timer]() { InsertInLoop(timer); });
-  return timer;
+  return Insert(micros_value, micros_interval, TimerProcCallback(cb));
 }
 
 TimerId TimerList::Insert(uint64_t micros_value, uint64_t micros_interval,
                           TimerProcCallback&& cb) {
-  TimerId timer(micros_value,
-                new Timer(micros_value, micros_interval, std::move(cb)));
-  eventloop_->RunInLoop([this, timer]() { InsertInLoop(timer); });
+  Slot* slot;
+  TimerId timer = NewSlot(micros_interval, &slot);
+  slot->timerproc_cb = std::move(cb);
+  if (eventloop_->IsInMyLoop()) {
+    InsertInLoop(micros_value, timer);
+  } else {
+    eventloop_->QueueInLoop(
+        [this, micros_value, timer]() { InsertInLoop(micros_value, timer); });
+  }
   return timer;
 }
 
 void TimerList::Erase(TimerId timer) {
-  eventloop_->RunInLoop([this, timer]() { EraseInLoop(timer); });
+  if (!timer.Valid()) {
+    return;
+  }
+  if (eventloop_->IsInMyLoop()) {
+    EraseInLoop(timer);
+    return;
+  }
+  Slot* slot = GetSlot(timer.index);
+  if (slot == nullptr) {
+    return;
+  }
+  // Only ever move the flag forward, so a stale handle can not overwrite
+  // the cancellation of a newer timer in the same slot.
+  uint32_t cancelled = slot->cancelled.load(std::memory_order_relaxed);
+  while (static_cast<int32_t>(timer.generation - cancelled) > 0 &&
+         !slot->cancelled.compare_exchange_weak(cancelled, timer.generation,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+  }
 }
 
-void TimerList::InsertInLoop(TimerId timer) {
-  eventloop_->AssertInMyLoop();
-  timers_.insert(timer);
-  timer_ptrs_.insert(timer.second);
+TimerId TimerList::NewSlot(uint64_t micros_interval, Slot** slot) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_slots_.empty()) {
+    if (num_chunks_ == kMaxChunks) {
+      VOYAGER_LOG(FATAL) << "TimerList::NewSlot - too many timers";
+    }
+    Slot* chunk = new Slot[kSlotsPerChunk];
+    uint32_t base = num_chunks_ * kSlotsPerChunk;
+    for (uint32_t i = kSlotsPerChunk; i > 0; --i) {
+      free_slots_.push_back(base + i - 1);
+    }
+    chunks_[num_chunks_].store(chunk, std::memory_order_release);
+    ++num_chunks_;
+  }
+  uint32_t index = free_slots_.back();
+  free_slots_.pop_back();
+  Slot* s = chunks_[index / kSlotsPerChunk].load(std::memory_order_relaxed) +
+            index % kSlotsPerChunk;
+  s->micros_interval = micros_interval;
+  s->in_heap = false;
+  *slot = s;
+  return TimerId(index, s->generation);
 }
 
-void TimerList::EraseInLoop(TimerId timer) {
-  eventloop_->AssertInMyLoop();
-  std::set<Timer*>::iterator it = timer_ptrs_.find(timer.second);
-  if (it != timer_ptrs_.end()) {
-    timer.first = timer.second->micros_value;
-    timers_.erase(timer);
-    delete *it;
-    timer_ptrs_.erase(it);
+TimerList::Slot* TimerList::GetSlot(uint32_t index) const {
+  uint32_t chunk = index / kSlotsPerChunk;
+  if (chunk >= kMaxChunks) {
+    return nullptr;
   }
+  Slot* s = chunks_[chunk].load(std::memory_order_acquire);
+  return s == nullptr ? nullptr : s + index % kSlotsPerChunk;
 }
 
-uint64_t TimerList::TimeoutMicros() const {
-  eventloop_->AssertInMyLoop();
-  if (timers_.empty()) {
-    return -1;
+void TimerList::FreeSlot(Slot* slot, uint32_t index) {
+  slot->timerproc_cb = nullptr;
+  slot->in_heap = false;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (++slot->generation == 0) {
+    slot->generation = 1;
   }
-  std::set<TimerId>::const_iterator it = timers_.begin();
-  uint64_t now = timeops::NowMicros();
-  if (now < last_time_out_) {
-    return 0;
+  free_slots_.push_back(index);
+}
+
+bool TimerList::IsCancelled(const Slot* slot, uint32_t generation) const {
+  return slot->cancelled.load(std::memory_order_acquire) == generation;
+}
+
+void TimerList::InsertInLoop(uint64_t micros_value, TimerId timer) {
+  eventloop_->AssertInMyLoop();
+  Slot* slot = GetSlot(timer.index);
+  if (slot->generation != timer.generation) {
+    // Erased in the loop thread before it was queued here.
+    return;
   }
-  if (it->first <= now) {
-    return 0;
-  } else {
-    return (it->first - now);
+  if (IsCancelled(slot, timer.generation)) {
+    FreeSlot(slot, timer.index);
+    return;
   }
+  slot->in_heap = true;
+  PushEntry(micros_value, timer.index, timer.generation);
+  ResetTimerFd();
 }
 
-void TimerList::RunTimerProcs() {
+void TimerList::EraseInLoop(TimerId timer) {
   eventloop_->AssertInMyLoop();
-  if (timers_.empty()) {
+  Slot* slot = GetSlot(timer.index);
+  if (slot == nullptr || slot->generation != timer.generation) {
     return;
   }
+  if (slot->in_heap) {
+    ++stale_entries_;
+  }
+  FreeSlot(slot, timer.index);
+  static const size_t kMinCompactEntries = 64;
+  if (stale_entries_ > kMinCompactEntries &&
+      stale_entries_ * 2 > heap_.size()) {
+    Compact();
+  }
+  ResetTimerFd();
+}
+
+void TimerList::PushEntry(uint64_t micros_value, uint32_t index,
+                          uint32_t generation) {
+  Entry e;
+  e.micros_value = micros_value;
+  e.index = index;
+  e.generation = generation;
+  heap_.push_back(e);
+  std::push_heap(heap_.begin(), heap_.end(), EntryGreater());
+}
+
+void TimerList::PopEntry() {
+  std::pop_heap(heap_.begin(), heap_.end(), EntryGreater());
+  heap_.pop_back();
+}
 
-  uint64_t micros_now = timeops::NowMicros();
+void TimerList::PopStaleEntries() {
+  while (!heap_.empty()) {
+    uint32_t index = heap_.front().index;
+    uint32_t generation = heap_.front().generation;
+    Slot* slot = GetSlot(index);
+    if (slot->generation != generation) {
+      PopEntry();
+      --stale_entries_;
+    } else if (IsCancelled(slot, generation)) {
+      PopEntry();
+      FreeSlot(slot, index);
+    } else {
+      break;
+    }
+  }
+}
 
-  // FIXME 处理系统时钟向前调整时定时器被挂起的问题
-  if (micros_now < last_time_out_) {
-    uint64_t diff = last_time_out_ - micros_now;
-    std::set<TimerId> timers;
-    for (auto& it : timers_) {
-      uint64_t value = it.first > diff ? it.first - diff : 0;
-      it.second->micros_value = value;
-      timers.insert(TimerId(value, it.second));
+void TimerList::Compact() {
+  std::vector<Entry> heap;
+  heap.reserve(heap_.size() - stale_entries_);
+  for (const Entry& e : heap_) {
+    Slot* slot = GetSlot(e.index);
+    if (slot->generation != e.generation) {
+      continue;
+    }
+    if (IsCancelled(slot, e.generation)) {
+      FreeSlot(slot, e.index);
+      continue;
     }
-    timers_.swap(timers);
+    heap.push_back(e);
+  }
+  heap_.swap(heap);
+  std::make_heap(heap_.begin(), heap_.end(), EntryGreater());
+  stale_entries_ = 0;
+}
+
+uint64_t TimerList::TimeoutMicros() {
+  eventloop_->AssertInMyLoop();
+  PopStaleEntries();
+  if (heap_.empty()) {
+    return -1;
+  }
+  uint64_t now = timeops::MonotonicMicros();
+  if (heap_.front().micros_value <= now) {
+    return 0;
+  } else {
+    return (heap_.front().micros_value - now);
   }
-  last_time_out_ = micros_now;
+}
 
-  std::set<TimerId>::iterator it;
+void TimerList::RunTimerProcs() {
+  eventloop_->AssertInMyLoop();
+  uint64_t micros_now = eventloop_->MonotonicNow();
   while (true) {
-    it = timers_.begin();
-    if (it != timers_.end() && it->first <= micros_now) {
-      Timer* t = it->second;
-      timers_.erase(it);
-      TimerProcCallback cb = t->timerproc_cb;
-      if (t->micros_interval > 0) {
-        t->micros_value = micros_now + t->micros_interval;
-        TimerId timer(t->micros_value, t);
-        timers_.insert(timer);
-      } else {
-        delete t;
-        timer_ptrs_.erase(t);
-      }
+    PopStaleEntries();
+    if (heap_.empty() || heap_.front().micros_value > micros_now) {
+      break;
+    }
+    Entry e = heap_.front();
+    PopEntry();
+    EventLoopStatsRecorder* recorder = eventloop_->StatsRecorder();
+    if (VOYAGER_PREDICT_FALSE(recorder != nullptr)) {
+      recorder->timer_lateness_micros.Add(micros_now - e.micros_value);
+    }
+    Slot* slot = GetSlot(e.index);
+    slot->in_heap = false;
+    TimerProcCallback cb(std::move(slot->timerproc_cb));
+    StallScope scope(eventloop_->GetStallWatch(), "TimerProc");
+    if (slot->micros_interval > 0) {
       cb();
+      // The callback may have erased its own timer.
+      if (slot->generation == e.generation) {
+        if (IsCancelled(slot, e.generation)) {
+          FreeSlot(slot, e.index);
+        } else {
+          slot->timerproc_cb = std::move(cb);
+          slot->in_heap = true;
+          PushEntry(micros_now + slot->micros_interval, e.index,
+                    e.generation);
+        }
+      }
     } else {
-      break;
+      FreeSlot(slot, e.index);
+      cb();
     }
   }
+  ResetTimerFd();
+}
+
+void TimerList::ResetTimerFd() {
+#ifdef __linux__
+  PopStaleEntries();
+  if (heap_.empty()) {
+    return;
+  }
+  // Only ever arm the timerfd earlier. If the earliest timer is erased, the
+  // timerfd fires once for nothing and HandleRead() arms it again, which is
+  // cheaper than a timerfd_settime() for every cancellation.
+  uint64_t value = heap_.front().micros_value;
+  if (armed_value_ != 0 && armed_value_ <= value) {
+    return;
+  }
+  struct itimerspec new_value;
+  memset(&new_value, 0, sizeof(new_value));
+  new_value.it_value.tv_sec =
+      static_cast<time_t>(value / timeops::kMicroSecondsPerSecond);
+  new_value.it_value.tv_nsec =
+      static_cast<long>(value % timeops::kMicroSecondsPerSecond) * 1000;
+  if (::timerfd_settime(timerfd_, TFD_TIMER_ABSTIME, &new_value, nullptr) ==
+      -1) {
+    VOYAGER_LOG(ERROR) << "timerfd_settime: " << strerror(errno);
+  }
+  armed_value_ = value;
+#endif
+}
+
+void TimerList::HandleRead() {
+#ifdef __linux__
+  uint64_t exp = 0;
+  ssize_t n = ::read(timerfd_, &exp, sizeof(exp));
+  if (n != sizeof(exp) && errno != EAGAIN) {
+    VOYAGER_LOG(ERROR) << "TimerList::HandleRead - read: " << strerror(errno);
+  }
+  // The timerfd has expired, so it is no longer armed.
+  armed_value_ = 0;
+  RunTimerProcs();
+#endif
 }
 
 }  // namespace voyager
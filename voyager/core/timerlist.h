@@ -5,8 +5,9 @@
 #ifndef VOYAGER_CORE_TIMERLIST_H_
 #define VOYAGER_CORE_TIMERLIST_H_
 
-#include <set>
-#include <utility>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "voyager/core/callback.h"
@@ -14,6 +15,18 @@
 
 namespace voyager {
 
+// The deadlines of timers are CLOCK_MONOTONIC microseconds, so adjusting the
+// system clock never delays or fires them early. On linux all timers share
+// one timerfd registered in the poller, which is armed with the earliest
+// deadline at nanosecond precision; elsewhere EventLoop passes the earliest
+// deadline to the poller as timeout and calls RunTimerProcs() itself.
+//
+// Timers live in slots which never move, and are ordered by a binary heap
+// of (deadline, slot, generation) entries. Cancelling a timer in the loop
+// thread frees its slot at once and leaves its heap entry behind, which is
+// skipped because the generation no longer matches. Other threads cancel a
+// timer by raising an atomic flag of the slot, without taking a lock or
+// waking up the loop. The heap is rebuilt when most of it is stale.
 class TimerList {
  public:
   explicit TimerList(EventLoop* ev);
@@ -25,19 +38,57 @@ class TimerList {
                  TimerProcCallback&& cb);
   void Erase(TimerId timer);
 
-  uint64_t TimeoutMicros() const;
+  uint64_t TimeoutMicros();
   void RunTimerProcs();
 
  private:
-  void InsertInLoop(TimerId timer);
-  void EraseInLoop(TimerId timer);
+  struct Slot;
+  struct Entry {
+    uint64_t micros_value;
+    uint32_t index;
+    uint32_t generation;
+  };
+  struct EntryGreater {
+    bool operator()(const Entry& a, const Entry& b) const {
+      return a.micros_value > b.micros_value;
+    }
+  };
+
+  static const uint32_t kSlotsPerChunk = 1024;
+  static const uint32_t kMaxChunks = 4096;
+
+  TimerId NewSlot(uint64_t micros_interval, Slot** slot);
+  Slot* GetSlot(uint32_t index) const;
+  void FreeSlot(Slot* slot, uint32_t index);
+  bool IsCancelled(const Slot* slot, uint32_t generation) const;
 
-  uint64_t last_time_out_;
+  void InsertInLoop(uint64_t micros_value, TimerId timer);
+  void EraseInLoop(TimerId timer);
+  void PushEntry(uint64_t micros_value, uint32_t index, uint32_t generation);
+  void PopEntry();
+  void PopStaleEntries();
+  void Compact();
+  void ResetTimerFd();
+  void HandleRead();
 
   EventLoop* eventloop_;
 
-  std::set<Timer*> timer_ptrs_;
-  std::set<TimerId> timers_;
+#ifdef __linux__
+  const int timerfd_;
+  std::unique_ptr<Dispatch> dispatch_;
+  // The deadline the timerfd is armed with, 0 means it has expired.
+  uint64_t armed_value_;
+#endif
+
+  // Guards free_slots_ and the growth of chunks_.
+  std::mutex mutex_;
+  std::vector<uint32_t> free_slots_;
+  uint32_t num_chunks_;
+  std::unique_ptr<std::atomic<Slot*>[]> chunks_;
+
+  // Only touched in the loop thread.
+  std::vector<Entry> heap_;
+  size_t stale_entries_;
 
   // No copying allowed
   TimerList(const TimerList&);
@@ -0,0 +1,504 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/hpack.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace voyager {
+
+namespace {
+
+// RFC 7541 appendix B, by symbol, 256 is EOS.
+const struct {
+  uint32_t code;
+  int bits;
+} kHuffmanCodes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+    {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+    {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+    {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+    {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+    {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+    {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+    {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+    {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+    {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+    {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+    {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+    {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+    {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+    {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+    {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+    {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+    {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+    {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+    {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+    {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+    {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+    {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+    {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+    {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+    {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+    {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+    {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+    {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+    {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+    {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+    {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+    {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+    {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+    {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+    {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+    {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+    {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+    {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+    {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+    {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+    {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+    {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+    {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+    {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+    {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+    {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+    {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+    {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+    {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+    {0x3fffffff, 30},
+};
+
+// RFC 7541 appendix A.
+const struct {
+  const char* name;
+  const char* value;
+} kStaticTable[HpackTable::kStaticEntries] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+const size_t kDefaultTableSize = 4096;
+
+// The Huffman code as a binary tree, leaves hold the symbols.
+class HuffmanTree {
+ public:
+  struct Node {
+    int16_t child[2];
+    int16_t symbol;
+  };
+
+  HuffmanTree() {
+    nodes_.push_back(Node{{-1, -1}, -1});
+    for (int symbol = 0; symbol < 257; ++symbol) {
+      size_t node = 0;
+      for (int i = kHuffmanCodes[symbol].bits - 1; i >= 0; --i) {
+        int bit = (kHuffmanCodes[symbol].code >> i) & 1;
+        if (nodes_[node].child[bit] < 0) {
+          nodes_[node].child[bit] = static_cast<int16_t>(nodes_.size());
+          nodes_.push_back(Node{{-1, -1}, -1});
+        }
+        node = static_cast<size_t>(nodes_[node].child[bit]);
+      }
+      nodes_[node].symbol = static_cast<int16_t>(symbol);
+    }
+  }
+
+  const Node& At(size_t i) const { return nodes_[i]; }
+
+ private:
+  std::vector<Node> nodes_;
+};
+
+}  // namespace
+
+namespace hpack {
+
+size_t HuffmanLength(const Slice& s) {
+  size_t bits = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    bits += static_cast<size_t>(
+        kHuffmanCodes[static_cast<uint8_t>(s[i])].bits);
+  }
+  return (bits + 7) / 8;
+}
+
+void HuffmanEncode(const Slice& s, std::string* out) {
+  uint64_t buffer = 0;
+  int bits = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    const auto& code = kHuffmanCodes[static_cast<uint8_t>(s[i])];
+    buffer = (buffer << code.bits) | code.code;
+    bits += code.bits;
+    while (bits >= 8) {
+      bits -= 8;
+      out->push_back(static_cast<char>(buffer >> bits));
+    }
+  }
+  if (bits > 0) {
+    // Padded with the most significant bits of EOS, all ones.
+    buffer = (buffer << (8 - bits)) | (0xffu >> bits);
+    out->push_back(static_cast<char>(buffer));
+  }
+}
+
+bool HuffmanDecode(const Slice& s, std::string* out) {
+  static const HuffmanTree tree;
+  size_t node = 0;
+  // The bits since the last symbol, and whether they are all ones.
+  int depth = 0;
+  bool ones = true;
+  for (size_t i = 0; i < s.size(); ++i) {
+    uint8_t byte = static_cast<uint8_t>(s[i]);
+    for (int b = 7; b >= 0; --b) {
+      int bit = (byte >> b) & 1;
+      int16_t next = tree.At(node).child[bit];
+      if (next < 0) {
+        return false;
+      }
+      node = static_cast<size_t>(next);
+      ++depth;
+      ones = ones && bit == 1;
+      int16_t symbol = tree.At(node).symbol;
+      if (symbol >= 0) {
+        if (symbol == 256) {
+          return false;
+        }
+        out->push_back(static_cast<char>(symbol));
+        node = 0;
+        depth = 0;
+        ones = true;
+      }
+    }
+  }
+  return depth <= 7 && ones;
+}
+
+void EncodeInteger(uint64_t value, int n, uint8_t flags, std::string* out) {
+  const uint64_t max = (1u << n) - 1;
+  if (value < max) {
+    out->push_back(static_cast<char>(flags | value));
+    return;
+  }
+  out->push_back(static_cast<char>(flags | max));
+  value -= max;
+  while (value >= 128) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool DecodeInteger(const Slice& s, size_t* p, int n, uint64_t* value) {
+  if (*p >= s.size()) {
+    return false;
+  }
+  const uint64_t max = (1u << n) - 1;
+  *value = static_cast<uint8_t>(s[(*p)++]) & max;
+  if (*value < max) {
+    return true;
+  }
+  for (int shift = 0; *p < s.size() && shift <= 28; shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(s[(*p)++]);
+    *value += static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace hpack
+
+HpackTable::HpackTable(size_t max_size) : size_(0), max_size_(max_size) {}
+
+void HpackTable::SetMaxSize(size_t max_size) {
+  max_size_ = max_size;
+  while (size_ > max_size_) {
+    size_ -= entries_.back().first.size() + entries_.back().second.size() +
+             kEntryOverhead;
+    entries_.pop_back();
+  }
+}
+
+void HpackTable::Add(const Slice& name, const Slice& value) {
+  size_t size = name.size() + value.size() + kEntryOverhead;
+  // name and value may be an entry which is evicted.
+  std::pair<std::string, std::string> entry(name.ToString(),
+                                            value.ToString());
+  while (!entries_.empty() && size_ + size > max_size_) {
+    size_ -= entries_.back().first.size() + entries_.back().second.size() +
+             kEntryOverhead;
+    entries_.pop_back();
+  }
+  if (size <= max_size_) {
+    entries_.push_front(std::move(entry));
+    size_ += size;
+  }
+}
+
+bool HpackTable::Get(size_t index, Slice* name, Slice* value) const {
+  if (index == 0) {
+    return false;
+  }
+  if (index <= kStaticEntries) {
+    *name = kStaticTable[index - 1].name;
+    *value = kStaticTable[index - 1].value;
+    return true;
+  }
+  index -= kStaticEntries + 1;
+  if (index >= entries_.size()) {
+    return false;
+  }
+  *name = entries_[index].first;
+  *value = entries_[index].second;
+  return true;
+}
+
+size_t HpackTable::Find(const Slice& name, const Slice& value,
+                        size_t* name_index) const {
+  *name_index = 0;
+  for (size_t i = 0; i < kStaticEntries; ++i) {
+    if (name == kStaticTable[i].name) {
+      if (value == kStaticTable[i].value) {
+        return i + 1;
+      }
+      if (*name_index == 0) {
+        *name_index = i + 1;
+      }
+    }
+  }
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (name == entries_[i].first) {
+      if (value == entries_[i].second) {
+        return kStaticEntries + 1 + i;
+      }
+      if (*name_index == 0) {
+        *name_index = kStaticEntries + 1 + i;
+      }
+    }
+  }
+  return 0;
+}
+
+HpackEncoder::HpackEncoder()
+    : table_(kDefaultTableSize),
+      pending_size_(kDefaultTableSize),
+      size_changed_(false) {}
+
+void HpackEncoder::SetMaxTableSize(size_t size) {
+  size = size < kDefaultTableSize ? size : kDefaultTableSize;
+  if (size != table_.MaxSize()) {
+    // Only the last change is announced. The peer keeps the entries which
+    // a smaller size in between evicted here, but they are never used.
+    table_.SetMaxSize(size);
+    pending_size_ = size;
+    size_changed_ = true;
+  }
+}
+
+void HpackEncoder::Begin(std::string* out) {
+  if (size_changed_) {
+    hpack::EncodeInteger(pending_size_, 5, 0x20, out);
+    size_changed_ = false;
+  }
+}
+
+static void EncodeString(const Slice& s, std::string* out) {
+  size_t huffman = hpack::HuffmanLength(s);
+  if (huffman < s.size()) {
+    hpack::EncodeInteger(huffman, 7, 0x80, out);
+    hpack::HuffmanEncode(s, out);
+  } else {
+    hpack::EncodeInteger(s.size(), 7, 0, out);
+    out->append(s.data(), s.size());
+  }
+}
+
+void HpackEncoder::Encode(const Slice& name, const Slice& value,
+                          std::string* out) {
+  size_t name_index;
+  size_t index = table_.Find(name, value, &name_index);
+  if (index > 0) {
+    hpack::EncodeInteger(index, 7, 0x80, out);
+    return;
+  }
+  if (name == "set-cookie" || name == "authorization" || name == "cookie") {
+    // Never indexed, not even by intermediaries.
+    hpack::EncodeInteger(name_index, 4, 0x10, out);
+  } else if (name == "content-length" || name == "date" || name == "etag" ||
+             name == "last-modified" || name == "content-range" ||
+             name == "location") {
+    // Different for most responses, would only evict useful entries.
+    hpack::EncodeInteger(name_index, 4, 0x00, out);
+  } else {
+    hpack::EncodeInteger(name_index, 6, 0x40, out);
+    table_.Add(name, value);
+  }
+  if (name_index == 0) {
+    EncodeString(name, out);
+  }
+  EncodeString(value, out);
+}
+
+HpackDecoder::HpackDecoder() : table_(kDefaultTableSize) {}
+
+bool HpackDecoder::DecodeString(const Slice& block, size_t* p,
+                                std::string* s) {
+  if (*p >= block.size()) {
+    return false;
+  }
+  bool huffman = (block[*p] & 0x80) != 0;
+  uint64_t length;
+  if (!hpack::DecodeInteger(block, p, 7, &length) ||
+      length > block.size() - *p) {
+    return false;
+  }
+  Slice data(block.data() + *p, static_cast<size_t>(length));
+  *p += static_cast<size_t>(length);
+  s->clear();
+  if (huffman) {
+    return hpack::HuffmanDecode(data, s);
+  }
+  s->assign(data.data(), data.size());
+  return true;
+}
+
+bool HpackDecoder::Decode(
+    const Slice& block, size_t max_list_size,
+    std::vector<std::pair<std::string, std::string>>* headers,
+    size_t* list_size) {
+  size_t p = 0;
+  bool first = true;
+  *list_size = 0;
+  while (p < block.size()) {
+    uint8_t byte = static_cast<uint8_t>(block[p]);
+    uint64_t index;
+    Slice name;
+    Slice value;
+    if (byte & 0x80) {
+      // Indexed header field.
+      if (!hpack::DecodeInteger(block, &p, 7, &index) ||
+          !table_.Get(static_cast<size_t>(index), &name, &value)) {
+        return false;
+      }
+      *list_size += name.size() + value.size() + HpackTable::kEntryOverhead;
+      if (*list_size <= max_list_size) {
+        headers->push_back(std::make_pair(name.ToString(), value.ToString()));
+      }
+    } else if ((byte & 0xe0) == 0x20) {
+      // Dynamic table size update, only before the first field.
+      if (!first || !hpack::DecodeInteger(block, &p, 5, &index) ||
+          index > kDefaultTableSize) {
+        return false;
+      }
+      table_.SetMaxSize(static_cast<size_t>(index));
+      continue;
+    } else {
+      // Literal with incremental indexing, without, or never indexed.
+      bool indexing = (byte & 0xc0) == 0x40;
+      int n = indexing ? 6 : 4;
+      if (!hpack::DecodeInteger(block, &p, n, &index)) {
+        return false;
+      }
+      std::pair<std::string, std::string> field;
+      if (index == 0) {
+        if (!DecodeString(block, &p, &field.first)) {
+          return false;
+        }
+      } else if (table_.Get(static_cast<size_t>(index), &name, &value)) {
+        field.first = name.ToString();
+      } else {
+        return false;
+      }
+      if (!DecodeString(block, &p, &field.second)) {
+        return false;
+      }
+      if (indexing) {
+        table_.Add(field.first, field.second);
+      }
+      *list_size += field.first.size() + field.second.size() +
+                    HpackTable::kEntryOverhead;
+      if (*list_size <= max_list_size) {
+        headers->push_back(std::move(field));
+      }
+    }
+    first = false;
+  }
+  return true;
+}
+
+}  // namespace voyager
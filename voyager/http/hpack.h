@@ -0,0 +1,110 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HPACK_H_
+#define VOYAGER_HTTP_HPACK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// HPACK, the header compression of HTTP/2 (RFC 7541).
+namespace hpack {
+
+// The length of s once Huffman coded.
+size_t HuffmanLength(const Slice& s);
+void HuffmanEncode(const Slice& s, std::string* out);
+// False for an invalid code, or padding which is not a prefix of EOS.
+bool HuffmanDecode(const Slice& s, std::string* out);
+
+// Appends value with an n bit prefix, the rest of the first byte is flags.
+void EncodeInteger(uint64_t value, int n, uint8_t flags, std::string* out);
+// Reads an integer with an n bit prefix from *p on, false if it is cut
+// short or too large.
+bool DecodeInteger(const Slice& s, size_t* p, int n, uint64_t* value);
+
+}  // namespace hpack
+
+// The static table followed by the dynamic one, which each end of a
+// connection keeps in step with the other for one direction.
+class HpackTable {
+ public:
+  static const size_t kStaticEntries = 61;
+  // What an entry costs beside its name and value.
+  static const size_t kEntryOverhead = 32;
+
+  explicit HpackTable(size_t max_size);
+
+  // Evicts the oldest entries to fit.
+  void SetMaxSize(size_t max_size);
+  size_t MaxSize() const { return max_size_; }
+  size_t Size() const { return size_; }
+  size_t Entries() const { return kStaticEntries + entries_.size(); }
+
+  // An entry larger than the whole table empties it.
+  void Add(const Slice& name, const Slice& value);
+  // The entry at index, from 1, false if there is none.
+  bool Get(size_t index, Slice* name, Slice* value) const;
+  // The index of an entry with name and value, 0 if there is none. Then
+  // *name_index is that of an entry with name, or 0.
+  size_t Find(const Slice& name, const Slice& value, size_t* name_index) const;
+
+ private:
+  // Newest first, at kStaticEntries + 1.
+  std::deque<std::pair<std::string, std::string>> entries_;
+  size_t size_;
+  size_t max_size_;
+};
+
+class HpackEncoder {
+ public:
+  HpackEncoder();
+
+  // The SETTINGS_HEADER_TABLE_SIZE of the peer. The table takes the
+  // smaller of it and 4096, announced at the start of the next block.
+  void SetMaxTableSize(size_t size);
+
+  // Starts a header block.
+  void Begin(std::string* out);
+  // Appends a header, name in lower case. Values which would be cached in
+  // vain or which are secret, such as cookies, are not indexed.
+  void Encode(const Slice& name, const Slice& value, std::string* out);
+
+ private:
+  HpackTable table_;
+  size_t pending_size_;
+  bool size_changed_;
+};
+
+class HpackDecoder {
+ public:
+  // Bounded by the SETTINGS_HEADER_TABLE_SIZE we announce, 4096.
+  HpackDecoder();
+
+  // Decodes a whole header block into headers, false on a compression
+  // error, after which the connection can not go on. *list_size is the
+  // size of the header list as SETTINGS_MAX_HEADER_LIST_SIZE counts it.
+  // Past max_list_size the rest of the fields are decoded only to keep the
+  // table in step, and not added to headers.
+  bool Decode(const Slice& block, size_t max_list_size,
+              std::vector<std::pair<std::string, std::string>>* headers,
+              size_t* list_size);
+
+ private:
+  bool DecodeString(const Slice& block, size_t* p, std::string* s);
+
+  HpackTable table_;
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HPACK_H_
@@ -0,0 +1,930 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http2_session.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/http/http_date.h"
+#include "voyager/util/base64/base64.h"
+
+namespace voyager {
+
+namespace {
+
+enum FrameType {
+  kData = 0,
+  kHeaders = 1,
+  kPriority = 2,
+  kRstStream = 3,
+  kSettings = 4,
+  kPushPromise = 5,
+  kPing = 6,
+  kGoAway = 7,
+  kWindowUpdate = 8,
+  kContinuation = 9,
+};
+
+const uint8_t kEndStream = 0x1;
+const uint8_t kAck = 0x1;
+const uint8_t kEndHeaders = 0x4;
+const uint8_t kPadded = 0x8;
+const uint8_t kPriorityFlag = 0x20;
+
+enum ErrorCode {
+  kNoError = 0,
+  kProtocolError = 1,
+  kFlowControlError = 3,
+  kStreamClosed = 5,
+  kFrameSizeError = 6,
+  kRefusedStream = 7,
+  kCompressionError = 9,
+  kEnhanceYourCalm = 11,
+};
+
+enum SettingId {
+  kHeaderTableSize = 1,
+  kEnablePush = 2,
+  kMaxConcurrentStreams = 3,
+  kInitialWindowSize = 4,
+  kMaxFrameSize = 5,
+  kMaxHeaderListSize = 6,
+};
+
+const size_t kFrameHeaderSize = 9;
+// The SETTINGS_MAX_FRAME_SIZE of the server, the default.
+const size_t kMaxFrameSizeOfServer = 16384;
+const uint32_t kDefaultWindowSize = 65535;
+const int64_t kMaxWindowSize = 0x7fffffff;
+
+uint32_t Read32(const char* p) {
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  return (static_cast<uint32_t>(u[0]) << 24) |
+         (static_cast<uint32_t>(u[1]) << 16) |
+         (static_cast<uint32_t>(u[2]) << 8) | static_cast<uint32_t>(u[3]);
+}
+
+void Append32(uint32_t value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 24));
+  out->push_back(static_cast<char>(value >> 16));
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendSetting(uint16_t id, uint32_t value, std::string* out) {
+  out->push_back(static_cast<char>(id >> 8));
+  out->push_back(static_cast<char>(id));
+  Append32(value, out);
+}
+
+// Drops the padding of a DATA or HEADERS frame, false if it is longer than
+// the frame.
+bool StripPadding(uint8_t flags, Slice* payload) {
+  if ((flags & kPadded) == 0) {
+    return true;
+  }
+  if (payload->empty()) {
+    return false;
+  }
+  size_t padding = static_cast<uint8_t>((*payload)[0]);
+  payload->remove_prefix(1);
+  if (padding > payload->size()) {
+    return false;
+  }
+  *payload = Slice(payload->data(), payload->size() - padding);
+  return true;
+}
+
+// RFC 7540 8.1.2.2, they only mean something to HTTP/1.
+bool ConnectionSpecific(const std::string& name) {
+  return name == "connection" || name == "keep-alive" ||
+         name == "proxy-connection" || name == "transfer-encoding" ||
+         name == "upgrade";
+}
+
+bool DecodeBase64Url(const Slice& s, std::string* out) {
+  std::string input(s.data(), s.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    if (input[i] == '-') {
+      input[i] = '+';
+    } else if (input[i] == '_') {
+      input[i] = '/';
+    }
+  }
+  while (input.size() % 4 != 0) {
+    input.push_back('=');
+  }
+  return Base64Decode(input, out);
+}
+
+}  // namespace
+
+const char Http2Session::kPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+struct Http2Session::Stream {
+  Stream(uint32_t i, int64_t send, int64_t recv)
+      : id(i),
+        head_request(false),
+        remote_closed(false),
+        head_sent(false),
+        end_pending(false),
+        send_window(send),
+        recv_window(recv),
+        recv_unacked(0) {}
+
+  const uint32_t id;
+  // Until it is complete and handed out.
+  HttpRequestPtr request;
+  bool head_request;
+  // END_STREAM received.
+  bool remote_closed;
+  bool head_sent;
+  // END_STREAM goes with the last of pending.
+  bool end_pending;
+  int64_t send_window;
+  int64_t recv_window;
+  uint32_t recv_unacked;
+  // The body waiting for the windows.
+  OutputChain pending;
+  std::function<void()> drain_cb;
+};
+
+Http2Options::Http2Options()
+    : max_concurrent_streams(100),
+      initial_window_size(1024 * 1024),
+      connection_window_size(16 * 1024 * 1024),
+      max_header_list_size(64 * 1024),
+      high_water_mark(1024 * 1024) {}
+
+Http2Session::Http2Session(const TcpConnectionPtr& ptr,
+                           const Http2Options& options,
+                           const RequestCallback& cb)
+    : conn_wp_(ptr),
+      eventloop_(ptr->OwnerEventLoop()),
+      options_(options),
+      request_cb_(cb),
+      max_body_size_(4 * 1024 * 1024),
+      in_batch_(false),
+      preface_received_(false),
+      goaway_sent_(false),
+      goaway_received_(false),
+      last_stream_id_(0),
+      continuation_id_(0),
+      continuation_end_stream_(false),
+      initial_window_size_(kDefaultWindowSize),
+      max_frame_size_(kMaxFrameSizeOfServer),
+      send_window_(kDefaultWindowSize),
+      recv_window_(kDefaultWindowSize),
+      recv_unacked_(0) {
+  ptr->SetHighWaterMark(options_.high_water_mark);
+}
+
+Http2Session::~Http2Session() {}
+
+bool Http2Session::Upgradable(const HttpRequest& request) {
+  if (request.Version() != HttpMessage::kHttp11 ||
+      !request.Headers().Has(HttpHeaders::kHttp2Settings)) {
+    return false;
+  }
+  // A list of protocols, h2c among them.
+  Slice upgrade(request.Value(HttpHeaders::kUpgrade));
+  size_t p = 0;
+  while (p < upgrade.size()) {
+    while (p < upgrade.size() && (upgrade[p] == ' ' || upgrade[p] == ',')) {
+      ++p;
+    }
+    size_t end = p;
+    while (end < upgrade.size() && upgrade[end] != ',' &&
+           upgrade[end] != ' ') {
+      ++end;
+    }
+    if (end - p == 3 && strncasecmp(upgrade.data() + p, "h2c", 3) == 0) {
+      return true;
+    }
+    p = end;
+  }
+  return false;
+}
+
+void Http2Session::Start() {
+  std::string settings;
+  AppendSetting(kMaxConcurrentStreams, options_.max_concurrent_streams,
+                &settings);
+  AppendSetting(kInitialWindowSize, options_.initial_window_size, &settings);
+  AppendSetting(kMaxHeaderListSize, options_.max_header_list_size,
+                &settings);
+  WriteFrameHeader(settings.size(), kSettings, 0, 0);
+  out_.Append(std::move(settings));
+  if (options_.connection_window_size > kDefaultWindowSize) {
+    WriteWindowUpdate(0, options_.connection_window_size - kDefaultWindowSize);
+    recv_window_ = options_.connection_window_size;
+  }
+  Flush();
+}
+
+void Http2Session::Upgrade(const HttpRequestPtr& request) {
+  in_batch_ = true;
+  std::string settings;
+  if (!DecodeBase64Url(request->Value(HttpHeaders::kHttp2Settings),
+                       &settings) ||
+      settings.size() % 6 != 0) {
+    Fail(kProtocolError);
+  }
+  bool ok = !goaway_sent_;
+  for (size_t i = 0; ok && i < settings.size(); i += 6) {
+    uint16_t id = static_cast<uint16_t>(
+        (static_cast<uint8_t>(settings[i]) << 8) |
+        static_cast<uint8_t>(settings[i + 1]));
+    ok = ApplySetting(id, Read32(settings.data() + i + 2));
+  }
+  if (ok) {
+    // RFC 7540 3.2, the request is stream 1, half closed by the client.
+    last_stream_id_ = 1;
+    std::unique_ptr<Stream> stream(
+        new Stream(1, initial_window_size_, options_.initial_window_size));
+    stream->remote_closed = true;
+    stream->head_request = request->GetMethod() == HttpRequest::kHead;
+    stream->request = request;
+    request->SetVersion(HttpMessage::kHttp20);
+    Stream* s = stream.get();
+    streams_[1] = std::move(stream);
+    Dispatch(s);
+  }
+  in_batch_ = false;
+  Flush();
+}
+
+void Http2Session::OnMessage(Buffer* buf) {
+  if (goaway_sent_ && streams_.empty()) {
+    buf->RetrieveAll();
+    return;
+  }
+  in_batch_ = true;
+  bool ok = true;
+  if (!preface_received_) {
+    size_t n = std::min(buf->ReadableSize(), kPrefaceSize);
+    if (memcmp(buf->Peek(), kPreface, n) != 0) {
+      ok = Fail(kProtocolError);
+    } else if (n == kPrefaceSize) {
+      buf->Retrieve(kPrefaceSize);
+      preface_received_ = true;
+    } else {
+      ok = false;
+    }
+  }
+  while (ok && buf->ReadableSize() >= kFrameHeaderSize) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buf->Peek());
+    size_t length = (static_cast<size_t>(p[0]) << 16) |
+                    (static_cast<size_t>(p[1]) << 8) | p[2];
+    uint8_t type = p[3];
+    uint8_t flags = p[4];
+    uint32_t id = Read32(buf->Peek() + 5) & 0x7fffffff;
+    if (length > kMaxFrameSizeOfServer) {
+      ok = Fail(kFrameSizeError);
+      break;
+    }
+    if (buf->ReadableSize() < kFrameHeaderSize + length) {
+      break;
+    }
+    ok = HandleFrame(type, flags, id,
+                     Slice(buf->Peek() + kFrameHeaderSize, length));
+    buf->Retrieve(kFrameHeaderSize + length);
+  }
+  if (goaway_sent_) {
+    buf->RetrieveAll();
+  }
+  UpdateWindows();
+  Pump();
+  in_batch_ = false;
+  Flush();
+}
+
+void Http2Session::OnWriteComplete() {
+  UpdateWindows();
+  Pump();
+  Flush();
+  for (auto& it : streams_) {
+    Stream* s = it.second.get();
+    if (s->drain_cb && s->head_sent && !s->end_pending) {
+      s->drain_cb();
+    }
+  }
+}
+
+bool Http2Session::HandleFrame(uint8_t type, uint8_t flags, uint32_t id,
+                               Slice payload) {
+  if (continuation_id_ != 0 &&
+      (type != kContinuation || id != continuation_id_)) {
+    return Fail(kProtocolError);
+  }
+  switch (type) {
+    case kData:
+      return OnData(flags, id, payload);
+    case kHeaders:
+      return OnHeaders(flags, id, payload);
+    case kPriority:
+      if (id == 0) {
+        return Fail(kProtocolError);
+      }
+      if (payload.size() != 5) {
+        Reset(id, kFrameSizeError);
+      }
+      // Everything is sent as it comes, by turns.
+      return true;
+    case kRstStream:
+      if (id == 0 || id > last_stream_id_) {
+        return Fail(kProtocolError);
+      }
+      if (payload.size() != 4) {
+        return Fail(kFrameSizeError);
+      }
+      streams_.erase(id);
+      return true;
+    case kSettings:
+      if (id != 0) {
+        return Fail(kProtocolError);
+      }
+      return OnSettings(flags, payload);
+    case kPing:
+      if (id != 0) {
+        return Fail(kProtocolError);
+      }
+      if (payload.size() != 8) {
+        return Fail(kFrameSizeError);
+      }
+      if ((flags & kAck) == 0) {
+        WriteFrameHeader(8, kPing, kAck, 0);
+        out_.Append(payload);
+      }
+      return true;
+    case kGoAway:
+      if (id != 0) {
+        return Fail(kProtocolError);
+      }
+      if (payload.size() < 8) {
+        return Fail(kFrameSizeError);
+      }
+      // The streams open are finished, then the connection is closed.
+      goaway_received_ = true;
+      return true;
+    case kWindowUpdate:
+      return OnWindowUpdate(id, payload);
+    case kContinuation:
+      if (continuation_id_ == 0) {
+        return Fail(kProtocolError);
+      }
+      header_block_.append(payload.data(), payload.size());
+      if (header_block_.size() > 2 * options_.max_header_list_size) {
+        return Fail(kEnhanceYourCalm);
+      }
+      if (flags & kEndHeaders) {
+        continuation_id_ = 0;
+        return OnHeaderBlock(id, continuation_end_stream_);
+      }
+      return true;
+    case kPushPromise:
+      // Only servers push.
+      return Fail(kProtocolError);
+    default:
+      // Unknown frames are ignored.
+      return true;
+  }
+}
+
+bool Http2Session::OnData(uint8_t flags, uint32_t id, Slice payload) {
+  if (id == 0) {
+    return Fail(kProtocolError);
+  }
+  // The padding counts against the windows too.
+  uint32_t length = static_cast<uint32_t>(payload.size());
+  recv_window_ -= length;
+  if (recv_window_ < 0) {
+    return Fail(kFlowControlError);
+  }
+  recv_unacked_ += length;
+  if (!StripPadding(flags, &payload)) {
+    return Fail(kProtocolError);
+  }
+  auto it = streams_.find(id);
+  if (it == streams_.end() || it->second->remote_closed) {
+    if (id > last_stream_id_) {
+      return Fail(kProtocolError);
+    }
+    Reset(id, kStreamClosed);
+    return true;
+  }
+  Stream* s = it->second.get();
+  s->recv_window -= length;
+  if (s->recv_window < 0) {
+    Reset(id, kFlowControlError);
+    return true;
+  }
+  s->recv_unacked += length;
+  if (s->request) {
+    // The stream is answered and no longer credited.
+    if (s->request->Body().size() + payload.size() > max_body_size_) {
+      Reject(id, 413);
+      return true;
+    }
+    s->request->AppendBody(payload.data(), payload.size());
+  }
+  if (flags & kEndStream) {
+    s->remote_closed = true;
+    Dispatch(s);
+  }
+  return true;
+}
+
+bool Http2Session::OnHeaders(uint8_t flags, uint32_t id, Slice payload) {
+  if (id == 0 || (id & 1) == 0) {
+    return Fail(kProtocolError);
+  }
+  if (!StripPadding(flags, &payload)) {
+    return Fail(kProtocolError);
+  }
+  if (flags & kPriorityFlag) {
+    if (payload.size() < 5) {
+      return Fail(kFrameSizeError);
+    }
+    payload.remove_prefix(5);
+  }
+  header_block_.assign(payload.data(), payload.size());
+  bool end_stream = (flags & kEndStream) != 0;
+  if ((flags & kEndHeaders) == 0) {
+    continuation_id_ = id;
+    continuation_end_stream_ = end_stream;
+    return true;
+  }
+  return OnHeaderBlock(id, end_stream);
+}
+
+bool Http2Session::OnHeaderBlock(uint32_t id, bool end_stream) {
+  // Decoded even for a stream which is refused, to keep the table in step.
+  std::vector<std::pair<std::string, std::string>> headers;
+  size_t list_size;
+  bool decoded = decoder_.Decode(header_block_, options_.max_header_list_size,
+                                 &headers, &list_size);
+  header_block_.clear();
+  if (!decoded) {
+    return Fail(kCompressionError);
+  }
+  bool too_large = list_size > options_.max_header_list_size;
+
+  auto it = streams_.find(id);
+  if (it != streams_.end()) {
+    // Trailers, which end the request.
+    Stream* s = it->second.get();
+    if (s->remote_closed) {
+      Reset(id, kStreamClosed);
+    } else if (!end_stream) {
+      Reset(id, kProtocolError);
+    } else {
+      s->remote_closed = true;
+      if (too_large) {
+        Reject(id, 431);
+      } else {
+        Dispatch(s);
+      }
+    }
+    return true;
+  }
+  if (id <= last_stream_id_) {
+    return Fail(kStreamClosed);
+  }
+  last_stream_id_ = id;
+  if (goaway_sent_ || goaway_received_) {
+    return true;
+  }
+  if (streams_.size() >= options_.max_concurrent_streams ||
+      (refuse_cb_ && refuse_cb_())) {
+    Reset(id, kRefusedStream);
+    return true;
+  }
+  std::unique_ptr<Stream> stream(new Stream(id, initial_window_size_,
+                                            options_.initial_window_size));
+  stream->remote_closed = end_stream;
+  Stream* s = stream.get();
+  streams_[id] = std::move(stream);
+  if (too_large) {
+    Reject(id, 431);
+    return true;
+  }
+
+  HttpRequestPtr request(new HttpRequest());
+  request->SetVersion(HttpMessage::kHttp20);
+  bool valid = true;
+  bool regular = false;
+  bool method = false;
+  bool path = false;
+  std::string authority;
+  std::string cookie;
+  for (auto& header : headers) {
+    const std::string& name = header.first;
+    const std::string& value = header.second;
+    if (name.empty()) {
+      valid = false;
+      break;
+    }
+    for (size_t i = 0; i < name.size(); ++i) {
+      valid = valid && !isupper(static_cast<unsigned char>(name[i]));
+    }
+    if (name[0] == ':') {
+      // Pseudo-headers come first, each once.
+      if (regular) {
+        valid = false;
+      } else if (name == ":method" && !method) {
+        method = !value.empty() &&
+                 request->SetMethod(value.data(), value.data() + value.size());
+        valid = valid && method;
+      } else if (name == ":path" && !path) {
+        size_t query = value.find('?');
+        request->SetPath(value.substr(0, query));
+        if (query != std::string::npos) {
+          request->SetQuery(value.substr(query + 1));
+        }
+        path = !value.empty();
+      } else if (name == ":authority" && authority.empty()) {
+        authority = value;
+      } else if (name != ":scheme") {
+        valid = false;
+      }
+      continue;
+    }
+    regular = true;
+    if (ConnectionSpecific(name) || (name == "te" && value != "trailers")) {
+      valid = false;
+    } else if (name == "cookie") {
+      // RFC 7540 8.1.2.5, the crumbs are joined again.
+      if (!cookie.empty()) {
+        cookie += "; ";
+      }
+      cookie += value;
+    } else {
+      request->MutableHeaders()->Add(name, value);
+    }
+  }
+  if (!valid || !method || !path) {
+    Reset(id, kProtocolError);
+    return true;
+  }
+  if (!cookie.empty()) {
+    request->MutableHeaders()->Add("cookie", cookie);
+  }
+  if (!authority.empty() && !request->Headers().Has(HttpHeaders::kHost)) {
+    request->MutableHeaders()->Add("host", authority);
+  }
+
+  s->head_request = request->GetMethod() == HttpRequest::kHead;
+  s->request = request;
+  if (end_stream) {
+    Dispatch(s);
+  }
+  return true;
+}
+
+bool Http2Session::OnSettings(uint8_t flags, const Slice& payload) {
+  if (flags & kAck) {
+    return payload.empty() || Fail(kFrameSizeError);
+  }
+  if (payload.size() % 6 != 0) {
+    return Fail(kFrameSizeError);
+  }
+  for (size_t i = 0; i < payload.size(); i += 6) {
+    uint16_t id = static_cast<uint16_t>(
+        (static_cast<uint8_t>(payload[i]) << 8) |
+        static_cast<uint8_t>(payload[i + 1]));
+    if (!ApplySetting(id, Read32(payload.data() + i + 2))) {
+      return false;
+    }
+  }
+  WriteFrameHeader(0, kSettings, kAck, 0);
+  return true;
+}
+
+bool Http2Session::ApplySetting(uint16_t id, uint32_t value) {
+  switch (id) {
+    case kHeaderTableSize:
+      encoder_.SetMaxTableSize(value);
+      break;
+    case kEnablePush:
+      if (value > 1) {
+        return Fail(kProtocolError);
+      }
+      break;
+    case kInitialWindowSize: {
+      if (value > kMaxWindowSize) {
+        return Fail(kFlowControlError);
+      }
+      // RFC 7540 6.9.2, the windows of the open streams move by the change.
+      int64_t delta = static_cast<int64_t>(value) - initial_window_size_;
+      for (auto& it : streams_) {
+        it.second->send_window += delta;
+        if (it.second->send_window > kMaxWindowSize) {
+          return Fail(kFlowControlError);
+        }
+      }
+      initial_window_size_ = value;
+      break;
+    }
+    case kMaxFrameSize:
+      if (value < kMaxFrameSizeOfServer || value > 16777215) {
+        return Fail(kProtocolError);
+      }
+      max_frame_size_ = value;
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+bool Http2Session::OnWindowUpdate(uint32_t id, const Slice& payload) {
+  if (payload.size() != 4) {
+    return Fail(kFrameSizeError);
+  }
+  uint32_t increment = Read32(payload.data()) & 0x7fffffff;
+  if (id == 0) {
+    if (increment == 0) {
+      return Fail(kProtocolError);
+    }
+    send_window_ += increment;
+    return send_window_ <= kMaxWindowSize || Fail(kFlowControlError);
+  }
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    // Allowed for a stream just closed.
+    return id <= last_stream_id_ || Fail(kProtocolError);
+  }
+  if (increment == 0) {
+    Reset(id, kProtocolError);
+    return true;
+  }
+  it->second->send_window += increment;
+  if (it->second->send_window > kMaxWindowSize) {
+    Reset(id, kFlowControlError);
+  }
+  return true;
+}
+
+void Http2Session::Dispatch(Stream* stream) {
+  if (!stream->request) {
+    return;
+  }
+  HttpRequestPtr request(std::move(stream->request));
+  // The stream may be closed by the time the callback returns.
+  request_cb_(shared_from_this(), request, stream->id);
+}
+
+void Http2Session::Reject(uint32_t id, int code) {
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    return;
+  }
+  it->second->request.reset();
+  HttpResponse response;
+  response.SetStatusCode(code);
+  SubmitResponse(id, &response);
+}
+
+bool Http2Session::Fail(uint32_t code) {
+  if (!goaway_sent_) {
+    goaway_sent_ = true;
+    std::string payload;
+    Append32(last_stream_id_, &payload);
+    Append32(code, &payload);
+    WriteFrameHeader(payload.size(), kGoAway, 0, 0);
+    out_.Append(std::move(payload));
+  }
+  streams_.clear();
+  continuation_id_ = 0;
+  return false;
+}
+
+void Http2Session::Reset(uint32_t id, uint32_t code) {
+  std::string payload;
+  Append32(code, &payload);
+  WriteFrameHeader(payload.size(), kRstStream, 0, id);
+  out_.Append(std::move(payload));
+  streams_.erase(id);
+}
+
+void Http2Session::Close(StreamMap::iterator it) {
+  if (!it->second->remote_closed) {
+    // RFC 7540 8.1, the rest of the request is not needed.
+    Reset(it->first, kNoError);
+    return;
+  }
+  streams_.erase(it);
+}
+
+void Http2Session::SubmitResponse(uint32_t id, HttpResponse* response) {
+  auto it = streams_.find(id);
+  if (it == streams_.end() || it->second->head_sent) {
+    return;
+  }
+  Stream* s = it->second.get();
+  int code = response->StatusCode();
+  bool bodyless = code < 200 || code == 204 || code == 304;
+  bool content_length =
+      !bodyless && !response->Headers().Has(HttpHeaders::kContentLength);
+  if (!bodyless && !s->head_request) {
+    response->TakeBody(&s->pending);
+  }
+  if (s->pending.empty()) {
+    WriteHeaders(s, *response, content_length, true);
+    Close(it);
+  } else {
+    WriteHeaders(s, *response, content_length, false);
+    s->end_pending = true;
+    Pump();
+  }
+  Flush();
+}
+
+void Http2Session::SubmitHead(uint32_t id, const HttpResponse& response) {
+  auto it = streams_.find(id);
+  if (it == streams_.end() || it->second->head_sent) {
+    return;
+  }
+  WriteHeaders(it->second.get(), response, false, false);
+  Flush();
+}
+
+void Http2Session::SubmitData(uint32_t id, OutputChain* data,
+                              bool end_stream) {
+  auto it = streams_.find(id);
+  if (it == streams_.end() || !it->second->head_sent ||
+      it->second->end_pending) {
+    data->Clear();
+    return;
+  }
+  Stream* s = it->second.get();
+  if (s->head_request) {
+    data->Clear();
+  } else {
+    s->pending.Append(data);
+  }
+  s->end_pending = end_stream;
+  Pump();
+  Flush();
+}
+
+void Http2Session::SetDrainCallback(uint32_t id,
+                                    const std::function<void()>& cb) {
+  auto it = streams_.find(id);
+  if (it != streams_.end()) {
+    it->second->drain_cb = cb;
+  }
+}
+
+void Http2Session::WriteFrameHeader(size_t length, uint8_t type,
+                                    uint8_t flags, uint32_t id) {
+  char header[kFrameHeaderSize];
+  header[0] = static_cast<char>(length >> 16);
+  header[1] = static_cast<char>(length >> 8);
+  header[2] = static_cast<char>(length);
+  header[3] = static_cast<char>(type);
+  header[4] = static_cast<char>(flags);
+  header[5] = static_cast<char>(id >> 24);
+  header[6] = static_cast<char>(id >> 16);
+  header[7] = static_cast<char>(id >> 8);
+  header[8] = static_cast<char>(id);
+  out_.Append(header, kFrameHeaderSize);
+}
+
+void Http2Session::WriteHeaders(Stream* stream, const HttpResponse& response,
+                                bool content_length, bool end_stream) {
+  std::string block;
+  encoder_.Begin(&block);
+  encoder_.Encode(":status", std::to_string(response.StatusCode()), &block);
+  const HttpHeaders& headers = response.Headers();
+  if (!headers.Has(HttpHeaders::kDate)) {
+    encoder_.Encode("date", http_date::Now(), &block);
+  }
+  if (content_length) {
+    encoder_.Encode("content-length", std::to_string(response.BodySize()),
+                    &block);
+  }
+  std::string name;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    Slice n(headers.Name(i));
+    name.resize(n.size());
+    for (size_t j = 0; j < n.size(); ++j) {
+      name[j] = static_cast<char>(tolower(static_cast<unsigned char>(n[j])));
+    }
+    if (!ConnectionSpecific(name)) {
+      encoder_.Encode(name, headers.Value(i), &block);
+    }
+  }
+
+  // What does not fit in HEADERS follows in CONTINUATION frames.
+  size_t offset = 0;
+  do {
+    size_t n = std::min(block.size() - offset,
+                        static_cast<size_t>(max_frame_size_));
+    uint8_t flags = offset + n == block.size() ? kEndHeaders : 0;
+    if (offset == 0 && end_stream) {
+      flags |= kEndStream;
+    }
+    WriteFrameHeader(n, offset == 0 ? kHeaders : kContinuation, flags,
+                     stream->id);
+    out_.Append(block.data() + offset, n);
+    offset += n;
+  } while (offset < block.size());
+  stream->head_sent = true;
+}
+
+void Http2Session::WriteWindowUpdate(uint32_t id, uint32_t increment) {
+  std::string payload;
+  Append32(increment, &payload);
+  WriteFrameHeader(payload.size(), kWindowUpdate, 0, id);
+  out_.Append(std::move(payload));
+}
+
+void Http2Session::UpdateWindows() {
+  if (goaway_sent_ || Blocked()) {
+    return;
+  }
+  if (recv_unacked_ > 0 &&
+      recv_unacked_ >= options_.connection_window_size / 2) {
+    WriteWindowUpdate(0, recv_unacked_);
+    recv_window_ += recv_unacked_;
+    recv_unacked_ = 0;
+  }
+  for (auto& it : streams_) {
+    Stream* s = it.second.get();
+    if (!s->remote_closed && s->recv_unacked > 0 &&
+        s->recv_unacked >= options_.initial_window_size / 2) {
+      WriteWindowUpdate(s->id, s->recv_unacked);
+      s->recv_window += s->recv_unacked;
+      s->recv_unacked = 0;
+    }
+  }
+}
+
+void Http2Session::Pump() {
+  // One frame from each stream in turn, so that none of them starves the
+  // others.
+  bool progress = true;
+  while (progress && !Blocked()) {
+    progress = false;
+    for (auto it = streams_.begin(); it != streams_.end() && !Blocked();) {
+      Stream* s = it->second.get();
+      size_t size = s->pending.size();
+      int64_t window = std::min(s->send_window, send_window_);
+      size_t n = std::min(size, static_cast<size_t>(max_frame_size_));
+      if (window < static_cast<int64_t>(n)) {
+        n = window > 0 ? static_cast<size_t>(window) : 0;
+      }
+      if ((size == 0 && !s->end_pending) || (size > 0 && n == 0)) {
+        ++it;
+        continue;
+      }
+      bool last = s->end_pending && n == size;
+      WriteFrameHeader(n, kData, last ? kEndStream : 0, s->id);
+      out_.Append(&s->pending, n);
+      s->send_window -= static_cast<int64_t>(n);
+      send_window_ -= static_cast<int64_t>(n);
+      progress = true;
+      if (last) {
+        Close(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+bool Http2Session::Blocked() const {
+  TcpConnectionPtr ptr(conn_wp_.lock());
+  return ptr && ptr->OutputSize() + out_.size() >= options_.high_water_mark;
+}
+
+void Http2Session::Flush() {
+  if (in_batch_) {
+    return;
+  }
+  TcpConnectionPtr ptr(conn_wp_.lock());
+  if (!ptr) {
+    return;
+  }
+  if (!out_.empty()) {
+    // Not out_ itself, a write which completes at once comes back here.
+    OutputChain out;
+    out.Swap(&out_);
+    ptr->SendMessage(&out);
+  }
+  if ((goaway_sent_ || goaway_received_) && streams_.empty()) {
+    ptr->ShutDown();
+  }
+}
+
+}  // namespace voyager
@@ -0,0 +1,189 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP2_SESSION_H_
+#define VOYAGER_HTTP_HTTP2_SESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "voyager/core/buffer.h"
+#include "voyager/core/output_chain.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/http/hpack.h"
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+struct Http2Options {
+  // Default: 100
+  // The most streams a client may have open at once on a connection.
+  uint32_t max_concurrent_streams;
+
+  // Default: 1024 * 1024
+  // How much of a request body the client may send ahead on a stream.
+  uint32_t initial_window_size;
+
+  // Default: 16 * 1024 * 1024
+  // How much of all the request bodies it may send ahead on a connection.
+  uint32_t connection_window_size;
+
+  // Default: 64 * 1024
+  // Requests with larger headers are answered with 431.
+  uint32_t max_header_list_size;
+
+  // Default: 1024 * 1024
+  // The high water mark of the connection. While more output than this
+  // waits to be written, no DATA frame is added, nor the WINDOW_UPDATE
+  // frames which would let the client send more, until it is written.
+  size_t high_water_mark;
+
+  Http2Options();
+};
+
+// The server end of an HTTP/2 connection over cleartext TCP (RFC 7540): the
+// framing, HPACK, the streams of requests multiplexed over the connection,
+// and the flow control of both directions. The requests are handed out
+// complete, as HttpRequests with version kHttp20, and the HttpResponses to
+// them are sent on their streams with the DATA frames of all the streams
+// interleaved, as far as the windows of the client allow.
+//
+// Only in the loop of the connection, see HttpServer for its use.
+class Http2Session : public std::enable_shared_from_this<Http2Session> {
+ public:
+  typedef std::function<void(const std::shared_ptr<Http2Session>&,
+                             const HttpRequestPtr&, uint32_t)>
+      RequestCallback;
+
+  // What a client with prior knowledge starts with.
+  static const char kPreface[];
+  static const size_t kPrefaceSize = 24;
+
+  Http2Session(const TcpConnectionPtr& ptr, const Http2Options& options,
+               const RequestCallback& cb);
+  ~Http2Session();
+
+  EventLoop* OwnerEventLoop() const { return eventloop_; }
+  const std::weak_ptr<TcpConnection>& Connection() const { return conn_wp_; }
+
+  // Whether an HTTP/1.1 request asks to switch to h2c.
+  static bool Upgradable(const HttpRequest& request);
+
+  // Sends the SETTINGS of the server, the preface of the client is read
+  // next.
+  void Start();
+  // After Start() and the 101 response, request becomes stream 1, with the
+  // settings of its HTTP2-Settings header.
+  void Upgrade(const HttpRequestPtr& request);
+
+  // Handles the frames in buf. A connection error sends GOAWAY and shuts
+  // the connection down.
+  void OnMessage(Buffer* buf);
+  void OnWriteComplete();
+
+  // The head and the body of response, which ends stream id.
+  void SubmitResponse(uint32_t id, HttpResponse* response);
+  // Only the head, the body follows with SubmitData().
+  void SubmitHead(uint32_t id, const HttpResponse& response);
+  // The next piece of the body, end_stream with the last one.
+  void SubmitData(uint32_t id, OutputChain* data, bool end_stream);
+  // Called when everything written so far on the connection has been sent
+  // while stream id still goes on, see
+  // HttpResponseWriter::SetWriteCompleteCallback().
+  void SetDrainCallback(uint32_t id, const std::function<void()>& cb);
+
+  // Streams whose request bodies grow larger are answered with 413.
+  // Default: 4 * 1024 * 1024
+  void SetMaxBodySize(size_t size) { max_body_size_ = size; }
+
+  // Consulted for every new stream. While it returns true, new streams are
+  // reset with REFUSED_STREAM before their requests are read, which the
+  // client may retry, RFC 7540 8.1.4. The streams open go on.
+  void SetRefuseCallback(const std::function<bool()>& cb) { refuse_cb_ = cb; }
+
+  // The streams not closed yet.
+  size_t Streams() const { return streams_.size(); }
+
+ private:
+  struct Stream;
+  typedef std::map<uint32_t, std::unique_ptr<Stream>> StreamMap;
+
+  bool HandleFrame(uint8_t type, uint8_t flags, uint32_t id, Slice payload);
+  bool OnData(uint8_t flags, uint32_t id, Slice payload);
+  bool OnHeaders(uint8_t flags, uint32_t id, Slice payload);
+  bool OnHeaderBlock(uint32_t id, bool end_stream);
+  bool OnSettings(uint8_t flags, const Slice& payload);
+  bool ApplySetting(uint16_t id, uint32_t value);
+  bool OnWindowUpdate(uint32_t id, const Slice& payload);
+  void Dispatch(Stream* stream);
+  // Answers stream id with code, such as 431, instead of handing its
+  // request out.
+  void Reject(uint32_t id, int code);
+
+  // A connection error, false to stop reading.
+  bool Fail(uint32_t code);
+  void Reset(uint32_t id, uint32_t code);
+  void Close(StreamMap::iterator it);
+
+  void WriteFrameHeader(size_t length, uint8_t type, uint8_t flags,
+                        uint32_t id);
+  void WriteHeaders(Stream* stream, const HttpResponse& response,
+                    bool content_length, bool end_stream);
+  void WriteWindowUpdate(uint32_t id, uint32_t increment);
+  // Credits the client with what was received, unless the output is above
+  // the high water mark.
+  void UpdateWindows();
+  // Writes DATA frames from the streams in turn, as far as the windows and
+  // the high water mark allow.
+  void Pump();
+  bool Blocked() const;
+  void Flush();
+
+  std::weak_ptr<TcpConnection> conn_wp_;
+  EventLoop* const eventloop_;
+  const Http2Options options_;
+  RequestCallback request_cb_;
+  std::function<bool()> refuse_cb_;
+  size_t max_body_size_;
+
+  HpackEncoder encoder_;
+  HpackDecoder decoder_;
+  StreamMap streams_;
+  OutputChain out_;
+  // While set, out_ is sent when the frames read are handled.
+  bool in_batch_;
+
+  bool preface_received_;
+  // After either, the streams open are finished and the connection closed.
+  bool goaway_sent_;
+  bool goaway_received_;
+  uint32_t last_stream_id_;
+  // The header block which continues in CONTINUATION frames.
+  uint32_t continuation_id_;
+  bool continuation_end_stream_;
+  std::string header_block_;
+
+  // The settings of the client.
+  uint32_t initial_window_size_;
+  uint32_t max_frame_size_;
+
+  int64_t send_window_;
+  int64_t recv_window_;
+  uint32_t recv_unacked_;
+
+  // No copying allowed
+  Http2Session(const Http2Session&);
+  void operator=(const Http2Session&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP2_SESSION_H_
@@ -0,0 +1,121 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_body_decoder.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "voyager/core/buffer.h"
+
+namespace voyager {
+
+HttpBodyDecoder::HttpBodyDecoder() : state_(kEnd), remaining_(0) {}
+
+void HttpBodyDecoder::SetLength(uint64_t length) {
+  remaining_ = length;
+  state_ = length == 0 ? kEnd : kLength;
+}
+
+void HttpBodyDecoder::SetChunked() {
+  remaining_ = 0;
+  state_ = kChunkSize;
+}
+
+void HttpBodyDecoder::SetUntilClose() {
+  remaining_ = 0;
+  state_ = kUntilClose;
+}
+
+HttpBodyDecoder::Result HttpBodyDecoder::Decode(Buffer* buf, size_t* n) {
+  while (true) {
+    if (state_ == kEnd) {
+      return kDone;
+    } else if (state_ == kUntilClose) {
+      *n = buf->ReadableSize();
+      return *n > 0 ? kData : kNeedMore;
+    } else if (state_ == kLength || state_ == kChunkData) {
+      *n = static_cast<size_t>(
+          std::min<uint64_t>(buf->ReadableSize(), remaining_));
+      if (*n == 0) {
+        return kNeedMore;
+      }
+      remaining_ -= *n;
+      if (remaining_ == 0) {
+        state_ = state_ == kLength ? kEnd : kChunkEnd;
+      }
+      return kData;
+    } else if (state_ == kChunkSize || state_ == kTrailers) {
+      const char* lf = static_cast<const char*>(
+          memchr(buf->Peek(), '\n', buf->ReadableSize()));
+      if (lf == nullptr) {
+        // Chunk extensions and trailers are not worth buffering much of.
+        return buf->ReadableSize() < kMaxLineSize ? kNeedMore : kError;
+      }
+      const char* end = lf;
+      if (end != buf->Peek() && end[-1] == '\r') {
+        --end;
+      }
+      if (state_ == kChunkSize) {
+        if (!ParseChunkSize(buf->Peek(), end)) {
+          return kError;
+        }
+      } else if (end == buf->Peek()) {
+        state_ = kEnd;
+      }
+      buf->RetrieveUntil(lf + 1);
+    } else {
+      // kChunkEnd
+      const char* p = buf->Peek();
+      size_t size = buf->ReadableSize();
+      if (size > 0 && p[0] == '\n') {
+        buf->Retrieve(1);
+        state_ = kChunkSize;
+      } else if (size > 1 && p[0] == '\r' && p[1] == '\n') {
+        buf->Retrieve(2);
+        state_ = kChunkSize;
+      } else {
+        return size == 0 || (size == 1 && p[0] == '\r') ? kNeedMore : kError;
+      }
+    }
+  }
+}
+
+bool HttpBodyDecoder::Close() {
+  if (state_ == kUntilClose) {
+    state_ = kEnd;
+  }
+  return state_ == kEnd;
+}
+
+bool HttpBodyDecoder::ParseChunkSize(const char* begin, const char* end) {
+  uint64_t size = 0;
+  const char* p = begin;
+  for (; p != end; ++p) {
+    int digit;
+    if (*p >= '0' && *p <= '9') {
+      digit = *p - '0';
+    } else if (*p >= 'a' && *p <= 'f') {
+      digit = *p - 'a' + 10;
+    } else if (*p >= 'A' && *p <= 'F') {
+      digit = *p - 'A' + 10;
+    } else {
+      break;
+    }
+    if (size > kMaxBodySize) {
+      return false;
+    }
+    size = size * 16 + static_cast<uint64_t>(digit);
+  }
+  // Extensions after ';' are ignored.
+  if (p == begin || (p != end && *p != ';' && *p != ' ' && *p != '\t')) {
+    return false;
+  }
+  remaining_ = size;
+  state_ = size == 0 ? kTrailers : kChunkData;
+  return true;
+}
+
+}  // namespace voyager
@@ -0,0 +1,64 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_BODY_DECODER_H_
+#define VOYAGER_HTTP_HTTP_BODY_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace voyager {
+
+class Buffer;
+
+// Finds the body of a message at the front of a buffer, delimited by a
+// length, by the chunked transfer coding, or by the end of the connection,
+// for both HttpRequestParser and HttpResponseParser. The framing is
+// consumed here, the body bytes are left for the caller to take.
+class HttpBodyDecoder {
+ public:
+  enum Result { kError, kNeedMore, kData, kDone };
+
+  // Of a chunk size line or a trailer line.
+  static const size_t kMaxLineSize = 4096;
+  static const uint64_t kMaxBodySize = 1ULL << 50;
+
+  HttpBodyDecoder();
+
+  void SetLength(uint64_t length);
+  void SetChunked();
+  // The body runs until the connection closes, see Close().
+  void SetUntilClose();
+  void Reset() { SetLength(0); }
+
+  // Skips the framing at the front of buf. kData: the next *n bytes of buf
+  // are the body, which the caller must retrieve before the next call.
+  Result Decode(Buffer* buf, size_t* n);
+  // The connection closed, which ends a body delimited by it. False if the
+  // body was cut short.
+  bool Close();
+
+  bool Finished() const { return state_ == kEnd; }
+
+ private:
+  enum State {
+    kLength,
+    kUntilClose,
+    kChunkSize,
+    kChunkData,
+    kChunkEnd,
+    kTrailers,
+    kEnd
+  };
+
+  bool ParseChunkSize(const char* begin, const char* end);
+
+  State state_;
+  // Of the body, or of the current chunk, still to be read.
+  uint64_t remaining_;
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_BODY_DECODER_H_
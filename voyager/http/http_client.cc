@@ -8,7 +8,6 @@
 
 #include "voyager/core/eventloop.h"
 #include "voyager/core/sockaddr.h"
-#include "voyager/http/http_response_parser.h"
 #include "voyager/util/logging.h"
 
 namespace voyager {
@@ -34,7 +33,7 @@ void HttpClient::DoHttpRequestInLoop(const HttpRequestPtr& request,
 }
 
 void HttpClient::FirstRequest(const HttpRequestPtr& request) {
-  std::string host(request->Value(HttpMessage::kHost));
+  std::string host(request->Value(HttpHeaders::kHost).ToString());
   uint16_t port = 80;
   size_t found = host.find(":");
   if (found != std::string::npos) {
@@ -50,7 +49,9 @@ void HttpClient::FirstRequest(const HttpRequestPtr& request) {
   client_->SetConnectionCallback([this, request](const TcpConnectionPtr& ptr) {
     eventloop_->RemoveTimer(timer_);
     gaurd_ = ptr;
-    ptr->SetContext(new HttpResponseParser());
+    HttpResponseParser* parser = new HttpResponseParser();
+    parser->SetBodyCallback(body_cb_);
+    ptr->SetContext(parser);
     ptr->SendMessage(&request->RequestMessage());
   });
 
@@ -68,12 +69,14 @@ void HttpClient::HandleMessage(const TcpConnectionPtr& ptr, Buffer* buffer) {
   assert(!queue_cb_.empty());
   HttpResponseParser* parser =
       reinterpret_cast<HttpResponseParser*>(ptr->Context());
-  bool ok = parser->ParseBuffer(buffer);
-  if (!ok) {
-    ptr->ShutDown();
-  }
-
-  if (parser->FinishParse()) {
+  while (!queue_cb_.empty()) {
+    if (!parser->ParseBuffer(buffer)) {
+      ptr->ShutDown();
+      return;
+    }
+    if (!parser->FinishParse()) {
+      return;
+    }
     RequestCallback cb = queue_cb_.front();
     queue_cb_.pop_front();
     cb(parser->GetResponse(), Status::OK());
@@ -84,6 +87,12 @@ void HttpClient::HandleMessage(const TcpConnectionPtr& ptr, Buffer* buffer) {
 void HttpClient::HandleClose(const TcpConnectionPtr& ptr) {
   HttpResponseParser* parser =
       reinterpret_cast<HttpResponseParser*>(ptr->Context());
+  // A body delimited by the end of the connection.
+  if (parser != nullptr && !queue_cb_.empty() && parser->Close()) {
+    RequestCallback cb = queue_cb_.front();
+    queue_cb_.pop_front();
+    cb(parser->GetResponse(), Status::OK());
+  }
   for (CallbackQueue::iterator it = queue_cb_.begin(); it != queue_cb_.end();
        ++it) {
     (*it)(nullptr, Status::NetworkError("Unknow error"));
@@ -13,6 +13,7 @@
 #include "voyager/core/timerlist.h"
 #include "voyager/http/http_request.h"
 #include "voyager/http/http_response.h"
+#include "voyager/http/http_response_parser.h"
 #include "voyager/util/status.h"
 
 namespace voyager {
@@ -25,6 +26,13 @@ class HttpClient {
 
   void DoHttpRequest(const HttpRequestPtr& request, const RequestCallback& cb);
 
+  // Takes the response bodies piece by piece as they arrive, the responses
+  // handed to the RequestCallback are then without them. Set it before the
+  // first request.
+  void SetBodyCallback(const HttpResponseParser::BodyCallback& cb) {
+    body_cb_ = cb;
+  }
+
  private:
   void DoHttpRequestInLoop(const HttpRequestPtr& request,
                            const RequestCallback& cb);
@@ -41,6 +49,7 @@ class HttpClient {
   std::unique_ptr<TcpClient> client_;
   typedef std::deque<RequestCallback> CallbackQueue;
   CallbackQueue queue_cb_;
+  HttpResponseParser::BodyCallback body_cb_;
 
   // No copying allowed
   HttpClient(const HttpClient&);
@@ -0,0 +1,335 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_compression.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#ifdef VOYAGER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+
+namespace voyager {
+
+namespace {
+
+// The q-value of coding in an Accept-Encoding header, that of "*" if it is
+// not listed, -1 if neither is.
+double Quality(const Slice& accept_encoding, const char* coding) {
+  const size_t length = strlen(coding);
+  double wildcard = -1.0;
+  size_t p = 0;
+  while (p < accept_encoding.size()) {
+    size_t end = p;
+    while (end < accept_encoding.size() && accept_encoding[end] != ',') {
+      ++end;
+    }
+    std::string element(accept_encoding.data() + p, end - p);
+    p = end + 1;
+
+    size_t semicolon = element.find(';');
+    std::string name(element, 0, semicolon);
+    size_t begin = name.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+      continue;
+    }
+    size_t n = name.find_last_not_of(" \t") + 1 - begin;
+    double q = 1.0;
+    if (semicolon != std::string::npos) {
+      size_t at = element.find("q=", semicolon);
+      if (at != std::string::npos) {
+        q = atof(element.c_str() + at + 2);
+      }
+    }
+    if (n == length && strncasecmp(name.c_str() + begin, coding, n) == 0) {
+      return q;
+    }
+    if (n == 1 && name[begin] == '*') {
+      wildcard = q;
+    }
+  }
+  return wildcard;
+}
+
+bool Contains(const Slice& s, const char* word) {
+  return std::string(s.data(), s.size()).find(word) != std::string::npos;
+}
+
+}  // namespace
+
+#ifdef VOYAGER_HAVE_ZLIB
+
+struct HttpCompressor::Stream {
+  z_stream z;
+};
+
+bool HttpCompressor::Available() { return true; }
+
+HttpCompressor::HttpCompressor(Coding coding, int level)
+    : stream_(new Stream()) {
+  assert(coding != kIdentity);
+  memset(&stream_->z, 0, sizeof(stream_->z));
+  // 15 bits of window for the zlib format of deflate, plus 16 for gzip.
+  int bits = coding == kGzip ? 15 + 16 : 15;
+  int r = deflateInit2(&stream_->z, level, Z_DEFLATED, bits, 8,
+                       Z_DEFAULT_STRATEGY);
+  assert(r == Z_OK);
+  (void)r;
+}
+
+HttpCompressor::~HttpCompressor() { deflateEnd(&stream_->z); }
+
+void HttpCompressor::Deflate(const Slice& data, int flush, std::string* out) {
+  z_stream* z = &stream_->z;
+  z->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  z->avail_in = static_cast<uInt>(data.size());
+  size_t room = deflateBound(z, static_cast<uLong>(data.size()));
+  do {
+    size_t size = out->size();
+    out->resize(size + room);
+    z->next_out = reinterpret_cast<Bytef*>(&(*out)[size]);
+    z->avail_out = static_cast<uInt>(room);
+    int r = deflate(z, flush);
+    out->resize(size + room - z->avail_out);
+    if (r == Z_STREAM_END || r == Z_BUF_ERROR) {
+      break;
+    }
+  } while (z->avail_out == 0);
+  assert(z->avail_in == 0);
+}
+
+void HttpCompressor::Compress(const Slice& data, std::string* out) {
+  if (!data.empty()) {
+    Deflate(data, Z_NO_FLUSH, out);
+  }
+}
+
+void HttpCompressor::Flush(std::string* out) {
+  Deflate(Slice(), Z_SYNC_FLUSH, out);
+}
+
+void HttpCompressor::Finish(std::string* out) {
+  Deflate(Slice(), Z_FINISH, out);
+}
+
+#else
+
+struct HttpCompressor::Stream {};
+
+bool HttpCompressor::Available() { return false; }
+
+HttpCompressor::HttpCompressor(Coding, int) { assert(Available()); }
+
+HttpCompressor::~HttpCompressor() {}
+
+void HttpCompressor::Deflate(const Slice&, int, std::string*) {}
+
+void HttpCompressor::Compress(const Slice&, std::string*) {}
+
+void HttpCompressor::Flush(std::string*) {}
+
+void HttpCompressor::Finish(std::string*) {}
+
+#endif  // VOYAGER_HAVE_ZLIB
+
+HttpCompressor::Coding HttpCompressor::Negotiate(
+    const Slice& accept_encoding) {
+  if (accept_encoding.empty()) {
+    return kIdentity;
+  }
+  double gzip = Quality(accept_encoding, "gzip");
+  double deflate = Quality(accept_encoding, "deflate");
+  if (gzip <= 0.0 && deflate <= 0.0) {
+    return kIdentity;
+  }
+  return gzip >= deflate ? kGzip : kDeflate;
+}
+
+bool HttpCompressor::Accepts(const Slice& accept_encoding, Coding coding) {
+  return coding == kIdentity || Quality(accept_encoding, Name(coding)) > 0.0;
+}
+
+const char* HttpCompressor::Name(Coding coding) {
+  switch (coding) {
+    case kGzip:
+      return "gzip";
+    case kDeflate:
+      return "deflate";
+    default:
+      return "identity";
+  }
+}
+
+std::string HttpCompressor::Compress(Coding coding, int level,
+                                     const Slice& data) {
+  std::string out;
+  HttpCompressor compressor(coding, level);
+  compressor.Compress(data, &out);
+  compressor.Finish(&out);
+  return out;
+}
+
+HttpCompression::HttpCompression(int level, size_t min_size,
+                                 size_t cache_bytes)
+    : level_(level),
+      min_size_(min_size),
+      cache_bytes_(cache_bytes),
+      cached_bytes_(0) {}
+
+HttpCompression::~HttpCompression() {}
+
+bool HttpCompression::Compressible(const HttpResponse& response) const {
+  int code = response.StatusCode();
+  if (code < 200 || code == 204 || code == 206 || code == 304) {
+    return false;
+  }
+  const HttpHeaders& headers = response.Headers();
+  if (headers.Has(HttpHeaders::kContentEncoding) ||
+      headers.Has(HttpHeaders::kContentRange) ||
+      Contains(headers.Get(HttpHeaders::kCacheControl), "no-transform")) {
+    return false;
+  }
+  Slice type(headers.Get(HttpHeaders::kContentType));
+  if (type.empty()) {
+    return true;
+  }
+  std::string t;
+  for (size_t i = 0; i < type.size() && type[i] != ';'; ++i) {
+    t.push_back(static_cast<char>(tolower(type[i])));
+  }
+  // Images, audio, video and archives are compressed already.
+  return t.compare(0, 5, "text/") == 0 ||
+         t.find("json") != std::string::npos ||
+         t.find("javascript") != std::string::npos ||
+         t.find("xml") != std::string::npos ||
+         t.find("svg") != std::string::npos;
+}
+
+void HttpCompression::Compress(const HttpRequest& request,
+                               HttpCompressor::Coding coding,
+                               HttpResponse* response) {
+  const std::string& body =
+      response->SharedBody() ? *response->SharedBody() : response->Body();
+  if (body.size() < min_size_ || !Compressible(*response)) {
+    return;
+  }
+  MarkVary(response);
+  if (coding == HttpCompressor::kIdentity) {
+    return;
+  }
+
+  std::string key;
+  BodyPtr compressed;
+  if (cache_bytes_ > 0 && Cacheable(*response)) {
+    key = request.Value(HttpHeaders::kHost).ToString();
+    key += request.Path();
+    key += '?';
+    key += request.Query();
+    key += '\n';
+    key += response->Value(HttpHeaders::kETag).ToString();
+    key += '\n';
+    key += HttpCompressor::Name(coding);
+    compressed = Lookup(key);
+  }
+  if (!compressed) {
+    compressed = std::make_shared<const std::string>(
+        HttpCompressor::Compress(coding, level_, body));
+    if (!key.empty()) {
+      Insert(key, compressed);
+    }
+  }
+  if (compressed->size() >= body.size()) {
+    return;
+  }
+  MarkCompressed(coding, response);
+  response->RemoveHeader("Content-Length");
+  response->SetBody(std::string());
+  response->SetSharedBody(compressed);
+}
+
+std::unique_ptr<HttpCompressor> HttpCompression::Start(
+    HttpCompressor::Coding coding, HttpResponse* response) {
+  std::unique_ptr<HttpCompressor> compressor;
+  if (!response->Headers().Has(HttpHeaders::kContentLength) &&
+      Compressible(*response)) {
+    MarkVary(response);
+    if (coding != HttpCompressor::kIdentity) {
+      MarkCompressed(coding, response);
+      compressor.reset(new HttpCompressor(coding, level_));
+    }
+  }
+  return compressor;
+}
+
+size_t HttpCompression::CachedBytes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return cached_bytes_;
+}
+
+void HttpCompression::MarkVary(HttpResponse* response) {
+  std::string vary(response->Value(HttpHeaders::kVary).ToString());
+  if (vary.empty()) {
+    response->AddHeader("Vary", "Accept-Encoding");
+  } else if (vary != "*" && !Contains(vary, "Accept-Encoding") &&
+             !Contains(vary, "accept-encoding")) {
+    response->AddHeader("Vary", vary + ", Accept-Encoding");
+  }
+}
+
+void HttpCompression::MarkCompressed(HttpCompressor::Coding coding,
+                                     HttpResponse* response) {
+  response->AddHeader("Content-Encoding", HttpCompressor::Name(coding));
+  // The compressed bytes differ, so a strong validator becomes a weak one.
+  std::string etag(response->Value(HttpHeaders::kETag).ToString());
+  if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+    response->AddHeader("ETag", "W/" + etag);
+  }
+}
+
+bool HttpCompression::Cacheable(const HttpResponse& response) {
+  Slice cache_control(response.Value(HttpHeaders::kCacheControl));
+  return response.Headers().Has(HttpHeaders::kETag) &&
+         !Contains(cache_control, "no-store") &&
+         !Contains(cache_control, "private");
+}
+
+HttpCompression::BodyPtr HttpCompression::Lookup(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = bodies_.find(key);
+  if (it == bodies_.end()) {
+    return BodyPtr();
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  return it->second.body;
+}
+
+void HttpCompression::Insert(const std::string& key, const BodyPtr& body) {
+  if (body->size() > cache_bytes_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bodies_.find(key) != bodies_.end()) {
+    // Compressed by another loop meanwhile.
+    return;
+  }
+  lru_.push_front(key);
+  Entry entry;
+  entry.body = body;
+  entry.lru = lru_.begin();
+  bodies_.insert(std::make_pair(key, entry));
+  cached_bytes_ += body->size();
+  while (cached_bytes_ > cache_bytes_) {
+    auto it = bodies_.find(lru_.back());
+    cached_bytes_ -= it->second.body->size();
+    bodies_.erase(it);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace voyager
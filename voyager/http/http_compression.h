@@ -0,0 +1,130 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_COMPRESSION_H_
+#define VOYAGER_HTTP_HTTP_COMPRESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// Compresses a body with zlib for the gzip or the deflate content coding,
+// all at once or piece by piece as it is produced.
+class HttpCompressor {
+ public:
+  enum Coding {
+    kIdentity,
+    kGzip,
+    kDeflate,
+  };
+
+  // Whether voyager was built with zlib, nothing can be compressed
+  // otherwise.
+  static bool Available();
+  // The coding a client prefers by its Accept-Encoding header, gzip or
+  // deflate by their q-values and gzip on a tie, kIdentity if it accepts
+  // neither of them.
+  static Coding Negotiate(const Slice& accept_encoding);
+  // Whether accept_encoding allows coding, by name or by "*".
+  static bool Accepts(const Slice& accept_encoding, Coding coding);
+  // The name of coding in Content-Encoding.
+  static const char* Name(Coding coding);
+
+  // level goes from 1, the fastest, to 9, the smallest.
+  HttpCompressor(Coding coding, int level);
+  ~HttpCompressor();
+
+  // Appends what comes out for data, which may be nothing yet.
+  void Compress(const Slice& data, std::string* out);
+  // Appends all that is held back, so the client can decompress everything
+  // given so far.
+  void Flush(std::string* out);
+  // Appends the end of the body, nothing may be given after it.
+  void Finish(std::string* out);
+
+  // The whole of data at once.
+  static std::string Compress(Coding coding, int level, const Slice& data);
+
+ private:
+  struct Stream;
+
+  void Deflate(const Slice& data, int flush, std::string* out);
+
+  std::unique_ptr<Stream> stream_;
+
+  // No copying allowed
+  HttpCompressor(const HttpCompressor&);
+  void operator=(const HttpCompressor&);
+};
+
+// Compresses the responses of a server for the clients which accept it, see
+// HttpServerOptions::compression_level. The compressed bodies of the
+// responses which have an ETag are kept, so a hot resource is compressed
+// once rather than for every request. Safe to use from all the loops of a
+// server at once.
+class HttpCompression {
+ public:
+  HttpCompression(int level, size_t min_size, size_t cache_bytes);
+  ~HttpCompression();
+
+  int Level() const { return level_; }
+  // Whether a response may be compressed at all: its type is worth it, it
+  // is not encoded or partial already and does not forbid it.
+  bool Compressible(const HttpResponse& response) const;
+  // Compresses the body of the response to request with coding, if it is
+  // compressible and at least min_size, and marks the response as varying
+  // by Accept-Encoding.
+  void Compress(const HttpRequest& request, HttpCompressor::Coding coding,
+                HttpResponse* response);
+  // For a body which is streamed instead: the compressor for it, with the
+  // headers to say so added to response, or nullptr if it is sent as it is.
+  std::unique_ptr<HttpCompressor> Start(HttpCompressor::Coding coding,
+                                        HttpResponse* response);
+
+  // The bytes of the compressed bodies kept.
+  size_t CachedBytes();
+
+ private:
+  typedef std::shared_ptr<const std::string> BodyPtr;
+  struct Entry {
+    BodyPtr body;
+    std::list<std::string>::iterator lru;
+  };
+
+  static void MarkVary(HttpResponse* response);
+  static void MarkCompressed(HttpCompressor::Coding coding,
+                             HttpResponse* response);
+  static bool Cacheable(const HttpResponse& response);
+  BodyPtr Lookup(const std::string& key);
+  void Insert(const std::string& key, const BodyPtr& body);
+
+  const int level_;
+  const size_t min_size_;
+  const size_t cache_bytes_;
+
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Entry> bodies_;
+  size_t cached_bytes_;
+
+  // No copying allowed
+  HttpCompression(const HttpCompression&);
+  void operator=(const HttpCompression&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_COMPRESSION_H_
@@ -0,0 +1,119 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_date.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "voyager/core/eventloop.h"
+
+namespace voyager {
+namespace http_date {
+
+namespace {
+
+const size_t kDateSize = 29;
+// Room for any year, though only four digits fit kDateSize.
+const size_t kBufferSize = 64;
+
+const char* const kDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const kMonths[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                               "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// Not strftime(), whose names follow the locale.
+void FormatTo(time_t t, char* buf, size_t size) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  snprintf(buf, size, "%s, %02d %s %04d %02d:%02d:%02d GMT",
+           kDays[tm.tm_wday], tm.tm_mday, kMonths[tm.tm_mon],
+           tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+int ToMonth(const char* name) {
+  for (int i = 0; i < 12; ++i) {
+    if (strcmp(kMonths[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+struct Cache {
+  Cache() : second(-1) {}
+  time_t second;
+  char date[kBufferSize];
+};
+
+thread_local Cache cache;
+
+}  // anonymous namespace
+
+std::string Format(time_t t) {
+  char buf[kBufferSize];
+  FormatTo(t, buf, sizeof(buf));
+  return std::string(buf);
+}
+
+bool Parse(const Slice& s, time_t* t) {
+  char buf[kBufferSize];
+  if (s.size() >= sizeof(buf)) {
+    return false;
+  }
+  memcpy(buf, s.data(), s.size());
+  buf[s.size()] = '\0';
+
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  char month[4];
+  char zone[4];
+  int n = 0;
+  if (sscanf(buf, "%*3s, %2d %3s %4d %2d:%2d:%2d %3s%n", &tm.tm_mday, month,
+             &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, zone,
+             &n) == 7 &&
+      n == static_cast<int>(s.size())) {
+    tm.tm_year -= 1900;
+  } else if (sscanf(buf, "%*[A-Za-z], %2d-%3s-%2d %2d:%2d:%2d %3s%n",
+                    &tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min,
+                    &tm.tm_sec, zone, &n) == 7 &&
+             n == static_cast<int>(s.size())) {
+    // RFC 7231 7.1.1.1, a two digit year which looks more than 50 years
+    // in the future is in the past.
+    if (tm.tm_year < 70) {
+      tm.tm_year += 100;
+    }
+  } else if (sscanf(buf, "%*3s %3s %2d %2d:%2d:%2d %4d%n", month, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &tm.tm_year,
+                    &n) == 6 &&
+             n == static_cast<int>(s.size())) {
+    tm.tm_year -= 1900;
+    strcpy(zone, "GMT");
+  } else {
+    return false;
+  }
+  tm.tm_mon = ToMonth(month);
+  if (tm.tm_mon < 0 || strcmp(zone, "GMT") != 0) {
+    return false;
+  }
+  *t = timegm(&tm);
+  return *t != -1;
+}
+
+Slice Now() {
+  time_t now;
+  EventLoop* loop = EventLoop::RunLoop();
+  if (loop != nullptr && loop->IsInMyLoop() && loop->Now() != 0) {
+    now = static_cast<time_t>(loop->Now() / 1000000);
+  } else {
+    now = time(nullptr);
+  }
+  if (now != cache.second) {
+    FormatTo(now, cache.date, sizeof(cache.date));
+    cache.second = now;
+  }
+  return Slice(cache.date, kDateSize);
+}
+
+}  // namespace http_date
+}  // namespace voyager
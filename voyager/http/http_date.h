@@ -0,0 +1,34 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_DATE_H_
+#define VOYAGER_HTTP_HTTP_DATE_H_
+
+#include <time.h>
+
+#include <string>
+
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// HTTP dates, in the format of RFC 7231 7.1.1.1:
+// "Sun, 06 Nov 1994 08:49:37 GMT".
+namespace http_date {
+
+extern std::string Format(time_t t);
+
+// Also takes the obsolete RFC 850 and asctime() formats, as recipients
+// must. False if s is none of them.
+extern bool Parse(const Slice& s, time_t* t);
+
+// The current date, formatted at most once per second in every thread. In a
+// loop thread the clock is the cached EventLoop::Now(), so serving a
+// response reads no clock at all. Valid until the next call in the thread.
+extern Slice Now();
+
+}  // namespace http_date
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_DATE_H_
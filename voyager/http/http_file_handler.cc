@@ -0,0 +1,413 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_file_handler.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "voyager/http/http_compression.h"
+#include "voyager/http/http_date.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+namespace {
+
+const struct {
+  const char* extension;
+  const char* type;
+} kTypes[] = {
+    {"html", "text/html; charset=utf-8"},
+    {"htm", "text/html; charset=utf-8"},
+    {"css", "text/css; charset=utf-8"},
+    {"js", "application/javascript; charset=utf-8"},
+    {"json", "application/json"},
+    {"txt", "text/plain; charset=utf-8"},
+    {"xml", "application/xml"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"webp", "image/webp"},
+    {"ico", "image/x-icon"},
+    {"pdf", "application/pdf"},
+    {"wasm", "application/wasm"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"mp4", "video/mp4"},
+};
+
+const char* ContentType(const std::string& path) {
+  size_t dot = path.rfind('.');
+  if (dot != std::string::npos && path.find('/', dot) == std::string::npos) {
+    const char* extension = path.c_str() + dot + 1;
+    for (size_t i = 0; i < sizeof(kTypes) / sizeof(kTypes[0]); ++i) {
+      if (strcasecmp(kTypes[i].extension, extension) == 0) {
+        return kTypes[i].type;
+      }
+    }
+  }
+  return "application/octet-stream";
+}
+
+int Hex(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c = static_cast<char>(c | 0x20);
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Decodes the percent escapes of path into an absolute one, false if it
+// may leave the root.
+bool DecodePath(const Slice& path, std::string* result) {
+  result->clear();
+  if (path.empty() || path[0] != '/') {
+    result->push_back('/');
+  }
+  for (size_t i = 0; i < path.size(); ++i) {
+    char c = path[i];
+    if (c == '%') {
+      int high = i + 2 < path.size() ? Hex(path[i + 1]) : -1;
+      int low = i + 2 < path.size() ? Hex(path[i + 2]) : -1;
+      if (high < 0 || low < 0) {
+        return false;
+      }
+      c = static_cast<char>(high * 16 + low);
+      i += 2;
+    }
+    if (c == '\0') {
+      return false;
+    }
+    result->push_back(c);
+  }
+  // No "." or ".." segment.
+  for (size_t i = 0; i < result->size(); ++i) {
+    if ((*result)[i] == '/' && i + 1 < result->size() &&
+        (*result)[i + 1] == '.') {
+      size_t end = i + 2;
+      if (end < result->size() && (*result)[end] == '.') {
+        ++end;
+      }
+      if (end == result->size() || (*result)[end] == '/') {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The next element of a comma separated list, trimmed, from *p on.
+Slice NextElement(const Slice& list, size_t* p) {
+  size_t begin = *p;
+  while (begin < list.size() && (list[begin] == ' ' || list[begin] == '\t' ||
+                                 list[begin] == ',')) {
+    ++begin;
+  }
+  size_t end = begin;
+  while (end < list.size() && list[end] != ',') {
+    ++end;
+  }
+  *p = end;
+  while (end > begin && (list[end - 1] == ' ' || list[end - 1] == '\t')) {
+    --end;
+  }
+  return Slice(list.data() + begin, end - begin);
+}
+
+// Whether the If-None-Match list holds etag, by the weak comparison.
+bool MatchesETag(const Slice& list, const std::string& etag) {
+  size_t p = 0;
+  while (p < list.size()) {
+    Slice element(NextElement(list, &p));
+    if (element == "*") {
+      return true;
+    }
+    if (element.starts_with("W/")) {
+      element.remove_prefix(2);
+    }
+    if (element == etag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+enum RangeResult { kNoRange, kRange, kUnsatisfiable };
+
+// A single "bytes=" range of a file of size bytes. Several ranges, or any
+// which is not understood, are ignored and the whole file is sent.
+RangeResult ParseRange(const Slice& range, size_t size, size_t* begin,
+                       size_t* length) {
+  if (!range.starts_with("bytes=")) {
+    return kNoRange;
+  }
+  std::string spec(range.data() + 6, range.size() - 6);
+  if (spec.find(',') != std::string::npos) {
+    return kNoRange;
+  }
+  size_t dash = spec.find('-');
+  if (dash == std::string::npos ||
+      spec.find_first_not_of("0123456789-") != std::string::npos) {
+    return kNoRange;
+  }
+  std::string first(spec, 0, dash);
+  std::string last(spec, dash + 1);
+  if (first.empty()) {
+    // The last bytes.
+    if (last.empty()) {
+      return kNoRange;
+    }
+    unsigned long long n = strtoull(last.c_str(), nullptr, 10);
+    if (n == 0 || size == 0) {
+      return kUnsatisfiable;
+    }
+    *length = n < size ? static_cast<size_t>(n) : size;
+    *begin = size - *length;
+    return kRange;
+  }
+  unsigned long long from = strtoull(first.c_str(), nullptr, 10);
+  if (from >= size) {
+    return kUnsatisfiable;
+  }
+  unsigned long long to = size - 1;
+  if (!last.empty()) {
+    to = strtoull(last.c_str(), nullptr, 10);
+    if (to < from) {
+      return kNoRange;
+    }
+    if (to >= size) {
+      to = size - 1;
+    }
+  }
+  *begin = static_cast<size_t>(from);
+  *length = static_cast<size_t>(to - from + 1);
+  return kRange;
+}
+
+}  // anonymous namespace
+
+HttpFileOptions::HttpFileOptions()
+    : index("index.html"),
+      max_open_files(1024),
+      revalidate_micros(1000 * 1000),
+      precompressed(true) {}
+
+struct HttpFileHandler::File {
+  File() : fd(-1), size(0), mtime(0), ino(0) {}
+  ~File() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  // -1 for a path which is no regular file.
+  int fd;
+  size_t size;
+  time_t mtime;
+  ino_t ino;
+  std::string etag;
+  std::string last_modified;
+};
+
+HttpFileHandler::HttpFileHandler(const std::string& root,
+                                 const HttpFileOptions& options)
+    : root_(root), options_(options) {}
+
+HttpFileHandler::~HttpFileHandler() {}
+
+void HttpFileHandler::Handle(const HttpRequestPtr& request,
+                             HttpResponse* response) {
+  Serve(request, request->Path(), response);
+}
+
+void HttpFileHandler::Serve(const HttpRequestPtr& request, const Slice& path,
+                            HttpResponse* response) {
+  response->SetVersion(request->Version());
+  HttpRequest::Method method = request->GetMethod();
+  if (method != HttpRequest::kGet && method != HttpRequest::kHead) {
+    response->SetStatusCode(405);
+    response->AddHeader("Allow", "GET, HEAD");
+    return;
+  }
+
+  std::string name;
+  if (!DecodePath(path, &name)) {
+    response->SetStatusCode(404);
+    return;
+  }
+  if (name[name.size() - 1] == '/') {
+    name += options_.index;
+  }
+  std::string full(root_ + name);
+  FilePtr file(Open(full));
+  if (!file) {
+    response->SetStatusCode(404);
+    return;
+  }
+
+  if (options_.precompressed) {
+    FilePtr gz(Open(full + ".gz"));
+    if (gz) {
+      response->AddHeader("Vary", "Accept-Encoding");
+      if (HttpCompressor::Accepts(
+              request->Value(HttpHeaders::kAcceptEncoding),
+              HttpCompressor::kGzip)) {
+        response->AddHeader("Content-Encoding", "gzip");
+        file = gz;
+      }
+    }
+  }
+
+  response->AddHeader("Content-Type", ContentType(name));
+  response->AddHeader("Last-Modified", file->last_modified);
+  response->AddHeader("ETag", file->etag);
+  response->AddHeader("Accept-Ranges", "bytes");
+
+  // RFC 7232 6, If-Modified-Since only counts without If-None-Match.
+  bool not_modified;
+  Slice none_match(request->Value(HttpHeaders::kIfNoneMatch));
+  if (!none_match.empty()) {
+    not_modified = MatchesETag(none_match, file->etag);
+  } else {
+    time_t since;
+    not_modified =
+        http_date::Parse(request->Value(HttpHeaders::kIfModifiedSince),
+                         &since) &&
+        file->mtime <= since;
+  }
+  if (not_modified) {
+    response->SetStatusCode(304);
+    return;
+  }
+
+  size_t begin = 0;
+  size_t length = file->size;
+  Slice range(request->Value(HttpHeaders::kRange));
+  Slice if_range(request->Value(HttpHeaders::kIfRange));
+  if (!range.empty() && method == HttpRequest::kGet &&
+      (if_range.empty() || if_range == file->etag ||
+       if_range == file->last_modified)) {
+    RangeResult result = ParseRange(range, file->size, &begin, &length);
+    if (result == kUnsatisfiable) {
+      response->SetStatusCode(416);
+      response->AddHeader("Content-Range",
+                          "bytes */" + std::to_string(file->size));
+      return;
+    }
+    if (result == kRange) {
+      response->SetStatusCode(206);
+      response->AddHeader("Content-Range",
+                          "bytes " + std::to_string(begin) + "-" +
+                              std::to_string(begin + length - 1) + "/" +
+                              std::to_string(file->size));
+    }
+  }
+
+  response->AddHeader("Content-Length", std::to_string(length));
+  if (method == HttpRequest::kGet) {
+    response->SetFileBody(file->fd, static_cast<off_t>(begin), length, file);
+  }
+}
+
+size_t HttpFileHandler::CachedFiles() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return files_.size();
+}
+
+HttpFileHandler::FilePtr HttpFileHandler::Open(const std::string& path) {
+  uint64_t now = timeops::MonotonicMicros();
+  FilePtr cached;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(path);
+    if (it != files_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      cached = it->second.file;
+      if (now - it->second.checked < options_.revalidate_micros) {
+        return cached->fd >= 0 ? cached : FilePtr();
+      }
+    }
+  }
+
+  // Outside of the lock, the other loops go on meanwhile.
+  if (cached) {
+    struct stat st;
+    bool regular = ::stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+    bool same = cached->fd >= 0
+                    ? regular && st.st_ino == cached->ino &&
+                          st.st_mtime == cached->mtime &&
+                          static_cast<size_t>(st.st_size) == cached->size
+                    : !regular;
+    if (same) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = files_.find(path);
+      if (it != files_.end()) {
+        it->second.checked = now;
+      }
+      return cached->fd >= 0 ? cached : FilePtr();
+    }
+  }
+  FilePtr file(Load(path));
+  Insert(path, file, now);
+  return file->fd >= 0 ? file : FilePtr();
+}
+
+HttpFileHandler::FilePtr HttpFileHandler::Load(const std::string& path) {
+  std::shared_ptr<File> file(new File());
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return file;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return file;
+  }
+  file->fd = fd;
+  file->size = static_cast<size_t>(st.st_size);
+  file->mtime = st.st_mtime;
+  file->ino = st.st_ino;
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%llx-%zx\"",
+           static_cast<unsigned long long>(st.st_mtime), file->size);
+  file->etag = etag;
+  file->last_modified = http_date::Format(st.st_mtime);
+  return file;
+}
+
+void HttpFileHandler::Insert(const std::string& path, const FilePtr& file,
+                             uint64_t now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = files_.find(path);
+  if (it != files_.end()) {
+    // Responses still sending the old one keep it open.
+    it->second.file = file;
+    it->second.checked = now;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    return;
+  }
+  lru_.push_front(path);
+  Slot slot;
+  slot.file = file;
+  slot.checked = now;
+  slot.lru = lru_.begin();
+  files_.insert(std::make_pair(path, slot));
+  while (files_.size() > options_.max_open_files) {
+    files_.erase(lru_.back());
+    lru_.pop_back();
+  }
+}
+
+}  // namespace voyager
@@ -0,0 +1,100 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_FILE_HANDLER_H_
+#define VOYAGER_HTTP_HTTP_FILE_HANDLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+struct HttpFileOptions {
+  // Default: "index.html"
+  // Served for a path which ends with '/'.
+  std::string index;
+
+  // Default: 1024
+  // The most files kept open, with their stat() results, least recently
+  // used first out. Missing files are remembered as well.
+  size_t max_open_files;
+
+  // Default: 1000 * 1000 microseconds
+  // How long a cached file is trusted before it is stat()ed again.
+  uint64_t revalidate_micros;
+
+  // Default: true
+  // Serves "name.gz" in place of "name" to the clients which accept gzip.
+  bool precompressed;
+
+  HttpFileOptions();
+};
+
+// Serves the files under a directory. The body goes from the file to the
+// socket with sendfile(), so a download neither copies through user space
+// nor allocates by the size of the file. It answers conditional requests
+// (If-None-Match, If-Modified-Since) with 304, and a single byte range
+// (Range, If-Range) with 206:
+//
+//   HttpFileHandler files("/var/www", HttpFileOptions());
+//   server.SetHttpCallback(std::bind(&HttpFileHandler::Handle, &files,
+//                                    std::placeholders::_1,
+//                                    std::placeholders::_2));
+//
+// Safe to use from all the loops of a server at once.
+class HttpFileHandler {
+ public:
+  HttpFileHandler(const std::string& root, const HttpFileOptions& options);
+  ~HttpFileHandler();
+
+  // Serves the path of the request.
+  void Handle(const HttpRequestPtr& request, HttpResponse* response);
+  // Serves path under the root, such as the rest matched by an HttpRouter,
+  // with or without a leading '/'.
+  void Serve(const HttpRequestPtr& request, const Slice& path,
+             HttpResponse* response);
+
+  // The files cached, open or missing.
+  size_t CachedFiles();
+
+ private:
+  struct File;
+  typedef std::shared_ptr<const File> FilePtr;
+  struct Slot {
+    FilePtr file;
+    uint64_t checked;
+    std::list<std::string>::iterator lru;
+  };
+
+  // The cached file at the full path, nullptr if it is not a regular file.
+  FilePtr Open(const std::string& path);
+  static FilePtr Load(const std::string& path);
+  void Insert(const std::string& path, const FilePtr& file, uint64_t now);
+
+  const std::string root_;
+  const HttpFileOptions options_;
+
+  std::mutex mutex_;
+  // Most recently used first.
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Slot> files_;
+
+  // No copying allowed
+  HttpFileHandler(const HttpFileHandler&);
+  void operator=(const HttpFileHandler&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_FILE_HANDLER_H_
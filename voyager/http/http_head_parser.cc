@@ -0,0 +1,249 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_head_parser.h"
+
+#include <string.h>
+#include <strings.h>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#include <string>
+
+namespace voyager {
+
+namespace {
+
+// The first of [p, end) which is a or b, or end. Lines are short, so the
+// vector loops fall through to narrower ones for their tails.
+inline const char* FindAny(const char* p, const char* end, char a, char b) {
+#if defined(__AVX2__)
+  const __m256i va = _mm256_set1_epi8(a);
+  const __m256i vb = _mm256_set1_epi8(b);
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb))));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+#endif
+#if defined(__SSE4_2__)
+  const __m128i set = _mm_setr_epi8(a, b, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                    0, 0);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int i = _mm_cmpestri(set, 2, v, 16,
+                         _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY |
+                             _SIDD_LEAST_SIGNIFICANT);
+    if (i != 16) {
+      return p + i;
+    }
+    p += 16;
+  }
+#endif
+  while (p != end && *p != a && *p != b) {
+    ++p;
+  }
+  return p;
+}
+
+inline bool IsBlank(char c) { return c == ' ' || c == '\t'; }
+
+bool ToMethod(const char* begin, size_t size, HttpRequest::Method* method) {
+  static const struct {
+    const char* name;
+    size_t size;
+    HttpRequest::Method method;
+  } kMethods[] = {
+      {"GET", 3, HttpRequest::kGet},         {"POST", 4, HttpRequest::kPost},
+      {"PUT", 3, HttpRequest::kPut},         {"HEAD", 4, HttpRequest::kHead},
+      {"DELETE", 6, HttpRequest::kDelete},   {"PATCH", 5, HttpRequest::kPatch},
+      {"OPTIONS", 7, HttpRequest::kOptions}, {"TRACE", 5, HttpRequest::kTrace},
+      {"CONNECT", 7, HttpRequest::kConnect},
+  };
+  for (size_t i = 0; i < sizeof(kMethods) / sizeof(kMethods[0]); ++i) {
+    if (kMethods[i].size == size &&
+        memcmp(kMethods[i].name, begin, size) == 0) {
+      *method = kMethods[i].method;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+HttpHeadParser::HttpHeadParser() { Reset(); }
+
+void HttpHeadParser::Reset() {
+  base_ = nullptr;
+  scanned_ = 0;
+  head_size_ = 0;
+  method_ = HttpRequest::kGet;
+  version_ = HttpMessage::kHttp11;
+  method_name_ = path_ = query_ = Span();
+  header_count_ = 0;
+}
+
+HttpHeadParser::Result HttpHeadParser::Parse(const char* data, size_t size) {
+  base_ = data;
+  const char* end = data + size;
+
+  // Empty lines ahead of the request line are ignored, RFC 7230 3.5.
+  const char* begin = data;
+  while (begin != end && (*begin == '\r' || *begin == '\n')) {
+    if (*begin == '\r' && (begin + 1 == end || begin[1] != '\n')) {
+      return begin + 1 == end ? kIncomplete : kError;
+    }
+    begin += *begin == '\r' ? 2 : 1;
+  }
+  if (begin == end) {
+    return kIncomplete;
+  }
+
+  // The head ends at "\n\r\n" or "\n\n".
+  const char* p = data + scanned_;
+  if (p < begin) {
+    p = begin;
+  }
+  const char* head_end = nullptr;
+  while ((p = FindAny(p, end, '\n', '\n')) != end) {
+    if (p + 1 != end && p[1] == '\n') {
+      head_end = p + 2;
+      break;
+    }
+    if (p + 2 < end && p[1] == '\r' && p[2] == '\n') {
+      head_end = p + 3;
+      break;
+    }
+    ++p;
+  }
+  if (head_end == nullptr) {
+    if (size > kMaxHeadSize) {
+      return kError;
+    }
+    scanned_ = size < 2 ? 0 : size - 2;
+    return kIncomplete;
+  }
+  if (static_cast<size_t>(head_end - data) > kMaxHeadSize) {
+    return kError;
+  }
+
+  header_count_ = 0;
+  bool first = true;
+  p = begin;
+  while (true) {
+    const char* eol = FindAny(p, head_end, '\r', '\n');
+    if (*eol == '\r' && eol[1] != '\n') {
+      return kError;
+    }
+    if (eol == p) {
+      break;
+    }
+    bool ok = first ? ParseRequestLine(p, eol) : ParseHeader(p, eol);
+    if (!ok) {
+      return kError;
+    }
+    first = false;
+    p = eol + (*eol == '\r' ? 2 : 1);
+  }
+  head_size_ = static_cast<size_t>(head_end - data);
+  return kComplete;
+}
+
+HttpHeadParser::Span HttpHeadParser::MakeSpan(const char* begin,
+                                              const char* end) const {
+  Span span;
+  span.offset = static_cast<uint32_t>(begin - base_);
+  span.size = static_cast<uint32_t>(end - begin);
+  return span;
+}
+
+bool HttpHeadParser::ParseRequestLine(const char* begin, const char* end) {
+  const char* sp = FindAny(begin, end, ' ', ' ');
+  if (sp == end || !ToMethod(begin, static_cast<size_t>(sp - begin), &method_)) {
+    return false;
+  }
+  method_name_ = MakeSpan(begin, sp);
+
+  const char* target = sp + 1;
+  const char* p = FindAny(target, end, ' ', '?');
+  if (p == end || p == target) {
+    return false;
+  }
+  path_ = MakeSpan(target, p);
+  query_ = Span();
+  if (*p == '?') {
+    const char* q = p + 1;
+    p = FindAny(q, end, ' ', ' ');
+    if (p == end) {
+      return false;
+    }
+    query_ = MakeSpan(q, p);
+  }
+
+  const char* version = p + 1;
+  if (end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0) {
+    return false;
+  }
+  if (version[7] == '1') {
+    version_ = HttpMessage::kHttp11;
+  } else if (version[7] == '0') {
+    version_ = HttpMessage::kHttp10;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool HttpHeadParser::ParseHeader(const char* begin, const char* end) {
+  // Obsolete line folding is rejected, RFC 7230 3.2.4.
+  if (IsBlank(*begin) || header_count_ == kMaxHeaders) {
+    return false;
+  }
+  const char* colon = FindAny(begin, end, ':', ' ');
+  if (colon == end || *colon != ':' || colon == begin) {
+    return false;
+  }
+  const char* value = colon + 1;
+  while (value != end && IsBlank(*value)) {
+    ++value;
+  }
+  while (end != value && IsBlank(end[-1])) {
+    --end;
+  }
+  Field* field = &headers_[header_count_++];
+  field->name = MakeSpan(begin, colon);
+  field->value = MakeSpan(value, end);
+  return true;
+}
+
+Slice HttpHeadParser::Header(const Slice& name) const {
+  for (size_t i = 0; i < header_count_; ++i) {
+    const Span& span = headers_[i].name;
+    if (span.size == name.size() &&
+        strncasecmp(base_ + span.offset, name.data(), name.size()) == 0) {
+      return Get(headers_[i].value);
+    }
+  }
+  return Slice();
+}
+
+void HttpHeadParser::ToRequest(HttpRequest* request) const {
+  request->SetMethod(method_);
+  request->SetVersion(version_);
+  Slice path(Path());
+  request->SetPath(path.data(), path.data() + path.size());
+  Slice query(Query());
+  request->SetQuery(query.data(), query.data() + query.size());
+  for (size_t i = 0; i < header_count_; ++i) {
+    request->MutableHeaders()->Add(HeaderName(i), HeaderValue(i));
+  }
+}
+
+}  // namespace voyager
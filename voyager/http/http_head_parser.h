@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_HEAD_PARSER_H_
+#define VOYAGER_HTTP_HTTP_HEAD_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "voyager/http/http_request.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// Parses the request line and the headers of an HTTP/1.x request in place.
+// The delimiters are found with SSE4.2 or AVX2 when the build enables them,
+// and the parts are only recorded as offsets into the parsed bytes, so
+// nothing is copied or allocated until ToRequest():
+//
+//   HttpHeadParser head;
+//   if (head.Parse(buf->Peek(), buf->ReadableSize()) ==
+//       HttpHeadParser::kComplete) {
+//     Slice host = head.Header("Host");
+//     ...
+//     buf->Retrieve(head.HeadSize());
+//   }
+//
+// The Slices point into the parsed bytes and are valid until the buffer is
+// retrieved from or appended to.
+class HttpHeadParser {
+ public:
+  static const size_t kMaxHeaders = 64;
+  static const size_t kMaxHeadSize = 64 * 1024;
+
+  enum Result { kComplete, kIncomplete, kError };
+
+  HttpHeadParser();
+
+  // Call again with the same data and more bytes appended while the head is
+  // kIncomplete, the bytes already searched are not searched again. Reset()
+  // before parsing the next request.
+  Result Parse(const char* data, size_t size);
+  void Reset();
+
+  // The bytes of the head, including leading empty lines and the empty line
+  // which ends it.
+  size_t HeadSize() const { return head_size_; }
+
+  HttpRequest::Method GetMethod() const { return method_; }
+  HttpMessage::HttpVersion Version() const { return version_; }
+  Slice MethodName() const { return Get(method_name_); }
+  Slice Path() const { return Get(path_); }
+  // Without the '?'.
+  Slice Query() const { return Get(query_); }
+
+  size_t HeaderCount() const { return header_count_; }
+  Slice HeaderName(size_t i) const { return Get(headers_[i].name); }
+  Slice HeaderValue(size_t i) const { return Get(headers_[i].value); }
+  // The value of the first header named name, ignoring case, or an empty
+  // Slice.
+  Slice Header(const Slice& name) const;
+
+  // Copies the head into request.
+  void ToRequest(HttpRequest* request) const;
+
+ private:
+  struct Span {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Field {
+    Span name;
+    Span value;
+  };
+
+  Slice Get(const Span& span) const {
+    return Slice(base_ + span.offset, span.size);
+  }
+  Span MakeSpan(const char* begin, const char* end) const;
+
+  bool ParseRequestLine(const char* begin, const char* end);
+  bool ParseHeader(const char* begin, const char* end);
+
+  const char* base_;
+  size_t scanned_;
+  size_t head_size_;
+  HttpRequest::Method method_;
+  HttpMessage::HttpVersion version_;
+  Span method_name_;
+  Span path_;
+  Span query_;
+  size_t header_count_;
+  Field headers_[kMaxHeaders];
+
+  // No copying allowed
+  HttpHeadParser(const HttpHeadParser&);
+  void operator=(const HttpHeadParser&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_HEAD_PARSER_H_
@@ -0,0 +1,325 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_headers.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <string>
+
+namespace voyager {
+
+namespace {
+
+const char* const kNames[HttpHeaders::kNumIds] = {
+    "",
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Ranges",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Host",
+    "HTTP2-Settings",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Keep-Alive",
+    "Last-Modified",
+    "Location",
+    "Origin",
+    "Range",
+    "Referer",
+    "Server",
+    "Set-Cookie",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+    "X-Forwarded-For",
+};
+
+const size_t kMaxNameSize = 24;
+// The names of a bucket and the 0 which ends them.
+const size_t kBucketSize = 4;
+
+// The interned names by their size and their last letter, most buckets
+// hold one name.
+class IdTable {
+ public:
+  IdTable() {
+    memset(buckets_, 0, sizeof(buckets_));
+    for (int i = 1; i < HttpHeaders::kNumIds; ++i) {
+      size_t size = strlen(kNames[i]);
+      unsigned char* bucket = buckets_[size][Hash(kNames[i][size - 1])];
+      unsigned char* ids = bucket;
+      while (*ids != 0) {
+        ++ids;
+      }
+      // A new name which collides with three others needs a larger
+      // kBucketSize, or Find() would run into the next bucket.
+      if (ids - bucket >= static_cast<ptrdiff_t>(kBucketSize - 1)) {
+        abort();
+      }
+      *ids = static_cast<unsigned char>(i);
+    }
+  }
+
+  HttpHeaders::Id Find(const Slice& name) const {
+    if (name.empty() || name.size() > kMaxNameSize) {
+      return HttpHeaders::kOther;
+    }
+    const unsigned char* ids =
+        buckets_[name.size()][Hash(name[name.size() - 1])];
+    for (; *ids != 0; ++ids) {
+      if (strncasecmp(kNames[*ids], name.data(), name.size()) == 0) {
+        return static_cast<HttpHeaders::Id>(*ids);
+      }
+    }
+    return HttpHeaders::kOther;
+  }
+
+ private:
+  static size_t Hash(char c) { return static_cast<size_t>(c | 0x20) & 7; }
+
+  unsigned char buckets_[kMaxNameSize + 1][8][kBucketSize];
+};
+
+const IdTable kIdTable;
+
+}  // anonymous namespace
+
+HttpHeaders::HttpHeaders()
+    : size_(0),
+      bytes_(inline_bytes_),
+      used_(0),
+      garbage_(0),
+      capacity_(kInlineBytes) {
+  memset(first_, -1, sizeof(first_));
+}
+
+HttpHeaders::HttpHeaders(const HttpHeaders& other)
+    : size_(0),
+      bytes_(inline_bytes_),
+      used_(0),
+      garbage_(0),
+      capacity_(kInlineBytes) {
+  memset(first_, -1, sizeof(first_));
+  *this = other;
+}
+
+HttpHeaders& HttpHeaders::operator=(const HttpHeaders& other) {
+  if (this != &other) {
+    Clear();
+    for (size_t i = 0; i < other.size(); ++i) {
+      Add(other.Name(i), other.Value(i));
+    }
+  }
+  return *this;
+}
+
+HttpHeaders::Id HttpHeaders::ToId(const Slice& name) {
+  return kIdTable.Find(name);
+}
+
+const char* HttpHeaders::Name(Id id) { return kNames[id]; }
+
+bool HttpHeaders::EqualsIgnoreCase(const Slice& a, const Slice& b) {
+  return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+void HttpHeaders::Add(const Slice& name, const Slice& value) {
+  size_t size = used_ + name.size() + value.size();
+  if (size > capacity_) {
+    // name and value may be our own Slices, which Compact() and Grow()
+    // move.
+    std::string copy(name.data(), name.size());
+    copy.append(value.data(), value.size());
+    Compact();
+    if (used_ + copy.size() > capacity_) {
+      Grow(used_ + copy.size());
+    }
+    Add(Slice(copy.data(), name.size()),
+        Slice(copy.data() + name.size(), value.size()));
+    return;
+  }
+  Entry entry;
+  entry.name = Store(name);
+  entry.name_size = static_cast<uint32_t>(name.size());
+  entry.value = Store(value);
+  entry.value_size = static_cast<uint32_t>(value.size());
+  entry.id = ToId(name);
+  if (size_ < kInlineHeaders) {
+    entries_[size_] = entry;
+  } else {
+    more_.push_back(entry);
+  }
+  if (entry.id != kOther && first_[entry.id] < 0) {
+    first_[entry.id] = static_cast<int16_t>(size_);
+  }
+  ++size_;
+}
+
+void HttpHeaders::Set(const Slice& name, const Slice& value) {
+  // A single header whose value the new one fits into is overwritten where
+  // it is, which is how a value is usually replaced.
+  Id id = ToId(name);
+  size_t found = size_;
+  size_t count = 0;
+  if (id == kOther || first_[id] >= 0) {
+    for (size_t i = 0; i < size_; ++i) {
+      if (At(i).id == id && (id != kOther || EqualsIgnoreCase(Name(i), name))) {
+        found = i;
+        ++count;
+      }
+    }
+  }
+  if (count == 1 && value.size() <= At(found).value_size) {
+    Entry& entry = At(found);
+    // value may be a Slice of our own.
+    memmove(bytes_ + entry.value, value.data(), value.size());
+    garbage_ += entry.value_size - value.size();
+    entry.value_size = static_cast<uint32_t>(value.size());
+    return;
+  }
+  // Without compacting, name and value may be Slices of our own.
+  RemoveAll(name);
+  Add(name, value);
+}
+
+void HttpHeaders::Remove(const Slice& name) {
+  if (RemoveAll(name) && garbage_ > used_ / 2) {
+    Compact();
+  }
+}
+
+bool HttpHeaders::RemoveAll(const Slice& name) {
+  Id id = ToId(name);
+  if (id != kOther && first_[id] < 0) {
+    return false;
+  }
+  size_t i = 0;
+  bool removed = false;
+  while (i < size_) {
+    const Entry& entry = At(i);
+    if (entry.id == id && (id != kOther || EqualsIgnoreCase(Name(i), name))) {
+      RemoveAt(i);
+      removed = true;
+    } else {
+      ++i;
+    }
+  }
+  if (removed) {
+    Reindex();
+  }
+  return removed;
+}
+
+void HttpHeaders::Clear() {
+  size_ = 0;
+  more_.clear();
+  used_ = 0;
+  garbage_ = 0;
+  memset(first_, -1, sizeof(first_));
+}
+
+Slice HttpHeaders::Get(Id id) const {
+  int i = first_[id];
+  return i < 0 ? Slice() : Value(static_cast<size_t>(i));
+}
+
+Slice HttpHeaders::Get(const Slice& name) const {
+  Id id = ToId(name);
+  if (id != kOther) {
+    return Get(id);
+  }
+  for (size_t i = 0; i < size_; ++i) {
+    if (At(i).id == kOther && EqualsIgnoreCase(Name(i), name)) {
+      return Value(i);
+    }
+  }
+  return Slice();
+}
+
+Slice HttpHeaders::Name(size_t i) const {
+  const Entry& entry = At(i);
+  return Slice(bytes_ + entry.name, entry.name_size);
+}
+
+Slice HttpHeaders::Value(size_t i) const {
+  const Entry& entry = At(i);
+  return Slice(bytes_ + entry.value, entry.value_size);
+}
+
+void HttpHeaders::Grow(size_t size) {
+  size_t capacity = capacity_ * 2;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  std::unique_ptr<char[]> bytes(new char[capacity]);
+  memcpy(bytes.get(), bytes_, used_);
+  heap_bytes_.swap(bytes);
+  bytes_ = heap_bytes_.get();
+  capacity_ = capacity;
+}
+
+uint32_t HttpHeaders::Store(const Slice& s) {
+  uint32_t offset = static_cast<uint32_t>(used_);
+  memcpy(bytes_ + used_, s.data(), s.size());
+  used_ += s.size();
+  return offset;
+}
+
+void HttpHeaders::Compact() {
+  if (garbage_ == 0) {
+    return;
+  }
+  // The entries are stored in their order, so the bytes only move down.
+  size_t used = 0;
+  for (size_t i = 0; i < size_; ++i) {
+    Entry& entry = At(i);
+    memmove(bytes_ + used, bytes_ + entry.name, entry.name_size);
+    entry.name = static_cast<uint32_t>(used);
+    used += entry.name_size;
+    memmove(bytes_ + used, bytes_ + entry.value, entry.value_size);
+    entry.value = static_cast<uint32_t>(used);
+    used += entry.value_size;
+  }
+  used_ = used;
+  garbage_ = 0;
+}
+
+void HttpHeaders::RemoveAt(size_t i) {
+  garbage_ += At(i).name_size + At(i).value_size;
+  for (size_t j = i + 1; j < size_; ++j) {
+    At(j - 1) = At(j);
+  }
+  --size_;
+  if (size_ >= kInlineHeaders) {
+    more_.pop_back();
+  }
+}
+
+void HttpHeaders::Reindex() {
+  memset(first_, -1, sizeof(first_));
+  for (size_t i = size_; i-- > 0;) {
+    Id id = At(i).id;
+    if (id != kOther) {
+      first_[id] = static_cast<int16_t>(i);
+    }
+  }
+}
+
+}  // namespace voyager
@@ -0,0 +1,142 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_HEADERS_H_
+#define VOYAGER_HTTP_HTTP_HEADERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// The headers of a message in their order, as a flat array of entries which
+// point into one byte arena. The first kInlineHeaders entries and
+// kInlineBytes bytes live inside the object, so the headers of most
+// messages allocate nothing. Names are compared ignoring case, and the well
+// known ones are interned into an Id which is found in O(1):
+//
+//   Slice host = headers.Get(HttpHeaders::kHost);
+//   Slice trace = headers.Get("X-Trace-Id");
+//
+// The Slices returned are valid until the headers are changed.
+class HttpHeaders {
+ public:
+  enum Id {
+    kOther,
+    kAccept,
+    kAcceptEncoding,
+    kAcceptLanguage,
+    kAcceptRanges,
+    kAuthorization,
+    kCacheControl,
+    kConnection,
+    kContentEncoding,
+    kContentLength,
+    kContentRange,
+    kContentType,
+    kCookie,
+    kDate,
+    kETag,
+    kExpect,
+    kHost,
+    kHttp2Settings,
+    kIfModifiedSince,
+    kIfNoneMatch,
+    kIfRange,
+    kKeepAlive,
+    kLastModified,
+    kLocation,
+    kOrigin,
+    kRange,
+    kReferer,
+    kServer,
+    kSetCookie,
+    kTransferEncoding,
+    kUpgrade,
+    kUserAgent,
+    kVary,
+    kXForwardedFor,
+    kNumIds
+  };
+
+  static const size_t kInlineHeaders = 16;
+  static const size_t kInlineBytes = 512;
+
+  HttpHeaders();
+  HttpHeaders(const HttpHeaders& other);
+  HttpHeaders& operator=(const HttpHeaders& other);
+
+  // kOther for names which are not interned.
+  static Id ToId(const Slice& name);
+  // The canonical name, "" for kOther.
+  static const char* Name(Id id);
+  static bool EqualsIgnoreCase(const Slice& a, const Slice& b);
+
+  // Appends a header, keeping any with the same name.
+  void Add(const Slice& name, const Slice& value);
+  // Replaces every header named name with one. A single one is overwritten
+  // in its place when the new value is not longer.
+  void Set(const Slice& name, const Slice& value);
+  void Remove(const Slice& name);
+  void Clear();
+
+  // The value of the first header with the name, or an empty Slice.
+  Slice Get(Id id) const;
+  Slice Get(const Slice& name) const;
+  bool Has(Id id) const { return first_[id] >= 0; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  Slice Name(size_t i) const;
+  Slice Value(size_t i) const;
+  Id GetId(size_t i) const { return At(i).id; }
+
+ private:
+  struct Entry {
+    uint32_t name;
+    uint32_t name_size;
+    uint32_t value;
+    uint32_t value_size;
+    Id id;
+  };
+
+  const Entry& At(size_t i) const {
+    return i < kInlineHeaders ? entries_[i] : more_[i - kInlineHeaders];
+  }
+  Entry& At(size_t i) {
+    return i < kInlineHeaders ? entries_[i] : more_[i - kInlineHeaders];
+  }
+  void Grow(size_t size);
+  // Copies s into the arena, which has room for it.
+  uint32_t Store(const Slice& s);
+  // Drops the bytes of the removed and the shrunk values from the arena.
+  void Compact();
+  // Remove() without compacting, false if there was no such header.
+  bool RemoveAll(const Slice& name);
+  void RemoveAt(size_t i);
+  void Reindex();
+
+  Entry entries_[kInlineHeaders];
+  std::vector<Entry> more_;
+  size_t size_;
+  // The index of the first entry of every Id, or -1.
+  int16_t first_[kNumIds];
+
+  char inline_bytes_[kInlineBytes];
+  std::unique_ptr<char[]> heap_bytes_;
+  char* bytes_;
+  size_t used_;
+  // The bytes of used_ which no entry points to any more.
+  size_t garbage_;
+  size_t capacity_;
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_HEADERS_H_
@@ -47,36 +47,17 @@ const char* HttpMessage::VersionToString() const {
 
 void HttpMessage::AddHeader(const char* begin, const char* colon,
                             const char* end) {
-  std::string field(begin, colon);
+  Slice field(begin, static_cast<size_t>(colon - begin));
   ++colon;
   while (colon != end && *colon == ' ') {
     ++colon;
   }
-  std::string value(colon, end);
-  AddHeader(field, value);
+  AddHeader(field, Slice(colon, static_cast<size_t>(end - colon)));
 }
 
-void HttpMessage::AddHeader(const std::string& field,
-                            const std::string& value) {
+void HttpMessage::AddHeader(const Slice& field, const Slice& value) {
   if (!field.empty() && !value.empty()) {
-    std::string key(field);
-    TransferField(&key);
-    header_map_[key] = value;
-  }
-}
-
-void HttpMessage::RemoveHeader(const std::string& field) {
-  header_map_.erase(field);
-}
-
-void HttpMessage::TransferField(std::string* s) {
-  const char* begin = &*s->begin();
-  if (strcasecmp(begin, kConnection) == 0) {
-    s->assign(kConnection);
-  } else if (strcasecmp(begin, kContentLength) == 0) {
-    s->assign(kContentLength);
-  } else if (strcasecmp(begin, kHost) == 0) {
-    s->assign(kHost);
+    headers_.Set(field, value);
   }
 }
 
@@ -5,10 +5,12 @@
 #ifndef VOYAGER_HTTP_HTTP_MESSAGE_H_
 #define VOYAGER_HTTP_HTTP_MESSAGE_H_
 
-#include <map>
 #include <string>
 #include <utility>
 
+#include "voyager/http/http_headers.h"
+#include "voyager/util/slice.h"
+
 namespace voyager {
 
 class HttpMessage {
@@ -31,30 +33,23 @@ class HttpMessage {
   const char* VersionToString() const;
 
   void AddHeader(const char* begin, const char* colon, const char* end);
-  void AddHeader(const std::string& field, const std::string& value);
-  void RemoveHeader(const std::string& field);
-  std::string Value(const std::string& field) {
-    std::string value;
-    std::map<std::string, std::string>::iterator it = header_map_.find(field);
-    if (it != header_map_.end()) {
-      value = it->second;
-    }
-
-    return value;
-  }
-  const std::map<std::string, std::string>& HeaderMap() const {
-    return header_map_;
-  }
+  // Replaces any header named field, empty values are ignored.
+  void AddHeader(const Slice& field, const Slice& value);
+  void RemoveHeader(const Slice& field) { headers_.Remove(field); }
+  // Empty if there is no such header.
+  Slice Value(const Slice& field) const { return headers_.Get(field); }
+  Slice Value(HttpHeaders::Id id) const { return headers_.Get(id); }
+  const HttpHeaders& Headers() const { return headers_; }
+  HttpHeaders* MutableHeaders() { return &headers_; }
 
   void SetBody(const std::string& body) { body_ = body; }
   void SetBody(std::string&& body) { body_ = std::move(body); }
+  void AppendBody(const char* data, size_t size) { body_.append(data, size); }
   const std::string& Body() const { return body_; }
 
  protected:
-  void TransferField(std::string* s);
-
   HttpVersion version_;
-  std::map<std::string, std::string> header_map_;
+  HttpHeaders headers_;
   std::string body_;
 };
 
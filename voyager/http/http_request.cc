@@ -5,11 +5,11 @@
 #include "voyager/http/http_request.h"
 
 #include <string.h>
-#include <map>
 
 namespace voyager {
 
-HttpRequest::HttpRequest() {}
+// The message buffer is only allocated when it is used.
+HttpRequest::HttpRequest() : method_(kGet), message_(0) {}
 
 bool HttpRequest::SetMethod(const char* begin, const char* end) {
   size_t size = end - begin;
@@ -95,11 +95,10 @@ Buffer& HttpRequest::RequestMessage() {
   message_.Append(" ");
   message_.Append(VersionToString());
   message_.Append("\r\n");
-  for (std::map<std::string, std::string>::iterator it = header_map_.begin();
-       it != header_map_.end(); ++it) {
-    message_.Append(it->first);
-    message_.Append(":");
-    message_.Append(it->second);
+  for (size_t i = 0; i < headers_.size(); ++i) {
+    message_.Append(headers_.Name(i));
+    message_.Append(": ");
+    message_.Append(headers_.Value(i));
     message_.Append("\r\n");
   }
   message_.Append("\r\n");
@@ -5,6 +5,10 @@
 #include "voyager/http/http_request_parser.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <memory>
 #include <string>
 
 #include "voyager/core/buffer.h"
@@ -12,103 +16,92 @@
 namespace voyager {
 
 HttpRequestParser::HttpRequestParser()
-    : state_(kLine), request_(new HttpRequest()) {}
+    : state_(kHead),
+      request_(new HttpRequest()),
+      max_body_size_(4 * 1024 * 1024),
+      too_large_(false) {}
 
 bool HttpRequestParser::ParseBuffer(Buffer* buf) {
   bool ok = true;
   bool flag = true;
   while (flag && ok) {
-    if (state_ == kLine) {
-      const char* crlf = buf->FindCRLF();
-      if (crlf) {
-        ok = ParseRequestLine(buf->Peek(), crlf);
-        if (ok) {
-          buf->RetrieveUntil(crlf + 2);
-          state_ = kHeaders;
-        } else {
-          flag = false;
-        }
-      } else {
-        flag = false;
-      }
-    } else if (state_ == kHeaders) {
-      const char* crlf = buf->FindCRLF();
-      if (crlf) {
-        const char* colon = buf->Peek();
-        if (colon == crlf) {
-          state_ = kBody;
-        } else {
-          while (colon != crlf && *colon != ':') {
-            ++colon;
-          }
-          if (colon == buf->Peek() || colon == crlf) {
-            ok = false;
-          } else {
-            request_->AddHeader(buf->Peek(), colon, crlf);
-          }
-        }
-        buf->RetrieveUntil(crlf + 2);
+    if (state_ == kHead) {
+      HttpHeadParser::Result result =
+          head_.Parse(buf->Peek(), buf->ReadableSize());
+      if (result == HttpHeadParser::kComplete) {
+        head_.ToRequest(request_.get());
+        ok = ParseFraming();
+        buf->Retrieve(head_.HeadSize());
+        head_.Reset();
+        state_ = kBody;
       } else {
+        ok = result != HttpHeadParser::kError;
         flag = false;
       }
     } else if (state_ == kBody) {
-      if (ParseRequestBody(buf)) {
+      size_t n;
+      HttpBodyDecoder::Result result = body_.Decode(buf, &n);
+      if (result == HttpBodyDecoder::kData) {
+        ok = TakeBody(buf, n);
+      } else if (result == HttpBodyDecoder::kDone) {
         state_ = kEnd;
       } else {
-        ok = false;
+        ok = result != HttpBodyDecoder::kError;
+        flag = false;
       }
-      flag = false;
     } else {
+      flag = false;
     }
   }
   return ok;
 }
 
 void HttpRequestParser::Reset() {
-  state_ = kLine;
-  request_.reset(new HttpRequest());
+  state_ = kHead;
+  head_.Reset();
+  body_.Reset();
+  request_ = std::make_shared<HttpRequest>();
+  too_large_ = false;
 }
 
-bool HttpRequestParser::ParseRequestLine(const char* begin, const char* end) {
-  bool ok = false;
-  const char* tmp = begin;
-  while (tmp != end && !isspace(*tmp)) {
-    ++tmp;
+bool HttpRequestParser::ParseFraming() {
+  Slice length(head_.Header(HttpMessage::kContentLength));
+  Slice coding(head_.Header("Transfer-Encoding"));
+  if (!coding.empty()) {
+    // Other codings can not be delimited, and a Content-Length beside the
+    // coding is how requests are smuggled, RFC 7230 3.3.3.
+    body_.SetChunked();
+    return length.empty() && coding.size() == 7 &&
+           strncasecmp(coding.data(), "chunked", 7) == 0;
   }
-  if (tmp != end && request_->SetMethod(begin, tmp)) {
-    ++tmp;
-    const char* start = tmp;
-    const char* p = nullptr;
-    while (tmp != end && !isspace(*tmp)) {
-      if (*tmp == '?') {
-        p = tmp;
-      }
-      ++tmp;
-    }
-    if (tmp != end) {
-      if (p != nullptr) {
-        request_->SetPath(start, p);
-        request_->SetQuery(p, tmp);
-      } else {
-        request_->SetPath(start, tmp);
-      }
-      start = tmp + 1;
-      ok = request_->SetVersion(start, end);
+  uint64_t size = 0;
+  for (size_t i = 0; i < length.size(); ++i) {
+    if (length[i] < '0' || length[i] > '9' ||
+        size > HttpBodyDecoder::kMaxBodySize) {
+      return false;
     }
+    size = size * 10 + static_cast<uint64_t>(length[i] - '0');
   }
-  return ok;
+  body_.SetLength(size);
+  too_large_ = !body_cb_ && size > max_body_size_;
+  return !too_large_;
 }
 
-bool HttpRequestParser::ParseRequestBody(Buffer* buf) {
-  const std::string& s = request_->Value(HttpMessage::kContentLength);
-  if (request_->GetMethod() != HttpRequest::kPost || s.empty()) {
+bool HttpRequestParser::TakeBody(Buffer* buf, size_t n) {
+  if (n == 0) {
     return true;
   }
-  if (static_cast<int>(buf->ReadableSize()) == atoi(&*(s.begin()))) {
-    request_->SetBody(buf->RetrieveAllAsString());
-    return true;
+  if (body_cb_) {
+    body_cb_(request_, Slice(buf->Peek(), n));
+  } else {
+    if (request_->Body().size() + n > max_body_size_) {
+      too_large_ = true;
+      return false;
+    }
+    request_->AppendBody(buf->Peek(), n);
   }
-  return false;
+  buf->Retrieve(n);
+  return true;
 }
 
 }  // namespace voyager
@@ -5,31 +5,65 @@
 #ifndef VOYAGER_HTTP_HTTP_REQUEST_PARSER_H_
 #define VOYAGER_HTTP_HTTP_REQUEST_PARSER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+#include "voyager/http/http_body_decoder.h"
+#include "voyager/http/http_head_parser.h"
 #include "voyager/http/http_request.h"
+#include "voyager/util/slice.h"
 
 namespace voyager {
 
 class Buffer;
 
+// Parses one request at a time from the front of the buffer. The body is
+// delimited by Content-Length, whatever the method, or by the chunked
+// transfer coding. It is kept in the request unless a BodyCallback takes it
+// piece by piece as it arrives, so that large uploads are never held in
+// memory.
 class HttpRequestParser {
  public:
+  // Called with the request, whose head is complete, and the next piece of
+  // its body.
+  typedef std::function<void(const HttpRequestPtr&, const Slice&)>
+      BodyCallback;
+
   HttpRequestParser();
 
+  void SetBodyCallback(const BodyCallback& cb) { body_cb_ = cb; }
+  // Larger bodies are rejected unless a BodyCallback takes them, see
+  // TooLarge().
+  // Default: 4 * 1024 * 1024
+  void SetMaxBodySize(size_t size) { max_body_size_ = size; }
+
   bool ParseBuffer(Buffer* buf);
   bool FinishParse() const { return state_ == kEnd; }
+  // Whether no body is being read, so what is buffered starts a request.
+  bool InHead() const { return state_ == kHead; }
+  // Whether ParseBuffer() failed on a body over the maximum size.
+  bool TooLarge() const { return too_large_; }
 
   HttpRequestPtr GetRequest() const { return request_; }
 
   void Reset();
 
  private:
-  enum ParserState { kLine, kHeaders, kBody, kEnd };
+  enum ParserState { kHead, kBody, kEnd };
 
-  bool ParseRequestLine(const char* begin, const char* end);
-  bool ParseRequestBody(Buffer* buf);
+  bool ParseFraming();
+  // Hands n bytes of the body to body_cb_ or keeps them in the request.
+  bool TakeBody(Buffer* buf, size_t n);
 
   ParserState state_;
+  HttpHeadParser head_;
+  HttpBodyDecoder body_;
   HttpRequestPtr request_;
+  BodyCallback body_cb_;
+  size_t max_body_size_;
+  bool too_large_;
 
   // No copying allowed
   HttpRequestParser(const HttpRequestParser&);
@@ -3,27 +3,211 @@
 // found in the LICENSE file.
 
 #include "voyager/http/http_response.h"
-#include <map>
+
+#include <sys/uio.h>
+
+#include <utility>
+
+#include "voyager/http/http_date.h"
 
 namespace voyager {
 
+namespace {
+
+const int kMinCode = 100;
+const int kMaxCode = 599;
+
+const struct {
+  int code;
+  const char* reason;
+} kReasons[] = {
+    {100, "Continue"},
+    {101, "Switching Protocols"},
+    {200, "OK"},
+    {201, "Created"},
+    {202, "Accepted"},
+    {203, "Non-Authoritative Information"},
+    {204, "No Content"},
+    {205, "Reset Content"},
+    {206, "Partial Content"},
+    {300, "Multiple Choices"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
+    {303, "See Other"},
+    {304, "Not Modified"},
+    {307, "Temporary Redirect"},
+    {308, "Permanent Redirect"},
+    {400, "Bad Request"},
+    {401, "Unauthorized"},
+    {402, "Payment Required"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {406, "Not Acceptable"},
+    {407, "Proxy Authentication Required"},
+    {408, "Request Timeout"},
+    {409, "Conflict"},
+    {410, "Gone"},
+    {411, "Length Required"},
+    {412, "Precondition Failed"},
+    {413, "Payload Too Large"},
+    {414, "URI Too Long"},
+    {415, "Unsupported Media Type"},
+    {416, "Range Not Satisfiable"},
+    {417, "Expectation Failed"},
+    {426, "Upgrade Required"},
+    {428, "Precondition Required"},
+    {429, "Too Many Requests"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Timeout"},
+    {505, "HTTP Version Not Supported"},
+};
+
+// The whole status line of every known code for HTTP/1.0 and HTTP/1.1,
+// built once so that a response only copies it.
+class StatusLines {
+ public:
+  StatusLines() {
+    for (int i = 0; i <= kMaxCode - kMinCode; ++i) {
+      reasons_[i] = "";
+    }
+    for (size_t i = 0; i < sizeof(kReasons) / sizeof(kReasons[0]); ++i) {
+      int code = kReasons[i].code;
+      std::string rest(" " + std::to_string(code) + " " + kReasons[i].reason +
+                       "\r\n");
+      lines_[HttpMessage::kHttp10][code - kMinCode] = "HTTP/1.0" + rest;
+      lines_[HttpMessage::kHttp11][code - kMinCode] = "HTTP/1.1" + rest;
+      reasons_[code - kMinCode] = kReasons[i].reason;
+    }
+  }
+
+  // Empty if there is no such line.
+  Slice Line(HttpMessage::HttpVersion version, int code) const {
+    if (version > HttpMessage::kHttp11 || code < kMinCode ||
+        code > kMaxCode) {
+      return Slice();
+    }
+    return Slice(lines_[version][code - kMinCode]);
+  }
+
+  const char* Reason(int code) const {
+    if (code < kMinCode || code > kMaxCode) {
+      return "";
+    }
+    return reasons_[code - kMinCode];
+  }
+
+ private:
+  std::string lines_[HttpMessage::kHttp11 + 1][kMaxCode - kMinCode + 1];
+  const char* reasons_[kMaxCode - kMinCode + 1];
+};
+
+const StatusLines kStatusLines;
+
+}  // anonymous namespace
+
+void HttpResponse::SetStatusCode(const char* begin, const char* end) {
+  int code = 0;
+  for (const char* p = begin; p != end && *p >= '0' && *p <= '9'; ++p) {
+    code = code * 10 + (*p - '0');
+    if (code > kMaxCode) {
+      break;
+    }
+  }
+  status_code_ = code;
+}
+
+std::string HttpResponse::ReasonParse() const {
+  return reason_parse_.empty() ? std::string(Reason(status_code_))
+                               : reason_parse_;
+}
+
+const char* HttpResponse::Reason(int code) { return kStatusLines.Reason(code); }
+
+void HttpResponse::SetFileBody(int fd, off_t offset, size_t size,
+                               const std::shared_ptr<const void>& owner) {
+  file_fd_ = fd;
+  file_offset_ = offset;
+  file_size_ = size;
+  file_owner_ = owner;
+}
+
 Buffer& HttpResponse::ResponseMessage() {
-  message_.Append(VersionToString());
-  message_.Append(" ");
-  message_.Append(status_code_);
-  message_.Append(" ");
-  message_.Append(reason_parse_);
-  message_.Append("\r\n");
-  for (std::map<std::string, std::string>::iterator it = header_map_.begin();
-       it != header_map_.end(); ++it) {
-    message_.Append(it->first);
-    message_.Append(": ");
-    message_.Append(it->second);
-    message_.Append("\r\n");
-  }
-  message_.Append("\r\n");
-  message_.Append(body_);
+  OutputChain head;
+  AppendHead(&head);
+  struct iovec iov[OutputChain::kMaxIovecs];
+  int n = head.Peek(iov, OutputChain::kMaxIovecs);
+  for (int i = 0; i < n; ++i) {
+    message_.Append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+  }
+  message_.Append(shared_body_ ? *shared_body_ : body_);
   return message_;
 }
 
+void HttpResponse::AppendHead(OutputChain* out) const {
+  AppendHead(out, false);
+}
+
+void HttpResponse::SerializeTo(OutputChain* out) {
+  // RFC 7230 3.3.2, no Content-Length for the statuses without a body.
+  bool content_length = !headers_.Has(HttpHeaders::kContentLength) &&
+                        !headers_.Has(HttpHeaders::kTransferEncoding) &&
+                        status_code_ >= 200 && status_code_ != 204 &&
+                        status_code_ != 304;
+  AppendHead(out, content_length);
+  TakeBody(out);
+}
+
+void HttpResponse::TakeBody(OutputChain* out) {
+  if (file_fd_ >= 0) {
+    out->AppendFile(file_fd_, file_offset_, file_size_, file_owner_);
+    file_fd_ = -1;
+    file_owner_.reset();
+  } else if (shared_body_) {
+    out->Append(shared_body_);
+    shared_body_.reset();
+  } else {
+    out->Append(std::move(body_));
+    body_.clear();
+  }
+}
+
+void HttpResponse::AppendHead(OutputChain* out, bool content_length) const {
+  Slice line;
+  if (reason_parse_.empty()) {
+    line = kStatusLines.Line(version_, status_code_);
+  }
+  if (line.empty()) {
+    out->Append(VersionToString());
+    out->Append(" ");
+    out->Append(std::to_string(status_code_));
+    out->Append(" ");
+    out->Append(ReasonParse());
+    out->Append("\r\n");
+  } else {
+    out->Append(line);
+  }
+  if (!headers_.Has(HttpHeaders::kDate)) {
+    out->Append("Date: ");
+    out->Append(http_date::Now());
+    out->Append("\r\n");
+  }
+  if (content_length) {
+    out->Append("Content-Length: ");
+    out->Append(std::to_string(BodySize()));
+    out->Append("\r\n");
+  }
+  for (size_t i = 0; i < headers_.size(); ++i) {
+    out->Append(headers_.Name(i));
+    out->Append(": ");
+    out->Append(headers_.Value(i));
+    out->Append("\r\n");
+  }
+  out->Append("\r\n");
+}
+
 }  // namespace voyager
@@ -5,39 +5,90 @@
 #ifndef VOYAGER_HTTP_HTTP_RESPONSE_H_
 #define VOYAGER_HTTP_HTTP_RESPONSE_H_
 
+#include <sys/types.h>
+
 #include <memory>
 #include <string>
 
 #include "voyager/core/buffer.h"
+#include "voyager/core/output_chain.h"
 #include "voyager/http/http_message.h"
 
 namespace voyager {
 
 class HttpResponse : public HttpMessage {
  public:
-  HttpResponse() : close_(false), status_code_("200"), reason_parse_("OK") {}
+  HttpResponse()
+      : close_(false),
+        status_code_(200),
+        file_fd_(-1),
+        file_offset_(0),
+        file_size_(0),
+        message_(0) {}
 
   void SetCloseState(bool close) { close_ = close; }
   bool CloseState() const { return close_; }
 
-  void SetStatusCode(const char* begin, const char* end) {
-    status_code_.assign(begin, end);
+  void SetStatusCode(int code) { status_code_ = code; }
+  void SetStatusCode(const char* begin, const char* end);
+  void SetStatusCode(const std::string& code) {
+    SetStatusCode(code.data(), code.data() + code.size());
   }
-  void SetStatusCode(const std::string& code) { status_code_ = code; }
-  const std::string& GetStatusCode() const { return status_code_; }
+  int StatusCode() const { return status_code_; }
+  std::string GetStatusCode() const { return std::to_string(status_code_); }
 
+  // Only needed for a reason phrase other than the standard one.
   void SetReasonParse(const char* begin, const char* end) {
     reason_parse_.assign(begin, end);
   }
   void SetReasonParse(const std::string& s) { reason_parse_ = s; }
-  const std::string& ReasonParse() const { return reason_parse_; }
+  std::string ReasonParse() const;
+  // The standard reason phrase of code, "" for unknown codes.
+  static const char* Reason(int code);
+
+  // A body which is shared rather than owned, such as a cached file, takes
+  // the place of Body() and is sent without being copied.
+  void SetSharedBody(const std::shared_ptr<const std::string>& body) {
+    shared_body_ = body;
+  }
+  const std::shared_ptr<const std::string>& SharedBody() const {
+    return shared_body_;
+  }
+  // Or a body sent from size bytes of the file fd at offset with
+  // sendfile(), without ever being read. owner keeps fd open until then,
+  // or is null when the caller keeps it open longer than the response.
+  void SetFileBody(int fd, off_t offset, size_t size,
+                   const std::shared_ptr<const void>& owner);
+  size_t BodySize() const {
+    if (file_fd_ >= 0) {
+      return file_size_;
+    }
+    return shared_body_ ? shared_body_->size() : body_.size();
+  }
 
+  // Without a file body.
   Buffer& ResponseMessage();
+  // The status line and the headers, up to the empty line, with a Date
+  // header unless the response has one.
+  void AppendHead(OutputChain* out) const;
+  // The whole response, with a Content-Length header unless it is framed
+  // already or has no body by its status. A large body is referenced
+  // rather than copied, and is moved out of the response.
+  void SerializeTo(OutputChain* out);
+  // Only the body, moved out the same way.
+  void TakeBody(OutputChain* out);
 
  private:
+  void AppendHead(OutputChain* out, bool content_length) const;
+
   bool close_;
-  std::string status_code_;
+  int status_code_;
   std::string reason_parse_;
+  std::shared_ptr<const std::string> shared_body_;
+  int file_fd_;
+  off_t file_offset_;
+  size_t file_size_;
+  std::shared_ptr<const void> file_owner_;
   Buffer message_;
 };
 
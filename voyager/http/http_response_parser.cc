@@ -5,6 +5,8 @@
 #include "voyager/http/http_response_parser.h"
 
 #include <stdio.h>
+#include <strings.h>
+
 #include <string>
 
 #include "voyager/core/buffer.h"
@@ -36,6 +38,7 @@ bool HttpResponseParser::ParseBuffer(Buffer* buf) {
       if (crlf) {
         const char* colon = buf->Peek();
         if (colon == crlf) {
+          ok = ParseFraming();
           state_ = kBody;
         } else {
           while (colon != crlf && *colon != ':') {
@@ -52,20 +55,33 @@ bool HttpResponseParser::ParseBuffer(Buffer* buf) {
         flag = false;
       }
     } else if (state_ == kBody) {
-      if (ParseResponseBody(buf)) {
+      size_t n;
+      HttpBodyDecoder::Result result = body_.Decode(buf, &n);
+      if (result == HttpBodyDecoder::kData) {
+        ok = TakeBody(buf, n);
+      } else if (result == HttpBodyDecoder::kDone) {
         state_ = kEnd;
       } else {
-        ok = false;
+        ok = result != HttpBodyDecoder::kError;
+        flag = false;
       }
-      flag = false;
     } else {
+      flag = false;
     }
   }
   return ok;
 }
 
+bool HttpResponseParser::Close() {
+  if (state_ == kBody && body_.Close()) {
+    state_ = kEnd;
+  }
+  return state_ == kEnd;
+}
+
 void HttpResponseParser::Reset() {
   state_ = kLine;
+  body_.Reset();
   response_.reset(new HttpResponse());
 }
 
@@ -93,16 +109,45 @@ bool HttpResponseParser::ParseResponseLine(const char* begin, const char* end) {
   return true;
 }
 
-bool HttpResponseParser::ParseResponseBody(Buffer* buf) {
-  const std::string& s = response_->Value(HttpMessage::kContentLength);
-  if (s.empty()) {
+bool HttpResponseParser::ParseFraming() {
+  int code = response_->StatusCode();
+  if (code < 200 || code == 204 || code == 304) {
+    body_.SetLength(0);
+    return true;
+  }
+  Slice coding(response_->Value(HttpHeaders::kTransferEncoding));
+  Slice length(response_->Value(HttpHeaders::kContentLength));
+  if (coding.size() == 7 && strncasecmp(coding.data(), "chunked", 7) == 0) {
+    body_.SetChunked();
     return true;
   }
-  if (static_cast<int>(buf->ReadableSize()) == atoi(&*(s.begin()))) {
-    response_->SetBody(buf->RetrieveAllAsString());
+  if (!coding.empty() || length.empty()) {
+    body_.SetUntilClose();
     return true;
   }
-  return false;
+  uint64_t size = 0;
+  for (size_t i = 0; i < length.size(); ++i) {
+    if (length[i] < '0' || length[i] > '9' ||
+        size > HttpBodyDecoder::kMaxBodySize) {
+      return false;
+    }
+    size = size * 10 + static_cast<uint64_t>(length[i] - '0');
+  }
+  body_.SetLength(size);
+  return body_cb_ || size <= kMaxContentLength;
+}
+
+bool HttpResponseParser::TakeBody(Buffer* buf, size_t n) {
+  if (body_cb_) {
+    body_cb_(response_, Slice(buf->Peek(), n));
+  } else {
+    if (response_->Body().size() + n > kMaxContentLength) {
+      return false;
+    }
+    response_->AppendBody(buf->Peek(), n);
+  }
+  buf->Retrieve(n);
+  return true;
 }
 
 }  // namespace voyager
@@ -5,18 +5,39 @@
 #ifndef VOYAGER_HTTP_HTTP_RESPONSE_PARSER_H_
 #define VOYAGER_HTTP_HTTP_RESPONSE_PARSER_H_
 
+#include <stddef.h>
+
+#include <functional>
+
+#include "voyager/http/http_body_decoder.h"
 #include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
 
 namespace voyager {
 
 class Buffer;
 
+// Parses one response at a time from the front of the buffer. The body is
+// delimited by Content-Length, by the chunked transfer coding, or else by
+// the end of the connection, see Close(). Like with HttpRequestParser, a
+// BodyCallback may take it piece by piece instead of the response.
 class HttpResponseParser {
  public:
+  typedef std::function<void(const HttpResponsePtr&, const Slice&)>
+      BodyCallback;
+
+  // Larger bodies are rejected unless a BodyCallback takes them.
+  static const size_t kMaxContentLength = 1024 * 1024 * 1024;
+
   HttpResponseParser();
 
+  void SetBodyCallback(const BodyCallback& cb) { body_cb_ = cb; }
+
   bool ParseBuffer(Buffer* buf);
   bool FinishParse() const { return state_ == kEnd; }
+  // The connection closed, which completes a response whose body ran until
+  // then. False if the response was cut short.
+  bool Close();
 
   HttpResponsePtr GetResponse() const { return response_; }
 
@@ -26,10 +47,13 @@ class HttpResponseParser {
   enum ParserState { kLine, kHeaders, kBody, kEnd };
 
   bool ParseResponseLine(const char* begin, const char* end);
-  bool ParseResponseBody(Buffer* buf);
+  bool ParseFraming();
+  bool TakeBody(Buffer* buf, size_t n);
 
   ParserState state_;
+  HttpBodyDecoder body_;
   HttpResponsePtr response_;
+  BodyCallback body_cb_;
 
   // No copying allowed
   HttpResponseParser(const HttpResponseParser&);
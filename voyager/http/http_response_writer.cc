@@ -0,0 +1,274 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_response_writer.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <utility>
+
+#include "voyager/core/eventloop.h"
+
+namespace voyager {
+
+HttpResponseWriter::HttpResponseWriter(const TcpConnectionPtr& ptr,
+                                       HttpMessage::HttpVersion version,
+                                       bool close)
+    : conn_wp_(ptr),
+      eventloop_(ptr->OwnerEventLoop()),
+      version_(version),
+      close_(close),
+      head_sent_(false),
+      chunked_(false),
+      ended_(false),
+      stream_id_(0),
+      coding_(HttpCompressor::kIdentity),
+      batch_(nullptr),
+      head_(true),
+      finished_(false) {}
+
+HttpResponseWriter::HttpResponseWriter(
+    const std::shared_ptr<Http2Session>& session, uint32_t stream_id)
+    : conn_wp_(session->Connection()),
+      eventloop_(session->OwnerEventLoop()),
+      version_(HttpMessage::kHttp20),
+      close_(false),
+      head_sent_(false),
+      chunked_(false),
+      ended_(false),
+      session_(session),
+      stream_id_(stream_id),
+      coding_(HttpCompressor::kIdentity),
+      batch_(nullptr),
+      head_(true),
+      finished_(false) {}
+
+void HttpResponseWriter::WriteHead(HttpResponse* response) {
+  assert(!head_sent_);
+  head_sent_ = true;
+  close_ = close_ || response->CloseState();
+  if (compression_) {
+    compressor_ = compression_->Start(coding_, response);
+  }
+  if (stream_id_ != 0) {
+    std::shared_ptr<HttpResponse> head(new HttpResponse());
+    head->SetStatusCode(response->StatusCode());
+    *head->MutableHeaders() = response->Headers();
+    uint32_t id = stream_id_;
+    RunInSession([head, id](Http2Session* session) {
+      session->SubmitHead(id, *head);
+    });
+    return;
+  }
+  if (!response->Headers().Has(HttpHeaders::kContentLength)) {
+    if (version_ == HttpMessage::kHttp11) {
+      chunked_ = true;
+      response->AddHeader("Transfer-Encoding", "chunked");
+    } else {
+      close_ = true;
+    }
+  }
+  OutputChain head;
+  response->AppendHead(&head);
+  Flush(&head);
+}
+
+void HttpResponseWriter::Write(const Slice& data) {
+  assert(head_sent_);
+  if (data.empty()) {
+    return;
+  }
+  OutputChain out;
+  if (compressor_) {
+    std::string z;
+    compressor_->Compress(data, &z);
+    compressor_->Flush(&z);
+    BeginChunk(&out, z.size());
+    out.Append(std::move(z));
+  } else {
+    BeginChunk(&out, data.size());
+    out.Append(data);
+  }
+  EndChunk(&out);
+  Flush(&out);
+}
+
+void HttpResponseWriter::Write(const std::shared_ptr<const std::string>& data) {
+  assert(head_sent_);
+  if (compressor_) {
+    Write(Slice(*data));
+    return;
+  }
+  if (data->empty()) {
+    return;
+  }
+  OutputChain out;
+  BeginChunk(&out, data->size());
+  out.Append(data);
+  EndChunk(&out);
+  Flush(&out);
+}
+
+void HttpResponseWriter::End() {
+  assert(head_sent_);
+  OutputChain out;
+  if (compressor_ && !ended_) {
+    std::string z;
+    compressor_->Finish(&z);
+    BeginChunk(&out, z.size());
+    out.Append(std::move(z));
+    EndChunk(&out);
+  }
+  Finish(&out);
+}
+
+void HttpResponseWriter::Send(HttpResponse* response) {
+  assert(!head_sent_);
+  head_sent_ = true;
+  close_ = close_ || response->CloseState();
+  if (compression_) {
+    compression_->Compress(*request_, coding_, response);
+  }
+  if (stream_id_ != 0) {
+    ended_ = true;
+    std::shared_ptr<HttpResponse> whole(
+        new HttpResponse(std::move(*response)));
+    uint32_t id = stream_id_;
+    RunInSession([whole, id](Http2Session* session) {
+      session->SubmitResponse(id, whole.get());
+    });
+    return;
+  }
+  OutputChain out;
+  response->SerializeTo(&out);
+  Finish(&out);
+}
+
+bool HttpResponseWriter::Connected() const {
+  TcpConnectionPtr ptr(conn_wp_.lock());
+  return ptr && ptr->IsConnected();
+}
+
+void HttpResponseWriter::Flush(OutputChain* out) {
+  if (out->empty()) {
+    return;
+  }
+  if (stream_id_ != 0) {
+    std::shared_ptr<OutputChain> chain(new OutputChain());
+    chain->Swap(out);
+    uint32_t id = stream_id_;
+    RunInSession([chain, id](Http2Session* session) {
+      session->SubmitData(id, chain.get(), false);
+    });
+    return;
+  }
+  if (eventloop_->IsInMyLoop()) {
+    FlushInLoop(out);
+    return;
+  }
+  std::shared_ptr<OutputChain> chain(new OutputChain());
+  chain->Swap(out);
+  std::shared_ptr<HttpResponseWriter> self(shared_from_this());
+  eventloop_->RunInLoop([self, chain]() { self->FlushInLoop(chain.get()); });
+}
+
+void HttpResponseWriter::FlushInLoop(OutputChain* out) {
+  if (!head_) {
+    held_.Append(out);
+  } else if (batch_ != nullptr) {
+    batch_->Append(out);
+  } else {
+    TcpConnectionPtr ptr(conn_wp_.lock());
+    if (ptr) {
+      ptr->SendMessage(out);
+    }
+  }
+}
+
+void HttpResponseWriter::BeginChunk(OutputChain* out, size_t size) const {
+  if (chunked_) {
+    char buf[24];
+    int n = snprintf(buf, sizeof(buf), "%zx\r\n", size);
+    out->Append(buf, static_cast<size_t>(n));
+  }
+}
+
+void HttpResponseWriter::EndChunk(OutputChain* out) const {
+  if (chunked_) {
+    out->Append("\r\n", 2);
+  }
+}
+
+void HttpResponseWriter::Finish(OutputChain* out) {
+  if (ended_.exchange(true)) {
+    return;
+  }
+  if (chunked_) {
+    out->Append("0\r\n\r\n", 5);
+  }
+  if (stream_id_ != 0) {
+    std::shared_ptr<OutputChain> chain(new OutputChain());
+    chain->Swap(out);
+    uint32_t id = stream_id_;
+    RunInSession([chain, id](Http2Session* session) {
+      session->SubmitData(id, chain.get(), true);
+    });
+    return;
+  }
+  if (eventloop_->IsInMyLoop()) {
+    FinishInLoop(out);
+    return;
+  }
+  std::shared_ptr<OutputChain> chain(new OutputChain());
+  chain->Swap(out);
+  std::shared_ptr<HttpResponseWriter> self(shared_from_this());
+  eventloop_->RunInLoop([self, chain]() { self->FinishInLoop(chain.get()); });
+}
+
+void HttpResponseWriter::FinishInLoop(OutputChain* out) {
+  FlushInLoop(out);
+  finished_ = true;
+  // Inside the batch HttpServer sees it when the handler returns, and a
+  // writer behind others when it becomes the head. Never from inside the
+  // handler, which may be in the middle of the batch.
+  if (head_ && batch_ == nullptr && done_cb_) {
+    std::shared_ptr<HttpResponseWriter> self(shared_from_this());
+    eventloop_->QueueInLoop([self]() { self->done_cb_(); });
+  }
+}
+
+void HttpResponseWriter::RunInSession(
+    const std::function<void(Http2Session*)>& f) {
+  std::shared_ptr<Http2Session> session(session_.lock());
+  if (!session) {
+    return;
+  }
+  if (eventloop_->IsInMyLoop()) {
+    f(session.get());
+  } else {
+    eventloop_->RunInLoop([session, f]() { f(session.get()); });
+  }
+}
+
+void HttpResponseWriter::SetHead(bool head) {
+  head_ = head;
+  if (head_) {
+    FlushInLoop(&held_);
+  }
+}
+
+void HttpResponseWriter::OnWriteComplete() {
+  if (write_complete_cb_ && !ended_) {
+    // Not from inside the write which completed, the callback writes again.
+    std::shared_ptr<HttpResponseWriter> self(shared_from_this());
+    eventloop_->QueueInLoop([self]() {
+      if (!self->ended_) {
+        self->write_complete_cb_();
+      }
+    });
+  }
+}
+
+}  // namespace voyager
@@ -0,0 +1,145 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_RESPONSE_WRITER_H_
+#define VOYAGER_HTTP_HTTP_RESPONSE_WRITER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "voyager/core/output_chain.h"
+#include "voyager/core/tcp_connection.h"
+#include "voyager/http/http2_session.h"
+#include "voyager/http/http_compression.h"
+#include "voyager/http/http_message.h"
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// Sends the response to one request, at once or as its body becomes
+// available, from the handler or later from any thread:
+//
+//   server.SetStreamCallback(
+//       [](HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+//         backend.Call(..., [writer](const std::string& result) {
+//           HttpResponse response;
+//           response.SetBody(result);
+//           writer->Send(&response);
+//         });
+//       });
+//
+// Without a Content-Length header the body is sent with the chunked transfer
+// coding, or to an HTTP/1.0 client until the connection closes. On HTTP/2
+// it goes in DATA frames on the stream of the request. A writer may
+// be kept and used from any thread, but by one thread at a time. The
+// responses of a connection are sent in the order of its requests: a writer
+// whose predecessors are not done yet holds its output until they are.
+// With HttpServerOptions::compression_level set, a body without a
+// Content-Length is compressed as it is written, each piece flushed through
+// so that the client gets it at once.
+class HttpResponseWriter
+    : public std::enable_shared_from_this<HttpResponseWriter> {
+ public:
+  HttpResponseWriter(const TcpConnectionPtr& ptr,
+                     HttpMessage::HttpVersion version, bool close);
+  // For stream stream_id of an HTTP/2 connection, where the body goes in
+  // DATA frames.
+  HttpResponseWriter(const std::shared_ptr<Http2Session>& session,
+                     uint32_t stream_id);
+
+  // Sends the status line and the headers of response, its body is ignored.
+  // Adds Transfer-Encoding to response when the body is chunked.
+  void WriteHead(HttpResponse* response);
+  // Sends the next piece of the body, empty pieces are skipped.
+  void Write(const Slice& data);
+  // Sends data without copying it, it is kept until written.
+  void Write(const std::shared_ptr<const std::string>& data);
+  // Ends the body, and the connection if the request or the response asked
+  // for it.
+  void End();
+  // WriteHead(), Write() of the body and End() with one write, see
+  // HttpResponse::SerializeTo().
+  void Send(HttpResponse* response);
+
+  // Whether the connection is still up, a producer should stop otherwise.
+  bool Connected() const;
+
+  // Called in the loop of the connection whenever everything written so far
+  // has been sent, to write the next piece without piling up the body in
+  // the output buffer. Set it before the first Write().
+  void SetWriteCompleteCallback(const std::function<void()>& cb) {
+    write_complete_cb_ = cb;
+  }
+
+ private:
+  friend class HttpServer;
+
+  void Flush(OutputChain* out);
+  void FlushInLoop(OutputChain* out);
+  void BeginChunk(OutputChain* out, size_t size) const;
+  void EndChunk(OutputChain* out) const;
+  // Sends out, the last bytes of the response, and ends it.
+  void Finish(OutputChain* out);
+  void FinishInLoop(OutputChain* out);
+  // Runs f on the HTTP/2 session in its loop.
+  void RunInSession(const std::function<void(Http2Session*)>& f);
+
+  // Used by HttpServer in the loop. While the handler runs inside the read
+  // event everything goes to batch, after the responses before it.
+  void SetBatch(OutputChain* batch) { batch_ = batch; }
+  // A writer behind others holds its output until it becomes the head.
+  void SetHead(bool head);
+  // Ended, and everything is sent or held.
+  bool Finished() const { return finished_; }
+  bool Close() const { return close_; }
+  // Called in the loop when the head writer finishes outside of the batch.
+  void SetDoneCallback(const std::function<void()>& cb) { done_cb_ = cb; }
+  // The response to request is compressed by compression with coding when
+  // it may be.
+  void SetCompression(const std::shared_ptr<HttpCompression>& compression,
+                      const HttpRequestPtr& request,
+                      HttpCompressor::Coding coding) {
+    compression_ = compression;
+    request_ = request;
+    coding_ = coding;
+  }
+  void OnWriteComplete();
+
+  std::weak_ptr<TcpConnection> conn_wp_;
+  EventLoop* const eventloop_;
+  const HttpMessage::HttpVersion version_;
+  bool close_;
+  bool head_sent_;
+  bool chunked_;
+  std::atomic<bool> ended_;
+  // Set for HTTP/2.
+  std::weak_ptr<Http2Session> session_;
+  const uint32_t stream_id_;
+  std::shared_ptr<HttpCompression> compression_;
+  HttpRequestPtr request_;
+  HttpCompressor::Coding coding_;
+  std::unique_ptr<HttpCompressor> compressor_;
+
+  // Only touched in the loop.
+  OutputChain* batch_;
+  bool head_;
+  bool finished_;
+  OutputChain held_;
+  std::function<void()> done_cb_;
+  std::function<void()> write_complete_cb_;
+
+  // No copying allowed
+  HttpResponseWriter(const HttpResponseWriter&);
+  void operator=(const HttpResponseWriter&);
+};
+
+typedef std::shared_ptr<HttpResponseWriter> HttpResponseWriterPtr;
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_RESPONSE_WRITER_H_
@@ -0,0 +1,254 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/http/http_router.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace voyager {
+
+namespace {
+
+const char* const kMethodNames[] = {"OPTIONS", "HEAD",    "GET",
+                                    "POST",    "PUT",     "DELETE",
+                                    "TRACE",   "CONNECT", "PATCH"};
+
+bool IsName(const char* begin, const char* end) {
+  if (begin == end) {
+    return false;
+  }
+  for (const char* p = begin; p != end; ++p) {
+    if (*p == '/' || *p == ':' || *p == '*') {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+struct HttpRouter::Node {
+  Node() : handler(-1) {}
+
+  // The static bytes on the edge into the node.
+  std::string prefix;
+  // The first byte of the prefix of every child, in their order.
+  std::string indices;
+  std::vector<std::unique_ptr<Node>> children;
+  // Matches the next segment.
+  std::string param_name;
+  std::unique_ptr<Node> param;
+  // Matches the rest of the path.
+  std::string rest_name;
+  std::unique_ptr<Node> rest;
+  // The index into handlers_, or -1.
+  int handler;
+};
+
+Slice HttpRouteParams::Get(const Slice& name) const {
+  for (size_t i = 0; i < size_; ++i) {
+    if (names_[i] == name) {
+      return values_[i];
+    }
+  }
+  return Slice();
+}
+
+HttpRouter::HttpRouter() {}
+
+HttpRouter::~HttpRouter() {}
+
+bool HttpRouter::Add(HttpRequest::Method method, const std::string& pattern,
+                     const Handler& handler) {
+  if (method < 0 || method >= kNumMethods || pattern.empty() ||
+      pattern[0] != '/') {
+    return false;
+  }
+  if (!roots_[method]) {
+    roots_[method].reset(new Node());
+  }
+  Node* node = Insert(roots_[method].get(), pattern.data(),
+                      pattern.data() + pattern.size());
+  if (node == nullptr || node->handler >= 0) {
+    return false;
+  }
+  node->handler = static_cast<int>(handlers_.size());
+  handlers_.push_back(handler);
+  return true;
+}
+
+HttpRouter::Node* HttpRouter::Insert(Node* node, const char* p,
+                                     const char* end) {
+  while (p != end) {
+    if (*p == ':') {
+      const char* q = static_cast<const char*>(
+          memchr(p, '/', static_cast<size_t>(end - p)));
+      if (q == nullptr) {
+        q = end;
+      }
+      if (p[-1] != '/' || !IsName(p + 1, q)) {
+        return nullptr;
+      }
+      if (!node->param) {
+        node->param.reset(new Node());
+        node->param_name.assign(p + 1, q);
+      } else if (node->param_name.compare(0, std::string::npos, p + 1,
+                                          static_cast<size_t>(q - p - 1)) !=
+                 0) {
+        return nullptr;
+      }
+      node = node->param.get();
+      p = q;
+      continue;
+    }
+
+    if (*p == '*') {
+      if (p[-1] != '/' || (p + 1 != end && !IsName(p + 1, end))) {
+        return nullptr;
+      }
+      if (!node->rest) {
+        node->rest.reset(new Node());
+        node->rest_name.assign(p + 1, end);
+      } else if (node->rest_name.compare(0, std::string::npos, p + 1,
+                                         static_cast<size_t>(end - p - 1)) !=
+                 0) {
+        return nullptr;
+      }
+      return node->rest.get();
+    }
+
+    const char* q = p;
+    while (q != end && *q != ':' && *q != '*') {
+      ++q;
+    }
+    size_t i = node->indices.find(*p);
+    if (i == std::string::npos) {
+      std::unique_ptr<Node> child(new Node());
+      child->prefix.assign(p, q);
+      node->indices.push_back(*p);
+      node->children.push_back(std::move(child));
+      node = node->children.back().get();
+      p = q;
+      continue;
+    }
+    Node* child = node->children[i].get();
+    size_t n = 0;
+    size_t max = std::min(child->prefix.size(), static_cast<size_t>(q - p));
+    while (n < max && child->prefix[n] == p[n]) {
+      ++n;
+    }
+    if (n < child->prefix.size()) {
+      // Splits the edge where the new pattern leaves it.
+      std::unique_ptr<Node> middle(new Node());
+      middle->prefix.assign(child->prefix, 0, n);
+      child->prefix.erase(0, n);
+      middle->indices.push_back(child->prefix[0]);
+      middle->children.push_back(std::move(node->children[i]));
+      node->children[i] = std::move(middle);
+      child = node->children[i].get();
+    }
+    node = child;
+    p += n;
+  }
+  return node;
+}
+
+const HttpRouter::Handler* HttpRouter::Match(HttpRequest::Method method,
+                                             const Slice& path,
+                                             HttpRouteParams* params) const {
+  params->size_ = 0;
+  if (method < 0 || method >= kNumMethods || !roots_[method]) {
+    return nullptr;
+  }
+  const Node* node = Match(roots_[method].get(), path.data(),
+                           path.data() + path.size(), params);
+  return node == nullptr ? nullptr
+                         : &handlers_[static_cast<size_t>(node->handler)];
+}
+
+const HttpRouter::Node* HttpRouter::Match(const Node* node, const char* p,
+                                          const char* end,
+                                          HttpRouteParams* params) {
+  if (p == end) {
+    if (node->handler >= 0) {
+      return node;
+    }
+  } else {
+    const void* index = memchr(node->indices.data(), *p, node->indices.size());
+    if (index != nullptr) {
+      const Node* child = node->children[static_cast<size_t>(
+                              static_cast<const char*>(index) -
+                              node->indices.data())]
+                              .get();
+      size_t n = child->prefix.size();
+      if (static_cast<size_t>(end - p) >= n &&
+          memcmp(p, child->prefix.data(), n) == 0) {
+        const Node* found = Match(child, p + n, end, params);
+        if (found != nullptr) {
+          return found;
+        }
+      }
+    }
+
+    if (node->param && params->size_ < HttpRouteParams::kMaxParams) {
+      const char* q = static_cast<const char*>(
+          memchr(p, '/', static_cast<size_t>(end - p)));
+      if (q == nullptr) {
+        q = end;
+      }
+      if (q != p) {
+        size_t mark = params->size_;
+        params->names_[mark] = Slice(node->param_name);
+        params->values_[mark] = Slice(p, static_cast<size_t>(q - p));
+        ++params->size_;
+        const Node* found = Match(node->param.get(), q, end, params);
+        if (found != nullptr) {
+          return found;
+        }
+        params->size_ = mark;
+      }
+    }
+  }
+
+  if (node->rest && node->rest->handler >= 0 &&
+      params->size_ < HttpRouteParams::kMaxParams) {
+    params->names_[params->size_] = Slice(node->rest_name);
+    params->values_[params->size_] = Slice(p, static_cast<size_t>(end - p));
+    ++params->size_;
+    return node->rest.get();
+  }
+  return nullptr;
+}
+
+void HttpRouter::Handle(const HttpRequestPtr& request,
+                        HttpResponse* response) const {
+  HttpRouteParams params;
+  const Handler* handler = Match(request->GetMethod(), request->Path(), &params);
+  if (handler != nullptr) {
+    (*handler)(request, response, params);
+    return;
+  }
+  std::string allow;
+  for (int i = 0; i < kNumMethods; ++i) {
+    if (i != request->GetMethod() &&
+        Match(static_cast<HttpRequest::Method>(i), request->Path(), &params)) {
+      if (!allow.empty()) {
+        allow += ", ";
+      }
+      allow += kMethodNames[i];
+    }
+  }
+  response->SetVersion(request->Version());
+  if (allow.empty()) {
+    response->SetStatusCode(404);
+  } else {
+    response->SetStatusCode(405);
+    response->AddHeader("Allow", allow);
+  }
+}
+
+}  // namespace voyager
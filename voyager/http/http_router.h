@@ -0,0 +1,98 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_HTTP_HTTP_ROUTER_H_
+#define VOYAGER_HTTP_HTTP_ROUTER_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/util/slice.h"
+
+namespace voyager {
+
+// The parameters captured by a route, as views into the path.
+class HttpRouteParams {
+ public:
+  static const size_t kMaxParams = 16;
+
+  HttpRouteParams() : size_(0) {}
+
+  size_t size() const { return size_; }
+  Slice Name(size_t i) const { return names_[i]; }
+  Slice Value(size_t i) const { return values_[i]; }
+  // The value of the parameter name, empty if there is none.
+  Slice Get(const Slice& name) const;
+
+ private:
+  friend class HttpRouter;
+
+  Slice names_[kMaxParams];
+  Slice values_[kMaxParams];
+  size_t size_;
+};
+
+// Dispatches requests by method and path. The routes of every method are
+// compiled into a radix tree of their static parts, where a segment ":name"
+// matches one path segment and a last segment "*name" (or "*") matches the
+// rest of the path:
+//
+//   HttpRouter router;
+//   router.Add(HttpRequest::kGet, "/users/:id/items/*rest", ShowItems);
+//   server.SetHttpCallback(std::bind(&HttpRouter::Handle, &router,
+//                                    std::placeholders::_1,
+//                                    std::placeholders::_2));
+//
+// Matching walks the path once and allocates nothing. Static segments take
+// precedence over parameters, which take precedence over the rest, so
+// "/users/new" beats "/users/:id"; only when a static branch fails deeper
+// down is the parameter branch tried as well. Add routes before serving.
+class HttpRouter {
+ public:
+  typedef std::function<void(const HttpRequestPtr&, HttpResponse*,
+                             const HttpRouteParams&)>
+      Handler;
+
+  HttpRouter();
+  ~HttpRouter();
+
+  // False if the pattern is malformed, names a parameter differently than
+  // a route which shares it, or is already routed.
+  bool Add(HttpRequest::Method method, const std::string& pattern,
+           const Handler& handler);
+
+  // The handler of the path, nullptr if there is none.
+  const Handler* Match(HttpRequest::Method method, const Slice& path,
+                       HttpRouteParams* params) const;
+
+  // Runs the handler of the request, or answers 404 Not Found, or 405
+  // Method Not Allowed with an Allow header when only the method differs.
+  void Handle(const HttpRequestPtr& request, HttpResponse* response) const;
+
+ private:
+  struct Node;
+
+  static const int kNumMethods = HttpRequest::kPatch + 1;
+
+  Node* Insert(Node* node, const char* p, const char* end);
+  static const Node* Match(const Node* node, const char* p, const char* end,
+                           HttpRouteParams* params);
+
+  std::unique_ptr<Node> roots_[kNumMethods];
+  std::vector<Handler> handlers_;
+
+  // No copying allowed
+  HttpRouter(const HttpRouter&);
+  void operator=(const HttpRouter&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_HTTP_HTTP_ROUTER_H_
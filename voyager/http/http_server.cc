@@ -3,14 +3,32 @@
 // found in the LICENSE file.
 
 #include "voyager/http/http_server.h"
-#include "voyager/http/http_request_parser.h"
+
+#include <string.h>
+
+#include <algorithm>
 
 namespace voyager {
 
 struct HttpServer::Context {
-  explicit Context(const EntryPtr& e) : entry_wp(e) {}
+  explicit Context(const EntryPtr& e)
+      : entry_wp(e), stopped(false), closing(false), http1(false) {}
+  // Whether responses are still being produced, so the connection is not
+  // idle even if nothing moves on it.
+  bool Busy() const {
+    return http2 ? http2->Streams() > 0 : !writers.empty();
+  }
   std::weak_ptr<Entry> entry_wp;
   HttpRequestParser parser;
+  // The responses which are not done yet, in the order of the requests.
+  std::deque<HttpResponseWriterPtr> writers;
+  // Whether reading stopped while max_pipeline_depth of them were pending.
+  bool stopped;
+  // Whether a response which closes the connection is pending.
+  bool closing;
+  // Set once the connection is known to speak HTTP/1, or HTTP/2.
+  bool http1;
+  std::shared_ptr<Http2Session> http2;
 };
 
 struct HttpServer::Entry {
@@ -35,13 +53,24 @@ HttpServer::HttpServer(EventLoop* ev, const HttpServerOptions& options)
       std::bind(&HttpServer::OnConnection, this, std::placeholders::_1));
   server_.SetCloseCallback(
       std::bind(&HttpServer::OnClose, this, std::placeholders::_1));
+  server_.SetWriteCompleteCallback(
+      std::bind(&HttpServer::OnWriteComplete, this, std::placeholders::_1));
   server_.SetMessageCallback(std::bind(&HttpServer::OnMessage, this,
                                        std::placeholders::_1,
                                        std::placeholders::_2));
+  if (options_.compression_level > 0 && HttpCompressor::Available()) {
+    compression_.reset(new HttpCompression(options_.compression_level,
+                                           options_.compression_min_size,
+                                           options_.compression_cache_bytes));
+  }
 }
 
 void HttpServer::Start() {
   server_.Start();
+  if (options_.overload_control) {
+    overload_.reset(new OverloadController(&server_, options_.overload));
+    server_.OwnerEventLoop()->RunInLoop([this]() { overload_->Start(); });
+  }
   if (idle_ticks_ > 0) {
     const std::vector<EventLoop*>* loops = server_.AllLoops();
     for (auto& loop : *loops) {
@@ -57,7 +86,12 @@ void HttpServer::OnConnection(const TcpConnectionPtr& ptr) {
   if (result) {
     EntryPtr entry(new Entry(ptr));
     UpdateBuckets(ptr, entry);
-    ptr->SetContext(new Context(entry));
+    Context* context = new Context(entry);
+    context->parser.SetMaxBodySize(options_.max_body_size);
+    if (body_cb_) {
+      context->parser.SetBodyCallback(body_cb_);
+    }
+    ptr->SetContext(context);
   }
 }
 
@@ -69,37 +103,194 @@ void HttpServer::OnClose(const TcpConnectionPtr& ptr) {
 
 void HttpServer::OnMessage(const TcpConnectionPtr& ptr, Buffer* buf) {
   Context* context = reinterpret_cast<Context*>(ptr->Context());
+  if (!context->http1 && options_.http2) {
+    if (!context->http2 && buf->ReadableSize() > 0) {
+      size_t n = std::min(buf->ReadableSize(), Http2Session::kPrefaceSize);
+      if (memcmp(buf->Peek(), Http2Session::kPreface, n) != 0) {
+        context->http1 = true;
+      } else if (n == Http2Session::kPrefaceSize) {
+        StartHttp2(ptr, context);
+      }
+    }
+    if (!context->http1) {
+      if (context->http2) {
+        // Kept alive if a callback closes the connection.
+        std::shared_ptr<Http2Session> session(context->http2);
+        session->OnMessage(buf);
+      }
+      if (ptr->IsConnected()) {
+        EntryPtr entry = (context->entry_wp).lock();
+        if (entry) {
+          UpdateBuckets(ptr, entry);
+        }
+      }
+      return;
+    }
+  }
+
   HttpRequestParser& parser = context->parser;
-  bool ok = parser.ParseBuffer(buf);
-  if (!ok) {
-    ptr->SendMessage(std::string("HTTP/1.1 400 Bad Request\r\n\r\n"));
-    ptr->ShutDown();
+  std::deque<HttpResponseWriterPtr>& writers = context->writers;
+  if (context->closing) {
+    // Nothing after a response which closes the connection is answered.
+    buf->RetrieveAll();
+    return;
+  }
+  if (overload_ && buf->ReadableSize() > 0 && parser.InHead() &&
+      overload_->Overloaded(ptr->OwnerEventLoop())) {
+    // Fail fast without parsing, the client may retry elsewhere. A request
+    // whose body is arriving is answered first, and so are the ones still
+    // pending.
+    buf->RetrieveAll();
+    if (writers.empty()) {
+      ptr->SendMessage(std::string(
+          "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n"
+          "Content-Length: 0\r\nConnection: close\r\n\r\n"));
+      ptr->ShutDown();
+    } else {
+      HttpResponse response;
+      response.SetVersion(HttpMessage::kHttp11);
+      response.SetStatusCode(503);
+      response.AddHeader("Retry-After", "1");
+      response.AddHeader("Connection", "close");
+      response.SetCloseState(true);
+      Queue(ptr, context, &response);
+    }
+    return;
   }
 
-  if (parser.FinishParse()) {
+  const size_t max_writers = static_cast<size_t>(options_.max_pipeline_depth);
+  OutputChain out;
+  bool close = false;
+  int depth = 0;
+  while (!close && depth < options_.max_pipeline_depth &&
+         writers.size() < max_writers) {
+    if (!parser.ParseBuffer(buf)) {
+      if (writers.empty()) {
+        out.Append(parser.TooLarge()
+                       ? "HTTP/1.1 413 Payload Too Large\r\n\r\n"
+                       : "HTTP/1.1 400 Bad Request\r\n\r\n");
+        close = true;
+      } else {
+        // After the responses still pending.
+        HttpResponse response;
+        response.SetVersion(HttpMessage::kHttp11);
+        response.SetStatusCode(parser.TooLarge() ? 413 : 400);
+        response.SetCloseState(true);
+        Queue(ptr, context, &response);
+      }
+      break;
+    }
+    if (!parser.FinishParse()) {
+      break;
+    }
     HttpRequestPtr request(parser.GetRequest());
+    parser.Reset();
     HttpResponse response;
 
-    std::string s(request->Value(HttpMessage::kConnection));
+    Slice s(request->Value(HttpHeaders::kConnection));
 
-    if (strcasecmp(&*s.begin(), "close") == 0 ||
-        (strcasecmp(&*s.begin(), "keep-alive") != 0 &&
+    if (HttpHeaders::EqualsIgnoreCase(s, "close") ||
+        (!HttpHeaders::EqualsIgnoreCase(s, "keep-alive") &&
          (request->Version() == HttpMessage::kHttp10))) {
       response.SetCloseState(true);
-    } else {
-      parser.Reset();
+    }
+    ++depth;
+    if (options_.http2 && writers.empty() &&
+        Http2Session::Upgradable(*request)) {
+      // RFC 7540 3.2, the response to the request comes on stream 1.
+      out.Append(
+          "HTTP/1.1 101 Switching Protocols\r\n"
+          "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+      ptr->SendMessage(&out);
+      context->http1 = false;
+      StartHttp2(ptr, context);
+      std::shared_ptr<Http2Session> session(context->http2);
+      session->Upgrade(request);
+      if (ptr->IsConnected()) {
+        session->OnMessage(buf);
+      }
+      return;
+    }
+
+    HttpCompressor::Coding coding = HttpCompressor::kIdentity;
+    if (compression_) {
+      coding = HttpCompressor::Negotiate(
+          request->Value(HttpHeaders::kAcceptEncoding));
+    }
+
+    if (stream_cb_) {
+      HttpResponseWriterPtr writer(new HttpResponseWriter(
+          ptr, request->Version(), response.CloseState()));
+      if (compression_) {
+        writer->SetCompression(compression_, request, coding);
+      }
+      writer->SetHead(writers.empty());
+      writer->SetBatch(&out);
+      stream_cb_(request, writer);
+      writer->SetBatch(nullptr);
+      if (writers.empty() && writer->Finished()) {
+        close = writer->Close();
+        continue;
+      }
+      if (writers.empty() && !out.empty()) {
+        // The head writer sends on its own from now on.
+        ptr->SendMessage(&out);
+      }
+      writers.push_back(writer);
+      std::weak_ptr<TcpConnection> wp(ptr);
+      writer->SetDoneCallback([this, wp, buf]() {
+        TcpConnectionPtr p = wp.lock();
+        if (p && p->IsConnected()) {
+          OnWriterDone(p, buf);
+        }
+      });
+      if (response.CloseState()) {
+        // Nothing after it is answered.
+        context->closing = true;
+        break;
+      }
+      continue;
     }
 
     if (http_cb_) {
       http_cb_(request, &response);
     }
+    if (compression_) {
+      compression_->Compress(*request, coding, &response);
+    }
 
-    ptr->SendMessage(&response.ResponseMessage());
-    if (response.CloseState()) {
-      ptr->ShutDown();
+    if (writers.empty()) {
+      response.SerializeTo(&out);
+      close = response.CloseState();
+    } else {
+      Queue(ptr, context, &response);
+      if (response.CloseState()) {
+        break;
+      }
     }
   }
 
+  if (!out.empty()) {
+    ptr->SendMessage(&out);
+  }
+  if (close) {
+    ptr->ShutDown();
+    return;
+  }
+  if (writers.size() >= max_writers && !context->stopped) {
+    // Bounds what piles up in the input until the responses are done.
+    context->stopped = true;
+    ptr->StopRead();
+  } else if (depth == options_.max_pipeline_depth &&
+             buf->ReadableSize() > 0) {
+    // Nothing may be read again, so the rest is not left for the next read.
+    ptr->OwnerEventLoop()->QueueInLoop([this, ptr, buf]() {
+      if (ptr->IsConnected() && buf->ReadableSize() > 0) {
+        OnMessage(ptr, buf);
+      }
+    });
+  }
+
   if (ptr->IsConnected()) {
     EntryPtr entry = (context->entry_wp).lock();
     if (entry) {
@@ -108,13 +299,135 @@ void HttpServer::OnMessage(const TcpConnectionPtr& ptr, Buffer* buf) {
   }
 }
 
+void HttpServer::Queue(const TcpConnectionPtr& ptr, Context* context,
+                       HttpResponse* response) {
+  HttpResponseWriterPtr writer(new HttpResponseWriter(
+      ptr, response->Version(), response->CloseState()));
+  writer->SetHead(false);
+  writer->Send(response);
+  context->writers.push_back(writer);
+  if (response->CloseState()) {
+    context->closing = true;
+  }
+}
+
+void HttpServer::OnWriterDone(const TcpConnectionPtr& ptr, Buffer* buf) {
+  Context* context = reinterpret_cast<Context*>(ptr->Context());
+  std::deque<HttpResponseWriterPtr>& writers = context->writers;
+  while (!writers.empty()) {
+    writers.front()->SetHead(true);
+    if (!writers.front()->Finished()) {
+      break;
+    }
+    bool close = writers.front()->Close();
+    writers.pop_front();
+    if (close) {
+      writers.clear();
+      ptr->ShutDown();
+      return;
+    }
+  }
+  if (context->stopped) {
+    context->stopped = false;
+    ptr->StartRead();
+  }
+  if (buf->ReadableSize() > 0) {
+    OnMessage(ptr, buf);
+  }
+}
+
+void HttpServer::StartHttp2(const TcpConnectionPtr& ptr, Context* context) {
+  context->http2.reset(new Http2Session(
+      ptr, options_.http2_options,
+      std::bind(&HttpServer::OnHttp2Request, this, std::placeholders::_1,
+                std::placeholders::_2, std::placeholders::_3)));
+  if (options_.overload_control) {
+    // Not a 503 of HTTP/1, the new streams are refused on their own.
+    EventLoop* loop = ptr->OwnerEventLoop();
+    context->http2->SetRefuseCallback([this, loop]() {
+      return overload_ && overload_->Overloaded(loop);
+    });
+  }
+  context->http2->SetMaxBodySize(options_.max_body_size);
+  context->http2->Start();
+}
+
+void HttpServer::OnHttp2Request(const std::shared_ptr<Http2Session>& session,
+                                const HttpRequestPtr& request, uint32_t id) {
+  HttpCompressor::Coding coding = HttpCompressor::kIdentity;
+  if (compression_) {
+    coding =
+        HttpCompressor::Negotiate(request->Value(HttpHeaders::kAcceptEncoding));
+  }
+  if (stream_cb_) {
+    HttpResponseWriterPtr writer(new HttpResponseWriter(session, id));
+    if (compression_) {
+      writer->SetCompression(compression_, request, coding);
+    }
+    std::weak_ptr<HttpResponseWriter> wp(writer);
+    session->SetDrainCallback(id, [wp]() {
+      HttpResponseWriterPtr w(wp.lock());
+      if (w) {
+        w->OnWriteComplete();
+      }
+    });
+    stream_cb_(request, writer);
+    return;
+  }
+  HttpResponse response;
+  response.SetVersion(HttpMessage::kHttp20);
+  if (http_cb_) {
+    http_cb_(request, &response);
+  }
+  if (compression_) {
+    compression_->Compress(*request, coding, &response);
+  }
+  session->SubmitResponse(id, &response);
+}
+
+void HttpServer::OnWriteComplete(const TcpConnectionPtr& ptr) {
+  Context* context = reinterpret_cast<Context*>(ptr->Context());
+  if (context == nullptr) {
+    return;
+  }
+  bool busy = context->Busy();
+  if (busy) {
+    // A long download is not idle.
+    EntryPtr entry = (context->entry_wp).lock();
+    if (entry) {
+      UpdateBuckets(ptr, entry);
+    }
+  }
+  if (context->http2) {
+    std::shared_ptr<Http2Session> session(context->http2);
+    session->OnWriteComplete();
+  } else if (busy) {
+    context->writers.front()->OnWriteComplete();
+  }
+}
+
 void HttpServer::OnTimer() {
   auto it = buckets_.find(EventLoop::RunLoop());
   assert(it != buckets_.end());
   if (++(it->second.second) == idle_ticks_) {
     it->second.second = 0;
   }
-  it->second.first.at(it->second.second).clear();
+  Bucket expired;
+  expired.swap(it->second.first.at(it->second.second));
+  for (const EntryPtr& entry : expired) {
+    if (entry->index != it->second.second) {
+      continue;
+    }
+    // A response which takes longer than the keep alive timeout, such as
+    // one answered later by an HttpResponseWriter, keeps the connection.
+    TcpConnectionPtr p = entry->conn_wp.lock();
+    if (p && p->IsConnected()) {
+      Context* context = reinterpret_cast<Context*>(p->Context());
+      if (context != nullptr && context->Busy()) {
+        it->second.first.at(it->second.second).insert(entry);
+      }
+    }
+  }
 }
 
 void HttpServer::UpdateBuckets(const TcpConnectionPtr& ptr,
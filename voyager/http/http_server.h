@@ -5,7 +5,9 @@
 #ifndef VOYAGER_HTTP_HTTP_SERVER_H_
 #define VOYAGER_HTTP_HTTP_SERVER_H_
 
+#include <deque>
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -13,11 +15,16 @@
 #include <vector>
 
 #include "voyager/core/eventloop.h"
+#include "voyager/core/overload_controller.h"
 #include "voyager/core/tcp_connection.h"
 #include "voyager/core/tcp_monitor.h"
 #include "voyager/core/tcp_server.h"
+#include "voyager/http/http2_session.h"
+#include "voyager/http/http_compression.h"
 #include "voyager/http/http_request.h"
+#include "voyager/http/http_request_parser.h"
 #include "voyager/http/http_response.h"
+#include "voyager/http/http_response_writer.h"
 #include "voyager/http/http_server_options.h"
 
 namespace voyager {
@@ -25,14 +32,33 @@ namespace voyager {
 class HttpServer {
  public:
   typedef std::function<void(HttpRequestPtr, HttpResponse*)> HttpCallback;
+  typedef std::function<void(HttpRequestPtr, const HttpResponseWriterPtr&)>
+      StreamCallback;
 
   HttpServer(EventLoop* ev, const HttpServerOptions& options);
 
   void Start();
 
+  int ListenFd() const { return server_.ListenFd(); }
+
+  // Both callbacks serve HTTP/2 as well, with requests of version kHttp20.
   void SetHttpCallback(const HttpCallback& cb) { http_cb_ = cb; }
   void SetHttpCallback(HttpCallback&& cb) { http_cb_ = std::move(cb); }
 
+  // Takes the place of the HttpCallback, to answer with the writer, now or
+  // later from any thread, at once or piece by piece, see
+  // HttpResponseWriter. Later requests of the connection are handled
+  // meanwhile, up to max_pipeline_depth pending ones, and their responses
+  // are held until the ones before are done.
+  void SetStreamCallback(const StreamCallback& cb) { stream_cb_ = cb; }
+
+  // Takes the request bodies piece by piece as they arrive, before the
+  // request is handled, instead of keeping them in the requests. Set it
+  // before Start(). HTTP/2 requests keep their bodies.
+  void SetBodyCallback(const HttpRequestParser::BodyCallback& cb) {
+    body_cb_ = cb;
+  }
+
  private:
   struct Context;
   struct Entry;
@@ -43,17 +69,32 @@ class HttpServer {
   void OnConnection(const TcpConnectionPtr& ptr);
   void OnClose(const TcpConnectionPtr& ptr);
   void OnMessage(const TcpConnectionPtr& ptr, Buffer* buf);
+  void OnWriteComplete(const TcpConnectionPtr& ptr);
+  // Puts a complete response behind the pending ones.
+  void Queue(const TcpConnectionPtr& ptr, Context* context,
+             HttpResponse* response);
+  // The head writer is done: sends what the next ones held, and goes on
+  // with the requests.
+  void OnWriterDone(const TcpConnectionPtr& ptr, Buffer* buf);
+  // Hands the connection over to HTTP/2.
+  void StartHttp2(const TcpConnectionPtr& ptr, Context* context);
+  void OnHttp2Request(const std::shared_ptr<Http2Session>& session,
+                      const HttpRequestPtr& request, uint32_t id);
   void OnTimer();
   void UpdateBuckets(const TcpConnectionPtr& ptr, const EntryPtr& entry);
 
   HttpServerOptions options_;
   HttpCallback http_cb_;
+  StreamCallback stream_cb_;
+  HttpRequestParser::BodyCallback body_cb_;
 
   int idle_ticks_;
   std::map<voyager::EventLoop*, std::pair<BucketList, int>> buckets_;
 
   TcpMonitor monitor_;
   TcpServer server_;
+  std::unique_ptr<OverloadController> overload_;
+  std::shared_ptr<HttpCompression> compression_;
 
   HttpServer(const HttpServer&);
   void operator=(const HttpServer&);
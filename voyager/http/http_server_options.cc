@@ -13,6 +13,13 @@ HttpServerOptions::HttpServerOptions()
       tick_time(2000000),
       keep_alive_time_out(5 * tick_time),
       max_all_connections(60000),
-      max_ip_connections(60) {}
+      max_ip_connections(60),
+      max_pipeline_depth(32),
+      max_body_size(4 * 1024 * 1024),
+      overload_control(false),
+      compression_level(0),
+      compression_min_size(1024),
+      compression_cache_bytes(0),
+      http2(true) {}
 
 }  // namespace voyager
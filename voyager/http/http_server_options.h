@@ -5,9 +5,14 @@
 #ifndef VOYAGER_HTTP_HTTP_SERVER_OPTIONS_H_
 #define VOYAGER_HTTP_HTTP_SERVER_OPTIONS_H_
 
+#include <stddef.h>
 #include <stdint.h>
+
 #include <string>
 
+#include "voyager/core/overload_controller.h"
+#include "voyager/http/http2_session.h"
+
 namespace voyager {
 
 struct HttpServerOptions {
@@ -34,6 +39,50 @@ struct HttpServerOptions {
   // Default: 60
   int max_ip_connections;
 
+  // Default: 32
+  // Pipelined requests which arrive together are answered together, with
+  // one write for the batch. At most this many of them are answered before
+  // the loop turns to other connections, the rest follow in a later batch.
+  int max_pipeline_depth;
+
+  // Default: 4 * 1024 * 1024
+  // Requests with larger bodies are answered with 413 and the connection is
+  // closed, unless a body callback takes the bodies. HTTP/2 requests, whose
+  // bodies are always kept, have their streams answered with 413.
+  size_t max_body_size;
+
+  // Default: false
+  // Sheds load when a loop falls behind, see OverloadController, and the
+  // requests which arrive at an overloaded loop are answered with 503, or
+  // their HTTP/2 streams refused.
+  bool overload_control;
+  OverloadOptions overload;
+
+  // Default: 0
+  // The zlib level, from 1 (fastest) to 9 (smallest), at which the response
+  // bodies are compressed for the clients which accept gzip or deflate, see
+  // HttpCompression. 0 leaves them as they are, and so does a build
+  // without zlib.
+  int compression_level;
+
+  // Default: 1024
+  // Smaller bodies are not worth compressing.
+  size_t compression_min_size;
+
+  // Default: 0
+  // Up to this many bytes of compressed bodies of the responses which have
+  // an ETag are kept, least recently used first out, to be sent again
+  // without compressing them again. 0 keeps none.
+  size_t compression_cache_bytes;
+
+  // Default: true
+  // Speaks HTTP/2 over cleartext TCP (h2c) with the clients which start
+  // with its connection preface, or which ask for it with "Upgrade: h2c".
+  // The requests of a connection are then handled as they arrive, all at
+  // once, and the responses interleaved, see Http2Session.
+  bool http2;
+  Http2Options http2_options;
+
   HttpServerOptions();
 };
 
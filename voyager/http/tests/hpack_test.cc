@@ -0,0 +1,206 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "voyager/http/hpack.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HpackTest {};
+
+typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
+static const size_t kNoLimit = static_cast<size_t>(-1);
+
+static std::string Bytes(const std::vector<int>& bytes) {
+  std::string s;
+  for (int b : bytes) {
+    s.push_back(static_cast<char>(b));
+  }
+  return s;
+}
+
+TEST(HpackTest, Integer) {
+  // RFC 7541 C.1.
+  std::string out;
+  hpack::EncodeInteger(10, 5, 0, &out);
+  ASSERT_EQ(out, Bytes({0x0a}));
+  out.clear();
+  hpack::EncodeInteger(1337, 5, 0xe0, &out);
+  ASSERT_EQ(out, Bytes({0xff, 0x9a, 0x0a}));
+  out.clear();
+  hpack::EncodeInteger(42, 8, 0, &out);
+  ASSERT_EQ(out, Bytes({0x2a}));
+
+  size_t p = 0;
+  uint64_t value;
+  ASSERT_TRUE(hpack::DecodeInteger(Bytes({0xff, 0x9a, 0x0a}), &p, 5, &value));
+  ASSERT_EQ(value, 1337U);
+  ASSERT_EQ(p, 3U);
+  p = 0;
+  ASSERT_TRUE(!hpack::DecodeInteger(Bytes({0x1f, 0x9a}), &p, 5, &value));
+  p = 0;
+  std::string huge(Bytes({0x1f}) + std::string(8, '\xff') + Bytes({0x01}));
+  ASSERT_TRUE(!hpack::DecodeInteger(huge, &p, 5, &value));
+}
+
+TEST(HpackTest, Huffman) {
+  std::string out;
+  hpack::HuffmanEncode("www.example.com", &out);
+  ASSERT_EQ(out, Bytes({0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab,
+                        0x90, 0xf4, 0xff}));
+  ASSERT_EQ(hpack::HuffmanLength("www.example.com"), out.size());
+
+  std::string all;
+  for (int i = 0; i < 256; ++i) {
+    all.push_back(static_cast<char>(i));
+  }
+  out.clear();
+  hpack::HuffmanEncode(all, &out);
+  std::string decoded;
+  ASSERT_TRUE(hpack::HuffmanDecode(out, &decoded));
+  ASSERT_EQ(decoded, all);
+
+  // '0' is 00000, the padding must be ones.
+  decoded.clear();
+  ASSERT_TRUE(!hpack::HuffmanDecode(Bytes({0x00}), &decoded));
+  // Eight bits of padding are too many.
+  decoded.clear();
+  ASSERT_TRUE(!hpack::HuffmanDecode(Bytes({0x07, 0xff}), &decoded));
+  decoded.clear();
+  ASSERT_TRUE(hpack::HuffmanDecode(Bytes({0x07}), &decoded));
+  ASSERT_EQ(decoded, "0");
+}
+
+TEST(HpackTest, Decode) {
+  // RFC 7541 C.4, three requests on a connection, with Huffman coding.
+  HpackDecoder decoder;
+  HeaderList headers;
+  size_t size;
+  ASSERT_TRUE(decoder.Decode(
+      Bytes({0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a,
+             0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff}),
+      kNoLimit, &headers, &size));
+  ASSERT_EQ(headers.size(), 4U);
+  ASSERT_EQ(headers[0].first, ":method");
+  ASSERT_EQ(headers[0].second, "GET");
+  ASSERT_EQ(headers[2].second, "/");
+  ASSERT_EQ(headers[3].first, ":authority");
+  ASSERT_EQ(headers[3].second, "www.example.com");
+  ASSERT_EQ(size, 4 * 32U + 7 + 3 + 7 + 4 + 5 + 1 + 10 + 15);
+
+  headers.clear();
+  ASSERT_TRUE(decoder.Decode(Bytes({0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8,
+                                    0xeb, 0x10, 0x64, 0x9c, 0xbf}),
+                             kNoLimit, &headers, &size));
+  ASSERT_EQ(headers.size(), 5U);
+  ASSERT_EQ(headers[3].second, "www.example.com");
+  ASSERT_EQ(headers[4].first, "cache-control");
+  ASSERT_EQ(headers[4].second, "no-cache");
+
+  headers.clear();
+  ASSERT_TRUE(decoder.Decode(
+      Bytes({0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9, 0x5b,
+             0xa9, 0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xb8, 0xe8,
+             0xb4, 0xbf}),
+      kNoLimit, &headers, &size));
+  ASSERT_EQ(headers.size(), 5U);
+  ASSERT_EQ(headers[1].second, "https");
+  ASSERT_EQ(headers[2].second, "/index.html");
+  ASSERT_EQ(headers[3].second, "www.example.com");
+  ASSERT_EQ(headers[4].first, "custom-key");
+  ASSERT_EQ(headers[4].second, "custom-value");
+
+  // An index past the tables, and a size update after a field.
+  headers.clear();
+  ASSERT_TRUE(!decoder.Decode(Bytes({0xff, 0x00}), kNoLimit, &headers, &size));
+  ASSERT_TRUE(!decoder.Decode(Bytes({0x82, 0x20}), kNoLimit, &headers, &size));
+  ASSERT_TRUE(
+      !decoder.Decode(Bytes({0x3f, 0xe2, 0x1f}), kNoLimit, &headers, &size));
+}
+
+TEST(HpackTest, Limit) {
+  // A large entry, then a block which refers to it many times.
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+  const std::string big(3000, 'v');
+  std::string block;
+  encoder.Begin(&block);
+  encoder.Encode("x-big", big, &block);
+  HeaderList headers;
+  size_t size;
+  ASSERT_TRUE(decoder.Decode(block, 4096, &headers, &size));
+  ASSERT_EQ(headers.size(), 1U);
+
+  block.clear();
+  encoder.Begin(&block);
+  for (int i = 0; i < 1000; ++i) {
+    encoder.Encode("x-big", big, &block);
+  }
+  encoder.Encode("x-new", "n", &block);
+  ASSERT_EQ(block.size(), 1000U + 8);
+  headers.clear();
+  ASSERT_TRUE(decoder.Decode(block, 4096, &headers, &size));
+  ASSERT_EQ(headers.size(), 1U);
+  ASSERT_EQ(size, 1000 * (3005 + 32U) + 6 + 32);
+
+  // The fields past the limit still went into the table.
+  block.clear();
+  encoder.Begin(&block);
+  encoder.Encode("x-new", "n", &block);
+  ASSERT_EQ(block.size(), 1U);
+  headers.clear();
+  ASSERT_TRUE(decoder.Decode(block, 4096, &headers, &size));
+  ASSERT_EQ(headers.size(), 1U);
+  ASSERT_EQ(headers[0].first, "x-new");
+}
+
+TEST(HpackTest, RoundTrip) {
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+  HeaderList fields = {
+      {":status", "200"},
+      {"content-type", "application/json"},
+      {"x-request-id", "a1b2c3"},
+      {"set-cookie", "session=secret"},
+      {"content-length", "1234"},
+  };
+  size_t first = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (i == 2) {
+      encoder.SetMaxTableSize(0);
+    }
+    std::string block;
+    encoder.Begin(&block);
+    for (auto& field : fields) {
+      encoder.Encode(field.first, field.second, &block);
+    }
+    HeaderList headers;
+    size_t size;
+    ASSERT_TRUE(decoder.Decode(block, kNoLimit, &headers, &size));
+    ASSERT_EQ(headers.size(), fields.size());
+    for (size_t j = 0; j < fields.size(); ++j) {
+      ASSERT_EQ(headers[j].first, fields[j].first);
+      ASSERT_EQ(headers[j].second, fields[j].second);
+    }
+    if (i == 0) {
+      first = block.size();
+    } else if (i == 1) {
+      // The indexed fields take a byte each the second time.
+      ASSERT_LT(block.size(), first);
+    } else {
+      ASSERT_EQ(static_cast<uint8_t>(block[0]), 0x20U);
+    }
+  }
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,430 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/http/hpack.h"
+#include "voyager/http/http2_session.h"
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/http/http_response_writer.h"
+#include "voyager/http/http_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class Http2ServerTest {};
+
+enum {
+  kData = 0,
+  kHeaders = 1,
+  kRstStream = 3,
+  kSettings = 4,
+  kPing = 6,
+  kWindowUpdate = 8
+};
+enum { kEndStream = 1, kAck = 1, kEndHeaders = 4 };
+
+struct Frame {
+  uint8_t type;
+  uint8_t flags;
+  uint32_t id;
+  std::string payload;
+};
+
+static void Write(int fd, const std::string& s) {
+  ASSERT_EQ(::write(fd, s.data(), s.size()), static_cast<ssize_t>(s.size()));
+}
+
+static bool ReadFull(int fd, char* p, size_t n) {
+  while (n > 0) {
+    ssize_t got = ::read(fd, p, n);
+    if (got <= 0) {
+      return false;
+    }
+    p += got;
+    n -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+static std::string MakeFrame(uint8_t type, uint8_t flags, uint32_t id,
+                             const std::string& payload) {
+  std::string s;
+  s.push_back(static_cast<char>(payload.size() >> 16));
+  s.push_back(static_cast<char>(payload.size() >> 8));
+  s.push_back(static_cast<char>(payload.size()));
+  s.push_back(static_cast<char>(type));
+  s.push_back(static_cast<char>(flags));
+  s.push_back(static_cast<char>(id >> 24));
+  s.push_back(static_cast<char>(id >> 16));
+  s.push_back(static_cast<char>(id >> 8));
+  s.push_back(static_cast<char>(id));
+  return s + payload;
+}
+
+static bool ReadFrame(int fd, Frame* frame) {
+  char head[9];
+  if (!ReadFull(fd, head, sizeof(head))) {
+    return false;
+  }
+  const uint8_t* h = reinterpret_cast<const uint8_t*>(head);
+  size_t length = (static_cast<size_t>(h[0]) << 16) |
+                  (static_cast<size_t>(h[1]) << 8) | h[2];
+  frame->type = h[3];
+  frame->flags = h[4];
+  frame->id = (static_cast<uint32_t>(h[5] & 0x7f) << 24) |
+              (static_cast<uint32_t>(h[6]) << 16) |
+              (static_cast<uint32_t>(h[7]) << 8) | h[8];
+  frame->payload.resize(length);
+  return length == 0 || ReadFull(fd, &frame->payload[0], length);
+}
+
+// With big copies of a large header, which are indexed after the first.
+static std::string Request(HpackEncoder* encoder, uint32_t id,
+                           const std::string& method, const std::string& path,
+                           bool end_stream, int big = 0) {
+  std::string block;
+  encoder->Begin(&block);
+  encoder->Encode(":method", method, &block);
+  encoder->Encode(":scheme", "http", &block);
+  encoder->Encode(":path", path, &block);
+  encoder->Encode(":authority", "x", &block);
+  for (int i = 0; i < big; ++i) {
+    encoder->Encode("x-big", std::string(3000, 'b'), &block);
+  }
+  return MakeFrame(kHeaders,
+                   static_cast<uint8_t>(kEndHeaders | (end_stream ? 1 : 0)),
+                   id, block);
+}
+
+static std::string WindowUpdate(uint32_t id, uint32_t increment) {
+  std::string payload;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    payload.push_back(static_cast<char>(increment >> shift));
+  }
+  return MakeFrame(kWindowUpdate, 0, id, payload);
+}
+
+// What the client keeps of the responses.
+struct Client {
+  HpackDecoder decoder;
+  std::map<uint32_t, std::map<std::string, std::string>> headers;
+  std::map<uint32_t, std::string> bodies;
+  std::map<uint32_t, bool> ended;
+  // The error codes of the streams reset.
+  std::map<uint32_t, uint32_t> resets;
+  bool settings = false;
+  bool settings_ack = false;
+  bool ping_ack = false;
+
+  // Reads one frame and records it.
+  bool Read(int fd) {
+    Frame frame;
+    if (!ReadFrame(fd, &frame)) {
+      return false;
+    }
+    if (frame.type == kHeaders) {
+      std::vector<std::pair<std::string, std::string>> fields;
+      size_t size;
+      ASSERT_TRUE(decoder.Decode(frame.payload, 1 << 20, &fields, &size));
+      for (auto& field : fields) {
+        headers[frame.id][field.first] = field.second;
+      }
+    } else if (frame.type == kData) {
+      bodies[frame.id] += frame.payload;
+    } else if (frame.type == kRstStream) {
+      ASSERT_EQ(frame.payload.size(), 4U);
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(frame.payload.data());
+      resets[frame.id] = (static_cast<uint32_t>(p[0]) << 24) |
+                         (static_cast<uint32_t>(p[1]) << 16) |
+                         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+    } else if (frame.type == kSettings) {
+      (frame.flags & kAck ? settings_ack : settings) = true;
+    } else if (frame.type == kPing) {
+      ASSERT_EQ(frame.flags & kAck, kAck);
+      ASSERT_EQ(frame.payload, "12345678");
+      ping_ack = true;
+    }
+    if ((frame.type == kHeaders || frame.type == kData) &&
+        (frame.flags & kEndStream)) {
+      ended[frame.id] = true;
+    }
+    return true;
+  }
+};
+
+static void Echo(HttpRequestPtr request, HttpResponse* response) {
+  ASSERT_TRUE(request->Version() == HttpMessage::kHttp20);
+  response->SetVersion(request->Version());
+  std::string body(request->Path() + ":" + request->Body() + "</r>");
+  response->AddHeader("Content-Length", std::to_string(body.size()));
+  response->AddHeader("X-Host", request->Value("Host"));
+  response->SetBody(body);
+}
+
+static void RunServer(const HttpServerOptions& options,
+                      const std::function<void(HttpServer*)>& setup,
+                      const std::function<void(uint16_t)>& f) {
+  EventLoop ev;
+  HttpServer server(&ev, options);
+  setup(&server);
+  server.Start();
+  test::RunServer(&ev, &server, f);
+}
+
+static void RunServer(const std::function<void(HttpServer*)>& setup,
+                      const std::function<void(uint16_t)>& f) {
+  HttpServerOptions options;
+  options.port = 0;
+  RunServer(options, setup, f);
+}
+
+TEST(Http2ServerTest, PriorKnowledge) {
+  RunServer([](HttpServer* server) { server->SetHttpCallback(Echo); },
+            [](uint16_t port) {
+              int fd = test::Connect(port);
+              ASSERT_GE(fd, 0);
+              HpackEncoder encoder;
+              // Two streams at once, the second with a body. The header
+              // blocks are encoded in order, as the table changes.
+              std::string s(Http2Session::kPreface,
+                            Http2Session::kPrefaceSize);
+              s += MakeFrame(kSettings, 0, 0, "");
+              s += Request(&encoder, 1, "GET", "/a", true);
+              s += Request(&encoder, 3, "POST", "/b", false);
+              s += MakeFrame(kData, 0, 3, "hel");
+              Write(fd, s);
+              Write(fd, MakeFrame(kData, kEndStream, 3, "lo") +
+                            MakeFrame(kPing, 0, 0, "12345678"));
+              Client client;
+              while (!(client.ended[1] && client.ended[3] &&
+                       client.ping_ack && client.settings_ack)) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_TRUE(client.settings);
+              ASSERT_EQ(client.headers[1][":status"], "200");
+              ASSERT_EQ(client.headers[1]["x-host"], "x");
+              ASSERT_EQ(client.bodies[1], "/a:</r>");
+              ASSERT_EQ(client.headers[3][":status"], "200");
+              ASSERT_EQ(client.headers[3]["content-length"], "12");
+              ASSERT_EQ(client.bodies[3], "/b:hello</r>");
+
+              // The dynamic tables of both ends stay in step.
+              Write(fd, Request(&encoder, 5, "GET", "/a", true));
+              while (!client.ended[5]) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.bodies[5], "/a:</r>");
+              ::close(fd);
+            });
+}
+
+TEST(Http2ServerTest, FlowControl) {
+  const size_t kSize = 200000;
+  std::vector<std::thread> producers;
+  RunServer(
+      [&producers, kSize](HttpServer* server) {
+        server->SetStreamCallback([&producers, kSize](
+            HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+          HttpResponse response;
+          response.SetVersion(request->Version());
+          writer->WriteHead(&response);
+          producers.push_back(std::thread([writer, kSize]() {
+            writer->Write(std::string(kSize / 2, 'x'));
+            writer->Write(std::string(kSize / 2, 'y'));
+            writer->End();
+          }));
+        });
+      },
+      [kSize](uint16_t port) {
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        HpackEncoder encoder;
+        Write(fd,
+              std::string(Http2Session::kPreface, Http2Session::kPrefaceSize) +
+                  MakeFrame(kSettings, 0, 0, "") +
+                  Request(&encoder, 1, "GET", "/big", true));
+        // No more than the initial window of 65535 bytes comes unasked.
+        Client client;
+        while (client.bodies[1].size() < 65535) {
+          ASSERT_TRUE(client.Read(fd));
+        }
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (::poll(&pfd, 1, 200) > 0) {
+          ASSERT_TRUE(client.Read(fd));
+        }
+        ASSERT_EQ(client.bodies[1].size(), 65535U);
+        ASSERT_TRUE(!client.ended[1]);
+
+        Write(fd, WindowUpdate(0, static_cast<uint32_t>(kSize)) +
+                      WindowUpdate(1, static_cast<uint32_t>(kSize)));
+        while (!client.ended[1]) {
+          ASSERT_TRUE(client.Read(fd));
+        }
+        ASSERT_EQ(client.bodies[1].size(), kSize);
+        ASSERT_EQ(client.bodies[1].find('y'), kSize / 2);
+        ::close(fd);
+      });
+  for (size_t i = 0; i < producers.size(); ++i) {
+    producers[i].join();
+  }
+}
+
+TEST(Http2ServerTest, Upgrade) {
+  RunServer([](HttpServer* server) { server->SetHttpCallback(Echo); },
+            [](uint16_t port) {
+              int fd = test::Connect(port);
+              ASSERT_GE(fd, 0);
+              Write(fd,
+                    "GET /u HTTP/1.1\r\nHost: x\r\n"
+                    "Connection: Upgrade, HTTP2-Settings\r\n"
+                    "Upgrade: h2c\r\n"
+                    "HTTP2-Settings: AAMAAABkAAQAAP__\r\n\r\n");
+              std::string head;
+              char c;
+              while (head.find("\r\n\r\n") == std::string::npos) {
+                ASSERT_TRUE(ReadFull(fd, &c, 1));
+                head.push_back(c);
+              }
+              ASSERT_EQ(head.find("HTTP/1.1 101 "), 0U);
+              ASSERT_NE(head.find("Upgrade: h2c"), std::string::npos);
+
+              // The request becomes stream 1, answered in frames.
+              HpackEncoder encoder;
+              Write(fd, std::string(Http2Session::kPreface,
+                                    Http2Session::kPrefaceSize) +
+                            MakeFrame(kSettings, 0, 0, ""));
+              Client client;
+              while (!client.ended[1]) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.headers[1][":status"], "200");
+              ASSERT_EQ(client.bodies[1], "/u:</r>");
+
+              Write(fd, Request(&encoder, 3, "GET", "/v", true));
+              while (!client.ended[3]) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.bodies[3], "/v:</r>");
+              ::close(fd);
+            });
+}
+
+TEST(Http2ServerTest, HeaderListSize) {
+  RunServer([](HttpServer* server) { server->SetHttpCallback(Echo); },
+            [](uint16_t port) {
+              int fd = test::Connect(port);
+              ASSERT_GE(fd, 0);
+              HpackEncoder encoder;
+              std::string s(Http2Session::kPreface,
+                            Http2Session::kPrefaceSize);
+              s += MakeFrame(kSettings, 0, 0, "");
+              s += Request(&encoder, 1, "GET", "/a", true, 1);
+              // About 90 KB of headers in a block of a few hundred bytes.
+              s += Request(&encoder, 3, "GET", "/b", true, 30);
+              s += Request(&encoder, 5, "GET", "/c", true, 1);
+              Write(fd, s);
+              Client client;
+              while (!(client.ended[1] && client.ended[3] &&
+                       client.ended[5])) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.headers[1][":status"], "200");
+              ASSERT_EQ(client.headers[3][":status"], "431");
+              // The table of the server stayed in step.
+              ASSERT_EQ(client.headers[5][":status"], "200");
+              ASSERT_EQ(client.bodies[5], "/c:</r>");
+              ::close(fd);
+            });
+}
+
+TEST(Http2ServerTest, BodyTooLarge) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.max_body_size = 8;
+  RunServer(options,
+            [](HttpServer* server) { server->SetHttpCallback(Echo); },
+            [](uint16_t port) {
+              int fd = test::Connect(port);
+              ASSERT_GE(fd, 0);
+              HpackEncoder encoder;
+              std::string s(Http2Session::kPreface,
+                            Http2Session::kPrefaceSize);
+              s += MakeFrame(kSettings, 0, 0, "");
+              s += Request(&encoder, 1, "POST", "/a", false);
+              s += MakeFrame(kData, kEndStream, 1, "12345678");
+              s += Request(&encoder, 3, "POST", "/b", false);
+              s += MakeFrame(kData, 0, 3, "12345");
+              s += MakeFrame(kData, kEndStream, 3, "6789");
+              Write(fd, s);
+              Client client;
+              while (!(client.ended[1] && client.ended[3])) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.bodies[1], "/a:12345678</r>");
+              ASSERT_EQ(client.headers[3][":status"], "413");
+              ::close(fd);
+            });
+}
+
+TEST(Http2ServerTest, Overload) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.overload_control = true;
+  options.overload.max_lag_micros = 5000;
+  // Stays overloaded once it is.
+  options.overload.recover_lag_micros = 0;
+  options.overload.interval_micros = 1000;
+  options.overload.shed_connections = 0;
+  RunServer(options,
+            [](HttpServer* server) {
+              server->SetHttpCallback(
+                  [](HttpRequestPtr request, HttpResponse* response) {
+                    // Puts the loop behind.
+                    usleep(30000);
+                    Echo(request, response);
+                  });
+            },
+            [](uint16_t port) {
+              int fd = test::Connect(port);
+              ASSERT_GE(fd, 0);
+              HpackEncoder encoder;
+              Write(fd, std::string(Http2Session::kPreface,
+                                    Http2Session::kPrefaceSize) +
+                            MakeFrame(kSettings, 0, 0, "") +
+                            Request(&encoder, 1, "GET", "/a", true));
+              Client client;
+              while (!client.ended[1]) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.bodies[1], "/a:</r>");
+              usleep(50000);
+
+              // A new stream is refused, the connection stays usable.
+              Write(fd, Request(&encoder, 3, "GET", "/b", true) +
+                            MakeFrame(kPing, 0, 0, "12345678"));
+              while (!client.ping_ack) {
+                ASSERT_TRUE(client.Read(fd));
+              }
+              ASSERT_EQ(client.resets[3], 7U);
+              ASSERT_TRUE(client.bodies.find(3) == client.bodies.end());
+              ::close(fd);
+            });
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
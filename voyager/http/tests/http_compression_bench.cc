@@ -0,0 +1,94 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "voyager/http/http_compression.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+// A JSON API response of about size bytes, with the repetition of real ones
+// rather than that of a single repeated string.
+static std::string MakeBody(size_t size) {
+  const char* names[] = {"alpha", "bravo", "charlie", "delta", "echo",
+                         "foxtrot", "golf", "hotel"};
+  uint32_t seed = 301;
+  std::string body("[");
+  for (int i = 0; body.size() < size; ++i) {
+    seed = seed * 1103515245 + 12345;
+    body += "{\"id\":" + std::to_string(i) + ",\"name\":\"" +
+            names[(seed >> 16) % 8] + "\",\"score\":" +
+            std::to_string((seed >> 8) % 100000) + ",\"active\":" +
+            ((seed & 1) ? "true" : "false") + ",\"tags\":[\"" +
+            names[(seed >> 4) % 8] + "\"]},";
+  }
+  body.back() = ']';
+  return body;
+}
+
+// How long size bytes take on a link of mbits per second, in microseconds.
+static double WireMicros(size_t size, double mbits) {
+  return static_cast<double>(size) * 8.0 / mbits;
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  using namespace voyager;
+  if (!HttpCompressor::Available()) {
+    fprintf(stderr, "built without zlib\n");
+    return 1;
+  }
+  size_t size = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 64 * 1024;
+  int rounds = argc > 2 ? atoi(argv[2]) : 200;
+  const std::string body(MakeBody(size));
+
+  // What each level costs in CPU against what it saves on the wire.
+  fprintf(stdout, "%zu bytes of JSON, gzip, %d rounds\n", body.size(),
+          rounds);
+  fprintf(stdout,
+          "level     bytes  ratio  us/response    MB/s  us@10Mbit/s  "
+          "us@100Mbit/s\n");
+  fprintf(stdout, "%5d %9zu %6.2f %12.1f %7s %12.1f %13.1f\n", 0, body.size(),
+          1.0, 0.0, "-", WireMicros(body.size(), 10),
+          WireMicros(body.size(), 100));
+  for (int level = 1; level <= 9; ++level) {
+    size_t out = 0;
+    uint64_t start = timeops::MonotonicNanos();
+    for (int r = 0; r < rounds; ++r) {
+      out = HttpCompressor::Compress(HttpCompressor::kGzip, level, body).size();
+    }
+    double micros =
+        static_cast<double>(timeops::MonotonicNanos() - start) / 1000.0 /
+        rounds;
+    fprintf(stdout, "%5d %9zu %6.2f %12.1f %7.1f %12.1f %13.1f\n", level, out,
+            static_cast<double>(body.size()) / static_cast<double>(out),
+            micros, static_cast<double>(body.size()) / micros,
+            WireMicros(out, 10), WireMicros(out, 100));
+  }
+
+  // A response with an ETag is compressed once, then taken from the cache.
+  HttpCompression compression(6, 1024, 16 << 20);
+  HttpRequest request;
+  request.SetPath("/api/items");
+  uint64_t start = timeops::MonotonicNanos();
+  for (int r = 0; r < rounds; ++r) {
+    HttpResponse response;
+    response.AddHeader("Content-Type", "application/json");
+    response.AddHeader("ETag", "\"42\"");
+    response.SetBody(body);
+    compression.Compress(request, HttpCompressor::kGzip, &response);
+  }
+  double micros =
+      static_cast<double>(timeops::MonotonicNanos() - start) / 1000.0 /
+      rounds;
+  fprintf(stdout, "level 6 with the cache: %.1f us/response, %zu bytes kept\n",
+          micros, compression.CachedBytes());
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <string>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/http/http_compression.h"
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/http/http_response_writer.h"
+#include "voyager/http/http_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpCompressionTest {};
+
+// Takes both the gzip and the zlib format.
+static std::string Inflate(const std::string& data) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  ASSERT_EQ(inflateInit2(&z, 15 + 32), Z_OK);
+  z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  z.avail_in = static_cast<uInt>(data.size());
+  std::string out;
+  char buf[4096];
+  int r;
+  do {
+    z.next_out = reinterpret_cast<Bytef*>(buf);
+    z.avail_out = sizeof(buf);
+    r = inflate(&z, Z_NO_FLUSH);
+    out.append(buf, sizeof(buf) - z.avail_out);
+  } while (r == Z_OK);
+  ASSERT_EQ(r, Z_STREAM_END);
+  inflateEnd(&z);
+  return out;
+}
+
+static std::string Text(size_t size) {
+  std::string s;
+  for (int i = 0; s.size() < size; ++i) {
+    s += "{\"id\":" + std::to_string(i) + ",\"name\":\"item\"},";
+  }
+  s.resize(size);
+  return s;
+}
+
+TEST(HttpCompressionTest, Negotiate) {
+  ASSERT_EQ(HttpCompressor::Negotiate(""), HttpCompressor::kIdentity);
+  ASSERT_EQ(HttpCompressor::Negotiate("gzip, deflate, br"),
+            HttpCompressor::kGzip);
+  ASSERT_EQ(HttpCompressor::Negotiate("deflate"), HttpCompressor::kDeflate);
+  ASSERT_EQ(HttpCompressor::Negotiate("gzip;q=0.5, deflate"),
+            HttpCompressor::kDeflate);
+  ASSERT_EQ(HttpCompressor::Negotiate("GZIP ; q=1"), HttpCompressor::kGzip);
+  ASSERT_EQ(HttpCompressor::Negotiate("gzip;q=0, deflate;q=0"),
+            HttpCompressor::kIdentity);
+  ASSERT_EQ(HttpCompressor::Negotiate("*"), HttpCompressor::kGzip);
+  ASSERT_EQ(HttpCompressor::Negotiate("gzip;q=0, *"),
+            HttpCompressor::kDeflate);
+  ASSERT_EQ(HttpCompressor::Negotiate("br, identity"),
+            HttpCompressor::kIdentity);
+  ASSERT_TRUE(HttpCompressor::Accepts("x, gzip", HttpCompressor::kGzip));
+  ASSERT_TRUE(!HttpCompressor::Accepts("gzip;q=0", HttpCompressor::kGzip));
+  ASSERT_TRUE(!HttpCompressor::Accepts("gzipped", HttpCompressor::kGzip));
+}
+
+TEST(HttpCompressionTest, Stream) {
+  std::string text(Text(100000));
+  HttpCompressor::Coding codings[] = {HttpCompressor::kGzip,
+                                      HttpCompressor::kDeflate};
+  for (auto coding : codings) {
+    for (int level = 1; level <= 9; level += 4) {
+      std::string whole(HttpCompressor::Compress(coding, level, text));
+      ASSERT_LT(whole.size(), text.size() / 4);
+      ASSERT_EQ(Inflate(whole), text);
+
+      // Each flushed piece can be decompressed at once.
+      HttpCompressor compressor(coding, level);
+      std::string out;
+      for (size_t i = 0; i < text.size(); i += 7000) {
+        compressor.Compress(Slice(text.data() + i,
+                                  std::min<size_t>(7000, text.size() - i)),
+                            &out);
+        compressor.Flush(&out);
+      }
+      compressor.Finish(&out);
+      ASSERT_EQ(Inflate(out), text);
+    }
+  }
+}
+
+TEST(HttpCompressionTest, Response) {
+  HttpCompression compression(6, 1024, 1 << 20);
+  HttpRequest request;
+  request.SetPath("/items");
+
+  HttpResponse small;
+  small.SetBody("tiny");
+  compression.Compress(request, HttpCompressor::kGzip, &small);
+  ASSERT_EQ(small.Body(), "tiny");
+  ASSERT_TRUE(small.Value(HttpHeaders::kVary).empty());
+
+  HttpResponse image;
+  image.AddHeader("Content-Type", "image/png");
+  image.SetBody(Text(4096));
+  compression.Compress(request, HttpCompressor::kGzip, &image);
+  ASSERT_TRUE(image.Value(HttpHeaders::kContentEncoding).empty());
+
+  HttpResponse identity;
+  identity.SetBody(Text(4096));
+  compression.Compress(request, HttpCompressor::kIdentity, &identity);
+  ASSERT_EQ(identity.Body(), Text(4096));
+  ASSERT_EQ(identity.Value(HttpHeaders::kVary).ToString(), "Accept-Encoding");
+
+  // Without an ETag nothing is kept.
+  HttpResponse plain;
+  plain.AddHeader("Content-Type", "application/json");
+  plain.AddHeader("Content-Length", "4096");
+  plain.SetBody(Text(4096));
+  compression.Compress(request, HttpCompressor::kDeflate, &plain);
+  ASSERT_EQ(plain.Value(HttpHeaders::kContentEncoding).ToString(), "deflate");
+  ASSERT_TRUE(!plain.Headers().Has(HttpHeaders::kContentLength));
+  ASSERT_EQ(Inflate(*plain.SharedBody()), Text(4096));
+  ASSERT_EQ(compression.CachedBytes(), 0U);
+
+  std::shared_ptr<const std::string> first;
+  for (int i = 0; i < 2; ++i) {
+    HttpResponse response;
+    response.AddHeader("Content-Type", "text/html");
+    response.AddHeader("ETag", "\"v1\"");
+    response.AddHeader("Vary", "Origin");
+    response.SetBody(Text(8192));
+    compression.Compress(request, HttpCompressor::kGzip, &response);
+    ASSERT_EQ(response.Value(HttpHeaders::kContentEncoding).ToString(),
+              "gzip");
+    ASSERT_EQ(response.Value(HttpHeaders::kETag).ToString(), "W/\"v1\"");
+    ASSERT_EQ(response.Value(HttpHeaders::kVary).ToString(),
+              "Origin, Accept-Encoding");
+    ASSERT_TRUE(response.Body().empty());
+    ASSERT_EQ(Inflate(*response.SharedBody()), Text(8192));
+    if (i == 0) {
+      first = response.SharedBody();
+      ASSERT_EQ(compression.CachedBytes(), first->size());
+    } else {
+      // Sent from the cache.
+      ASSERT_EQ(response.SharedBody(), first);
+    }
+  }
+
+  // The least recently used body goes first.
+  HttpCompression bounded(6, 1024, first->size() + 10);
+  for (int i = 0; i < 2; ++i) {
+    request.SetPath("/" + std::to_string(i));
+    HttpResponse response;
+    response.AddHeader("ETag", "\"v1\"");
+    response.SetBody(Text(8192));
+    bounded.Compress(request, HttpCompressor::kGzip, &response);
+  }
+  ASSERT_EQ(bounded.CachedBytes(), first->size());
+}
+
+static std::string Dechunk(const std::string& s) {
+  std::string body;
+  size_t p = 0;
+  while (p < s.size()) {
+    size_t size = strtoul(s.c_str() + p, nullptr, 16);
+    p = s.find("\r\n", p) + 2;
+    if (size == 0) {
+      break;
+    }
+    body.append(s, p, size);
+    p += size + 2;
+  }
+  return body;
+}
+
+// Sends request on a new connection and reads until the server closes it.
+static std::string Fetch(uint16_t port, const std::string& request) {
+  int fd = test::Connect(port);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(::write(fd, request.data(), request.size()),
+            static_cast<ssize_t>(request.size()));
+  std::string s;
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+    s.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  return s;
+}
+
+TEST(HttpCompressionTest, Server) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.compression_level = 6;
+  const std::string text(Text(50000));
+  EventLoop ev;
+  HttpServer server(&ev, options);
+  server.SetStreamCallback(
+      [&text](HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+        HttpResponse response;
+        response.SetVersion(HttpMessage::kHttp11);
+        response.SetCloseState(true);
+        response.AddHeader("Content-Type", "text/plain");
+        if (request->Path() == "/stream") {
+          writer->WriteHead(&response);
+          for (size_t i = 0; i < text.size(); i += 10000) {
+            writer->Write(Slice(text.data() + i, 10000));
+          }
+          writer->End();
+        } else {
+          response.SetBody(text);
+          writer->Send(&response);
+        }
+      });
+  server.Start();
+  test::RunServer(&ev, &server, [&text](uint16_t port) {
+    std::string s(Fetch(port,
+                        "GET /whole HTTP/1.1\r\n"
+                        "Accept-Encoding: gzip, deflate\r\n\r\n"));
+    size_t head = s.find("\r\n\r\n") + 4;
+    ASSERT_NE(s.find("Content-Encoding: gzip\r\n"), std::string::npos);
+    ASSERT_NE(s.find("Vary: Accept-Encoding\r\n"), std::string::npos);
+    ASSERT_NE(s.find("Content-Length: " + std::to_string(s.size() - head)),
+              std::string::npos);
+    ASSERT_EQ(Inflate(s.substr(head)), text);
+
+    s = Fetch(port,
+              "GET /stream HTTP/1.1\r\nAccept-Encoding: deflate\r\n\r\n");
+    head = s.find("\r\n\r\n") + 4;
+    ASSERT_NE(s.find("Content-Encoding: deflate\r\n"), std::string::npos);
+    ASSERT_NE(s.find("Transfer-Encoding: chunked\r\n"), std::string::npos);
+    ASSERT_EQ(Inflate(Dechunk(s.substr(head))), text);
+
+    s = Fetch(port, "GET /whole HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(s.find("Content-Encoding"), std::string::npos);
+    ASSERT_EQ(s.substr(s.find("\r\n\r\n") + 4), text);
+  });
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,170 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <functional>
+#include <string>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/http/http_date.h"
+#include "voyager/http/http_file_handler.h"
+#include "voyager/http/http_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpFileHandlerTest {};
+
+static void WriteFile(const std::string& path, const std::string& content) {
+  FILE* f = fopen(path.c_str(), "wb");
+  fwrite(content.data(), 1, content.size(), f);
+  fclose(f);
+}
+
+// Sends one request on a new connection and reads until the server closes.
+static std::string Fetch(uint16_t port, const std::string& request) {
+  int fd = test::Connect(port);
+  if (fd == -1) {
+    return "";
+  }
+  std::string s(request + "Connection: close\r\n\r\n");
+  ASSERT_EQ(::write(fd, s.data(), s.size()), static_cast<ssize_t>(s.size()));
+  s.clear();
+  char buf[65536];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+    s.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  return s;
+}
+
+static std::string Body(const std::string& response) {
+  size_t i = response.find("\r\n\r\n");
+  return i == std::string::npos ? "" : response.substr(i + 4);
+}
+
+static std::string Header(const std::string& response,
+                          const std::string& name) {
+  size_t i = response.find("\r\n" + name + ": ");
+  if (i == std::string::npos) {
+    return "";
+  }
+  i += name.size() + 4;
+  return response.substr(i, response.find("\r\n", i) - i);
+}
+
+TEST(HttpFileHandlerTest, Serve) {
+  char dir[] = "/tmp/http_file_handler_testXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  std::string root(dir);
+  std::string big;
+  for (int i = 0; big.size() < 3 * 1024 * 1024; ++i) {
+    big += std::to_string(i) + ",";
+  }
+  WriteFile(root + "/big.txt", big);
+  WriteFile(root + "/index.html", "<html></html>");
+  WriteFile(root + "/app.js", "plain");
+  WriteFile(root + "/app.js.gz", "gzipped");
+  mkdir((root + "/dir").c_str(), 0755);
+
+  HttpServerOptions options;
+  options.port = 0;
+  EventLoop ev;
+  HttpServer server(&ev, options);
+  HttpFileHandler files(root, HttpFileOptions());
+  server.SetHttpCallback(std::bind(&HttpFileHandler::Handle, &files,
+                                   std::placeholders::_1,
+                                   std::placeholders::_2));
+  server.Start();
+  test::RunServer(&ev, &server, [&big](uint16_t port) {
+    std::string s(Fetch(port, "GET /big.txt HTTP/1.1\r\n"));
+    ASSERT_EQ(s.find("HTTP/1.1 200 OK\r\n"), 0U);
+    ASSERT_EQ(Header(s, "Content-Type"), "text/plain; charset=utf-8");
+    ASSERT_EQ(Header(s, "Content-Length"), std::to_string(big.size()));
+    ASSERT_TRUE(Body(s) == big);
+    std::string etag(Header(s, "ETag"));
+    std::string modified(Header(s, "Last-Modified"));
+
+    s = Fetch(port, "HEAD /big.txt HTTP/1.1\r\n");
+    ASSERT_EQ(Header(s, "Content-Length"), std::to_string(big.size()));
+    ASSERT_EQ(Body(s), "");
+
+    s = Fetch(port, "GET /big.txt HTTP/1.1\r\nRange: bytes=10-19\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 206 Partial Content\r\n"), 0U);
+    ASSERT_EQ(Header(s, "Content-Range"),
+              "bytes 10-19/" + std::to_string(big.size()));
+    ASSERT_EQ(Body(s), big.substr(10, 10));
+    s = Fetch(port, "GET /big.txt HTTP/1.1\r\nRange: bytes=-5\r\n");
+    ASSERT_EQ(Body(s), big.substr(big.size() - 5));
+    s = Fetch(port, "GET /big.txt HTTP/1.1\r\nRange: bytes=99999999-\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 416 "), 0U);
+    // A stale If-Range gets the whole file.
+    s = Fetch(port,
+              "GET /big.txt HTTP/1.1\r\nRange: bytes=0-0\r\n"
+              "If-Range: \"stale\"\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 200 OK\r\n"), 0U);
+
+    s = Fetch(port, "GET /big.txt HTTP/1.1\r\nIf-None-Match: " + etag +
+                        "\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 304 Not Modified\r\n"), 0U);
+    ASSERT_EQ(Body(s), "");
+    s = Fetch(port, "GET /big.txt HTTP/1.1\r\nIf-Modified-Since: " +
+                        modified + "\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 304 Not Modified\r\n"), 0U);
+    s = Fetch(port,
+              "GET /big.txt HTTP/1.1\r\n"
+              "If-Modified-Since: Sun, 06 Nov 1994 08:49:37 GMT\r\n");
+    ASSERT_EQ(s.find("HTTP/1.1 200 OK\r\n"), 0U);
+
+    s = Fetch(port, "GET /app.js HTTP/1.1\r\nAccept-Encoding: gzip, br\r\n");
+    ASSERT_EQ(Header(s, "Content-Encoding"), "gzip");
+    ASSERT_EQ(Header(s, "Vary"), "Accept-Encoding");
+    ASSERT_EQ(Body(s), "gzipped");
+    s = Fetch(port, "GET /app.js HTTP/1.1\r\nAccept-Encoding: gzip;q=0\r\n");
+    ASSERT_EQ(Header(s, "Content-Encoding"), "");
+    ASSERT_EQ(Body(s), "plain");
+
+    s = Fetch(port, "GET / HTTP/1.1\r\n");
+    ASSERT_EQ(Body(s), "<html></html>");
+    ASSERT_EQ(Fetch(port, "GET /missing HTTP/1.1\r\n").find("HTTP/1.1 404"),
+              0U);
+    ASSERT_EQ(Fetch(port, "GET /dir HTTP/1.1\r\n").find("HTTP/1.1 404"), 0U);
+    ASSERT_EQ(Fetch(port, "GET /%2e%2e/etc/passwd HTTP/1.1\r\n")
+                  .find("HTTP/1.1 404"),
+              0U);
+    ASSERT_EQ(Fetch(port, "POST /big.txt HTTP/1.1\r\n").find("HTTP/1.1 405"),
+              0U);
+  });
+  ASSERT_LE(files.CachedFiles(), 8U);
+
+  unlink((root + "/big.txt").c_str());
+  unlink((root + "/index.html").c_str());
+  unlink((root + "/app.js").c_str());
+  unlink((root + "/app.js.gz").c_str());
+  rmdir((root + "/dir").c_str());
+  rmdir(dir);
+}
+
+TEST(HttpFileHandlerTest, Date) {
+  time_t t;
+  ASSERT_TRUE(http_date::Parse("Sun, 06 Nov 1994 08:49:37 GMT", &t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_EQ(http_date::Format(t), "Sun, 06 Nov 1994 08:49:37 GMT");
+  ASSERT_TRUE(http_date::Parse("Sunday, 06-Nov-94 08:49:37 GMT", &t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_TRUE(http_date::Parse("Sun Nov  6 08:49:37 1994", &t));
+  ASSERT_EQ(t, 784111777);
+  ASSERT_TRUE(!http_date::Parse("yesterday", &t));
+  ASSERT_TRUE(!http_date::Parse("Sun, 06 Nov 1994 08:49:37 PST", &t));
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,163 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "voyager/core/buffer.h"
+#include "voyager/http/http_head_parser.h"
+#include "voyager/http/http_request_parser.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpHeadParserTest {};
+
+static const char kRequest[] =
+    "GET /search?q=voyager&lang=en HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept:text/html,application/xhtml+xml;q=0.9 \r\n"
+    "X-Empty:\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+TEST(HttpHeadParserTest, Views) {
+  std::string s(kRequest);
+  s += "next";
+  HttpHeadParser head;
+  ASSERT_EQ(head.Parse(s.data(), s.size()), HttpHeadParser::kComplete);
+  ASSERT_EQ(head.HeadSize(), s.size() - 4);
+  ASSERT_EQ(head.GetMethod(), HttpRequest::kGet);
+  ASSERT_EQ(head.Version(), HttpMessage::kHttp11);
+  ASSERT_EQ(head.Path().ToString(), "/search");
+  ASSERT_EQ(head.Query().ToString(), "q=voyager&lang=en");
+  ASSERT_EQ(head.HeaderCount(), 5U);
+  ASSERT_EQ(head.HeaderName(2).ToString(), "Accept");
+  ASSERT_EQ(head.HeaderValue(2).ToString(),
+            "text/html,application/xhtml+xml;q=0.9");
+  ASSERT_EQ(head.HeaderValue(3).size(), 0U);
+  ASSERT_EQ(head.Header("host").ToString(), "www.example.com");
+  ASSERT_EQ(head.Header("CONNECTION").ToString(), "keep-alive");
+  ASSERT_EQ(head.Header("Cookie").size(), 0U);
+  ASSERT_TRUE(head.Header("Host").data() >= s.data() &&
+              head.Header("Host").data() < s.data() + s.size());
+}
+
+TEST(HttpHeadParserTest, Incremental) {
+  std::string s(kRequest);
+  HttpHeadParser head;
+  for (size_t i = 0; i < s.size(); ++i) {
+    ASSERT_EQ(head.Parse(s.data(), i), HttpHeadParser::kIncomplete);
+  }
+  ASSERT_EQ(head.Parse(s.data(), s.size()), HttpHeadParser::kComplete);
+  ASSERT_EQ(head.HeaderCount(), 5U);
+
+  // Bare LF line endings and leading empty lines.
+  std::string lf("\r\n\nPOST /api HTTP/1.0\nContent-Length: 2\n\nok");
+  head.Reset();
+  ASSERT_EQ(head.Parse(lf.data(), lf.size()), HttpHeadParser::kComplete);
+  ASSERT_EQ(head.HeadSize(), lf.size() - 2);
+  ASSERT_EQ(head.GetMethod(), HttpRequest::kPost);
+  ASSERT_EQ(head.Version(), HttpMessage::kHttp10);
+  ASSERT_EQ(head.Header("content-length").ToString(), "2");
+}
+
+TEST(HttpHeadParserTest, Errors) {
+  const char* bad[] = {
+      "GOT / HTTP/1.1\r\n\r\n",
+      "GET HTTP/1.1\r\n\r\n",
+      "GET / HTTP/2.0\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+      "GET / HTTP/1.1\r\n: a\r\n\r\n",
+      "GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n",
+      "GET / HTTP/1.1\r\nA: b\rc\r\n\r\n",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    HttpHeadParser head;
+    std::string s(bad[i]);
+    ASSERT_EQ(head.Parse(s.data(), s.size()), HttpHeadParser::kError);
+  }
+
+  std::string many("GET / HTTP/1.1\r\n");
+  for (size_t i = 0; i <= HttpHeadParser::kMaxHeaders; ++i) {
+    many += "X-" + std::to_string(i) + ": 1\r\n";
+  }
+  many += "\r\n";
+  HttpHeadParser head;
+  ASSERT_EQ(head.Parse(many.data(), many.size()), HttpHeadParser::kError);
+
+  std::string big("GET / HTTP/1.1\r\nX: ");
+  big.append(HttpHeadParser::kMaxHeadSize, 'a');
+  head.Reset();
+  ASSERT_EQ(head.Parse(big.data(), big.size()), HttpHeadParser::kError);
+}
+
+TEST(HttpHeadParserTest, RequestParser) {
+  Buffer buf;
+  buf.Append(kRequest);
+  HttpRequestParser parser;
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(parser.FinishParse());
+  HttpRequestPtr request(parser.GetRequest());
+  ASSERT_EQ(request->Path(), "/search");
+  ASSERT_EQ(request->Query(), "q=voyager&lang=en");
+  ASSERT_EQ(request->Value(HttpHeaders::kHost).ToString(), "www.example.com");
+  ASSERT_EQ(request->Value("connection").ToString(), "keep-alive");
+  ASSERT_EQ(request->Headers().size(), 5U);
+  ASSERT_EQ(buf.ReadableSize(), 0U);
+}
+
+TEST(HttpHeadParserTest, ChunkedBody) {
+  std::string s(
+      "POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+      "5;name=value\r\nhello\r\n"
+      "7\r\n, world\r\n"
+      "0\r\nX-Trailer: 1\r\n\r\n"
+      "GET / HTTP/1.1\r\n\r\n");
+  // Byte by byte, every state has to resume.
+  Buffer buf;
+  HttpRequestParser parser;
+  size_t i = 0;
+  while (!parser.FinishParse()) {
+    ASSERT_LT(i, s.size());
+    buf.Append(s.data() + i++, 1);
+    ASSERT_TRUE(parser.ParseBuffer(&buf));
+  }
+  ASSERT_EQ(parser.GetRequest()->Body(), "hello, world");
+  ASSERT_EQ(s.substr(i), "GET / HTTP/1.1\r\n\r\n");
+
+  // Pieces go to the callback instead.
+  std::string pieces;
+  parser.Reset();
+  parser.SetBodyCallback([&pieces](const HttpRequestPtr&, const Slice& data) {
+    pieces += "[" + data.ToString() + "]";
+  });
+  buf.RetrieveAll();
+  buf.Append(s.data(), 70);
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  buf.Append(s.data() + 70, s.size() - 70);
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(parser.FinishParse());
+  ASSERT_EQ(pieces, "[hel][lo][, world]");
+  ASSERT_EQ(parser.GetRequest()->Body(), "");
+
+  const char* bad[] = {
+      "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+      "Content-Length: 5\r\n\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n",
+      "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nab",
+  };
+  for (size_t j = 0; j < sizeof(bad) / sizeof(bad[0]); ++j) {
+    HttpRequestParser p;
+    Buffer b;
+    b.Append(bad[j]);
+    ASSERT_TRUE(!p.ParseBuffer(&b));
+  }
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,121 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ctype.h>
+
+#include <string>
+
+#include "voyager/http/http_headers.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpHeadersTest {};
+
+TEST(HttpHeadersTest, Interned) {
+  for (int i = 1; i < HttpHeaders::kNumIds; ++i) {
+    HttpHeaders::Id id = static_cast<HttpHeaders::Id>(i);
+    std::string name(HttpHeaders::Name(id));
+    ASSERT_EQ(HttpHeaders::ToId(name), id);
+    for (size_t j = 0; j < name.size(); ++j) {
+      name[j] = static_cast<char>(tolower(name[j]));
+    }
+    ASSERT_EQ(HttpHeaders::ToId(name), id);
+  }
+  ASSERT_EQ(HttpHeaders::ToId("X-Trace-Id"), HttpHeaders::kOther);
+  ASSERT_EQ(HttpHeaders::ToId("Hosts"), HttpHeaders::kOther);
+  ASSERT_EQ(HttpHeaders::ToId(""), HttpHeaders::kOther);
+}
+
+TEST(HttpHeadersTest, Lookup) {
+  HttpHeaders headers;
+  headers.Add("host", "example.com");
+  headers.Add("X-Trace-Id", "abc");
+  headers.Add("Set-Cookie", "a=1");
+  headers.Add("set-cookie", "b=2");
+  ASSERT_EQ(headers.size(), 4U);
+  ASSERT_EQ(headers.Get(HttpHeaders::kHost).ToString(), "example.com");
+  ASSERT_EQ(headers.Get("HOST").ToString(), "example.com");
+  ASSERT_EQ(headers.Get("x-trace-id").ToString(), "abc");
+  ASSERT_EQ(headers.Get(HttpHeaders::kSetCookie).ToString(), "a=1");
+  ASSERT_TRUE(!headers.Has(HttpHeaders::kContentLength));
+  ASSERT_TRUE(headers.Get("X-Missing").empty());
+  ASSERT_EQ(headers.Name(0).ToString(), "host");
+
+  headers.Set("Set-Cookie", "c=3");
+  ASSERT_EQ(headers.size(), 3U);
+  ASSERT_EQ(headers.Get(HttpHeaders::kSetCookie).ToString(), "c=3");
+  headers.Remove("x-TRACE-id");
+  ASSERT_EQ(headers.size(), 2U);
+  ASSERT_TRUE(headers.Get("X-Trace-Id").empty());
+  ASSERT_EQ(headers.Name(1).ToString(), "Set-Cookie");
+  headers.Clear();
+  ASSERT_TRUE(headers.empty());
+  ASSERT_TRUE(!headers.Has(HttpHeaders::kHost));
+}
+
+TEST(HttpHeadersTest, Overflow) {
+  HttpHeaders headers;
+  std::string big(1000, 'v');
+  for (int i = 0; i < 40; ++i) {
+    headers.Add("X-" + std::to_string(i), std::to_string(i));
+  }
+  headers.Add("Cookie", big);
+  // Our own Slices survive the arena growing.
+  headers.Add(headers.Name(3), headers.Get("Cookie"));
+  headers.Add("Date", headers.Value(40));
+  ASSERT_EQ(headers.size(), 43U);
+  for (int i = 0; i < 40; ++i) {
+    ASSERT_EQ(headers.Get("x-" + std::to_string(i)).ToString(),
+              std::to_string(i));
+  }
+  ASSERT_EQ(headers.Get(HttpHeaders::kCookie).ToString(), big);
+  ASSERT_EQ(headers.Value(41).ToString(), big);
+  ASSERT_EQ(headers.Get(HttpHeaders::kDate).ToString(), big);
+
+  headers.Remove("X-0");
+  ASSERT_EQ(headers.Get(HttpHeaders::kCookie).ToString(), big);
+  ASSERT_EQ(headers.Name(15).ToString(), "X-16");
+
+  HttpHeaders copy(headers);
+  headers.Clear();
+  ASSERT_EQ(copy.size(), 42U);
+  ASSERT_EQ(copy.Get("X-39").ToString(), "39");
+  ASSERT_EQ(copy.Get(HttpHeaders::kDate).ToString(), big);
+}
+
+TEST(HttpHeadersTest, Reuse) {
+  HttpHeaders headers;
+  headers.Add("Content-Length", "12345");
+  headers.Add("X-Trace-Id", "abc");
+  // A value which fits is overwritten in its place.
+  const char* p = headers.Get(HttpHeaders::kContentLength).data();
+  headers.Set("content-length", "42");
+  ASSERT_EQ(headers.Get(HttpHeaders::kContentLength).ToString(), "42");
+  ASSERT_TRUE(headers.Get(HttpHeaders::kContentLength).data() == p);
+  ASSERT_EQ(headers.Name(0).ToString(), "Content-Length");
+  // A longer one goes to the end, also from a Slice of our own.
+  headers.Set("Content-Length", "123456789");
+  headers.Set("X-Trace-Id", headers.Get(HttpHeaders::kContentLength));
+  ASSERT_EQ(headers.Name(1).ToString(), "X-Trace-Id");
+  ASSERT_EQ(headers.Get("X-Trace-Id").ToString(), "123456789");
+
+  // The bytes of removed headers are reused, the arena stays inline.
+  std::string big(200, 'v');
+  for (int i = 0; i < 100; ++i) {
+    headers.Add("X-Big", big);
+    headers.Remove("X-Big");
+  }
+  headers.Add("X-Big", big);
+  const char* begin = reinterpret_cast<const char*>(&headers);
+  const char* data = headers.Get("X-Big").data();
+  ASSERT_TRUE(data >= begin && data < begin + sizeof(headers));
+  ASSERT_EQ(headers.Get("X-Big").ToString(), big);
+  ASSERT_EQ(headers.Get(HttpHeaders::kContentLength).ToString(), "123456789");
+  ASSERT_EQ(headers.Get("X-Trace-Id").ToString(), "123456789");
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
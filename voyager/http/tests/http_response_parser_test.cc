@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "voyager/core/buffer.h"
+#include "voyager/http/http_response_parser.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpResponseParserTest {};
+
+// Feeds s one byte at a time, as the worst split of the network would.
+static bool FeedBytes(HttpResponseParser* parser, Buffer* buf,
+                      const std::string& s) {
+  for (size_t i = 0; i < s.size(); ++i) {
+    buf->Append(s.data() + i, 1);
+    if (!parser->ParseBuffer(buf)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(HttpResponseParserTest, ContentLength) {
+  HttpResponseParser parser;
+  Buffer buf;
+  ASSERT_TRUE(FeedBytes(&parser, &buf,
+                        "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhel"));
+  ASSERT_TRUE(!parser.FinishParse());
+  // The rest, and the next response behind it.
+  buf.Append(Slice("loHTTP/1.1 204 No Content\r\n\r\n"));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(parser.FinishParse());
+  ASSERT_EQ(parser.GetResponse()->StatusCode(), 200);
+  ASSERT_EQ(parser.GetResponse()->Body(), "hello");
+  parser.Reset();
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(parser.FinishParse());
+  ASSERT_EQ(parser.GetResponse()->StatusCode(), 204);
+  ASSERT_EQ(buf.ReadableSize(), 0U);
+}
+
+TEST(HttpResponseParserTest, Chunked) {
+  HttpResponseParser parser;
+  Buffer buf;
+  ASSERT_TRUE(FeedBytes(&parser, &buf,
+                        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                        "5;ext=1\r\nhello\r\n1\r\n \r\nA\r\n0123456789\r\n"
+                        "0\r\nX-Trailer: t\r\n\r\n"));
+  ASSERT_TRUE(parser.FinishParse());
+  ASSERT_EQ(parser.GetResponse()->Body(), "hello 0123456789");
+
+  parser.Reset();
+  buf.Append(Slice(
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"));
+  ASSERT_TRUE(!parser.ParseBuffer(&buf));
+}
+
+TEST(HttpResponseParserTest, Stream) {
+  HttpResponseParser parser;
+  std::string body;
+  size_t pieces = 0;
+  parser.SetBodyCallback(
+      [&body, &pieces](const HttpResponsePtr&, const Slice& data) {
+        body.append(data.data(), data.size());
+        ++pieces;
+      });
+  Buffer buf;
+  buf.Append(Slice(
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n"));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_EQ(body, "abc");
+  buf.Append(Slice("2\r\nde\r\n0\r\n\r\n"));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(parser.FinishParse());
+  ASSERT_EQ(body, "abcde");
+  ASSERT_EQ(pieces, 2U);
+  ASSERT_TRUE(parser.GetResponse()->Body().empty());
+}
+
+TEST(HttpResponseParserTest, UntilClose) {
+  HttpResponseParser parser;
+  Buffer buf;
+  buf.Append(Slice("HTTP/1.0 200 OK\r\n\r\nall of "));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  buf.Append(Slice("it"));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(!parser.FinishParse());
+  ASSERT_TRUE(parser.Close());
+  ASSERT_EQ(parser.GetResponse()->Body(), "all of it");
+
+  // A response cut short is not complete.
+  parser.Reset();
+  buf.Append(Slice("HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\nall"));
+  ASSERT_TRUE(parser.ParseBuffer(&buf));
+  ASSERT_TRUE(!parser.Close());
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
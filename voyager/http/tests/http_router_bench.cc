@@ -0,0 +1,138 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "voyager/http/http_router.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+// 100 resources of a REST API with 10 routes each.
+static void MakeRoutes(std::vector<std::string>* patterns,
+                       std::vector<std::string>* paths) {
+  const char* shapes[][2] = {
+      {"", ""},
+      {"/:id", "/12345"},
+      {"/:id/history", "/12345/history"},
+      {"/:id/owner", "/12345/owner"},
+      {"/:id/items", "/12345/items"},
+      {"/:id/items/:item", "/12345/items/678"},
+      {"/:id/items/:item/tags", "/12345/items/678/tags"},
+      {"/search", "/search"},
+      {"/export/*path", "/export/2016/11/report.csv"},
+      {"/stats/daily", "/stats/daily"},
+  };
+  for (int r = 0; r < 100; ++r) {
+    std::string resource("/api/v1/resource" + std::to_string(r));
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); ++s) {
+      patterns->push_back(resource + shapes[s][0]);
+      paths->push_back(resource + shapes[s][1]);
+    }
+  }
+}
+
+// What an if/else chain over the path amounts to: every pattern is tried in
+// turn, segment by segment.
+static bool MatchPattern(const std::string& pattern, const std::string& path) {
+  size_t i = 0;
+  size_t j = 0;
+  while (i < pattern.size() && j <= path.size()) {
+    if (pattern[i] == '*') {
+      return true;
+    }
+    if (pattern[i] == ':') {
+      while (i < pattern.size() && pattern[i] != '/') {
+        ++i;
+      }
+      size_t start = j;
+      while (j < path.size() && path[j] != '/') {
+        ++j;
+      }
+      if (j == start) {
+        return false;
+      }
+      continue;
+    }
+    if (j == path.size() || pattern[i] != path[j]) {
+      return false;
+    }
+    ++i;
+    ++j;
+  }
+  return i == pattern.size() && j == path.size();
+}
+
+static int LinearMatch(const std::vector<std::string>& patterns,
+                       const std::string& path) {
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    if (MatchPattern(patterns[i], path)) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  using namespace voyager;
+  int rounds = argc > 1 ? atoi(argv[1]) : 1000;
+  std::vector<std::string> patterns;
+  std::vector<std::string> paths;
+  MakeRoutes(&patterns, &paths);
+
+  HttpRouter router;
+  std::vector<int> hits(patterns.size(), 0);
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    int* hit = &hits[i];
+    if (!router.Add(HttpRequest::kGet, patterns[i],
+                    [hit](const HttpRequestPtr&, HttpResponse*,
+                          const HttpRouteParams&) { ++*hit; })) {
+      fprintf(stderr, "bad route %s\n", patterns[i].c_str());
+      return 1;
+    }
+  }
+
+  HttpRouteParams params;
+  uint64_t start = timeops::MonotonicNanos();
+  for (int r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      const HttpRouter::Handler* handler =
+          router.Match(HttpRequest::kGet, paths[i], &params);
+      (*handler)(HttpRequestPtr(), nullptr, params);
+    }
+  }
+  uint64_t nanos = timeops::MonotonicNanos() - start;
+  for (size_t i = 0; i < hits.size(); ++i) {
+    if (hits[i] != rounds) {
+      fprintf(stderr, "%s routed wrong\n", paths[i].c_str());
+      return 1;
+    }
+  }
+  uint64_t matches = static_cast<uint64_t>(rounds) * paths.size();
+  fprintf(stdout, "%zu routes, HttpRouter     %8.1f ns/match\n",
+          patterns.size(),
+          static_cast<double>(nanos) / static_cast<double>(matches));
+
+  // The linear scan is far slower, so it gets fewer rounds.
+  int linear_rounds = rounds / 100 > 0 ? rounds / 100 : 1;
+  int found = 0;
+  start = timeops::MonotonicNanos();
+  for (int r = 0; r < linear_rounds; ++r) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      found += LinearMatch(patterns, paths[i]) == static_cast<int>(i);
+    }
+  }
+  nanos = timeops::MonotonicNanos() - start;
+  matches = static_cast<uint64_t>(linear_rounds) * paths.size();
+  fprintf(stdout, "%zu routes, linear scan    %8.1f ns/match (%d found)\n",
+          patterns.size(),
+          static_cast<double>(nanos) / static_cast<double>(matches), found);
+  return 0;
+}
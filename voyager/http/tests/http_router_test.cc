@@ -0,0 +1,108 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <memory>
+#include <string>
+
+#include "voyager/http/http_router.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpRouterTest {};
+
+static HttpRouter::Handler Named(const std::string& name) {
+  return [name](const HttpRequestPtr&, HttpResponse* response,
+                const HttpRouteParams&) { response->SetBody(name); };
+}
+
+// The name of the route which matched, or "". The params point into path.
+static std::string Route(const HttpRouter& router, HttpRequest::Method method,
+                         const char* path, HttpRouteParams* params) {
+  const HttpRouter::Handler* handler = router.Match(method, path, params);
+  if (handler == nullptr) {
+    return "";
+  }
+  HttpResponse response;
+  (*handler)(HttpRequestPtr(), &response, *params);
+  return response.Body();
+}
+
+TEST(HttpRouterTest, Match) {
+  HttpRouter router;
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/", Named("root")));
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/users", Named("users")));
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/users/new", Named("new")));
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/users/:id", Named("user")));
+  ASSERT_TRUE(
+      router.Add(HttpRequest::kGet, "/users/:id/items/*rest", Named("items")));
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/usage", Named("usage")));
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/static/*", Named("static")));
+  ASSERT_TRUE(router.Add(HttpRequest::kPost, "/users", Named("create")));
+
+  HttpRouteParams params;
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/", &params), "root");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users", &params), "users");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/usage", &params), "usage");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users/new", &params), "new");
+  ASSERT_EQ(params.size(), 0U);
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users/42", &params), "user");
+  ASSERT_EQ(params.Get("id").ToString(), "42");
+  // The static branch fails deeper down, the parameter takes it.
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users/new/items/a/b", &params),
+            "items");
+  ASSERT_EQ(params.size(), 2U);
+  ASSERT_EQ(params.Get("id").ToString(), "new");
+  ASSERT_EQ(params.Get("rest").ToString(), "a/b");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/static/", &params), "static");
+  ASSERT_EQ(params.Value(0).ToString(), "");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/static/css/a.css", &params),
+            "static");
+  ASSERT_EQ(params.Value(0).ToString(), "css/a.css");
+  ASSERT_EQ(Route(router, HttpRequest::kPost, "/users", &params), "create");
+
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/user", &params), "");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users/", &params), "");
+  ASSERT_EQ(Route(router, HttpRequest::kGet, "/users/1/items", &params), "");
+  ASSERT_EQ(Route(router, HttpRequest::kDelete, "/users", &params), "");
+}
+
+TEST(HttpRouterTest, Invalid) {
+  HttpRouter router;
+  ASSERT_TRUE(router.Add(HttpRequest::kGet, "/a/:id", Named("a")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "/a/:id", Named("again")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "/a/:name/b", Named("renamed")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "a", Named("relative")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "/b/:", Named("unnamed")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "/b/x:y", Named("inside")));
+  ASSERT_TRUE(!router.Add(HttpRequest::kGet, "/b/*rest/c", Named("middle")));
+}
+
+TEST(HttpRouterTest, Handle) {
+  HttpRouter router;
+  router.Add(HttpRequest::kGet, "/a", Named("a"));
+  router.Add(HttpRequest::kPut, "/a", Named("a"));
+
+  HttpRequestPtr request(new HttpRequest());
+  request->SetPath("/a");
+  HttpResponse ok;
+  router.Handle(request, &ok);
+  ASSERT_EQ(ok.StatusCode(), 200);
+  ASSERT_EQ(ok.Body(), "a");
+
+  request->SetMethod(HttpRequest::kPost);
+  HttpResponse not_allowed;
+  router.Handle(request, &not_allowed);
+  ASSERT_EQ(not_allowed.StatusCode(), 405);
+  ASSERT_EQ(not_allowed.Value("Allow").ToString(), "GET, PUT");
+
+  request->SetPath("/b");
+  HttpResponse not_found;
+  router.Handle(request, &not_found);
+  ASSERT_EQ(not_found.StatusCode(), 404);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
@@ -0,0 +1,426 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voyager/core/eventloop.h"
+#include "voyager/core/tests/test_server.h"
+#include "voyager/http/http_request.h"
+#include "voyager/http/http_response.h"
+#include "voyager/http/http_response_writer.h"
+#include "voyager/http/http_server.h"
+#include "voyager/util/testharness.h"
+
+namespace voyager {
+
+class HttpServerTest {};
+
+static void Write(int fd, const std::string& s) {
+  ASSERT_EQ(::write(fd, s.data(), s.size()), static_cast<ssize_t>(s.size()));
+}
+
+static size_t Count(const std::string& s, const std::string& what) {
+  size_t n = 0;
+  for (size_t i = s.find(what); i != std::string::npos;
+       i = s.find(what, i + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+// Reads until n responses ending with "</r>" arrived, or the peer closed.
+static std::string ReadResponses(int fd, size_t n) {
+  std::string s;
+  char buf[4096];
+  while (Count(s, "</r>") < n) {
+    ssize_t got = ::read(fd, buf, sizeof(buf));
+    if (got <= 0) {
+      break;
+    }
+    s.append(buf, static_cast<size_t>(got));
+  }
+  return s;
+}
+
+// Reads until the peer closed.
+static std::string ReadAll(int fd) {
+  std::string s;
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+    s.append(buf, static_cast<size_t>(n));
+  }
+  return s;
+}
+
+// Answers with the path and the body of the request.
+static void Echo(HttpRequestPtr request, HttpResponse* response) {
+  response->SetVersion(request->Version());
+  std::string body(request->Path() + ":" + request->Body() + "</r>");
+  response->AddHeader("Content-Length", std::to_string(body.size()));
+  response->SetBody(body);
+}
+
+static void UseEcho(HttpServer* server) { server->SetHttpCallback(Echo); }
+
+static void RunServer(const HttpServerOptions& options,
+                      const std::function<void(HttpServer*)>& setup,
+                      const std::function<void(uint16_t)>& f) {
+  EventLoop ev;
+  HttpServer server(&ev, options);
+  setup(&server);
+  server.Start();
+  test::RunServer(&ev, &server, f);
+}
+
+static void RunServer(int depth, const std::function<void(HttpServer*)>& setup,
+                      const std::function<void(uint16_t)>& f) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.max_pipeline_depth = depth;
+  RunServer(options, setup, f);
+}
+
+TEST(HttpServerTest, Pipeline) {
+  RunServer(32, UseEcho, [](uint16_t port) {
+    int fd = test::Connect(port);
+    ASSERT_GE(fd, 0);
+    // A batch with a body, then a request split inside its body.
+    Write(fd,
+          "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+          "PUT /b HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+          "GET /c HTTP/1.1\r\n\r\n"
+          "POST /d HTTP/1.1\r\nContent-Length: 4\r\n\r\nde");
+    std::string s(ReadResponses(fd, 3));
+    ASSERT_EQ(Count(s, "HTTP/1.1 200 OK"), 3U);
+    size_t a = s.find("/a:</r>");
+    size_t b = s.find("/b:abc</r>");
+    size_t c = s.find("/c:</r>");
+    ASSERT_TRUE(a < b && b < c && c != std::string::npos);
+    Write(fd, "fg");
+    s = ReadResponses(fd, 1);
+    ASSERT_NE(s.find("/d:defg</r>"), std::string::npos);
+    ::close(fd);
+  });
+}
+
+TEST(HttpServerTest, Depth) {
+  RunServer(2, UseEcho, [](uint16_t port) {
+    int fd = test::Connect(port);
+    ASSERT_GE(fd, 0);
+    std::string batch;
+    for (int i = 0; i < 7; ++i) {
+      batch += "GET /" + std::to_string(i) + " HTTP/1.1\r\n\r\n";
+    }
+    Write(fd, batch);
+    std::string s(ReadResponses(fd, 7));
+    ASSERT_EQ(Count(s, "</r>"), 7U);
+    for (int i = 1; i < 7; ++i) {
+      ASSERT_LT(s.find("/" + std::to_string(i - 1) + ":"),
+                s.find("/" + std::to_string(i) + ":"));
+    }
+    ::close(fd);
+  });
+}
+
+TEST(HttpServerTest, BadRequest) {
+  RunServer(32, UseEcho, [](uint16_t port) {
+    int fd = test::Connect(port);
+    ASSERT_GE(fd, 0);
+    Write(fd,
+          "GET /ok HTTP/1.1\r\n\r\n"
+          "GET /bad HTTP/1.1\r\nContent-Length: x\r\n\r\n"
+          "GET /never HTTP/1.1\r\n\r\n");
+    std::string s(ReadResponses(fd, 2));
+    ASSERT_NE(s.find("/ok:</r>"), std::string::npos);
+    ASSERT_NE(s.find("400 Bad Request"), std::string::npos);
+    ASSERT_EQ(s.find("/never"), std::string::npos);
+    ::close(fd);
+  });
+}
+
+TEST(HttpServerTest, BodyTooLarge) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.max_body_size = 8;
+  RunServer(options, UseEcho, [](uint16_t port) {
+    int fd = test::Connect(port);
+    ASSERT_GE(fd, 0);
+    Write(fd,
+          "POST /a HTTP/1.1\r\nContent-Length: 4\r\n\r\nabcd"
+          "POST /b HTTP/1.1\r\nContent-Length: 9\r\n\r\n123456789");
+    std::string s(ReadAll(fd));
+    ASSERT_NE(s.find("/a:abcd</r>"), std::string::npos);
+    ASSERT_NE(s.find("HTTP/1.1 413 Payload Too Large\r\n"), std::string::npos);
+    ASSERT_EQ(s.find("/b:"), std::string::npos);
+    ::close(fd);
+
+    // A chunked body is only known to be too large as it arrives.
+    fd = test::Connect(port);
+    ASSERT_GE(fd, 0);
+    Write(fd,
+          "POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+          "5\r\n12345\r\n5\r\n67890\r\n0\r\n\r\n");
+    s = ReadAll(fd);
+    ASSERT_EQ(s.find("HTTP/1.1 413 Payload Too Large\r\n"), 0U);
+    ::close(fd);
+  });
+}
+
+TEST(HttpServerTest, Stream) {
+  std::vector<std::thread> producers;
+  std::string uploaded;
+  RunServer(
+      32,
+      [&producers, &uploaded](HttpServer* server) {
+        server->SetBodyCallback(
+            [&uploaded](const HttpRequestPtr&, const Slice& data) {
+              uploaded.append(data.data(), data.size());
+            });
+        server->SetStreamCallback([&producers](
+            HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+          HttpResponse response;
+          response.SetVersion(request->Version());
+          if (request->Path() != "/stream") {
+            response.SetBody(request->Path() + ":</r>");
+            writer->Send(&response);
+            return;
+          }
+          writer->WriteHead(&response);
+          writer->Write("a");
+          // The rest comes later from another thread.
+          producers.push_back(std::thread([writer]() {
+            usleep(10000);
+            writer->Write("bc");
+            writer->Write("");
+            writer->End();
+          }));
+        });
+      },
+      [](uint16_t port) {
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        Write(fd,
+              "GET /first HTTP/1.1\r\n\r\n"
+              "POST /stream HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+              "3\r\nup-\r\n4\r\nload\r\n0\r\n\r\n"
+              "GET /last HTTP/1.1\r\n\r\n");
+        std::string s(ReadResponses(fd, 2));
+        size_t first = s.find("/first:</r>");
+        size_t chunks = s.find(
+            "Transfer-Encoding: chunked\r\n\r\n"
+            "1\r\na\r\n2\r\nbc\r\n0\r\n\r\n");
+        size_t last = s.find("/last:</r>");
+        ASSERT_TRUE(first < chunks && chunks < last &&
+                    last != std::string::npos);
+
+        // An HTTP/1.0 stream ends with the connection.
+        int fd10 = test::Connect(port);
+        Write(fd10, "GET /stream HTTP/1.0\r\n\r\n");
+        s = ReadAll(fd10);
+        ASSERT_EQ(s.substr(s.size() - 7), "\r\n\r\nabc");
+        ::close(fd10);
+        ::close(fd);
+      });
+  for (size_t i = 0; i < producers.size(); ++i) {
+    producers[i].join();
+  }
+  ASSERT_EQ(uploaded, "up-load");
+}
+
+TEST(HttpServerTest, Serialize) {
+  std::shared_ptr<const std::string> big(new std::string(1 << 20, 'x'));
+  RunServer(
+      32,
+      [&big](HttpServer* server) {
+        server->SetHttpCallback(
+            [&big](HttpRequestPtr request, HttpResponse* response) {
+              response->SetVersion(request->Version());
+              if (request->Path() == "/big") {
+                response->SetStatusCode(404);
+                response->SetSharedBody(big);
+              } else {
+                response->SetStatusCode(204);
+              }
+            });
+      },
+      [&big](uint16_t port) {
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        Write(fd, "GET /big HTTP/1.1\r\n\r\nGET /none HTTP/1.1\r\n\r\n");
+        std::string s;
+        char buf[65536];
+        while (s.find("204 No Content") == std::string::npos ||
+               s.find("\r\n\r\n", s.find("204 No Content")) ==
+                   std::string::npos) {
+          ssize_t n = ::read(fd, buf, sizeof(buf));
+          if (n <= 0) {
+            break;
+          }
+          s.append(buf, static_cast<size_t>(n));
+        }
+        ASSERT_EQ(s.find("HTTP/1.1 404 Not Found\r\nDate: "), 0U);
+        ASSERT_NE(s.find("\r\nContent-Length: 1048576\r\n"),
+                  std::string::npos);
+        size_t body = s.find("\r\n\r\n") + 4;
+        ASSERT_EQ(s.substr(body, big->size()), *big);
+        std::string rest(s.substr(body + big->size()));
+        ASSERT_EQ(rest.find("HTTP/1.1 204 No Content\r\nDate: "), 0U);
+        ASSERT_EQ(rest.find("Content-Length"), std::string::npos);
+        ::close(fd);
+      });
+}
+
+// Answers every request from another thread, the later ones first, except
+// /now which is answered by the handler.
+static void AsyncTest(int depth) {
+  std::vector<std::thread> threads;
+  RunServer(
+      depth,
+      [&threads](HttpServer* server) {
+        server->SetStreamCallback([&threads](
+            HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+          HttpResponse response;
+          response.SetVersion(request->Version());
+          response.SetBody(request->Path() + ":</r>");
+          if (request->Path() == "/now") {
+            writer->Send(&response);
+            return;
+          }
+          int delay = 40000 - 5000 * atoi(request->Path().c_str() + 1);
+          threads.push_back(std::thread([writer, response, delay]() mutable {
+            usleep(static_cast<useconds_t>(delay));
+            writer->Send(&response);
+          }));
+        });
+      },
+      [](uint16_t port) {
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        Write(fd,
+              "GET /1 HTTP/1.1\r\n\r\nGET /now HTTP/1.1\r\n\r\n"
+              "GET /2 HTTP/1.1\r\n\r\nGET /3 HTTP/1.1\r\n\r\n"
+              "GET /4 HTTP/1.1\r\n\r\nGET /5 HTTP/1.1\r\n\r\n"
+              "GET /6 HTTP/1.1\r\nConnection: close\r\n\r\n"
+              "GET /never HTTP/1.1\r\n\r\n");
+        std::string s(ReadResponses(fd, 8));
+        ASSERT_EQ(Count(s, "</r>"), 7U);
+        const char* order[] = {"/1:", "/now:", "/2:", "/3:",
+                               "/4:", "/5:",   "/6:"};
+        for (int i = 1; i < 7; ++i) {
+          ASSERT_LT(s.find(order[i - 1]), s.find(order[i]));
+        }
+        ASSERT_NE(s.find("/6:"), std::string::npos);
+        ASSERT_EQ(s.find("/never"), std::string::npos);
+        ::close(fd);
+      });
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+TEST(HttpServerTest, Async) { AsyncTest(32); }
+
+TEST(HttpServerTest, AsyncDepth) { AsyncTest(2); }
+
+TEST(HttpServerTest, KeepAlive) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.tick_time = 50000;
+  options.keep_alive_time_out = 200000;
+  std::vector<std::thread> threads;
+  RunServer(
+      options,
+      [&threads](HttpServer* server) {
+        server->SetStreamCallback([&threads](
+            HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+          // Answered well after the keep alive timeout.
+          threads.push_back(std::thread([writer, request]() {
+            usleep(600000);
+            HttpResponse response;
+            response.SetVersion(request->Version());
+            response.SetBody(request->Path() + ":</r>");
+            writer->Send(&response);
+          }));
+        });
+      },
+      [](uint16_t port) {
+        int idle = test::Connect(port);
+        ASSERT_GE(idle, 0);
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        Write(fd, "GET /slow HTTP/1.1\r\n\r\n");
+        std::string s(ReadResponses(fd, 1));
+        ASSERT_NE(s.find("/slow:</r>"), std::string::npos);
+        // The connection which sent nothing was closed meanwhile.
+        char c;
+        ASSERT_EQ(::read(idle, &c, 1), 0);
+        ::close(idle);
+        ::close(fd);
+      });
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+TEST(HttpServerTest, Overload) {
+  HttpServerOptions options;
+  options.port = 0;
+  options.overload_control = true;
+  options.overload.max_lag_micros = 5000;
+  // Stays overloaded once it is.
+  options.overload.recover_lag_micros = 0;
+  options.overload.interval_micros = 1000;
+  options.overload.shed_connections = 0;
+  std::vector<std::thread> threads;
+  RunServer(
+      options,
+      [&threads](HttpServer* server) {
+        server->SetStreamCallback([&threads](
+            HttpRequestPtr request, const HttpResponseWriterPtr& writer) {
+          HttpResponse response;
+          response.SetVersion(request->Version());
+          response.SetBody(request->Path() + ":</r>");
+          if (request->Path() == "/block") {
+            // Puts the loop behind.
+            usleep(30000);
+            writer->Send(&response);
+            return;
+          }
+          threads.push_back(std::thread([writer, response]() mutable {
+            usleep(200000);
+            writer->Send(&response);
+          }));
+        });
+      },
+      [](uint16_t port) {
+        int fd = test::Connect(port);
+        ASSERT_GE(fd, 0);
+        Write(fd, "GET /async HTTP/1.1\r\n\r\nGET /block HTTP/1.1\r\n\r\n");
+        usleep(50000);
+        // Refused, but only after the responses still pending.
+        Write(fd, "GET /refused HTTP/1.1\r\n\r\n");
+        std::string s(ReadAll(fd));
+        size_t async = s.find("/async:</r>");
+        size_t block = s.find("/block:</r>");
+        size_t refused = s.find("HTTP/1.1 503 Service Unavailable\r\n");
+        ASSERT_TRUE(async < block && block < refused &&
+                    refused != std::string::npos);
+        ASSERT_EQ(s.find("/refused"), std::string::npos);
+        ::close(fd);
+      });
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) { return voyager::test::RunAllTests(); }
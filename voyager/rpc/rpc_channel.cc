@@ -41,8 +41,6 @@ void RpcChannel::CallMethod(const google::protobuf::MethodDescriptor* method,
     TimerId t;
     if (micros_ > 0) {
       t = loop_->RunAfter(micros_, std::bind(&RpcChannel::OnTimeout, this, id));
-    } else {
-      t.second = nullptr;
     }
     std::lock_guard<std::mutex> lock(mutex_);
     call_map_[id] = CallData(response, done, t);
@@ -86,7 +84,7 @@ bool RpcChannel::OnResponse(const TcpConnectionPtr& p,
       call_map_.erase(it);
     }
   }
-  if (data.timer.second != nullptr) {
+  if (data.timer.Valid()) {
     loop_->RemoveTimer(data.timer);
   }
 
@@ -0,0 +1,420 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "voyager/util/async_logging.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace voyager {
+
+// A byte ring for one producer thread and the flusher. Only whole lines
+// are published, so the flusher copies out raw bytes without parsing.
+class LogRing {
+ public:
+  explicit LogRing(size_t capacity)
+      : kicked(false),
+        abandoned(false),
+        appending(false),
+        mask_(RoundUp(capacity) - 1),
+        data_(new char[mask_ + 1]),
+        head_(0),
+        tail_(0) {}
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // Producer only, false if there is no room. *used is the bytes buffered
+  // afterwards.
+  bool Push(const char* p, size_t n, size_t* used) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (n > Capacity() - static_cast<size_t>(tail - head)) {
+      return false;
+    }
+    size_t offset = static_cast<size_t>(tail & mask_);
+    size_t first = std::min(n, Capacity() - offset);
+    memcpy(data_.get() + offset, p, first);
+    memcpy(data_.get(), p + first, n - first);
+    tail_.store(tail + n, std::memory_order_release);
+    *used = static_cast<size_t>(tail + n - head);
+    return true;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Consumer only.
+  template <typename W>
+  size_t Drain(const W& write) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    size_t n = static_cast<size_t>(tail - head);
+    if (n == 0) {
+      return 0;
+    }
+    size_t offset = static_cast<size_t>(head & mask_);
+    size_t first = std::min(n, Capacity() - offset);
+    write(data_.get() + offset, first);
+    if (n > first) {
+      write(data_.get(), n - first);
+    }
+    head_.store(tail, std::memory_order_release);
+    return n;
+  }
+
+  // Set by the producer once the ring is half full, until the next drain.
+  std::atomic<bool> kicked;
+  // The producer thread has exited.
+  std::atomic<bool> abandoned;
+  // Set by the producer around an Append(), so Stop() can wait for the ones
+  // which still saw the logger running.
+  std::atomic<bool> appending;
+
+ private:
+  static size_t RoundUp(size_t n) {
+    size_t c = 4096;
+    while (c < n) {
+      c <<= 1;
+    }
+    return c;
+  }
+
+  const uint64_t mask_;
+  std::unique_ptr<char[]> data_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+
+  // No copying allowed
+  LogRing(const LogRing&);
+  void operator=(const LogRing&);
+};
+
+namespace {
+
+std::atomic<uint64_t> next_logger_id(1);
+std::atomic<AsyncLogger*> installed(nullptr);
+
+const char* const kLogLevelNames[] = {"DEBUG", "INFO ", "WARN ", "ERROR",
+                                      "FATAL"};
+
+// The ring of the calling thread and its timestamp cache.
+struct ThreadLog {
+  uint64_t logger_id;
+  std::shared_ptr<LogRing> ring;
+  time_t second;
+  char prefix[32];
+  size_t prefix_size;
+  std::string line;
+
+  ThreadLog() : logger_id(0), second(-1), prefix_size(0) {}
+  ~ThreadLog() {
+    if (ring) {
+      ring->abandoned = true;
+    }
+  }
+};
+
+thread_local ThreadLog thread_log;
+
+void AppendUInt(std::string* s, uint64_t v, int width) {
+  char buf[24];
+  int i = sizeof(buf);
+  do {
+    buf[--i] = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0 || static_cast<int>(sizeof(buf)) - i < width);
+  s->append(buf + i, sizeof(buf) - static_cast<size_t>(i));
+}
+
+// "[2016/01/02-03:04:05.123456][LEVEL filename:line] message\n", as
+// DefaultLogHandler prints it. localtime_r() runs once a second.
+void FormatLine(ThreadLog* tl, LogLevel level, const char* filename, int line,
+                const std::string& message) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (ts.tv_sec != tl->second) {
+    struct tm t;
+    localtime_r(&ts.tv_sec, &t);
+    tl->prefix_size = static_cast<size_t>(snprintf(
+        tl->prefix, sizeof(tl->prefix), "[%04d/%02d/%02d-%02d:%02d:%02d.",
+        t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min,
+        t.tm_sec));
+    tl->second = ts.tv_sec;
+  }
+  std::string* s = &tl->line;
+  s->clear();
+  s->append(tl->prefix, tl->prefix_size);
+  AppendUInt(s, static_cast<uint64_t>(ts.tv_nsec / 1000), 6);
+  s->append("][", 2);
+  s->append(kLogLevelNames[level]);
+  s->push_back(' ');
+  s->append(filename);
+  s->push_back(':');
+  AppendUInt(s, static_cast<uint64_t>(line), 1);
+  s->append("] ", 2);
+  s->append(message);
+  s->push_back('\n');
+}
+
+}  // anonymous namespace
+
+AsyncLoggerOptions::AsyncLoggerOptions()
+    : roll_size(64 * 1024 * 1024),
+      roll_seconds(24 * 3600),
+      ring_size(1024 * 1024),
+      flush_interval_micros(100 * 1000) {}
+
+AsyncLogger::AsyncLogger(const AsyncLoggerOptions& options)
+    : options_(options),
+      id_(next_logger_id.fetch_add(1)),
+      running_(false),
+      accepting_(false),
+      kicked_(false),
+      flush_requests_(0),
+      flushes_(0),
+      dropped_(0),
+      reported_dropped_(0),
+      file_(nullptr),
+      file_size_(0),
+      roll_at_(0),
+      rolls_(0) {}
+
+AsyncLogger::~AsyncLogger() { Stop(); }
+
+void AsyncLogger::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  RollFile(static_cast<uint64_t>(time(nullptr)));
+  thread_.reset(new std::thread([this]() { Run(); }));
+  accepting_ = true;
+}
+
+void AsyncLogger::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || !accepting_) {
+      return;
+    }
+    accepting_ = false;
+  }
+  {
+    // The appends which saw accepting_ before it was cleared are pushed
+    // before the last drain, the later ones count as dropped.
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    for (size_t i = 0; i < rings_.size(); ++i) {
+      while (rings_[i]->appending.load()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  thread_->join();
+  thread_.reset();
+  if (file_ != nullptr && file_ != stderr) {
+    fclose(file_);
+  }
+  file_ = nullptr;
+}
+
+LogRing* AsyncLogger::GetRing() {
+  ThreadLog* tl = &thread_log;
+  if (tl->logger_id != id_) {
+    if (tl->ring) {
+      tl->ring->abandoned = true;
+    }
+    tl->ring.reset(new LogRing(options_.ring_size));
+    tl->logger_id = id_;
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(tl->ring);
+  }
+  return tl->ring.get();
+}
+
+void AsyncLogger::Append(LogLevel level, const char* filename, int line,
+                         const std::string& message) {
+  LogRing* ring = GetRing();
+  // Sequentially consistent with accepting_ in Stop(): either Stop() waits
+  // for this append, or this append sees the logger stopped.
+  ring->appending.store(true);
+  if (!accepting_.load()) {
+    ring->appending.store(false, std::memory_order_relaxed);
+    // Nobody would drain the ring.
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ThreadLog* tl = &thread_log;
+  FormatLine(tl, level, filename, line, message);
+  size_t used = 0;
+  if (!ring->Push(tl->line.data(), tl->line.size(), &used)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    used = ring->Capacity();
+  }
+  ring->appending.store(false, std::memory_order_release);
+  if (used > ring->Capacity() / 2 &&
+      !ring->kicked.exchange(true, std::memory_order_relaxed)) {
+    Kick();
+  }
+}
+
+void AsyncLogger::Kick() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    kicked_ = true;
+  }
+  cv_.notify_one();
+}
+
+void AsyncLogger::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!running_) {
+    return;
+  }
+  uint64_t request = ++flush_requests_;
+  cv_.notify_one();
+  flushed_cv_.wait(lock, [this, request]() {
+    return flushes_ >= request || !running_;
+  });
+}
+
+void AsyncLogger::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait_for(lock,
+                 std::chrono::microseconds(options_.flush_interval_micros),
+                 [this]() {
+                   return kicked_ || !running_ || flush_requests_ != flushes_;
+                 });
+    kicked_ = false;
+    bool stop = !running_;
+    uint64_t requests = flush_requests_;
+    lock.unlock();
+
+    DrainRings();
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+      ThreadLog* tl = &thread_log;
+      FormatLine(tl, LOGLEVEL_WARN, __FILE__, __LINE__,
+                 std::to_string(dropped - reported_dropped_) +
+                     " log messages dropped");
+      Write(tl->line.data(), tl->line.size());
+      reported_dropped_ = dropped;
+    }
+    fflush(file_);
+
+    lock.lock();
+    flushes_ = requests;
+    flushed_cv_.notify_all();
+    if (stop) {
+      break;
+    }
+  }
+}
+
+size_t AsyncLogger::DrainRings() {
+  std::vector<std::shared_ptr<LogRing> > rings;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings = rings_;
+  }
+  size_t bytes = 0;
+  bool abandoned = false;
+  for (size_t i = 0; i < rings.size(); ++i) {
+    LogRing* ring = rings[i].get();
+    // Read before draining: once the thread is gone, the drain empties it.
+    abandoned = ring->abandoned || abandoned;
+    ring->kicked.store(false, std::memory_order_relaxed);
+    bytes += ring->Drain(
+        [this](const char* data, size_t size) { Write(data, size); });
+  }
+  if (abandoned) {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                [](const std::shared_ptr<LogRing>& ring) {
+                                  return ring->abandoned.load() &&
+                                         ring->Empty();
+                                }),
+                 rings_.end());
+  }
+  return bytes;
+}
+
+void AsyncLogger::Write(const char* data, size_t size) {
+  if (!options_.basename.empty()) {
+    uint64_t now = static_cast<uint64_t>(time(nullptr));
+    if (now >= roll_at_ ||
+        (file_size_ > 0 && file_size_ + size > options_.roll_size)) {
+      RollFile(now);
+    }
+  }
+  fwrite(data, 1, size, file_);
+  file_size_ += size;
+}
+
+void AsyncLogger::RollFile(uint64_t now_seconds) {
+  if (options_.basename.empty()) {
+    file_ = stderr;
+    return;
+  }
+  if (file_ != nullptr && file_ != stderr) {
+    fclose(file_);
+  }
+  // Counted whether the file opens or not, the next roll is retried as
+  // usual.
+  file_size_ = 0;
+  roll_at_ = now_seconds + static_cast<uint64_t>(options_.roll_seconds);
+  time_t seconds = static_cast<time_t>(now_seconds);
+  struct tm t;
+  localtime_r(&seconds, &t);
+  char suffix[64];
+  strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &t);
+  std::string name(options_.basename);
+  name += suffix;
+  // Files rolled within the same second still get names of their own.
+  name += "." + std::to_string(getpid()) + "." + std::to_string(++rolls_) +
+          ".log";
+  file_ = fopen(name.c_str(), "ae");
+  if (file_ == nullptr) {
+    fprintf(stderr, "AsyncLogger - can not open %s: %s\n", name.c_str(),
+            strerror(errno));
+    file_ = stderr;
+    return;
+  }
+  setvbuf(file_, nullptr, _IOFBF, 256 * 1024);
+}
+
+void AsyncLogger::Handler(LogLevel level, const char* filename, int line,
+                          const std::string& message) {
+  AsyncLogger* logger = installed.load(std::memory_order_acquire);
+  if (logger == nullptr ||
+      !logger->accepting_.load(std::memory_order_acquire)) {
+    DefaultLogHandler(level, filename, line, message);
+    return;
+  }
+  logger->Append(level, filename, line, message);
+  if (level == LOGLEVEL_FATAL) {
+    logger->Flush();
+  }
+}
+
+void AsyncLogger::Install(AsyncLogger* logger) {
+  installed.store(logger, std::memory_order_release);
+  SetLogHandler(logger != nullptr ? &AsyncLogger::Handler
+                                  : &DefaultLogHandler);
+}
+
+}  // namespace voyager
@@ -0,0 +1,142 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOYAGER_UTIL_ASYNC_LOGGING_H_
+#define VOYAGER_UTIL_ASYNC_LOGGING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voyager/util/logging.h"
+
+namespace voyager {
+
+class LogRing;
+
+struct AsyncLoggerOptions {
+  // Log files are named basename.YYYYmmdd-HHMMSS.pid.N.log, where N counts
+  // the files of the logger. An empty basename writes to stderr without
+  // rotation. While a file can not be opened, the lines go to stderr until
+  // the next roll tries again.
+  // Default: ""
+  std::string basename;
+
+  // A new file is started once the current one reaches roll_size bytes, or
+  // roll_seconds after it was opened.
+  // Default: 64 * 1024 * 1024
+  size_t roll_size;
+  // Default: 24 * 3600
+  int roll_seconds;
+
+  // The bytes buffered for each logging thread, rounded up to a power of two.
+  // Messages which do not fit are dropped and counted, so a thread never
+  // blocks on the disk and the memory stays bounded.
+  // Default: 1024 * 1024
+  size_t ring_size;
+
+  // How often the flusher drains the rings, sooner when one is half full.
+  // Default: 100 * 1000
+  uint64_t flush_interval_micros;
+
+  AsyncLoggerOptions();
+};
+
+// A LogHandler which takes the disk off the logging threads. Every thread
+// formats its lines into its own lock-free ring, reusing a timestamp prefix
+// cached for the current second, and a single flusher thread drains the
+// rings into the log file, which it rotates by size and age:
+//
+//   AsyncLoggerOptions options;
+//   options.basename = "/var/log/server";
+//   AsyncLogger logger(options);
+//   logger.Start();
+//   AsyncLogger::Install(&logger);
+//   ...
+//   AsyncLogger::Install(nullptr);
+//
+// Lines of one thread keep their order, lines of different threads are only
+// ordered by the flush passes. FATAL messages are flushed before the process
+// aborts. While the installed logger is stopped, messages go to
+// DefaultLogHandler.
+class AsyncLogger {
+ public:
+  explicit AsyncLogger(const AsyncLoggerOptions& options);
+  // Stop()s the logger, Install(nullptr) before destroying it.
+  ~AsyncLogger();
+
+  void Start();
+  // Drains the rings and closes the file. Appends which race with it are
+  // either written or counted as dropped.
+  void Stop();
+
+  void Append(LogLevel level, const char* filename, int line,
+              const std::string& message);
+  // Waits until everything appended so far is written.
+  void Flush();
+
+  // Messages dropped because their ring was full, or appended while the
+  // logger was stopped.
+  uint64_t Dropped() const { return dropped_; }
+
+  // Routes VOYAGER_LOG to logger through SetLogHandler(), nullptr restores
+  // DefaultLogHandler.
+  static void Install(AsyncLogger* logger);
+
+ private:
+  static void Handler(LogLevel level, const char* filename, int line,
+                      const std::string& message);
+
+  LogRing* GetRing();
+  void Kick();
+  void Run();
+  // Drains every ring once, returns the bytes written.
+  size_t DrainRings();
+  void Write(const char* data, size_t size);
+  void RollFile(uint64_t now_seconds);
+
+  const AsyncLoggerOptions options_;
+  // Tells the rings of this logger from those of a destroyed one which may
+  // have had the same address.
+  const uint64_t id_;
+
+  std::mutex rings_mutex_;
+  std::vector<std::shared_ptr<LogRing> > rings_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable flushed_cv_;
+  bool running_;
+  // running_ for the producers, which check it without the lock.
+  std::atomic<bool> accepting_;
+  bool kicked_;
+  uint64_t flush_requests_;
+  uint64_t flushes_;
+  std::unique_ptr<std::thread> thread_;
+
+  std::atomic<uint64_t> dropped_;
+  uint64_t reported_dropped_;
+
+  // Only touched by the flusher.
+  FILE* file_;
+  size_t file_size_;
+  uint64_t roll_at_;
+  uint64_t rolls_;
+
+  // No copying allowed
+  AsyncLogger(const AsyncLogger&);
+  void operator=(const AsyncLogger&);
+};
+
+}  // namespace voyager
+
+#endif  // VOYAGER_UTIL_ASYNC_LOGGING_H_
@@ -15,6 +15,7 @@
 
 #include "voyager/util/slice.h"
 #include "voyager/util/status.h"
+#include "voyager/util/timeops.h"
 
 namespace voyager {
 
@@ -41,7 +42,21 @@ void NullLogHandler(LogLevel /* level */, const char* /* filename */,
                     int /* line */, const std::string& /* message */) {}
 
 static LogHandler* log_handler_ = &DefaultLogHandler;
-static LogLevel log_level_ = LOGLEVEL_WARN;
+
+namespace internal {
+LogLevel log_level = LOGLEVEL_WARN;
+}  // namespace internal
+
+bool LogRate::EveryMs(uint64_t ms) {
+  uint64_t now = timeops::CoarseMonotonicMicros();
+  uint64_t next = next_micros_.load(std::memory_order_relaxed);
+  if (now < next) {
+    return false;
+  }
+  // Only one of the threads which race here wins.
+  return next_micros_.compare_exchange_strong(next, now + ms * 1000,
+                                              std::memory_order_relaxed);
+}
 
 Logger::Logger(LogLevel level, const char* filename, int line)
     : level_(level), filename_(filename), line_(line) {}
@@ -107,7 +122,7 @@ DECLARE_STREAM_OPERATOR(const void*, "%p")
 #undef DECLARE_STREAM_OPERATOR
 
 void Logger::Finish() {
-  if (level_ >= log_level_) {
+  if (level_ >= internal::log_level) {
     log_handler_(level_, filename_, line_, message_);
   }
 
@@ -136,8 +151,8 @@ LogHandler* SetLogHandler(LogHandler* new_func) {
 }
 
 LogLevel SetLogLevel(LogLevel new_level) {
-  LogLevel old_level = log_level_;
-  log_level_ = new_level;
+  LogLevel old_level = internal::log_level;
+  internal::log_level = new_level;
   return old_level;
 }
 
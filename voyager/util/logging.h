@@ -5,6 +5,9 @@
 #ifndef VOYAGER_UTIL_LOGGING_H_
 #define VOYAGER_UTIL_LOGGING_H_
 
+#include <stdint.h>
+
+#include <atomic>
 #include <string>
 #include <thread>
 
@@ -61,9 +64,68 @@ class LogFinisher {
   void operator=(Logger& logger);
 };
 
-#define VOYAGER_LOG(LEVEL)   \
-  ::voyager::LogFinisher() = \
-      ::voyager::Logger(::voyager::LOGLEVEL_##LEVEL, __FILE__, __LINE__)
+// The state of one VOYAGER_LOG_EVERY_N or VOYAGER_LOG_EVERY_MS statement.
+class LogRate {
+ public:
+  LogRate() : count_(0), next_micros_(0) {}
+
+  // True for the 1st, the (n+1)th, ... call.
+  bool EveryN(uint64_t n) {
+    return count_.fetch_add(1, std::memory_order_relaxed) % n == 0;
+  }
+  // True at most once every ms milliseconds.
+  bool EveryMs(uint64_t ms);
+
+ private:
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> next_micros_;
+
+  // No copying allowed
+  LogRate(const LogRate&);
+  void operator=(const LogRate&);
+};
+
+namespace internal {
+extern LogLevel log_level;
+}  // namespace internal
+
+// Statements below VOYAGER_MIN_LOG_LEVEL (a LogLevel value) are removed at
+// compile time, except for FATAL ones, e.g. -DVOYAGER_MIN_LOG_LEVEL=1 drops
+// every VOYAGER_LOG(DEBUG).
+#ifndef VOYAGER_MIN_LOG_LEVEL
+#define VOYAGER_MIN_LOG_LEVEL 0
+#endif
+
+#define VOYAGER_LOG_IS_ON(LEVEL)                                  \
+  ((::voyager::LOGLEVEL_##LEVEL >= VOYAGER_MIN_LOG_LEVEL ||       \
+    ::voyager::LOGLEVEL_##LEVEL == ::voyager::LOGLEVEL_FATAL) &&  \
+   ::voyager::LOGLEVEL_##LEVEL >= ::voyager::internal::log_level)
+
+#define VOYAGER_LOG_IF_(LEVEL, CONDITION)                             \
+  !(CONDITION) ? (void)0                                              \
+               : ::voyager::LogFinisher() =                           \
+                     ::voyager::Logger(::voyager::LOGLEVEL_##LEVEL,   \
+                                       __FILE__, __LINE__)
+
+// The operands of << are not evaluated at all when LEVEL is disabled.
+#define VOYAGER_LOG(LEVEL) VOYAGER_LOG_IF_(LEVEL, VOYAGER_LOG_IS_ON(LEVEL))
+
+// For the hot paths, such as a failing read on every connection: only the
+// 1st, (N+1)th, ... occurrence, or at most one occurrence every MS
+// milliseconds, is logged. The lambda gives every statement its own state.
+#define VOYAGER_LOG_RATE_           \
+  []() -> ::voyager::LogRate& {     \
+    static ::voyager::LogRate rate; \
+    return rate;                    \
+  }()
+
+#define VOYAGER_LOG_EVERY_N(LEVEL, N) \
+  VOYAGER_LOG_IF_(LEVEL,              \
+                  VOYAGER_LOG_IS_ON(LEVEL) && VOYAGER_LOG_RATE_.EveryN(N))
+
+#define VOYAGER_LOG_EVERY_MS(LEVEL, MS) \
+  VOYAGER_LOG_IF_(LEVEL,                \
+                  VOYAGER_LOG_IS_ON(LEVEL) && VOYAGER_LOG_RATE_.EveryMs(MS))
 
 template <typename T>
 T* CheckNotNull(const char* /* filename */, int /* line */,
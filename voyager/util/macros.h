@@ -30,4 +30,14 @@
   } while (0)
 #endif
 
+// Hints for the branch predictor in the hottest paths, such as the checks of
+// optional instrumentation in EventLoop::Loop().
+#if defined(__GNUC__)
+#define VOYAGER_PREDICT_FALSE(x) (__builtin_expect(!!(x), 0))
+#define VOYAGER_PREDICT_TRUE(x) (__builtin_expect(!!(x), 1))
+#else
+#define VOYAGER_PREDICT_FALSE(x) (x)
+#define VOYAGER_PREDICT_TRUE(x) (x)
+#endif
+
 #endif  // VOYAGER_UTIL_MACROS_H_
@@ -0,0 +1,107 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voyager/util/async_logging.h"
+#include "voyager/util/logging.h"
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+// Every thread logs count lines like a server accepting connections, and
+// returns the time the threads spent logging.
+static uint64_t LogFromThreads(int threads, int count) {
+  std::vector<std::thread> workers;
+  uint64_t start = timeops::MonotonicNanos();
+  for (int t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([t, count]() {
+      for (int i = 0; i < count; ++i) {
+        VOYAGER_LOG(INFO) << "TcpServer::NewConnection [bench] - new "
+                          << "connection [127.0.0.1:5666-127.0.0.1:" << t
+                          << "#" << i << "]";
+      }
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+  return timeops::MonotonicNanos() - start;
+}
+
+static void Report(const char* name, uint64_t total, uint64_t nanos) {
+  fprintf(stdout, "%-32s %8.1f ns/msg %10.0f msgs/s\n", name,
+          static_cast<double>(nanos) / static_cast<double>(total),
+          static_cast<double>(total) * 1e9 / static_cast<double>(nanos));
+}
+
+static void RemoveDir(const std::string& dir) {
+  DIR* d = opendir(dir.c_str());
+  if (d != nullptr) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != nullptr) {
+      std::string name(entry->d_name);
+      if (name != "." && name != "..") {
+        unlink((dir + "/" + name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  int threads = argc > 1 ? atoi(argv[1]) : 4;
+  int count = argc > 2 ? atoi(argv[2]) : 200000;
+  uint64_t total = static_cast<uint64_t>(threads) * count;
+
+  char dir[] = "/tmp/voyager_log_benchXXXXXX";
+  if (mkdtemp(dir) == nullptr) {
+    perror("mkdtemp");
+    return 1;
+  }
+  voyager::SetLogLevel(voyager::LOGLEVEL_INFO);
+
+  // DefaultLogHandler, with stderr sent to a file.
+  std::string path = std::string(dir) + "/default.log";
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  int saved = dup(2);
+  dup2(fd, 2);
+  close(fd);
+  uint64_t nanos = voyager::LogFromThreads(threads, count);
+  fflush(stderr);
+  dup2(saved, 2);
+  close(saved);
+  voyager::Report("DefaultLogHandler", total, nanos);
+
+  voyager::AsyncLoggerOptions options;
+  options.basename = std::string(dir) + "/async";
+  voyager::AsyncLogger logger(options);
+  logger.Start();
+  voyager::AsyncLogger::Install(&logger);
+  uint64_t start = voyager::timeops::MonotonicNanos();
+  nanos = voyager::LogFromThreads(threads, count);
+  logger.Flush();
+  uint64_t flushed = voyager::timeops::MonotonicNanos() - start;
+  voyager::AsyncLogger::Install(nullptr);
+  logger.Stop();
+  voyager::Report("AsyncLogger", total, nanos);
+  voyager::Report("AsyncLogger until flushed", total, flushed);
+  fprintf(stdout, "AsyncLogger dropped %llu of %llu messages\n",
+          static_cast<unsigned long long>(logger.Dropped()),
+          static_cast<unsigned long long>(total));
+
+  voyager::RemoveDir(dir);
+  return 0;
+}
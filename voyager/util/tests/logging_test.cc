@@ -2,6 +2,18 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "voyager/util/async_logging.h"
 #include "voyager/util/logging.h"
 #include "voyager/util/testharness.h"
 
@@ -9,6 +21,166 @@ namespace voyager {
 
 class LoggingTest {};
 
+// The paths of the files in dir.
+static std::vector<std::string> ListFiles(const std::string& dir) {
+  std::vector<std::string> files;
+  DIR* d = opendir(dir.c_str());
+  struct dirent* entry;
+  while ((entry = readdir(d)) != nullptr) {
+    if (entry->d_name[0] != '.') {
+      files.push_back(dir + "/" + entry->d_name);
+    }
+  }
+  closedir(d);
+  return files;
+}
+
+// Counts the lines of the files which contain what, and removes the files.
+static int CountAndRemove(const std::vector<std::string>& files,
+                          const char* what) {
+  int n = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    FILE* f = fopen(files[i].c_str(), "r");
+    char line[1024];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+      if (strstr(line, what) != nullptr) {
+        ++n;
+      }
+    }
+    fclose(f);
+    unlink(files[i].c_str());
+  }
+  return n;
+}
+
+TEST(LoggingTest, AsyncLogger) {
+  char dir[] = "/tmp/voyager_logging_testXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  AsyncLoggerOptions options;
+  options.basename = std::string(dir) + "/test";
+  options.roll_size = 1024;
+  AsyncLogger logger(options);
+  // Not started yet, nothing would drain it.
+  logger.Append(LOGLEVEL_WARN, __FILE__, __LINE__, "lost");
+  ASSERT_EQ(logger.Dropped(), 1U);
+  logger.Start();
+  AsyncLogger::Install(&logger);
+  for (int i = 0; i < 100; ++i) {
+    VOYAGER_LOG(WARN) << "async message " << i;
+    if (i % 5 == 4) {
+      logger.Flush();
+    }
+  }
+  AsyncLogger::Install(nullptr);
+  logger.Stop();
+  ASSERT_EQ(logger.Dropped(), 1U);
+
+  std::vector<std::string> files(ListFiles(dir));
+  int lines = 0;
+  int reports = 0;
+  for (size_t i = 0; i < files.size(); ++i) {
+    FILE* f = fopen(files[i].c_str(), "r");
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+      ASSERT_EQ(line[0], '[');
+      // The report of the drops is formatted like the other lines.
+      ASSERT_TRUE(strstr(line, "][WARN ") != nullptr);
+      if (strstr(line, "] 1 log messages dropped") != nullptr) {
+        ++reports;
+      }
+      ++lines;
+    }
+    fclose(f);
+    unlink(files[i].c_str());
+  }
+  rmdir(dir);
+  // Rolled by size, within the same second too, without reusing a file.
+  ASSERT_GT(files.size(), 1U);
+  ASSERT_EQ(lines, 101);
+  ASSERT_EQ(reports, 1);
+}
+
+TEST(LoggingTest, AsyncLoggerRetryRoll) {
+  char dir[] = "/tmp/voyager_logging_testXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  std::string sub(std::string(dir) + "/sub");
+  AsyncLoggerOptions options;
+  options.basename = sub + "/test";
+  options.roll_size = 1024;
+  AsyncLogger logger(options);
+  // The directory is missing, the first lines go to stderr.
+  logger.Start();
+  std::string big(400, 'x');
+  for (int i = 0; i < 3; ++i) {
+    logger.Append(LOGLEVEL_WARN, __FILE__, __LINE__, big);
+  }
+  logger.Flush();
+  ASSERT_EQ(mkdir(sub.c_str(), 0700), 0);
+  // The next roll by size opens the file after all.
+  logger.Append(LOGLEVEL_WARN, __FILE__, __LINE__, "to the file");
+  logger.Stop();
+  std::vector<std::string> files(ListFiles(sub));
+  ASSERT_EQ(files.size(), 1U);
+  ASSERT_EQ(CountAndRemove(files, "] to the file"), 1);
+  rmdir(sub.c_str());
+  rmdir(dir);
+}
+
+TEST(LoggingTest, AsyncLoggerStopRace) {
+  char dir[] = "/tmp/voyager_logging_testXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  AsyncLoggerOptions options;
+  options.basename = std::string(dir) + "/test";
+  AsyncLogger logger(options);
+  logger.Start();
+  const int kThreads = 4;
+  const int kMessages = 2000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.push_back(std::thread([&logger]() {
+      for (int i = 0; i < kMessages; ++i) {
+        logger.Append(LOGLEVEL_INFO, __FILE__, __LINE__, "race");
+      }
+    }));
+  }
+  logger.Stop();
+  for (int t = 0; t < kThreads; ++t) {
+    threads[t].join();
+  }
+  // Every message is either written or counted as dropped.
+  int written = CountAndRemove(ListFiles(dir), "] race");
+  rmdir(dir);
+  ASSERT_EQ(static_cast<uint64_t>(written) + logger.Dropped(),
+            static_cast<uint64_t>(kThreads * kMessages));
+}
+
+static int evaluated = 0;
+
+static int Evaluate() { return ++evaluated; }
+
+TEST(LoggingTest, Lazy) {
+  LogHandler* old = SetLogHandler(nullptr);
+  evaluated = 0;
+  VOYAGER_LOG(DEBUG) << Evaluate();
+  VOYAGER_LOG(INFO) << Evaluate();
+  ASSERT_EQ(evaluated, 0);
+  VOYAGER_LOG(ERROR) << Evaluate();
+  ASSERT_EQ(evaluated, 1);
+
+  evaluated = 0;
+  for (int i = 0; i < 25; ++i) {
+    VOYAGER_LOG_EVERY_N(ERROR, 10) << Evaluate();
+  }
+  ASSERT_EQ(evaluated, 3);
+
+  evaluated = 0;
+  for (int i = 0; i < 5; ++i) {
+    VOYAGER_LOG_EVERY_MS(ERROR, 100000) << Evaluate();
+  }
+  ASSERT_EQ(evaluated, 1);
+  SetLogHandler(old);
+}
+
 TEST(LoggingTest, Simple) {
   char v1[] = "test char logger";
   short v2 = -1;
@@ -0,0 +1,49 @@
+// Copyright (c) 2016 Mirants Lu. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "voyager/util/timeops.h"
+
+namespace voyager {
+
+static uint64_t Gettimeofday() {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static void Bench(const char* name, uint64_t (*clock)(), int iterations) {
+  uint64_t sum = 0;
+  uint64_t start = timeops::MonotonicNanos();
+  for (int i = 0; i < iterations; ++i) {
+    sum += clock();
+  }
+  uint64_t end = timeops::MonotonicNanos();
+  fprintf(stdout, "%-24s %8.2f ns/call (checksum %" PRIu64 ")\n", name,
+          static_cast<double>(end - start) / iterations, sum & 0xff);
+}
+
+}  // namespace voyager
+
+int main(int argc, char** argv) {
+  int iterations = 10000000;
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+  }
+  // Calibrate the TSC outside of the timed section.
+  voyager::timeops::TscNanos();
+
+  voyager::Bench("gettimeofday", &voyager::Gettimeofday, iterations);
+  voyager::Bench("NowMicros", &voyager::timeops::NowMicros, iterations);
+  voyager::Bench("MonotonicMicros", &voyager::timeops::MonotonicMicros,
+                 iterations);
+  voyager::Bench("CoarseMonotonicMicros",
+                 &voyager::timeops::CoarseMonotonicMicros, iterations);
+  voyager::Bench("TscNanos", &voyager::timeops::TscNanos, iterations);
+  return 0;
+}
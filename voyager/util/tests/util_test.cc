@@ -111,6 +111,14 @@ TEST(StringPrintfTest, TestStringPrintf) {
 TEST(TimeopsTest, TestTimeops) {
   VOYAGER_LOG(INFO) << timeops::NowMicros();
   VOYAGER_LOG(INFO) << timeops::FormatTimestamp(timeops::NowMicros());
+
+  uint64_t mono = timeops::MonotonicMicros();
+  ASSERT_LE(mono, timeops::MonotonicMicros());
+  uint64_t tsc = timeops::TscNanos();
+  ASSERT_LE(tsc, timeops::TscNanos());
+  // The calibrated TSC stays on the CLOCK_MONOTONIC time base.
+  uint64_t diff = timeops::TscNanos() / 1000 - timeops::MonotonicMicros();
+  ASSERT_LT(diff + 1000, 2000U);
 }
 
 }  // namespace voyager
@@ -7,6 +7,12 @@
 #include <sys/time.h>
 #include <time.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define VOYAGER_HAVE_TSC 1
+#endif
+
 namespace voyager {
 namespace timeops {
 
@@ -16,6 +22,87 @@ uint64_t NowMicros() {
   return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
 }
 
+static inline uint64_t ClockNanos(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * kNonasSecondsPerSecond +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint64_t MonotonicMicros() { return ClockNanos(CLOCK_MONOTONIC) / 1000; }
+
+uint64_t MonotonicNanos() { return ClockNanos(CLOCK_MONOTONIC); }
+
+uint64_t CoarseMonotonicMicros() {
+#ifdef CLOCK_MONOTONIC_COARSE
+  return ClockNanos(CLOCK_MONOTONIC_COARSE) / 1000;
+#else
+  return ClockNanos(CLOCK_MONOTONIC) / 1000;
+#endif
+}
+
+#ifdef VOYAGER_HAVE_TSC
+namespace {
+
+class TscClock {
+ public:
+  TscClock() : usable_(false), base_tsc_(0), base_nanos_(0), scale_(0) {
+    unsigned int eax, ebx, ecx, edx;
+    // CPUID.80000007H:EDX[8] reports a TSC which runs at a constant rate
+    // in all ACPI P-, C- and T-states.
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) &&
+        (edx & (1U << 8))) {
+      Calibrate();
+    }
+  }
+
+  bool usable() const { return usable_; }
+
+  uint64_t Nanos() const {
+    uint64_t cycles = __rdtsc() - base_tsc_;
+    return base_nanos_ +
+           static_cast<uint64_t>(static_cast<double>(cycles) * scale_);
+  }
+
+ private:
+  // Measures the TSC rate over about 5ms of CLOCK_MONOTONIC.
+  void Calibrate() {
+    static const uint64_t kCalibrateNanos = 5 * 1000 * 1000;
+    uint64_t start_nanos = MonotonicNanos();
+    uint64_t start_tsc = __rdtsc();
+    uint64_t end_nanos;
+    do {
+      end_nanos = MonotonicNanos();
+    } while (end_nanos - start_nanos < kCalibrateNanos);
+    uint64_t end_tsc = __rdtsc();
+    if (end_tsc > start_tsc) {
+      scale_ = static_cast<double>(end_nanos - start_nanos) /
+               static_cast<double>(end_tsc - start_tsc);
+      base_tsc_ = end_tsc;
+      base_nanos_ = end_nanos;
+      usable_ = true;
+    }
+  }
+
+  bool usable_;
+  uint64_t base_tsc_;
+  uint64_t base_nanos_;
+  double scale_;
+};
+
+}  // anonymous namespace
+#endif
+
+uint64_t TscNanos() {
+#ifdef VOYAGER_HAVE_TSC
+  static const TscClock tsc;
+  if (tsc.usable()) {
+    return tsc.Nanos();
+  }
+#endif
+  return MonotonicNanos();
+}
+
 std::string FormatTimestamp(uint64_t micros) {
   const time_t seconds = static_cast<time_t>(micros / 1000000);
   micros = static_cast<int>(micros % 1000000);
@@ -18,8 +18,24 @@ static const uint64_t kMilliSecondsPerSecond = 1000;
 static const uint64_t kMicroSecondsPerSecond = 1000 * 1000;
 static const uint64_t kNonasSecondsPerSecond = 1000 * 1000 * 1000;
 
+// Wall clock time, from gettimeofday.
 extern uint64_t NowMicros();
 
+// CLOCK_MONOTONIC, which never jumps when the system clock is adjusted.
+extern uint64_t MonotonicMicros();
+extern uint64_t MonotonicNanos();
+
+// CLOCK_MONOTONIC_COARSE, only as precise as a scheduler tick (1~4ms), but
+// cheaper than MonotonicMicros(). Falls back to CLOCK_MONOTONIC where the
+// coarse clock is not available.
+extern uint64_t CoarseMonotonicMicros();
+
+// The invariant TSC calibrated against CLOCK_MONOTONIC on first use, so the
+// result shares the time base of MonotonicNanos(). It is the cheapest clock
+// here, but may drift a few microseconds per second from CLOCK_MONOTONIC.
+// Falls back to MonotonicNanos() when the cpu has no invariant TSC.
+extern uint64_t TscNanos();
+
 extern std::string FormatTimestamp(uint64_t micros);
 
 }  // namespace timeops